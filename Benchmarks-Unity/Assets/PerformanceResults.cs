@@ -33,7 +33,7 @@ public class PerformanceResults : MonoBehaviour{
 
 	// The different types of data, renderers and geometry modes.
 	public enum DataType { None, Frametime, GpuUsage, MemoryUsage, SharedMemory, BusUsage, DedicatedMemory, FbUsage }
-	public enum Renderer { None, All, Forward, GBuffer3, GBuffer6, VBuffer }
+	public enum Renderer { None, All, Forward, GBuffer3, GBuffer6, VBuffer, ForwardPlus }
 	public enum Mode { None, All, CompComp, GeomGeom, VertVert, VertGeom }
 	
 	// Represents an int that can hold an additional value "Unset"
@@ -64,8 +64,8 @@ public class PerformanceResults : MonoBehaviour{
 	// Parses a string in the format fwd_co_0_1024x768_2_400_29 (R_M_P_WxH_C_D_S) to return the settings
 	(Renderer renderer, Mode mode, int pCount, int resW, int resH, int complexity, int density, int spread) getTestParams(string testName) {
 		string[] split = testName.Split('_');
-		if(split.Length != 7) {
-			Debug.LogError("Cannot parse " + testName + ": splitting results in " + split.Length + " strings instead of 7.");
+		if(split.Length < 7) {// further parts (V-Buffer encoding, eg. _u32_pid) may follow; they are not filtered on
+			Debug.LogError("Cannot parse " + testName + ": splitting results in " + split.Length + " strings instead of at least 7.");
 			return (Renderer.None, Mode.None, -1, -1, -1, -1, -1, -1);
 		}
 		Renderer renderer;
@@ -74,6 +74,7 @@ public class PerformanceResults : MonoBehaviour{
 
 		switch(split[0]) {// Renderer
 			case "fwd": renderer = Renderer.Forward; break;
+			case "fwdp": renderer = Renderer.ForwardPlus; break;
 			case "g3": renderer = Renderer.GBuffer3; break;
 			case "g6": renderer = Renderer.GBuffer6; break;
 			case "v": renderer = Renderer.VBuffer; break;
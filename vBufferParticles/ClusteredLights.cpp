@@ -0,0 +1,111 @@
+#include "ClusteredLights.h"
+
+
+uint32_t ClusteredLights::lightCount = 0;
+
+
+ClusteredLights::ClusteredLights(DevicesPtr devices, const VkDescriptorPool& descriptorPool, int swapchainSize, bool binning) : devices(devices) {
+
+	/// Generate the lights (deterministic, so that all scenes and runs light the same way): scattered above the ground, with random hues
+	lights.resize(CLUSTERED_MAX_LIGHTS);
+	uint32_t seed = 1;
+	auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return (seed >> 8) / (float)(1 << 24); };// LCG, in [0, 1)
+	for (PointLight& light : lights) {
+		glm::vec3 position(random() * 12.f - 6.f, random() * 4.2f - 2.2f, random() * 12.f - 6.f);
+		float range = 1.f + random() * 1.5f;
+		float hue = random() * 6.f;
+		glm::vec3 colour = glm::clamp(glm::vec3(glm::abs(hue - 3.f) - 1.f, 2.f - glm::abs(hue - 2.f), 2.f - glm::abs(hue - 4.f)), 0.f, 1.f);
+		light.position_range = glm::vec4(position, range);
+		light.colour = glm::vec4(colour * 2.f, 0);
+	}
+
+	/// Buffers
+	clusterBuffer = new UniformBuffer<ClusterUBO>(swapchainSize, devices(), devices->getPhysicalDevice());
+	lightsBuffer = new UniformBuffer<PointLight>(swapchainSize, devices(), devices->getPhysicalDevice(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, CLUSTERED_MAX_LIGHTS);
+	if (!binning) return;
+	clustersBuffer = new UniformBuffer<uint32_t>(swapchainSize, devices(), devices->getPhysicalDevice(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, CLUSTER_COUNT * (1 + CLUSTER_MAX_LIGHTS));
+
+	/// Light binning pass: cluster UBO, lights in; clusters out
+	DESCRIPTOR_BINDING_ARRAY bindings = {};
+	appendBindings(bindings, VK_SHADER_STAGE_COMPUTE_BIT);
+	descriptor = new Descriptor(bindings, devices(), VK_PIPELINE_BIND_POINT_COMPUTE);
+	descriptor->createPipelineLayout();
+	std::vector<Descriptor::UBODescriptor> uboDescriptors = {};
+	appendDescriptors(uboDescriptors);
+	std::vector<Descriptor::ImageInfoDescriptor> imgDescriptors = {};
+	descriptor->createDescriptorSets(swapchainSize, descriptorPool, uboDescriptors, imgDescriptors);
+	pipeline = new ComputePipeline("light_clusters", descriptor->getPipelineLayout(), devices());
+
+}
+
+ClusteredLights::~ClusteredLights() {
+	DELETE(pipeline);
+	DELETE(descriptor);
+	DELETE(clusterBuffer);
+	DELETE(lightsBuffer);
+	DELETE(clustersBuffer);
+}
+
+void ClusteredLights::Update(uint32_t imageIndex, float time, const glm::mat4& view, const glm::mat4& proj) {
+
+	/// Lights bob up and down, each with its own phase
+	std::vector<PointLight> frameLights(lights.begin(), lights.begin() + lightCount);
+	for (uint32_t i = 0; i < lightCount; ++i)
+		frameLights[i].position_range.y += 0.3f * sin(time * 1.3f + i * 0.7f);
+	lightsBuffer->copyBuffer(imageIndex, frameLights.data(), frameLights.size());
+
+	ClusterUBO ubo = {};
+	ubo.view = view;
+	ubo.projScale = glm::vec4(proj[0][0], proj[1][1], proj[2][2], proj[3][2]);
+	ubo.lightCount = lightCount;
+	clusterBuffer->copyBuffer(imageIndex, ubo);
+}
+
+void ClusteredLights::cmdBindCompute(const VkCommandBuffer& cmdBuffer, int index) {
+
+	/// One invocation per cluster
+	descriptor->cmdBind(cmdBuffer, index);
+	pipeline->cmdBind(cmdBuffer, index);
+	vkCmdDispatch(cmdBuffer, CLUSTER_COUNT / CLUSTER_GROUP, 1, 1);
+
+	/// Make the light lists visible to the lighting pass (full-screen subpass or compute shading)
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, NULL, 0, NULL);
+
+}
+
+void ClusteredLights::appendBindings(DESCRIPTOR_BINDING_ARRAY& bindings, VkShaderStageFlags stage) {
+	appendLightBindings(bindings, stage);
+	bindings.push_back({ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stage });
+}
+
+void ClusteredLights::appendDescriptors(std::vector<Descriptor::UBODescriptor>& uboDescriptors) {
+	assert(clustersBuffer);
+	appendLightDescriptors(uboDescriptors);
+	uboDescriptors.push_back(Descriptor::UBODescriptor(clustersBuffer->getBuffers(), (int)sizeof(uint32_t) * CLUSTER_COUNT * (1 + CLUSTER_MAX_LIGHTS)));
+}
+
+void ClusteredLights::appendLightBindings(DESCRIPTOR_BINDING_ARRAY& bindings, VkShaderStageFlags stage) {
+	bindings.push_back({ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, stage });
+	bindings.push_back({ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stage });
+}
+
+void ClusteredLights::appendLightDescriptors(std::vector<Descriptor::UBODescriptor>& uboDescriptors) {
+	uboDescriptors.push_back(Descriptor::UBODescriptor(clusterBuffer->getBuffers(), (int)sizeof(ClusterUBO)));
+	uboDescriptors.push_back(Descriptor::UBODescriptor(lightsBuffer->getBuffers(), (int)sizeof(PointLight) * CLUSTERED_MAX_LIGHTS));
+}
+
+void ClusteredLights::setLightCount(uint32_t count) {
+	lightCount = count < CLUSTERED_MAX_LIGHTS ? count : CLUSTERED_MAX_LIGHTS;
+}
+
+void ClusteredLights::UI() {
+	int count = (int)lightCount;
+	if (ImGui::SliderInt("Point Lights", &count, 0, CLUSTERED_MAX_LIGHTS))
+		setLightCount((uint32_t)count);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include "VulkanDevices.h"
+#include "ComputePipeline.h"
+#include "UniformBuffer.h"
+#include "Descriptor.h"
+#include "Utils.h"
+#include <imgui.h>
+
+
+// froxel grid of clustered lighting (must match Shaders/clusters.glsl)
+#define CLUSTERS_X 16
+#define CLUSTERS_Y 9
+#define CLUSTERS_Z 24
+#define CLUSTER_COUNT (CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z)
+#define CLUSTER_MAX_LIGHTS 64
+// clusters per workgroup of the light binning pass (must match Shaders/light_clusters.comp)
+#define CLUSTER_GROUP 64
+// maximum amount of point lights; light buffers are allocated for this many, so that the light count can change without a rebuild
+#define CLUSTERED_MAX_LIGHTS 4096
+
+
+/// Data for one point light (see Shaders/clusters.glsl)
+struct PointLight {
+	glm::vec4 position_range;// xyz: world position; w: range
+	glm::vec4 colour;// rgb: colour scaled by intensity
+};// struct PointLight
+
+/// Camera and light count of the frame, read by the light binning and lighting passes
+struct ClusterUBO {
+	alignas(16) glm::mat4 view;
+	alignas(16) glm::vec4 projScale;// xy: proj[0][0], proj[1][1]; zw: proj[2][2], proj[3][2] (view depth from depth buffer values)
+	alignas(16) uint32_t lightCount;
+};// struct ClusterUBO
+
+
+/// Point lights binned into a froxel grid each frame by a compute pass, so that the deferred lighting passes only loop over the lights of each fragment's cluster.
+/// The owning scene appends the 3 buffers (cluster UBO, lights, cluster light lists) to its lighting descriptor, then dispatches the binning before its render pass.
+/// Without binning, only the lights are kept (cluster UBO + lights), for renderers that cull them in their own structure (see ForwardPlusScene).
+class ClusteredLights {
+
+	DevicesPtr devices;
+
+	/// Per-image buffers
+	UniformBuffer<ClusterUBO>* clusterBuffer;// host visible
+	UniformBuffer<PointLight>* lightsBuffer;// host visible, CLUSTERED_MAX_LIGHTS lights
+	UniformBuffer<uint32_t>* clustersBuffer = NULL;// device local, written by the binning pass: light count then light indices of each cluster
+
+	/// Light binning pass
+	Descriptor* descriptor = NULL;
+	ComputePipeline* pipeline = NULL;
+
+	/// Lights at rest; animated in Update()
+	std::vector<PointLight> lights;
+
+	/// Amount of lights used (shared by all scenes)
+	static uint32_t lightCount;
+
+public:
+
+	/// Creates buffers and the binning pass (if binning), and generates the lights of the scene.
+	ClusteredLights(DevicesPtr devices, const VkDescriptorPool& descriptorPool, int swapchainSize, bool binning = true);
+	~ClusteredLights();
+
+	/// Animates the lights, and uploads the lights and camera of the frame.
+	void Update(uint32_t imageIndex, float time, const glm::mat4& view, const glm::mat4& proj);
+
+	/// Records the light binning pass; must be recorded before the render pass reading the clusters (binning only).
+	void cmdBindCompute(const VkCommandBuffer& cmdBuffer, int index);
+
+	/// Appends the 3 bindings read by the lighting pass (cluster UBO, lights, clusters), for the given shader stage.
+	static void appendBindings(DESCRIPTOR_BINDING_ARRAY& bindings, VkShaderStageFlags stage);
+	/// Appends the matching buffers, in the same order as appendBindings() (binning only).
+	void appendDescriptors(std::vector<Descriptor::UBODescriptor>& uboDescriptors);
+
+	/// Appends the 2 bindings and buffers of the lights only (cluster UBO, lights).
+	static void appendLightBindings(DESCRIPTOR_BINDING_ARRAY& bindings, VkShaderStageFlags stage);
+	void appendLightDescriptors(std::vector<Descriptor::UBODescriptor>& uboDescriptors);
+
+	/// Change the amount of lights (clamped to CLUSTERED_MAX_LIGHTS).
+	static void setLightCount(uint32_t count);
+	static inline uint32_t getLightCount() { return lightCount; }
+
+	/// Light count slider; never requires a rebuild.
+	static void UI();
+
+};// class ClusteredLights
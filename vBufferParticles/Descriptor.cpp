@@ -1,4 +1,5 @@
 #include "Descriptor.h"
+#include <algorithm>
 
 /// Creates the descriptor set layout vulkan object.
 void Descriptor::createDescriptorSetLayout(std::vector<std::pair<VkDescriptorType, VkShaderStageFlags>>& bindings) {
@@ -28,7 +29,7 @@ void Descriptor::createDescriptorSetLayout(std::vector<std::pair<VkDescriptorTyp
 }
 
 /// (Re-)creates the pipeline layout vulkan resource.
-void Descriptor::createPipelineLayout() {
+void Descriptor::createPipelineLayout(uint32_t pushConstantsSize, VkShaderStageFlags pushConstantsStages) {
 
 	/// In case this function was previously called, destroy the old resource.
 	if(pipelineLayout != VK_NULL_HANDLE)
@@ -39,8 +40,11 @@ void Descriptor::createPipelineLayout() {
 	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 	pipelineLayoutInfo.setLayoutCount = 1;
 	pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-	pipelineLayoutInfo.pushConstantRangeCount = 0;
-	pipelineLayoutInfo.pPushConstantRanges = NULL;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = pushConstantsSize;
+	pushConstantRange.stageFlags = pushConstantsStages;
+	pipelineLayoutInfo.pushConstantRangeCount = pushConstantsSize > 0 ? 1 : 0;
+	pipelineLayoutInfo.pPushConstantRanges = pushConstantsSize > 0 ? &pushConstantRange : NULL;
 	if (vkCreatePipelineLayout(*logicalDevice, &pipelineLayoutInfo, NULL, &pipelineLayout) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create pipeline layout!");
 	}
@@ -54,6 +58,8 @@ Descriptor::Descriptor(std::vector<std::pair<VkDescriptorType, VkShaderStageFlag
 
 /// Cleanup resources.
 Descriptor::~Descriptor() {
+	if (ownPool != VK_NULL_HANDLE)
+		vkDestroyDescriptorPool(*logicalDevice, ownPool, NULL);
 	vkDestroyDescriptorSetLayout(*logicalDevice, descriptorSetLayout, NULL);
 	vkDestroyPipelineLayout(*logicalDevice, pipelineLayout, NULL);
 }
@@ -99,6 +105,7 @@ void Descriptor::createDescriptorSets(int swapchainSize, const VkDescriptorPool&
 				break;
 			case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
 			case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+			case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
 				{
 					Descriptor::ImageInfoDescriptor& imgInfoDescriptor = imageDescriptors[++imageInfoId];
 					VkDescriptorImageInfo* imgInfo = imgInfoDescriptor.getDescriptorInfo();
@@ -118,3 +125,31 @@ void Descriptor::createDescriptorSets(int swapchainSize, const VkDescriptorPool&
 	}
 
 }
+
+/// (Re-)creates the descriptor sets for this descriptor from a pool owned by this object, holding exactly the descriptors of swapchainSize sets.
+void Descriptor::createDescriptorSets(int swapchainSize, std::vector<UBODescriptor> uboDescriptors, std::vector<ImageInfoDescriptor> imageDescriptors) {
+
+	/// In case this function was previously called, destroy the old pool (and with it the old sets).
+	if (ownPool != VK_NULL_HANDLE)
+		vkDestroyDescriptorPool(*logicalDevice, ownPool, NULL);
+
+	/// One pool size per descriptor type, counting each binding of that type once per set.
+	std::vector<VkDescriptorPoolSize> poolSizes;
+	for (const VkDescriptorType& type : descriptorTypes) {
+		auto poolSize = std::find_if(poolSizes.begin(), poolSizes.end(), [&type](const VkDescriptorPoolSize& size) { return size.type == type; });
+		if (poolSize == poolSizes.end()) poolSizes.push_back({ type, (uint32_t)swapchainSize });
+		else poolSize->descriptorCount += swapchainSize;
+	}
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = (uint32_t)poolSizes.size();
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = (uint32_t)swapchainSize;
+	poolInfo.flags = 0;
+	if (vkCreateDescriptorPool(*logicalDevice, &poolInfo, NULL, &ownPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create descriptor pool.");
+	}
+
+	createDescriptorSets(swapchainSize, ownPool, uboDescriptors, imageDescriptors);
+}
@@ -18,6 +18,8 @@ class Descriptor : public Bindable {
 	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
 	std::vector<VkDescriptorSet> descriptorSets;
 	VkPipelineBindPoint pipelineBindPoint;
+	VkPushConstantRange pushConstantRange = {};// optional push constants range (size 0 if unused)
+	VkDescriptorPool ownPool = VK_NULL_HANDLE;// pool the descriptor sets were allocated from when it is owned by this object (see createDescriptorSets without a pool)
 
 	/// Creates the descriptor set layout given a certain amount of descriptor type + shader stage couples
 	void createDescriptorSetLayout(std::vector<std::pair<VkDescriptorType, VkShaderStageFlags>>& bindings);
@@ -56,9 +58,10 @@ public:
 		Texture* texture;
 		VkSampler sampler;
 
-		// Creates the image info descriptor, taking a texture object and a sampler. If the image is used as an input attachment, sampler can be VK_NULL_HANDLE.
-		inline ImageInfoDescriptor(Texture* t, VkSampler sampler) : texture(t), sampler(sampler) {
-			info = texture->getDescriptor(sampler);// let the texture object create its descriptor info.
+		// Creates the image info descriptor, taking a texture object and a sampler. If the image is used as an input attachment or storage image, sampler can be VK_NULL_HANDLE.
+		// layout: the layout the image is in when accessed through the descriptor (storage images are accessed in VK_IMAGE_LAYOUT_GENERAL)
+		inline ImageInfoDescriptor(Texture* t, VkSampler sampler, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) : texture(t), sampler(sampler) {
+			info = texture->getDescriptor(sampler, layout);// let the texture object create its descriptor info.
 		}
 
 		// returns the descriptor info for this image descriptor.
@@ -78,22 +81,32 @@ public:
 	virtual ~Descriptor();
 	
 	/// Creates the pipeline layout. Must be called each time the swapchain is recreated / resized.
-	void createPipelineLayout();//happens each time upon recreation of swapchain
+	/// pushConstantsSize: size in bytes of the push constants block accessible from pushConstantsStages (0 for none)
+	void createPipelineLayout(uint32_t pushConstantsSize = 0, VkShaderStageFlags pushConstantsStages = 0);//happens each time upon recreation of swapchain
 
 	/// Creates the descriptor sets for this Descriptor.
 	void createDescriptorSets(int swapchainSize, const VkDescriptorPool& descriptorPool, std::vector<UBODescriptor> uboDescriptors, std::vector<ImageInfoDescriptor> imageDescriptors);
 
+	/// Creates the descriptor sets for this Descriptor from a pool of its own, sized for them and destroyed with this object (which frees the sets).
+	/// For descriptors that may be recreated without the shared pool being reset, whose sets would otherwise accumulate in it (eg. storage images, of which it holds few)
+	void createDescriptorSets(int swapchainSize, std::vector<UBODescriptor> uboDescriptors, std::vector<ImageInfoDescriptor> imageDescriptors);
+
 	
 	/// Binds the attached pipeline layout and descriptor sets to the current command buffer
 	inline void cmdBind(const VkCommandBuffer& cmdBuffer, int index) const override {
 		vkCmdBindDescriptorSets(cmdBuffer, pipelineBindPoint, pipelineLayout, 0, 1, &descriptorSets[index], 0, NULL);
 	}
 
+	/// Updates the push constants block (see createPipelineLayout) at command buffer recording time
+	inline void cmdPushConstants(const VkCommandBuffer& cmdBuffer, const void* values) const {
+		vkCmdPushConstants(cmdBuffer, pipelineLayout, pushConstantRange.stageFlags, 0, pushConstantRange.size, values);
+	}
+
 
 	/// Getters
 
 	/// The types of descriptors used by this object
-	inline std::vector<VkDescriptorType>& getTypes() { return descriptorTypes; }// one of VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT for use within pool sizes
+	inline std::vector<VkDescriptorType>& getTypes() { return descriptorTypes; }// one of VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE for use within pool sizes
 	/// The Vulkan descriptor set layout handle
 	inline const VkDescriptorSetLayout& getDescriptorLayout() { return descriptorSetLayout; }
 	/// The Vulkan pipeline layout handle
@@ -112,7 +125,13 @@ public:
 #define DESCRIPTOR_BINDING_UBO_COMPUTE std::pair<VkDescriptorType, VkShaderStageFlags>{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT } // Uniform buffer object accessed from Compute Shader
 #define DESCRIPTOR_BINDING_INPUT_ATTACHMENT_FRAGMENT std::pair<VkDescriptorType, VkShaderStageFlags>{ VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT } //  Input attachment accessed from Fragment Shader
 #define DESCRIPTOR_BINDING_SAMPLER_FRAGMENT std::pair<VkDescriptorType, VkShaderStageFlags>{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT } // Sampler2D accessed from Fragment Shader
+#define DESCRIPTOR_BINDING_SAMPLER_COMPUTE std::pair<VkDescriptorType, VkShaderStageFlags>{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT } // Sampler2D accessed from Compute Shader
+#define DESCRIPTOR_BINDING_STORAGE_IMAGE_COMPUTE std::pair<VkDescriptorType, VkShaderStageFlags>{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT } // Storage image written to by a Compute pass
 #define DESCRIPTOR_BINDING_STORAGE_BUFFER_COMPUTE std::pair<VkDescriptorType, VkShaderStageFlags>{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT } // Storage buffer written to by a Compute pass
+#define DESCRIPTOR_BINDING_STORAGE_BUFFER_VERTEX std::pair<VkDescriptorType, VkShaderStageFlags>{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT } // Storage buffer read from the Vertex Shader
+#define DESCRIPTOR_BINDING_STORAGE_BUFFER_GEOMETRY std::pair<VkDescriptorType, VkShaderStageFlags>{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_GEOMETRY_BIT } // Storage buffer read from the Geometry Shader
+#define DESCRIPTOR_BINDING_STORAGE_BUFFER_FRAGMENT std::pair<VkDescriptorType, VkShaderStageFlags>{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT } // Storage buffer read from the Fragment Shader
 
 /// Shorthand for an input attachment image info descriptor (note that for input attachments, sampler can be NULL_HANDLE as the pixels written to by the previous subpass will be the only available)
 #define DESCRIPTOR_IMG_ATTACHMENT_INFO(attachment) Descriptor::ImageInfoDescriptor(attachment, VK_NULL_HANDLE) // no need for a sampler for input attachments, as they are read using subpassLoad()
+#define DESCRIPTOR_IMG_DEPTH_ATTACHMENT_INFO(depth) Descriptor::ImageInfoDescriptor(depth, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL) // depth read as an input attachment (see RenderPass: depthInput)
@@ -0,0 +1,188 @@
+#include "DynamicResolution.h"
+
+
+float DynamicResolution::targetTime = 0.f;
+
+
+DynamicResolution::DynamicResolution(VulkanAppBase* vulkanApp) : vulkanApp(vulkanApp), devices(vulkanApp->devices) {
+
+	Swapchain* swapchain = vulkanApp->getSwapchain();
+	int swapchainSize = swapchain->getSize();
+	RenderPass::renderScale = scale;
+
+	/// Render targets, blitted from once the scene is drawn
+	std::vector<VkImageView> views;
+	for (int i = 0; i < swapchainSize; ++i) {
+		renderTargets.push_back(new Texture(swapchain->getFormat(), swapchain->getExtent(), VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_COLOR_BIT,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, devices(), devices->getPhysicalDevice(), *vulkanApp->getCommandPool(), devices->getGraphicsQueue()));
+		views.push_back(renderTargets.back()->getImageView());
+	}
+	swapchain->setRenderTargets(views);
+
+	/// Overlay pass: continues from the upscaled swapchain image (left in PRESENT_SRC_KHR layout by cmdUpscale)
+	overlayDepth = new Texture(VK_FORMAT_D32_SFLOAT, swapchain->getExtent(), VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+		devices(), devices->getPhysicalDevice(), *vulkanApp->getCommandPool(), devices->getGraphicsQueue());
+	std::vector<RenderPass::RenderPassAttachmentDesc> attachments = { RENDERPASS_ATTACHMENT_DESC_PRESENT(swapchain->getFormat()), RENDERPASS_ATTACHMENT_DESC_DEPTH };
+	overlayRenderPass = new RenderPass(devices(), attachments, 1, swapchain->getExtent(), RenderPass::Chaining::Continuation);
+	overlayFramebuffers.resize(swapchainSize);
+	for (int i = 0; i < swapchainSize; ++i) {
+		std::vector<VkImageView> fbAttachments = { swapchain->getImageView(i), overlayDepth->getImageView() };
+		VkFramebufferCreateInfo framebufferInfo = {};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = overlayRenderPass->getRenderPass();
+		framebufferInfo.attachmentCount = (uint32_t)fbAttachments.size();
+		framebufferInfo.pAttachments = fbAttachments.data();
+		framebufferInfo.width = swapchain->getExtent().width;
+		framebufferInfo.height = swapchain->getExtent().height;
+		framebufferInfo.layers = 1;
+		if (vkCreateFramebuffer(*devices(), &framebufferInfo, NULL, &overlayFramebuffers[i]) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create overlay framebuffer");
+		}
+	}
+
+	/// Timestamp queries, 2 per image
+	VkQueryPoolCreateInfo queryInfo = {};
+	queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryInfo.queryCount = 2 * swapchainSize;
+	if (vkCreateQueryPool(*devices(), &queryInfo, NULL, &queryPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create timestamp query pool");
+	}
+	timed.assign(swapchainSize, false);
+	recordedScales.assign(swapchainSize, 0.f);
+
+	/// Timestamp resolution, and valid bits on the graphics queue (none: the scale is left as is)
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(devices->getPhysicalDevice(), &properties);
+	timestampPeriod = properties.limits.timestampPeriod;
+	uint32_t familyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(devices->getPhysicalDevice(), &familyCount, NULL);
+	std::vector<VkQueueFamilyProperties> families(familyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(devices->getPhysicalDevice(), &familyCount, families.data());
+	uint32_t validBits = families[devices->getGraphicsQueueFamily()].timestampValidBits;
+	timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+	if (validBits == 0)
+		printf("Dynamic resolution: the graphics queue has no timestamps, the render scale will not change.\n");
+
+}
+
+DynamicResolution::~DynamicResolution() {
+
+	vkDestroyQueryPool(*devices(), queryPool, NULL);
+	for (VkFramebuffer framebuffer : overlayFramebuffers)
+		vkDestroyFramebuffer(*devices(), framebuffer, NULL);
+	DELETE(overlayRenderPass);
+	DELETE(overlayDepth);
+	for (Texture*& renderTarget : renderTargets) {
+		DELETE(renderTarget);
+	}
+
+	RenderPass::renderScale = 1.f;
+
+}
+
+bool DynamicResolution::Update(uint32_t imageIndex) {
+
+	/// GPU time of the last frame of this image (complete: its fence was waited upon)
+	if (timed[imageIndex] && timestampMask != 0) {
+		uint64_t timestamps[2];
+		if (vkGetQueryPoolResults(*devices(), queryPool, 2 * imageIndex, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+			gpuTime = (float)((timestamps[1] - timestamps[0]) & timestampMask) * timestampPeriod * 1e-6f;
+			control(gpuTime);
+		}
+	}
+	timed[imageIndex] = true;// written by this frame
+
+	return recordedScales[imageIndex] != RenderPass::renderScale;
+}
+
+void DynamicResolution::control(float time) {
+
+	/// PID in velocity form: the scale integrates the output, so that it holds once the target is met, and saturates at its bounds without windup
+	float error = glm::clamp((targetTime - time) / targetTime, -1.f, 1.f);// > 0: time to spare
+	scale += DYNAMIC_RESOLUTION_KP * (error - previousError) + DYNAMIC_RESOLUTION_KI * error + DYNAMIC_RESOLUTION_KD * (error - 2.f * previousError + olderError);
+	scale = glm::clamp(scale, DYNAMIC_RESOLUTION_MIN_SCALE, DYNAMIC_RESOLUTION_MAX_SCALE);
+	olderError = previousError;
+	previousError = error;
+
+	RenderPass::renderScale = glm::clamp(std::round(scale / DYNAMIC_RESOLUTION_STEP) * DYNAMIC_RESOLUTION_STEP, DYNAMIC_RESOLUTION_MIN_SCALE, DYNAMIC_RESOLUTION_MAX_SCALE);
+
+}
+
+void DynamicResolution::cmdBeginFrame(const VkCommandBuffer& cmdBuffer, int index) {
+
+	vkCmdResetQueryPool(cmdBuffer, queryPool, 2 * index, 2);
+	vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 2 * index);
+	recordedScales[index] = RenderPass::renderScale;
+
+}
+
+RenderPass* DynamicResolution::cmdUpscale(const VkCommandBuffer& cmdBuffer, int index, RenderPass* sceneRenderPass) {
+
+	sceneRenderPass->end(cmdBuffer);
+	vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 2 * index + 1);
+
+	Swapchain* swapchain = vulkanApp->getSwapchain();
+	VkExtent2D extent = swapchain->getExtent();
+	VkExtent2D area = RenderPass::getRenderArea(extent);
+
+	/// Render target: left as a present attachment by the scene render passes; swapchain image: contents discarded (once acquired, see the wait stage of render())
+	VkImageMemoryBarrier barriers[2] = {};
+	for (VkImageMemoryBarrier& barrier : barriers) {
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	}
+	barriers[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	barriers[0].oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barriers[0].image = renderTargets[index]->getImage();
+	barriers[1].srcAccessMask = 0;
+	barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barriers[1].image = swapchain->getImage(index);
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 2, barriers);
+
+	/// Upscale the rendered part to the whole swapchain image
+	VkImageBlit blit = {};
+	blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	blit.srcOffsets[1] = { (int32_t)area.width, (int32_t)area.height, 1 };
+	blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	blit.dstOffsets[1] = { (int32_t)extent.width, (int32_t)extent.height, 1 };
+	vkCmdBlitImage(cmdBuffer, renderTargets[index]->getImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, swapchain->getImage(index), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+	/// Swapchain image: loaded by the overlay pass; render target: attachment of the next frame again (its render passes start from UNDEFINED)
+	barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barriers[1].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barriers[1].newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, NULL, 0, NULL, 1, &barriers[1]);
+
+	overlayRenderPass->begin(cmdBuffer, overlayFramebuffers[index]);
+	return overlayRenderPass;
+}
+
+bool DynamicResolution::UI(DynamicResolution* dynamicResolution) {
+
+	/// Target kept while disabled
+	static float target = DYNAMIC_RESOLUTION_DEFAULT_TARGET;
+	if (enabled()) target = targetTime;
+
+	bool rebuild = false;
+	bool dynamic = enabled();
+	if (ImGui::Checkbox("Dynamic Resolution", &dynamic)) {
+		setTarget(dynamic ? target : 0.f);
+		rebuild = true;
+	}
+
+	if (dynamicResolution) {
+		ImGui::SliderFloat("Target GPU Time (ms)", &targetTime, 2.f, 33.f, "%.1f");
+		VkExtent2D area = RenderPass::getRenderArea(dynamicResolution->vulkanApp->getSwapchain()->getExtent());
+		ImGui::Text("Render Scale: %.1f%% (%ux%u), GPU %.2f ms", RenderPass::renderScale * 100.f, area.width, area.height, dynamicResolution->gpuTime);
+	}
+
+	return rebuild;
+}
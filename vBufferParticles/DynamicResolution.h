@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include "VulkanAppBase.h"
+#include "Utils.h"
+#include <imgui.h>
+
+
+// bounds of the render scale (fraction of the swapchain extent rendered, along x and y)
+#define DYNAMIC_RESOLUTION_MIN_SCALE 0.5f
+#define DYNAMIC_RESOLUTION_MAX_SCALE 1.0f
+// render scales are rounded to steps of this size, so that command buffers are only re-recorded when the scale moves to another step
+#define DYNAMIC_RESOLUTION_STEP 0.025f
+// gains of the controller, applied each frame to the relative error of the GPU frame time ((target - time) / target, clamped to -1..1), in velocity form
+#define DYNAMIC_RESOLUTION_KP 0.1f
+#define DYNAMIC_RESOLUTION_KI 0.03f
+#define DYNAMIC_RESOLUTION_KD 0.02f
+// GPU frame time targeted by default, in milliseconds
+#define DYNAMIC_RESOLUTION_DEFAULT_TARGET 16.0f
+
+
+/// Renders the scenes at an internal resolution decoupled from the swapchain, and drives it from GPU frame timings to hold a target frame time.
+/// Scenes render to a render target per swapchain image (at the swapchain extent, the largest resolution), of which render passes only cover the
+/// top-left part given by RenderPass::renderScale, through their render area and dynamic viewport & scissor: no resource or pipeline is recreated
+/// when the scale changes, only the command buffer of each image is re-recorded as it comes up. The rendered part is then blitted (bilinear) to
+/// the swapchain image, and the UI overlay drawn at full resolution in a render pass of its own.
+/// Timestamps around the scene commands give the GPU time of each image's last frame; a PID controller turns their error to the target into
+/// render scale steps, within DYNAMIC_RESOLUTION_MIN_SCALE..DYNAMIC_RESOLUTION_MAX_SCALE. Compute work submitted to the compute queue (eg.
+/// particle generation) is not timed.
+class DynamicResolution {
+
+	VulkanAppBase* vulkanApp;
+	DevicesPtr devices;
+
+	/// Scene render targets, one per swapchain image (swapchain format; attachment #0 of the scene framebuffers)
+	std::vector<Texture*> renderTargets;
+
+	/// UI overlay pass, over the upscaled swapchain image (its depth attachment is only there for RenderPass, and never tested)
+	RenderPass* overlayRenderPass;
+	Texture* overlayDepth;
+	std::vector<VkFramebuffer> overlayFramebuffers;
+
+	/// Timestamps before and after the scene commands of each image
+	VkQueryPool queryPool;
+	float timestampPeriod;// nanoseconds per timestamp tick
+	uint64_t timestampMask;// valid bits of the timestamps
+	std::vector<bool> timed;// whether the timestamps of each image were written by a previous frame
+
+	/// Render scale recorded in the command buffer of each image
+	std::vector<float> recordedScales;
+
+	/// Controller state: unrounded scale, errors of the previous 2 frames, and the last GPU time measured (in ms)
+	float scale = DYNAMIC_RESOLUTION_MAX_SCALE;
+	float previousError = 0.f;
+	float olderError = 0.f;
+	float gpuTime = 0.f;
+
+	/// GPU frame time targeted, in milliseconds (shared by all scenes); 0 -> scenes render at the swapchain resolution directly
+	static float targetTime;
+
+	/// Updates the render scale from the GPU time of a frame
+	void control(float time);
+
+public:
+
+	/// Creates the render targets (and points the swapchain framebuffers to them), the overlay pass and the timestamp queries. Must be created
+	/// before the scene, whose framebuffers use the render targets.
+	DynamicResolution(VulkanAppBase* vulkanApp);
+	/// Cleanup; render passes cover their whole extent again
+	~DynamicResolution();
+
+	/// Render pass of the UI overlay (drawn at the swapchain resolution)
+	inline RenderPass* getRenderPass() { return overlayRenderPass; }
+
+	/// Reads the GPU time of the last frame of this image, and updates the render scale; returns true if the command buffer of this image must be
+	/// re-recorded (its render scale is out of date). Call from frame(), once the previous frame of the image has completed.
+	bool Update(uint32_t imageIndex);
+
+	/// Records the start of the frame (before the scene commands): timestamp, and the render scale used
+	void cmdBeginFrame(const VkCommandBuffer& cmdBuffer, int index);
+
+	/// Ends the last render pass of the scene, upscales the rendered part to the swapchain image, and begins the overlay pass (returned, for the UI).
+	RenderPass* cmdUpscale(const VkCommandBuffer& cmdBuffer, int index, RenderPass* sceneRenderPass);
+
+	/// Change the GPU frame time targeted, in milliseconds (0 disables dynamic resolution); scenes must be rebuilt to apply enabling/disabling it.
+	static inline void setTarget(float ms) { targetTime = ms > 0.f ? ms : 0.f; }
+	/// Whether scenes render at a dynamic resolution
+	static inline bool enabled() { return targetTime > 0.f; }
+
+	/// Dynamic resolution checkbox, target and current state (dynamicResolution may be NULL); returns true if the scene must be rebuilt.
+	static bool UI(DynamicResolution* dynamicResolution);
+
+};// class DynamicResolution
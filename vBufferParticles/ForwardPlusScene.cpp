@@ -0,0 +1,255 @@
+#include "ForwardPlusScene.h"
+
+ForwardPlusScene::ForwardPlusScene(VulkanAppBase* vulkanApp) : Scene(vulkanApp) {
+
+	/// Create objects that do not rely on a specific swapchain layout
+
+	//descriptor set & pipeline layouts: matrices, shrimp texture, light, raccoon texture, then point lights and tile light lists
+	DESCRIPTOR_BINDING_ARRAY firstSubpassBindings = { DESCRIPTOR_BINDING_UBO_VERTEX, DESCRIPTOR_BINDING_SAMPLER_FRAGMENT, DESCRIPTOR_BINDING_UBO_FRAGMENT, DESCRIPTOR_BINDING_SAMPLER_FRAGMENT };
+	ClusteredLights::appendLightBindings(firstSubpassBindings, VK_SHADER_STAGE_FRAGMENT_BIT);
+	firstSubpassBindings.push_back(DESCRIPTOR_BINDING_STORAGE_BUFFER_FRAGMENT);
+	firstSubpassDescriptor = new Descriptor(firstSubpassBindings, devices());
+
+	// create meshes
+	quad = MeshFactory::createQuadMesh(glm::vec3(-0.5f, 0, 0), glm::vec2(0.5f, 0.5f), devices(), devices->getPhysicalDevice(), *commandPool, devices->getGraphicsQueue());
+	cube = MeshFactory::createCubeMesh(glm::vec3(0.5f, 0, -3.0f), glm::vec3(2.5f, 2.5f, 2.5f), devices(), devices->getPhysicalDevice(), *commandPool, devices->getGraphicsQueue());
+	cube2 = MeshFactory::createCubeMesh(glm::vec3(2.0f, 0.3f, 2.0f), glm::vec3(1.0f, 1.5f, 1.0f), devices(), devices->getPhysicalDevice(), *commandPool, devices->getGraphicsQueue());
+	cube3 = MeshFactory::createCubeMesh(glm::vec3(-2.0f, 0.3f, 2.0f), glm::vec3(1.5f, 1.5f, 1.5f), devices(), devices->getPhysicalDevice(), *commandPool, devices->getGraphicsQueue());
+	ground = MeshFactory::createCubeMesh(glm::vec3(0, -2.5f, 0), glm::vec3(20, 0.2f, 20), devices(), devices->getPhysicalDevice(), *commandPool, devices->getGraphicsQueue());
+	raymarchCube = MeshFactory::createCubeMesh(glm::vec3(3.0f, 0, -2.0f), glm::vec3(2, 2, 2), devices(), devices->getPhysicalDevice(), *commandPool, devices->getGraphicsQueue());
+
+	// load textures
+	shrimpTex = new Texture("Textures/shrimp.png", devices(), devices->getPhysicalDevice(), *commandPool, devices->getGraphicsQueue());
+	raccoonTex = new Texture("Textures/raccoon.png", devices(), devices->getPhysicalDevice(), *commandPool, devices->getGraphicsQueue());
+
+
+	/// Create objects and layouts dependant on swapchain size
+	// Create render passes & attachments: the prepass clears and keeps everything, the shading pass (and any further instance drawing streamed particles) loads it
+	std::vector<RenderPass::RenderPassAttachmentDesc> attachments = { RENDERPASS_ATTACHMENT_DESC_PRESENT(vulkanApp->getSwapchain()->getFormat()), RENDERPASS_ATTACHMENT_DESC_DEPTH };
+	prepassRenderPass = new RenderPass(devices(), attachments, 1, vulkanApp->getSwapchain()->getExtent(), RenderPass::Chaining::First);
+	renderPass = new RenderPass(devices(), attachments, 1, vulkanApp->getSwapchain()->getExtent(), RenderPass::Chaining::Continuation);
+	prepassRenderPass->setScaled(true);
+	renderPass->setScaled(true);
+
+	// Create pipeline layouts
+	firstSubpassDescriptor->createPipelineLayout();
+
+	// Create pipelines; shading passes only pixels left visible by the prepass
+	depthPipeline = new GraphicsPipeline("default", "depth_fwdp", NULL, vulkanApp->getSwapchain()->getExtent(), firstSubpassDescriptor->getPipelineLayout(), prepassRenderPass, 0, true, 1, devices(), VK_COMPARE_OP_LESS, false);
+	shrimpPipeline = new GraphicsPipeline("default", "shrimp_fwdp", NULL, vulkanApp->getSwapchain()->getExtent(), firstSubpassDescriptor->getPipelineLayout(), renderPass, 0, true, 1, devices(), VK_COMPARE_OP_LESS_OR_EQUAL);
+	raymarchPipeline = new GraphicsPipeline("default", "raymarch_fwdp", NULL, vulkanApp->getSwapchain()->getExtent(), firstSubpassDescriptor->getPipelineLayout(), renderPass, 0, true, 1, devices(), VK_COMPARE_OP_LESS_OR_EQUAL);
+	raccoonPipeline = new GraphicsPipeline("default", "raccoon_fwdp", NULL, vulkanApp->getSwapchain()->getExtent(), firstSubpassDescriptor->getPipelineLayout(), renderPass, 0, true, 1, devices(), VK_COMPARE_OP_LESS_OR_EQUAL);
+
+	// Create the depth buffer (sampled by the light culling pass)
+	depthAttachment = new Texture(VK_FORMAT_D32_SFLOAT, vulkanApp->getSwapchain()->getExtent(), VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, devices(), devices->getPhysicalDevice(), *commandPool, devices->getGraphicsQueue());
+
+	// Create uniform buffers
+	lightBuffer = new LightBuffer(glm::vec3(2, 2, 2), 20, glm::vec3(1, 1, 0), glm::vec3(0.1f, 0.1f, 0.5f), vulkanApp->getSwapchain()->getSize(), devices(), devices->getPhysicalDevice());
+	matrixBuffer = new MatrixBuffer(vulkanApp->getSwapchain()->getSize(), devices(), devices->getPhysicalDevice());
+	clusteredLights = new ClusteredLights(devices, *descriptorPool, vulkanApp->getSwapchain()->getSize(), false);
+
+	// Create the light culling pass: lights and depth in; tile count along x then the light list of each tile out
+	lightTiles = { (vulkanApp->getSwapchain()->getExtent().width + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE, (vulkanApp->getSwapchain()->getExtent().height + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE };
+	int lightTilesSize = 1 + lightTiles.width * lightTiles.height * (1 + LIGHT_TILE_MAX_LIGHTS);
+	lightTilesBuffer = new UniformBuffer<uint32_t>(vulkanApp->getSwapchain()->getSize(), devices(), devices->getPhysicalDevice(),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, lightTilesSize);
+	DESCRIPTOR_BINDING_ARRAY lightTilesBindings = {};
+	ClusteredLights::appendLightBindings(lightTilesBindings, VK_SHADER_STAGE_COMPUTE_BIT);
+	lightTilesBindings.push_back(DESCRIPTOR_BINDING_STORAGE_BUFFER_COMPUTE);
+	lightTilesBindings.push_back(DESCRIPTOR_BINDING_SAMPLER_COMPUTE);
+	lightTilesDescriptor = new Descriptor(lightTilesBindings, devices(), VK_PIPELINE_BIND_POINT_COMPUTE);
+	lightTilesDescriptor->createPipelineLayout(sizeof(glm::ivec2), VK_SHADER_STAGE_COMPUTE_BIT);// size of the rendered part of the depth buffer (see RenderPass::renderScale)
+	std::vector<Descriptor::UBODescriptor> lightTilesUboDescriptors = {};
+	clusteredLights->appendLightDescriptors(lightTilesUboDescriptors);
+	lightTilesUboDescriptors.push_back(Descriptor::UBODescriptor(lightTilesBuffer->getBuffers(), (int)sizeof(uint32_t) * lightTilesSize));
+	std::vector<Descriptor::ImageInfoDescriptor> lightTilesImgDescriptors = { Descriptor::ImageInfoDescriptor(depthAttachment, vulkanApp->getSampler(), VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL) };// read with texelFetch (unfiltered)
+	lightTilesDescriptor->createDescriptorSets(vulkanApp->getSwapchain()->getSize(), *descriptorPool, lightTilesUboDescriptors, lightTilesImgDescriptors);
+	lightTilesPipeline = new ComputePipeline("light_tiles_fwdp", lightTilesDescriptor->getPipelineLayout(), devices());
+
+	// Create framebuffer attachments / note: attachment images will be prepended with present image
+	std::vector<VkImageView> attachmentImages = { depthAttachment->getImageView() };
+	vulkanApp->getSwapchain()->createFramebuffers(attachmentImages, renderPass->getRenderPass());
+
+	// Create subpass descriptor sets
+	std::vector<Descriptor::UBODescriptor> uboDescriptors1 = { Descriptor::UBODescriptor(matrixBuffer->getBuffers(), sizeof(MatrixBufferObject)), Descriptor::UBODescriptor(lightBuffer->getBuffers(), (int)sizeof(LightBufferObject)) };
+	clusteredLights->appendLightDescriptors(uboDescriptors1);
+	uboDescriptors1.push_back(Descriptor::UBODescriptor(lightTilesBuffer->getBuffers(), (int)sizeof(uint32_t) * lightTilesSize));
+	std::vector<Descriptor::ImageInfoDescriptor> imgDescriptors1 = { Descriptor::ImageInfoDescriptor(shrimpTex, vulkanApp->getSampler()), Descriptor::ImageInfoDescriptor(raccoonTex, vulkanApp->getSampler()) };
+	firstSubpassDescriptor->createDescriptorSets(vulkanApp->getSwapchain()->getSize(), *descriptorPool, uboDescriptors1, imgDescriptors1);
+
+	// Create particles (drawn in the shading pass, whose instances all continue from the previous one)
+	ParticleSystem::ParticlesConstructorParams args(ParticleRenderingMode::ForwardRen, devices, descriptorPool, vulkanApp->getSwapchain()->getSize(),
+		vulkanApp->getSwapchain()->getExtent(), renderPass, *commandPool, vulkanApp->getSampler(), ParticleSystem::isStreaming() ? renderPass : NULL);
+	particles = new ParticleSystem(args);
+}
+
+ForwardPlusScene::~ForwardPlusScene() {
+
+	DELETE(particles);
+
+	/// Objects dependant on swapchain
+	DELETE(lightTilesPipeline);
+	DELETE(lightTilesDescriptor);
+	DELETE(lightTilesBuffer);
+	DELETE(clusteredLights);
+
+	DELETE(lightBuffer);
+	DELETE(matrixBuffer);
+
+	DELETE(depthAttachment);
+
+	DELETE(depthPipeline);
+	DELETE(shrimpPipeline);
+	DELETE(raymarchPipeline);
+	DELETE(raccoonPipeline);
+
+	DELETE(prepassRenderPass);
+	DELETE(renderPass);
+
+	/// Objects independant from swapchain
+	delete quad;
+	delete cube;
+	delete cube2;
+	delete cube3;
+	delete shrimpTex;
+	delete raccoonTex;
+	delete raymarchCube;
+	delete ground;
+
+	delete firstSubpassDescriptor;
+}
+
+void ForwardPlusScene::Update(uint32_t imageIndex, float dt, float time) {
+
+	/// Setup matrices
+	const glm::mat4& view = vulkanApp->getCamera().getViewMatrix();
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), vulkanApp->getSwapchain()->getExtent().width / (float)vulkanApp->getSwapchain()->getExtent().height, NEAR, FAR);
+	projection[1][1] *= -1;//fix ogl upside-down y coordinate scaling
+
+	if (!particlesOnly) {
+		/// Update uniform buffers
+		matrixBuffer->updateBuffer(imageIndex, time, glm::mat4(1), view, projection);
+		lightBuffer->updateBuffer(imageIndex, dt, time);
+
+		/// Update point lights
+		clusteredLights->Update(imageIndex, time, view, projection);
+	}
+
+	/// Update particles ubos
+	particles->Update(imageIndex, dt, time, view, projection);
+
+}
+
+bool ForwardPlusScene::UI() {
+
+	ImGui::Text("Forward+ Settings");
+
+	ImGui::Checkbox("Particles Only", &particlesOnly);
+
+	ClusteredLights::UI();
+
+	bool rebuild;
+	particles = ParticleSystem::UI(particles, rebuild);
+	if (rebuild) return true;
+
+	return false;
+
+}
+
+void ForwardPlusScene::cmdBindMeshes(const VkCommandBuffer& cmdBuffer, int index, GraphicsPipeline* shrimp, GraphicsPipeline* raccoon, GraphicsPipeline* raymarch) {
+
+	firstSubpassDescriptor->cmdBind(cmdBuffer, index);
+
+	// shrimp-textured objects
+	shrimp->cmdBind(cmdBuffer, index);
+	quad->cmdBind(cmdBuffer, index);
+	cube->cmdBind(cmdBuffer, index);
+	cube2->cmdBind(cmdBuffer, index);
+	ground->cmdBind(cmdBuffer, index);
+
+	// raccoon-textured objects
+	if (raccoon != shrimp) raccoon->cmdBind(cmdBuffer, index);
+	cube3->cmdBind(cmdBuffer, index);
+
+	// raymarch animated objects
+	if (raymarch != raccoon) raymarch->cmdBind(cmdBuffer, index);
+	raymarchCube->cmdBind(cmdBuffer, index);
+
+}
+
+void ForwardPlusScene::cmdBindLightTiles(const VkCommandBuffer& cmdBuffer, int index) {
+
+	/// Depth written by the prepass becomes readable by the culling pass
+	VkImageMemoryBarrier depthBarrier = {};
+	depthBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	depthBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	depthBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	depthBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	depthBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	depthBarrier.image = depthAttachment->getImage();
+	depthBarrier.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &depthBarrier);
+
+	/// One workgroup per tile of the rendered part of the screen (all of it, unless under dynamic resolution)
+	VkExtent2D renderArea = RenderPass::getRenderArea(vulkanApp->getSwapchain()->getExtent());
+	glm::ivec2 renderSize = glm::ivec2(renderArea.width, renderArea.height);
+	lightTilesDescriptor->cmdBind(cmdBuffer, index);
+	lightTilesDescriptor->cmdPushConstants(cmdBuffer, &renderSize);
+	lightTilesPipeline->cmdBind(cmdBuffer, index);
+	vkCmdDispatch(cmdBuffer, (renderArea.width + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE, (renderArea.height + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE, 1);
+
+	/// Light lists become readable by the shading pass, and the depth buffer is an attachment again
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	depthBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	depthBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, 0, 1, &barrier, 0, NULL, 1, &depthBarrier);
+
+}
+
+RenderPass* ForwardPlusScene::cmdBind(const VkCommandBuffer& cmdBuffer, int index) {
+
+	// Depth prepass (also clears the frame when only particles are drawn)
+	prepassRenderPass->begin(cmdBuffer, vulkanApp->getSwapchain()->getFramebuffer(index)); {
+		if (!particlesOnly)
+			cmdBindMeshes(cmdBuffer, index, depthPipeline, depthPipeline, depthPipeline);
+	} prepassRenderPass->end(cmdBuffer);
+
+	// Light culling (dispatches cannot happen within a render pass)
+	if (!particlesOnly)
+		cmdBindLightTiles(cmdBuffer, index);
+
+	renderPass->begin(cmdBuffer, vulkanApp->getSwapchain()->getFramebuffer(index)); {
+
+		//Shading subpass:
+		{	//vkCmdFirstSubpass
+
+			if (!particlesOnly)
+				cmdBindMeshes(cmdBuffer, index, shrimpPipeline, raccoonPipeline, raymarchPipeline);
+
+			// particles
+			particles->cmdBind(cmdBuffer, index, vulkanApp->getSwapchain()->getFramebuffer(index));
+
+		}
+
+	}
+	return renderPass;
+}
+
+void ForwardPlusScene::cmdBindCompute(const VkCommandBuffer& cmdBuffer, int index) {
+
+	particles->cmdBindCompute(cmdBuffer, index);
+
+}
+
+bool ForwardPlusScene::computeRequired(uint32_t imageIndex) {
+
+	return particles->computeRequired(imageIndex);
+
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "Scene.h"
+#include "Particles.h"
+#include "ClusteredLights.h"
+
+
+// screen tiles of the light culling pass (must match Shaders/light_tiles.glsl)
+#define LIGHT_TILE_SIZE 16
+#define LIGHT_TILE_MAX_LIGHTS 64
+
+
+
+/// Forward+ scene: the meshes are first drawn to depth only, then a compute pass lists the point lights touching the depth range of each screen tile,
+/// and the meshes are shaded in a forward pass that only loops over the lights of each pixel's tile. Particles are drawn in the shading pass (unlit, as in forward).
+class ForwardPlusScene : public Scene {
+
+	/// Depth prepass, and the shading render pass continuing from it
+	RenderPass* prepassRenderPass;
+	RenderPass* renderPass;// also used as continuation when streaming particles in chunks (all instances load the previous contents)
+
+	/// Single descriptor for both passes
+	Descriptor* firstSubpassDescriptor;
+
+	/// Graphics pipelines (shader sets)
+	GraphicsPipeline* depthPipeline;// depth prepass, for all meshes
+	GraphicsPipeline* shrimpPipeline;// shrimp textured objects
+	GraphicsPipeline* raymarchPipeline;// raymarch animated object
+	GraphicsPipeline* raccoonPipeline;// raccoon textured object
+
+	/// Meshes in the scene (see descriptions in ForwardRendererScene.h)
+	Mesh* quad;
+	Mesh* cube;
+	Mesh* cube2;
+	Mesh* cube3;
+	Mesh* ground;
+	Mesh* raymarchCube;
+
+	/// Textures used in the scene
+	Texture* shrimpTex;
+	Texture* raccoonTex;
+
+	/// Depth buffer of the scene, also sampled by the light culling pass
+	Texture* depthAttachment;
+
+	/// Uniform buffers sent to shaders
+	LightBuffer* lightBuffer;
+	MatrixBuffer* matrixBuffer;
+
+	/// Point lights, culled per tile
+	ClusteredLights* clusteredLights;
+
+	/// Light culling pass: one workgroup per tile, writing the light list of each tile (per image, device local)
+	Descriptor* lightTilesDescriptor;
+	ComputePipeline* lightTilesPipeline;
+	UniformBuffer<uint32_t>* lightTilesBuffer;
+	VkExtent2D lightTiles;// tile count along x and y at the swapchain resolution (capacity of the light lists)
+
+	/// Particle system.
+	ParticleSystem* particles;
+
+	/// Whether to hide everything other than particles
+	bool particlesOnly = true;
+
+	/// Records the meshes with a given pipeline for each material (or the same pipeline for all)
+	void cmdBindMeshes(const VkCommandBuffer& cmdBuffer, int index, GraphicsPipeline* shrimp, GraphicsPipeline* raccoon, GraphicsPipeline* raymarch);
+
+	/// Records the light culling pass, in between the depth prepass and the shading pass
+	void cmdBindLightTiles(const VkCommandBuffer& cmdBuffer, int index);
+
+public:
+
+	/// Returns the shading render pass
+	inline RenderPass* getRenderPass() override { return renderPass; }
+
+	/// Initializer
+	ForwardPlusScene(VulkanAppBase* vulkanApp);
+
+	/// Cleanup
+	~ForwardPlusScene() override;
+
+	/// Updates the scene; called each frame
+	void Update(uint32_t imageIndex, float dt, float time) override;
+
+	/// Scene settings
+	bool UI() override;
+
+	/// Used to update a command buffer with the scene data
+	RenderPass* cmdBind(const VkCommandBuffer& cmdBuffer, int index) override;
+
+	/// Used to update the compute command buffer with current scene data
+	void cmdBindCompute(const VkCommandBuffer& cmdBuffer, int index) override;
+
+	/// Whether the compute command buffer for this image index must be submitted this frame
+	bool computeRequired(uint32_t imageIndex) override;
+
+};//class ForwardPlusScene
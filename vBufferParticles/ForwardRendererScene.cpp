@@ -24,15 +24,31 @@ ForwardRendererScene::ForwardRendererScene(VulkanAppBase* vulkanApp) : Scene(vul
 	/// Create objects and layouts dependant on swapchain size
 	// Create render pass & attachments
 	std::vector<RenderPass::RenderPassAttachmentDesc> attachments = { RENDERPASS_ATTACHMENT_DESC_PRESENT(vulkanApp->getSwapchain()->getFormat()), RENDERPASS_ATTACHMENT_DESC_DEPTH };
-	renderPass = new RenderPass(devices(), attachments, 1, vulkanApp->getSwapchain()->getExtent());
+	bool stereo = Multiview::stereo();// the scene is drawn in the stereo pass, and only the eyes are composited in the render pass
+	bool composited = ParticleUpsampler::enabled() || ParticleOIT::enabled();// particles drawn off-screen once the scene is done
+	bool chained = !stereo && (ParticleSystem::isStreaming() || composited);
+	renderPass = new RenderPass(devices(), attachments, 1, vulkanApp->getSwapchain()->getExtent(), chained ? RenderPass::Chaining::First : RenderPass::Chaining::None);
+	renderPass->setScaled(true);
+	if (stereo) {
+		multiview = new Multiview(vulkanApp, renderPass, 0);
+	} else if (composited) {// reduced resolution or transparent particles are composited in a further instance, which reads the scene depth
+		std::vector<RenderPass::RenderPassAttachmentDesc> compositeAttachments = { RENDERPASS_ATTACHMENT_DESC_PRESENT(vulkanApp->getSwapchain()->getFormat()), RENDERPASS_ATTACHMENT_DESC_DEPTH_READ_ONLY };
+		compositeRenderPass = new RenderPass(devices(), compositeAttachments, 1, vulkanApp->getSwapchain()->getExtent(), RenderPass::Chaining::Continuation);
+		compositeRenderPass->setScaled(true);
+	} else if (ParticleSystem::isStreaming()) {// particles will be drawn in further render pass instances, in between their compute dispatches
+		continuationRenderPass = new RenderPass(devices(), attachments, 1, vulkanApp->getSwapchain()->getExtent(), RenderPass::Chaining::Continuation);
+		continuationRenderPass->setScaled(true);
+	}
 
 	// Create pipeline layouts
 	firstSubpassDescriptor->createPipelineLayout();
 
-	// Create pipelines
-	shrimpPipeline = new GraphicsPipeline("default", "shrimp_fwd", NULL, vulkanApp->getSwapchain()->getExtent(), firstSubpassDescriptor->getPipelineLayout(), renderPass, 0, true, 1, devices());
-	raymarchPipeline = new GraphicsPipeline("default", "raymarch_fwd", NULL, vulkanApp->getSwapchain()->getExtent(), firstSubpassDescriptor->getPipelineLayout(), renderPass, 0, true, 1, devices());
-	raccoonPipeline = new GraphicsPipeline("default", "raccoon_fwd", NULL, vulkanApp->getSwapchain()->getExtent(), firstSubpassDescriptor->getPipelineLayout(), renderPass, 0, true, 1, devices());
+	// Create pipelines (in the stereo pass when rendering both eyes)
+	RenderPass* scenePass = multiview ? multiview->getRenderPass() : renderPass;
+	VkExtent2D sceneExtent = multiview ? multiview->getEyeExtent() : vulkanApp->getSwapchain()->getExtent();
+	shrimpPipeline = new GraphicsPipeline("default", "shrimp_fwd", NULL, sceneExtent, firstSubpassDescriptor->getPipelineLayout(), scenePass, 0, true, 1, devices());
+	raymarchPipeline = new GraphicsPipeline("default", "raymarch_fwd", NULL, sceneExtent, firstSubpassDescriptor->getPipelineLayout(), scenePass, 0, true, 1, devices());
+	raccoonPipeline = new GraphicsPipeline("default", "raccoon_fwd", NULL, sceneExtent, firstSubpassDescriptor->getPipelineLayout(), scenePass, 0, true, 1, devices());
 
 	// Create uniform buffers
 	lightBuffer = new LightBuffer(glm::vec3(2, 2, 2), 20, glm::vec3(1, 1, 0), glm::vec3(0.1f, 0.1f, 0.5f), vulkanApp->getSwapchain()->getSize(), devices(), devices->getPhysicalDevice());
@@ -47,15 +63,22 @@ ForwardRendererScene::ForwardRendererScene(VulkanAppBase* vulkanApp) : Scene(vul
 	std::vector<Descriptor::ImageInfoDescriptor> imgDescriptors1 = { Descriptor::ImageInfoDescriptor(shrimpTex, vulkanApp->getSampler()), Descriptor::ImageInfoDescriptor(raccoonTex, vulkanApp->getSampler()) };
 	firstSubpassDescriptor->createDescriptorSets(vulkanApp->getSwapchain()->getSize(), *descriptorPool, uboDescriptors1, imgDescriptors1);
 
-	// Create particles
-	ParticleSystem::ParticlesConstructorParams args(ParticleRenderingMode::ForwardRen, devices, descriptorPool, vulkanApp->getSwapchain()->getSize(),
-		vulkanApp->getSwapchain()->getExtent(), renderPass, *commandPool, vulkanApp->getSampler());
+	// Create particles (in the layer of the upsampler when drawn at reduced resolution, or of the OIT when transparent, or in the stereo pass)
+	if (ParticleUpsampler::enabled())
+		upsampler = new ParticleUpsampler(vulkanApp, compositeRenderPass, 0);
+	else if (ParticleOIT::enabled())
+		oit = new ParticleOIT(vulkanApp, compositeRenderPass, 0);
+	ParticleSystem::ParticlesConstructorParams args = upsampler ? upsampler->getParticlesParams() : oit ? oit->getParticlesParams() : ParticleSystem::ParticlesConstructorParams(ParticleRenderingMode::ForwardRen,
+		devices, descriptorPool, vulkanApp->getSwapchain()->getSize(), sceneExtent, scenePass, *commandPool, vulkanApp->getSampler(), multiview ? multiview->getContinuationRenderPass() : continuationRenderPass);
 	particles = new ParticleSystem(args);
 }
 
 ForwardRendererScene::~ForwardRendererScene() {
 
 	DELETE(particles);
+	DELETE(upsampler);
+	DELETE(oit);
+	DELETE(multiview);
 
 	/// Objects dependant on swapchain
 	DELETE(lightBuffer);
@@ -66,6 +89,8 @@ ForwardRendererScene::~ForwardRendererScene() {
 	DELETE(raccoonPipeline);
 
 	DELETE(renderPass);
+	DELETE(continuationRenderPass);
+	DELETE(compositeRenderPass);
 
 	/// Objects independant from swapchain
 	delete quad;
@@ -82,19 +107,24 @@ ForwardRendererScene::~ForwardRendererScene() {
 
 void ForwardRendererScene::Update(uint32_t imageIndex, float dt, float time) {
 
-	/// Setup matrices
+	/// Setup matrices (in stereo, each eye covers half of the screen, and sees from its own view)
 	const glm::mat4& view = vulkanApp->getCamera().getViewMatrix();
-	glm::mat4 projection = glm::perspective(glm::radians(45.0f), vulkanApp->getSwapchain()->getExtent().width / (float)vulkanApp->getSwapchain()->getExtent().height, NEAR, FAR);
+	VkExtent2D extent = multiview ? multiview->getEyeExtent() : vulkanApp->getSwapchain()->getExtent();
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), extent.width / (float)extent.height, NEAR, FAR);
 	projection[1][1] *= -1;//fix ogl upside-down y coordinate scaling
+	glm::mat4 eyeViews[MULTIVIEW_VIEWS];
+	if (multiview) Multiview::eyeViews(view, eyeViews);
 
 	if (!particlesOnly) {
 		/// Update uniform buffers
-		matrixBuffer->updateBuffer(imageIndex, time, glm::mat4(1), view, projection);
+		matrixBuffer->updateBuffer(imageIndex, time, glm::mat4(1), view, projection, glm::vec2(0.f), multiview ? eyeViews : NULL);
 		lightBuffer->updateBuffer(imageIndex, dt, time);
 	}
 
 	/// Update particles ubos
-	particles->Update(imageIndex, dt, time, view, projection);
+	particles->Update(imageIndex, dt, time, view, projection, glm::vec2(0.f), multiview ? eyeViews : NULL);
+	if (upsampler)
+		upsampler->Update(imageIndex, time, view, projection, particles);
 
 }
 
@@ -104,6 +134,10 @@ bool ForwardRendererScene::UI() {
 
 	ImGui::Checkbox("Particles Only", &particlesOnly);
 
+	if (ParticleUpsampler::UI(upsampler)) return true;
+	if (ParticleOIT::UI()) return true;
+	if (Multiview::UI()) return true;
+
 	bool rebuild;
 	particles = ParticleSystem::UI(particles, rebuild);
 	if (rebuild) return true;
@@ -113,7 +147,10 @@ bool ForwardRendererScene::UI() {
 }
 
 RenderPass* ForwardRendererScene::cmdBind(const VkCommandBuffer& cmdBuffer, int index) {
-	renderPass->begin(cmdBuffer, vulkanApp->getSwapchain()->getFramebuffer(index)); {
+	const VkFramebuffer& framebuffer = multiview ? multiview->getFramebuffer() : vulkanApp->getSwapchain()->getFramebuffer(index);
+	if (multiview) multiview->begin(cmdBuffer);// every draw below is rendered to both eyes
+	else renderPass->begin(cmdBuffer, framebuffer);
+	{
 
 		//Geometry subpass:
 		{	//vkCmdFirstSubpass
@@ -137,17 +174,49 @@ RenderPass* ForwardRendererScene::cmdBind(const VkCommandBuffer& cmdBuffer, int
 				raymarchCube->cmdBind(cmdBuffer, index);
 			}
 
-			// particles
-			particles->cmdBind(cmdBuffer, index);
+			// particles (at reduced resolution or transparent: drawn once the scene is done)
+			if (!upsampler && !oit)
+				particles->cmdBind(cmdBuffer, index, framebuffer);
 
 		}
 
 	}
+
+	// stereo: both eyes composited side by side in the render pass
+	if (multiview) {
+		multiview->end(cmdBuffer);
+		renderPass->begin(cmdBuffer, vulkanApp->getSwapchain()->getFramebuffer(index));
+		multiview->cmdBindComposite(cmdBuffer, index);
+		return renderPass;
+	}
+
+	// reduced resolution particles: drawn in the layer of the upsampler, then composited over the scene in a further instance
+	if (upsampler) {
+		renderPass->end(cmdBuffer);
+		upsampler->cmdBindParticles(cmdBuffer, index, particles);
+		compositeRenderPass->begin(cmdBuffer, vulkanApp->getSwapchain()->getFramebuffer(index));
+		upsampler->cmdBindComposite(cmdBuffer, index);
+		return compositeRenderPass;
+	}
+	// transparent particles: blended in the layer of the OIT, then composited over the scene in a further instance
+	if (oit) {
+		renderPass->end(cmdBuffer);
+		oit->cmdBindParticles(cmdBuffer, index, particles);
+		compositeRenderPass->begin(cmdBuffer, vulkanApp->getSwapchain()->getFramebuffer(index));
+		oit->cmdBindComposite(cmdBuffer, index);
+		return compositeRenderPass;
+	}
 	return renderPass;
 }
 
-void ForwardRendererScene::cmdBindCompute(const VkCommandBuffer& cmdBuffer) {
+void ForwardRendererScene::cmdBindCompute(const VkCommandBuffer& cmdBuffer, int index) {
+
+	particles->cmdBindCompute(cmdBuffer, index);
+
+}
+
+bool ForwardRendererScene::computeRequired(uint32_t imageIndex) {
 
-	particles->cmdBindCompute(cmdBuffer);
+	return particles->computeRequired(imageIndex);
 
 }
@@ -2,6 +2,9 @@
 
 #include "Scene.h"
 #include "Particles.h"
+#include "ParticleUpsampler.h"
+#include "ParticleOIT.h"
+#include "Multiview.h"
 
 
 
@@ -10,6 +13,8 @@ class ForwardRendererScene : public Scene {
 
 	/// Single render pass
 	RenderPass* renderPass;
+	RenderPass* continuationRenderPass = NULL;// chained continuation of the render pass, only created when streaming particles in chunks
+	RenderPass* compositeRenderPass = NULL;// continuation compositing reduced resolution or transparent particles over the read-only scene depth, only created with the upsampler or OIT
 
 	/// Single descriptor for the only subpass
 	Descriptor* firstSubpassDescriptor;
@@ -37,6 +42,11 @@ class ForwardRendererScene : public Scene {
 
 	/// Particle system.
 	ParticleSystem* particles;
+	ParticleUpsampler* upsampler = NULL;// draws the particles at reduced resolution; NULL when they are drawn in the scene directly
+	ParticleOIT* oit = NULL;// draws the particles with weighted blended transparency; NULL when they are drawn opaque
+
+	/// Stereo target in which the scene is rendered for both eyes at once, then composited side by side in the render pass; NULL in mono
+	Multiview* multiview = NULL;
 
 	/// Whether to hide everything other than particles
 	bool particlesOnly = true;
@@ -62,7 +72,10 @@ public:
 	RenderPass* cmdBind(const VkCommandBuffer& cmdBuffer, int index) override;
 
 	/// Used to update the compute command buffer with current scene data
-	void cmdBindCompute(const VkCommandBuffer& cmdBuffer) override;
+	void cmdBindCompute(const VkCommandBuffer& cmdBuffer, int index) override;
+
+	/// Whether the compute command buffer for this image index must be submitted this frame
+	bool computeRequired(uint32_t imageIndex) override;
 
 };//class ForwardRendererScene
 
@@ -1,6 +1,13 @@
 #include "GBuffer6Scene.h"
 
 GBuffer6Scene::GBuffer6Scene(VulkanAppBase* vulkanApp) : Scene(vulkanApp) {
+	/// Render scale and velocity attachment of the temporal upscaling, which the render pass and pipelines below depend on
+	if (TemporalUpscaler::enabled())
+		temporalUpscaler = new TemporalUpscaler(vulkanApp);
+
+	/// Layout of the G-Buffers: the compact layout reads the depth buffer in place of the position attachment, and the matrices to reconstruct positions with
+	bool compact = GBufferScene::usesCompactLayout();
+
 	/// Create objects that do not rely on a specific swapchain layout
 
 	//descriptor set & pipeline layouts
@@ -10,6 +17,8 @@ GBuffer6Scene::GBuffer6Scene(VulkanAppBase* vulkanApp) : Scene(vulkanApp) {
 #ifdef SEND_DEBUG_BUFFER_G6
 	secondSubpassBindings.push_back(DESCRIPTOR_BINDING_UBO_FRAGMENT);
 #endif
+	ClusteredLights::appendBindings(secondSubpassBindings, VK_SHADER_STAGE_FRAGMENT_BIT);
+	if (compact) secondSubpassBindings.push_back(DESCRIPTOR_BINDING_UBO_FRAGMENT);
 	secondSubpassDescriptor = new Descriptor(secondSubpassBindings, devices());
 
 	// create meshes
@@ -27,23 +36,33 @@ GBuffer6Scene::GBuffer6Scene(VulkanAppBase* vulkanApp) : Scene(vulkanApp) {
 
 	/// Create objects and layouts dependant on swapchain size
 	// Create render pass & attachments
-	std::vector<RenderPass::RenderPassAttachmentDesc> attachments = { RENDERPASS_ATTACHMENT_DESC_PRESENT(vulkanApp->getSwapchain()->getFormat()), RENDERPASS_ATTACHMENT_DESC_COLOUR, RENDERPASS_ATTACHMENT_DESC_VEC4, RENDERPASS_ATTACHMENT_DESC_VEC4, RENDERPASS_ATTACHMENT_DESC_VEC4, RENDERPASS_ATTACHMENT_DESC_VEC4, RENDERPASS_ATTACHMENT_DESC_VEC4, RENDERPASS_ATTACHMENT_DESC_DEPTH };
-	renderPass = new RenderPass(devices(), attachments, 2, vulkanApp->getSwapchain()->getExtent());
+	VkFormat normalFormat = compact ? GBufferScene::getCompactNormalFormat(devices->getPhysicalDevice()) : VK_FORMAT_R16G16B16A16_SFLOAT;
+	std::vector<RenderPass::RenderPassAttachmentDesc> attachments = { RENDERPASS_ATTACHMENT_DESC_PRESENT(vulkanApp->getSwapchain()->getFormat()), RENDERPASS_ATTACHMENT_DESC_COLOUR, RENDERPASS_ATTACHMENT_DESC_FORMAT(normalFormat), RENDERPASS_ATTACHMENT_DESC_VEC4, RENDERPASS_ATTACHMENT_DESC_VEC4, RENDERPASS_ATTACHMENT_DESC_VEC4, RENDERPASS_ATTACHMENT_DESC_DEPTH };
+	if (!compact) attachments.insert(attachments.begin() + 2, RENDERPASS_ATTACHMENT_DESC_VEC4);// position
+	if (temporalUpscaler) attachments.insert(attachments.end() - 1, RENDERPASS_ATTACHMENT_DESC_VELOCITY);// written by the first subpass after the G-Buffers
+	renderPass = new RenderPass(devices(), attachments, 2, vulkanApp->getSwapchain()->getExtent(), ParticleSystem::isStreaming() ? RenderPass::Chaining::First : RenderPass::Chaining::None, 1, compact);
+	renderPass->setScaled(true);
+	if (ParticleSystem::isStreaming()) {// particles will be drawn in further render pass instances, in between their compute dispatches
+		continuationRenderPass = new RenderPass(devices(), attachments, 2, vulkanApp->getSwapchain()->getExtent(), RenderPass::Chaining::Continuation, 1, compact);
+		continuationRenderPass->setScaled(true);
+	}
 
 	// Create pipeline layouts
 	firstSubpassDescriptor->createPipelineLayout();
 	secondSubpassDescriptor->createPipelineLayout();
 
 	// Create pipelines
-	shrimpPipeline = new GraphicsPipeline("default", "shrimp_6g", NULL, vulkanApp->getSwapchain()->getExtent(), firstSubpassDescriptor->getPipelineLayout(), renderPass, 0, true, 6, devices());
-	raymarchPipeline = new GraphicsPipeline("default", "raymarch_6g", NULL, vulkanApp->getSwapchain()->getExtent(), firstSubpassDescriptor->getPipelineLayout(), renderPass, 0, true, 6, devices());
-	raccoonPipeline = new GraphicsPipeline("default", "raccoon_6g", NULL, vulkanApp->getSwapchain()->getExtent(), firstSubpassDescriptor->getPipelineLayout(), renderPass, 0, true, 6, devices());
+	int gBufferCount = (compact ? 5 : 6) + (temporalUpscaler ? 1 : 0);// G-Buffers, and velocity
+	shrimpPipeline = new GraphicsPipeline("default", "shrimp_6g", NULL, vulkanApp->getSwapchain()->getExtent(), firstSubpassDescriptor->getPipelineLayout(), renderPass, 0, true, gBufferCount, devices());
+	raymarchPipeline = new GraphicsPipeline("default", "raymarch_6g", NULL, vulkanApp->getSwapchain()->getExtent(), firstSubpassDescriptor->getPipelineLayout(), renderPass, 0, true, gBufferCount, devices());
+	raccoonPipeline = new GraphicsPipeline("default", "raccoon_6g", NULL, vulkanApp->getSwapchain()->getExtent(), firstSubpassDescriptor->getPipelineLayout(), renderPass, 0, true, gBufferCount, devices());
 	ppPipeline = new GraphicsPipeline("pp", "pp_lighting_6g", NULL, vulkanApp->getSwapchain()->getExtent(), secondSubpassDescriptor->getPipelineLayout(), renderPass, 1, false, 1, devices());
 
 	//Create attachments
 	colorAttachment = new Texture(VK_FORMAT_R8G8B8A8_UNORM, vulkanApp->getSwapchain()->getExtent(), VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, devices(), devices->getPhysicalDevice(), *commandPool, devices->getGraphicsQueue());
-	positionAttachment = new Texture(VK_FORMAT_R16G16B16A16_SFLOAT, vulkanApp->getSwapchain()->getExtent(), VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, devices(), devices->getPhysicalDevice(), *commandPool, devices->getGraphicsQueue());
-	normalAttachment = new Texture(VK_FORMAT_R16G16B16A16_SFLOAT, vulkanApp->getSwapchain()->getExtent(), VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, devices(), devices->getPhysicalDevice(), *commandPool, devices->getGraphicsQueue());
+	if (!compact)
+		positionAttachment = new Texture(VK_FORMAT_R16G16B16A16_SFLOAT, vulkanApp->getSwapchain()->getExtent(), VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, devices(), devices->getPhysicalDevice(), *commandPool, devices->getGraphicsQueue());
+	normalAttachment = new Texture(normalFormat, vulkanApp->getSwapchain()->getExtent(), VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, devices(), devices->getPhysicalDevice(), *commandPool, devices->getGraphicsQueue());
 	emissionAttachment = new Texture(VK_FORMAT_R16G16B16A16_SFLOAT, vulkanApp->getSwapchain()->getExtent(), VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, devices(), devices->getPhysicalDevice(), *commandPool, devices->getGraphicsQueue());
 	specularAttachment = new Texture(VK_FORMAT_R16G16B16A16_SFLOAT, vulkanApp->getSwapchain()->getExtent(), VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, devices(), devices->getPhysicalDevice(), *commandPool, devices->getGraphicsQueue());
 	metallicRoughnessAttachment = new Texture(VK_FORMAT_R16G16B16A16_SFLOAT, vulkanApp->getSwapchain()->getExtent(), VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, devices(), devices->getPhysicalDevice(), *commandPool, devices->getGraphicsQueue());
@@ -54,9 +73,12 @@ GBuffer6Scene::GBuffer6Scene(VulkanAppBase* vulkanApp) : Scene(vulkanApp) {
 #ifdef SEND_DEBUG_BUFFER_G6
 	debugBuffer = new DebugBuffer(vulkanApp->getSwapchain()->getSize(), devices(), devices->getPhysicalDevice());
 #endif
+	clusteredLights = new ClusteredLights(devices, *descriptorPool, vulkanApp->getSwapchain()->getSize());
 
 	// Create framebuffer attachments / note: attachment images will be prepended with present image
-	std::vector<VkImageView> attachmentImages = { colorAttachment->getImageView(), positionAttachment->getImageView(), normalAttachment->getImageView(), emissionAttachment->getImageView(), specularAttachment->getImageView(), metallicRoughnessAttachment->getImageView(), vulkanApp->getDepthBuffer()->getImageView() };
+	std::vector<VkImageView> attachmentImages = { colorAttachment->getImageView(), normalAttachment->getImageView(), emissionAttachment->getImageView(), specularAttachment->getImageView(), metallicRoughnessAttachment->getImageView(), vulkanApp->getDepthBuffer()->getImageView() };
+	if (positionAttachment) attachmentImages.insert(attachmentImages.begin() + 1, positionAttachment->getImageView());
+	if (temporalUpscaler) attachmentImages.insert(attachmentImages.end() - 1, temporalUpscaler->getVelocityAttachment()->getImageView());
 	vulkanApp->getSwapchain()->createFramebuffers(attachmentImages, renderPass->getRenderPass());
 
 	// Create subpass descriptor sets
@@ -67,12 +89,17 @@ GBuffer6Scene::GBuffer6Scene(VulkanAppBase* vulkanApp) : Scene(vulkanApp) {
 #ifdef SEND_DEBUG_BUFFER_G6
 	uboDescriptors2.push_back(Descriptor::UBODescriptor(debugBuffer->getBuffers(), (int)sizeof(DebugBufferObject)));
 #endif
-	std::vector<Descriptor::ImageInfoDescriptor> imgDescriptors2 = { DESCRIPTOR_IMG_ATTACHMENT_INFO(colorAttachment), DESCRIPTOR_IMG_ATTACHMENT_INFO(positionAttachment), DESCRIPTOR_IMG_ATTACHMENT_INFO(normalAttachment), DESCRIPTOR_IMG_ATTACHMENT_INFO(emissionAttachment), DESCRIPTOR_IMG_ATTACHMENT_INFO(specularAttachment), DESCRIPTOR_IMG_ATTACHMENT_INFO(metallicRoughnessAttachment) };
+	clusteredLights->appendDescriptors(uboDescriptors2);
+	if (compact) uboDescriptors2.push_back(Descriptor::UBODescriptor(matrixBuffer->getBuffers(), sizeof(MatrixBufferObject)));
+	std::vector<Descriptor::ImageInfoDescriptor> imgDescriptors2 = { DESCRIPTOR_IMG_ATTACHMENT_INFO(colorAttachment),
+		compact ? DESCRIPTOR_IMG_DEPTH_ATTACHMENT_INFO(vulkanApp->getDepthBuffer()) : DESCRIPTOR_IMG_ATTACHMENT_INFO(positionAttachment), DESCRIPTOR_IMG_ATTACHMENT_INFO(normalAttachment), DESCRIPTOR_IMG_ATTACHMENT_INFO(emissionAttachment), DESCRIPTOR_IMG_ATTACHMENT_INFO(specularAttachment), DESCRIPTOR_IMG_ATTACHMENT_INFO(metallicRoughnessAttachment) };
 	secondSubpassDescriptor->createDescriptorSets(vulkanApp->getSwapchain()->getSize(), *descriptorPool, uboDescriptors2, imgDescriptors2);
 
 	// Setup particles
 	ParticleSystem::ParticlesConstructorParams args(ParticleRenderingMode::DeferredG6Ren, devices, descriptorPool, vulkanApp->getSwapchain()->getSize(),
-		vulkanApp->getSwapchain()->getExtent(), renderPass, *commandPool, vulkanApp->getSampler());
+		vulkanApp->getSwapchain()->getExtent(), renderPass, *commandPool, vulkanApp->getSampler(), continuationRenderPass);
+	args.motionVectors = temporalUpscaler != NULL;
+	args.compactGBuffer = compact;
 	particles = new ParticleSystem(args);
 
 }
@@ -94,6 +121,7 @@ GBuffer6Scene::~GBuffer6Scene() {
 #ifdef SEND_DEBUG_BUFFER_G6
 	DELETE(debugBuffer);
 #endif
+	DELETE(clusteredLights);
 
 	DELETE(shrimpPipeline);
 	DELETE(raymarchPipeline);
@@ -101,6 +129,8 @@ GBuffer6Scene::~GBuffer6Scene() {
 	DELETE(ppPipeline);
 
 	DELETE(renderPass);
+	DELETE(continuationRenderPass);
+	DELETE(temporalUpscaler);
 
 	/// Objects independant from swapchain
 	delete quad;
@@ -124,16 +154,22 @@ void GBuffer6Scene::Update(uint32_t imageIndex, float dt, float time) {
 	glm::mat4 projection = glm::perspective(glm::radians(45.0f), vulkanApp->getSwapchain()->getExtent().width / (float)vulkanApp->getSwapchain()->getExtent().height, NEAR, FAR);
 	projection[1][1] *= -1;//fix ogl upside-down y coordinate scaling
 
+	/// Sub-pixel offset of this frame (temporal upscaling)
+	glm::vec2 jitter = temporalUpscaler ? temporalUpscaler->Update(imageIndex) : glm::vec2(0.f);
+
 	/// Update uniform buffers
-	if (!particlesOnly)
-		matrixBuffer->updateBuffer(imageIndex, time, glm::mat4(1), view, projection);
+	if (!particlesOnly || GBufferScene::usesCompactLayout())// also read by the lighting pass of the compact layout
+		matrixBuffer->updateBuffer(imageIndex, time, glm::mat4(1), view, projection, jitter);
 	lightBuffer->updateBuffer(imageIndex, dt, time);
 #ifdef SEND_DEBUG_BUFFER_G6
 	debugBuffer->updateBuffer(imageIndex, { (float)debugView });//send debug data to shaders
 #endif
 
 		// Update particles
-	particles->Update(imageIndex, dt, time, view, projection);
+	particles->Update(imageIndex, dt, time, view, projection, jitter);
+
+		/// Update point lights
+	clusteredLights->Update(imageIndex, time, view, projection);
 
 }
 
@@ -159,6 +195,12 @@ bool GBuffer6Scene::UI() {
 
 	ImGui::Checkbox("Particles Only", &particlesOnly);
 
+	if (GBufferScene::compactLayoutUI(3 * 8 + (temporalUpscaler ? 4 : 0))) return true;// emission, specular, metallic & roughness: RGBA16F; velocity: RG16F
+
+	ClusteredLights::UI();
+
+	if (TemporalUpscaler::UI()) return true;
+
 	/// Particle setup
 	bool rebuild;
 	particles = ParticleSystem::UI(particles, rebuild);
@@ -168,6 +210,9 @@ bool GBuffer6Scene::UI() {
 }
 
 RenderPass* GBuffer6Scene::cmdBind(const VkCommandBuffer& cmdBuffer, int index) {
+	// bin the point lights before they are read by the lighting subpass
+	clusteredLights->cmdBindCompute(cmdBuffer, index);
+
 	renderPass->begin(cmdBuffer, vulkanApp->getSwapchain()->getFramebuffer(index)); {
 
 		//Geometry subpass:
@@ -193,7 +238,7 @@ RenderPass* GBuffer6Scene::cmdBind(const VkCommandBuffer& cmdBuffer, int index)
 			}
 
 			// particles
-			particles->cmdBind(cmdBuffer, index);
+			particles->cmdBind(cmdBuffer, index, vulkanApp->getSwapchain()->getFramebuffer(index));
 
 		}
 
@@ -208,9 +253,16 @@ RenderPass* GBuffer6Scene::cmdBind(const VkCommandBuffer& cmdBuffer, int index)
 		}
 
 	}
+
+	/// Reconstruct the swapchain resolution, and continue in the overlay pass
+	if (temporalUpscaler) return temporalUpscaler->cmdResolve(cmdBuffer, index, renderPass);
 	return renderPass;
 }
 
-void GBuffer6Scene::cmdBindCompute(const VkCommandBuffer& cmdBuffer) {
-	particles->cmdBindCompute(cmdBuffer);
+void GBuffer6Scene::cmdBindCompute(const VkCommandBuffer& cmdBuffer, int index) {
+	particles->cmdBindCompute(cmdBuffer, index);
+}
+
+bool GBuffer6Scene::computeRequired(uint32_t imageIndex) {
+	return particles->computeRequired(imageIndex);
 }
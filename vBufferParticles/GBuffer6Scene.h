@@ -2,6 +2,9 @@
 
 #include "Scene.h"
 #include "Particles.h"
+#include "ClusteredLights.h"
+#include "TemporalUpscaler.h"
+#include "GBufferScene.h"// layout of the G-Buffers, shared with the G-Buffer (3) renderer
 
 
 #define SEND_DEBUG_BUFFER_G6// comment out to prevent sending debug data to lighting shader. Shader must reflect this.
@@ -17,6 +20,7 @@ class GBuffer6Scene : public Scene {
 
 	/// Single render pass
 	RenderPass* renderPass;
+	RenderPass* continuationRenderPass = NULL;// chained continuation of the render pass, only created when streaming particles in chunks
 
 	/// One descriptor set for each subpass
 	Descriptor* firstSubpassDescriptor;
@@ -44,8 +48,8 @@ class GBuffer6Scene : public Scene {
 
 	/// Components of the G-Buffers
 	Texture* colorAttachment;// albedo
-	Texture* positionAttachment;// ws position
-	Texture* normalAttachment;// ws normals
+	Texture* positionAttachment = NULL;// ws position; NULL in the compact layout (see GBufferScene::setCompactLayout())
+	Texture* normalAttachment;// ws normals (octahedral in the compact layout)
 	Texture* emissionAttachment;// emissive colour
 	Texture* specularAttachment;// specular colour
 	Texture* metallicRoughnessAttachment;// metallic amount in R / roughness amount in G - note that these could be packed into the Alpha channel of other attachments instead, but we want to simulate a highly dense G-Buffer.
@@ -57,6 +61,12 @@ class GBuffer6Scene : public Scene {
 	/// Particles.
 	ParticleSystem* particles;
 
+	/// Point lights binned in clusters each frame, added by the lighting pass
+	ClusteredLights* clusteredLights;
+
+	/// Reconstruction of the swapchain resolution from jittered frames rendered at a reduced scale; NULL when rendering at the swapchain resolution
+	TemporalUpscaler* temporalUpscaler = NULL;
+
 	/// Whether to hide everything other than particles
 	bool particlesOnly = true;
 
@@ -68,8 +78,8 @@ class GBuffer6Scene : public Scene {
 
 public:
 
-	/// Returns (only) render pass
-	inline RenderPass* getRenderPass() override { return renderPass; }
+	/// Returns (only) render pass, or the overlay pass of the temporal upscaling (in which the UI is drawn)
+	inline RenderPass* getRenderPass() override { return temporalUpscaler ? temporalUpscaler->getRenderPass() : renderPass; }
 
 	/// Initializer
 	GBuffer6Scene(VulkanAppBase* vulkanApp);
@@ -87,6 +97,9 @@ public:
 	RenderPass* cmdBind(const VkCommandBuffer& cmdBuffer, int index) override;
 
 	/// Used to update the compute command buffer with current scene data
-	void cmdBindCompute(const VkCommandBuffer& cmdBuffer) override;
+	void cmdBindCompute(const VkCommandBuffer& cmdBuffer, int index) override;
+
+	/// Whether the compute command buffer for this image index must be submitted this frame
+	bool computeRequired(uint32_t imageIndex) override;
 
 };// class GBuffer6Scene
@@ -1,6 +1,87 @@
 #include "GBufferScene.h"
 
+bool GBufferScene::compactLayout = false;
+
+/// Reads __.defines, split around the G-Buffer layout define (its mode digit then starts the second part)
+static std::vector<std::string> splitGBufferDefine() {
+	std::string definesContents = U::readFileStr("__.defines");
+	std::vector<std::string> splitDefinesContents = U::splitStr("GBUFFER_COMPACT_", definesContents);
+	if (splitDefinesContents.size() != 2 || splitDefinesContents[1].length() < 1) throw std::runtime_error("Could not modify __.defines to recompile shaders for the G-Buffer layout.");
+	return splitDefinesContents;
+}
+
+bool GBufferScene::usesCompactLayout() {
+	// lazy init pattern: mirror the layout saved in __.defines
+	static bool firstTime = true;
+	if (firstTime) {
+		firstTime = false;
+		compactLayout = splitGBufferDefine()[1][0] == '1';
+	}
+	return compactLayout;
+}
+
+bool GBufferScene::setCompactLayout(bool compact, bool noRecompile) {
+
+	// Read the current layout from __.defines (the source of truth, which may differ from the default at start-up)
+	std::vector<std::string> splitDefinesContents = splitGBufferDefine();
+	GBufferScene::compactLayout = splitDefinesContents[1][0] == '1';
+
+	if (compact == GBufferScene::compactLayout) return false;// nothing to change!
+
+	GBufferScene::compactLayout = compact;
+
+	// Change __.defines to mirror the new layout
+	std::string compactDef = (compact ? "1" : "0");
+	std::string newDefinesContents = splitDefinesContents[0] + "GBUFFER_COMPACT_" + compactDef + splitDefinesContents[1].substr(1);
+	U::writeFile("__.defines", newDefinesContents);
+	printf(("Wrote to __.defines: #define GBUFFER_COMPACT_" + compactDef + ".\n").c_str());
+
+	// Recompile the shaders writing or reading the G-Buffers of both renderers
+	if (!noRecompile) {
+		CompileShader("Shaders/shrimp_g.frag");
+		CompileShader("Shaders/raccoon_g.frag");
+		CompileShader("Shaders/raymarch_g.frag");
+		CompileShader("Shaders/particles_g3.frag");
+		CompileShader("Shaders/comp_particles_g3.frag");
+		CompileShader("Shaders/pp_lighting_g.frag");
+		CompileShader("Shaders/shrimp_6g.frag");
+		CompileShader("Shaders/raccoon_6g.frag");
+		CompileShader("Shaders/raymarch_6g.frag");
+		CompileShader("Shaders/particles_g6.frag");
+		CompileShader("Shaders/comp_particles_g6.frag");
+		CompileShader("Shaders/pp_lighting_6g.frag");
+	}
+
+	// Force rebuilding pipelines & swapchain (using newly compiled shaders)
+	return true;
+}
+
+VkFormat GBufferScene::getCompactNormalFormat(const VkPhysicalDevice& physicalDevice) {
+	VkFormatProperties properties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, GBUFFER_COMPACT_NORMAL_FORMAT, &properties);
+	if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT) return GBUFFER_COMPACT_NORMAL_FORMAT;
+	return VK_FORMAT_R16G16_SFLOAT;// always supported as a colour attachment; the same 4 bytes, with less even precision
+}
+
+bool GBufferScene::compactLayoutUI(int extraBytes) {
+
+	bool compact = usesCompactLayout();
+	ImGui::Checkbox("Compact G-Buffer", &compact);
+	if (compact != compactLayout && setCompactLayout(compact)) return true;
+
+	// albedo (4 bytes), then position & normal (8 bytes each), or the octahedral normal (4 bytes)
+	ImGui::Text("G-Buffer size: %d B/px", (compactLayout ? 4 + 4 : 4 + 8 + 8) + extraBytes);
+	return false;
+}
+
 GBufferScene::GBufferScene(VulkanAppBase* vulkanApp) : Scene(vulkanApp) {
+	/// Render scale and velocity attachment of the temporal upscaling, which the render pass and pipelines below depend on
+	if (TemporalUpscaler::enabled())
+		temporalUpscaler = new TemporalUpscaler(vulkanApp);
+
+	/// Layout of the G-Buffers: the compact layout reads the depth buffer in place of the position attachment, and the matrices to reconstruct positions with
+	bool compact = usesCompactLayout();
+
 	/// Create objects that do not rely on a specific swapchain layout
 
 	//descriptor set & pipeline layouts
@@ -10,6 +91,8 @@ GBufferScene::GBufferScene(VulkanAppBase* vulkanApp) : Scene(vulkanApp) {
 #ifdef SEND_DEBUG_BUFFER_G3
 	secondSubpassBindings.push_back(DESCRIPTOR_BINDING_UBO_FRAGMENT);
 #endif
+	ClusteredLights::appendBindings(secondSubpassBindings, VK_SHADER_STAGE_FRAGMENT_BIT);
+	if (compact) secondSubpassBindings.push_back(DESCRIPTOR_BINDING_UBO_FRAGMENT);
 	secondSubpassDescriptor = new Descriptor(secondSubpassBindings, devices());
 
 	// create meshes
@@ -26,23 +109,35 @@ GBufferScene::GBufferScene(VulkanAppBase* vulkanApp) : Scene(vulkanApp) {
 
 	/// Create objects and layouts dependant on swapchain size
 	// Create render pass & attachments
-	std::vector<RenderPass::RenderPassAttachmentDesc> attachments = { RENDERPASS_ATTACHMENT_DESC_PRESENT(vulkanApp->getSwapchain()->getFormat()), RENDERPASS_ATTACHMENT_DESC_COLOUR, RENDERPASS_ATTACHMENT_DESC_VEC4, RENDERPASS_ATTACHMENT_DESC_VEC4, RENDERPASS_ATTACHMENT_DESC_DEPTH };
-	renderPass = new RenderPass(devices(), attachments, 2, vulkanApp->getSwapchain()->getExtent());
+	VkFormat normalFormat = compact ? getCompactNormalFormat(devices->getPhysicalDevice()) : VK_FORMAT_R16G16B16A16_SFLOAT;
+	std::vector<RenderPass::RenderPassAttachmentDesc> attachments = { RENDERPASS_ATTACHMENT_DESC_PRESENT(vulkanApp->getSwapchain()->getFormat()), RENDERPASS_ATTACHMENT_DESC_COLOUR, RENDERPASS_ATTACHMENT_DESC_FORMAT(normalFormat), RENDERPASS_ATTACHMENT_DESC_DEPTH };
+	if (!compact) attachments.insert(attachments.begin() + 2, RENDERPASS_ATTACHMENT_DESC_VEC4);// position
+	if (temporalUpscaler) attachments.insert(attachments.end() - 1, RENDERPASS_ATTACHMENT_DESC_VELOCITY);// written by the first subpass along with the G-Buffers
+	bool culled = ParticleSystem::usesOcclusionCulling();
+	bool chained = ParticleSystem::isStreaming() || culled;
+	renderPass = new RenderPass(devices(), attachments, 2, vulkanApp->getSwapchain()->getExtent(), chained ? RenderPass::Chaining::First : RenderPass::Chaining::None, 1, compact);
+	renderPass->setScaled(true);
+	if (chained) {// particles will be drawn in further render pass instances, in between their compute dispatches (or after their culling)
+		continuationRenderPass = new RenderPass(devices(), attachments, 2, vulkanApp->getSwapchain()->getExtent(), RenderPass::Chaining::Continuation, 1, compact);
+		continuationRenderPass->setScaled(true);
+	}
 
 	// Create pipeline layouts
 	firstSubpassDescriptor->createPipelineLayout();
 	secondSubpassDescriptor->createPipelineLayout();
 
 	// Create pipelines
-	shrimpPipeline = new GraphicsPipeline("default", "shrimp_g", NULL, vulkanApp->getSwapchain()->getExtent(), firstSubpassDescriptor->getPipelineLayout(), renderPass, 0, true, 3, devices());
-	raymarchPipeline = new GraphicsPipeline("default", "raymarch_g", NULL, vulkanApp->getSwapchain()->getExtent(), firstSubpassDescriptor->getPipelineLayout(), renderPass, 0, true, 3, devices());
-	raccoonPipeline = new GraphicsPipeline("default", "raccoon_g", NULL, vulkanApp->getSwapchain()->getExtent(), firstSubpassDescriptor->getPipelineLayout(), renderPass, 0, true, 3, devices());
+	int gBufferCount = (compact ? 2 : 3) + (temporalUpscaler ? 1 : 0);// G-Buffers, and velocity
+	shrimpPipeline = new GraphicsPipeline("default", "shrimp_g", NULL, vulkanApp->getSwapchain()->getExtent(), firstSubpassDescriptor->getPipelineLayout(), renderPass, 0, true, gBufferCount, devices());
+	raymarchPipeline = new GraphicsPipeline("default", "raymarch_g", NULL, vulkanApp->getSwapchain()->getExtent(), firstSubpassDescriptor->getPipelineLayout(), renderPass, 0, true, gBufferCount, devices());
+	raccoonPipeline = new GraphicsPipeline("default", "raccoon_g", NULL, vulkanApp->getSwapchain()->getExtent(), firstSubpassDescriptor->getPipelineLayout(), renderPass, 0, true, gBufferCount, devices());
 	ppPipeline = new GraphicsPipeline("pp", "pp_lighting_g", NULL, vulkanApp->getSwapchain()->getExtent(), secondSubpassDescriptor->getPipelineLayout(), renderPass, 1, false, 1, devices());
 
 	//Create attachments
 	colorAttachment = new Texture(VK_FORMAT_R8G8B8A8_UNORM, vulkanApp->getSwapchain()->getExtent(), VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, devices(), devices->getPhysicalDevice(), *commandPool, devices->getGraphicsQueue());
-	positionAttachment = new Texture(VK_FORMAT_R16G16B16A16_SFLOAT, vulkanApp->getSwapchain()->getExtent(), VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, devices(), devices->getPhysicalDevice(), *commandPool, devices->getGraphicsQueue());
-	normalAttachment = new Texture(VK_FORMAT_R16G16B16A16_SFLOAT, vulkanApp->getSwapchain()->getExtent(), VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, devices(), devices->getPhysicalDevice(), *commandPool, devices->getGraphicsQueue());
+	if (!compact)
+		positionAttachment = new Texture(VK_FORMAT_R16G16B16A16_SFLOAT, vulkanApp->getSwapchain()->getExtent(), VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, devices(), devices->getPhysicalDevice(), *commandPool, devices->getGraphicsQueue());
+	normalAttachment = new Texture(normalFormat, vulkanApp->getSwapchain()->getExtent(), VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, devices(), devices->getPhysicalDevice(), *commandPool, devices->getGraphicsQueue());
 
 	// Create uniform buffers
 	lightBuffer = new LightBuffer(glm::vec3(2, 2, 2), 20, glm::vec3(1, 1, 0), glm::vec3(0.1f, 0.1f, 0.5f), vulkanApp->getSwapchain()->getSize(), devices(), devices->getPhysicalDevice());
@@ -50,9 +145,12 @@ GBufferScene::GBufferScene(VulkanAppBase* vulkanApp) : Scene(vulkanApp) {
 #ifdef SEND_DEBUG_BUFFER_G3
 	debugBuffer = new DebugBuffer(vulkanApp->getSwapchain()->getSize(), devices(), devices->getPhysicalDevice());
 #endif
+	clusteredLights = new ClusteredLights(devices, *descriptorPool, vulkanApp->getSwapchain()->getSize());
 
 	// Create framebuffer attachments / note: attachment images will be prepended with present image
-	std::vector<VkImageView> attachmentImages = { colorAttachment->getImageView(), positionAttachment->getImageView(), normalAttachment->getImageView(), vulkanApp->getDepthBuffer()->getImageView() };
+	std::vector<VkImageView> attachmentImages = { colorAttachment->getImageView(), normalAttachment->getImageView(), vulkanApp->getDepthBuffer()->getImageView() };
+	if (positionAttachment) attachmentImages.insert(attachmentImages.begin() + 1, positionAttachment->getImageView());
+	if (temporalUpscaler) attachmentImages.insert(attachmentImages.end() - 1, temporalUpscaler->getVelocityAttachment()->getImageView());
 	vulkanApp->getSwapchain()->createFramebuffers(attachmentImages, renderPass->getRenderPass());
 
 	// Create subpass descriptor sets
@@ -63,12 +161,21 @@ GBufferScene::GBufferScene(VulkanAppBase* vulkanApp) : Scene(vulkanApp) {
 #ifdef SEND_DEBUG_BUFFER_G3
 	uboDescriptors2.push_back(Descriptor::UBODescriptor(debugBuffer->getBuffers(), (int)sizeof(DebugBufferObject)));
 #endif
-	std::vector<Descriptor::ImageInfoDescriptor> imgDescriptors2 = { DESCRIPTOR_IMG_ATTACHMENT_INFO(colorAttachment), DESCRIPTOR_IMG_ATTACHMENT_INFO(positionAttachment), DESCRIPTOR_IMG_ATTACHMENT_INFO(normalAttachment) };
+	clusteredLights->appendDescriptors(uboDescriptors2);
+	if (compact) uboDescriptors2.push_back(Descriptor::UBODescriptor(matrixBuffer->getBuffers(), sizeof(MatrixBufferObject)));
+	std::vector<Descriptor::ImageInfoDescriptor> imgDescriptors2 = { DESCRIPTOR_IMG_ATTACHMENT_INFO(colorAttachment),
+		compact ? DESCRIPTOR_IMG_DEPTH_ATTACHMENT_INFO(vulkanApp->getDepthBuffer()) : DESCRIPTOR_IMG_ATTACHMENT_INFO(positionAttachment), DESCRIPTOR_IMG_ATTACHMENT_INFO(normalAttachment) };
 	secondSubpassDescriptor->createDescriptorSets(vulkanApp->getSwapchain()->getSize(), *descriptorPool, uboDescriptors2, imgDescriptors2);
 
 	/// Setup particles
 	ParticleSystem::ParticlesConstructorParams args(ParticleRenderingMode::DeferredG3Ren, devices, descriptorPool, vulkanApp->getSwapchain()->getSize(),
-		vulkanApp->getSwapchain()->getExtent(), renderPass, *commandPool, vulkanApp->getSampler());
+		vulkanApp->getSwapchain()->getExtent(), renderPass, *commandPool, vulkanApp->getSampler(), continuationRenderPass);
+	args.motionVectors = temporalUpscaler != NULL;
+	args.compactGBuffer = compact;
+	if (culled) {
+		hiZ = new HiZPyramid(vulkanApp);
+		args.hiZ = hiZ;
+	}
 	particles = new ParticleSystem(args);
 
 }
@@ -76,6 +183,7 @@ GBufferScene::GBufferScene(VulkanAppBase* vulkanApp) : Scene(vulkanApp) {
 GBufferScene::~GBufferScene() {
 
 	DELETE(particles);
+	DELETE(hiZ);
 
 	/// Objects dependant on swapchain
 	DELETE(colorAttachment);
@@ -87,6 +195,7 @@ GBufferScene::~GBufferScene() {
 #ifdef SEND_DEBUG_BUFFER_G3
 	DELETE(debugBuffer);
 #endif
+	DELETE(clusteredLights);
 
 	DELETE(shrimpPipeline);
 	DELETE(raymarchPipeline);
@@ -94,6 +203,8 @@ GBufferScene::~GBufferScene() {
 	DELETE(ppPipeline);
 
 	DELETE(renderPass);
+	DELETE(continuationRenderPass);
+	DELETE(temporalUpscaler);
 
 	/// Objects independant from swapchain
 	delete quad;
@@ -117,9 +228,12 @@ void GBufferScene::Update(uint32_t imageIndex, float dt, float time) {
 	glm::mat4 projection = glm::perspective(glm::radians(45.0f), vulkanApp->getSwapchain()->getExtent().width / (float)vulkanApp->getSwapchain()->getExtent().height, NEAR, FAR);
 	projection[1][1] *= -1;//fix ogl upside-down y coordinate scaling
 
-	if (!particlesOnly) {
+	/// Sub-pixel offset of this frame (temporal upscaling)
+	glm::vec2 jitter = temporalUpscaler ? temporalUpscaler->Update(imageIndex) : glm::vec2(0.f);
+
+	if (!particlesOnly || compactLayout) {// also read by the lighting pass of the compact layout
 		/// Update uniform buffers
-		matrixBuffer->updateBuffer(imageIndex, time, glm::mat4(1), view, projection);
+		matrixBuffer->updateBuffer(imageIndex, time, glm::mat4(1), view, projection, jitter);
 	}
 	lightBuffer->updateBuffer(imageIndex, dt, time);
 
@@ -128,7 +242,10 @@ void GBufferScene::Update(uint32_t imageIndex, float dt, float time) {
 #endif
 
 		/// Update particle ubos
-	particles->Update(imageIndex, dt, time, view, projection);
+	particles->Update(imageIndex, dt, time, view, projection, jitter);
+
+		/// Update point lights
+	clusteredLights->Update(imageIndex, time, view, projection);
 
 }
 
@@ -154,6 +271,12 @@ bool GBufferScene::UI() {
 
 	ImGui::Checkbox("Particles Only", &particlesOnly);
 
+	if (compactLayoutUI(temporalUpscaler ? 4 : 0)) return true;// velocity: RG16F
+
+	ClusteredLights::UI();
+
+	if (TemporalUpscaler::UI()) return true;
+
 	bool rebuild;
 	particles = ParticleSystem::UI(particles, rebuild);
 	if (rebuild) return true;
@@ -162,6 +285,9 @@ bool GBufferScene::UI() {
 }
 
 RenderPass* GBufferScene::cmdBind(const VkCommandBuffer& cmdBuffer, int index) {
+	// bin the point lights before they are read by the lighting subpass
+	clusteredLights->cmdBindCompute(cmdBuffer, index);
+
 	renderPass->begin(cmdBuffer, vulkanApp->getSwapchain()->getFramebuffer(index)); {
 
 		//Geometry subpass:
@@ -187,7 +313,7 @@ RenderPass* GBufferScene::cmdBind(const VkCommandBuffer& cmdBuffer, int index) {
 			}
 
 			// particles
-			particles->cmdBind(cmdBuffer, index);
+			particles->cmdBind(cmdBuffer, index, vulkanApp->getSwapchain()->getFramebuffer(index));
 
 		}
 
@@ -202,9 +328,16 @@ RenderPass* GBufferScene::cmdBind(const VkCommandBuffer& cmdBuffer, int index) {
 		}
 
 	}
+
+	/// Reconstruct the swapchain resolution, and continue in the overlay pass
+	if (temporalUpscaler) return temporalUpscaler->cmdResolve(cmdBuffer, index, renderPass);
 	return renderPass;
 }
 
-void GBufferScene::cmdBindCompute(const VkCommandBuffer& cmdBuffer) {
-	particles->cmdBindCompute(cmdBuffer);
+void GBufferScene::cmdBindCompute(const VkCommandBuffer& cmdBuffer, int index) {
+	particles->cmdBindCompute(cmdBuffer, index);
+}
+
+bool GBufferScene::computeRequired(uint32_t imageIndex) {
+	return particles->computeRequired(imageIndex);
 }
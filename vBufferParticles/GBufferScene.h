@@ -2,6 +2,9 @@
 
 #include "Scene.h"
 #include "Particles.h"
+#include "ClusteredLights.h"
+#include "TemporalUpscaler.h"
+#include "HiZPyramid.h"
 
 
 #define SEND_DEBUG_BUFFER_G3 // comment out to prevent sending debug data to lighting shader. Shader must reflect this.
@@ -12,11 +15,16 @@
 #include "DebugBuffer.h"
 #endif
 
+/// Preferred format of the octahedral normals of the compact G-Buffer layout (falls back to R16G16_SFLOAT where it cannot be rendered to)
+#define GBUFFER_COMPACT_NORMAL_FORMAT VK_FORMAT_R16G16_SNORM
+
 /// A simple scene used to demonstrate standard deferred rendering with a set of G-Buffers
 class GBufferScene : public Scene {
 
 	/// Single render pass
 	RenderPass* renderPass;
+	RenderPass* continuationRenderPass = NULL;// chained continuation of the render pass, only created when streaming particles in chunks or culling them
+	HiZPyramid* hiZ = NULL;// depth pyramid of the meshes, only created when culling particles
 
 	/// One descriptor set for each subpass
 	Descriptor* firstSubpassDescriptor;
@@ -44,8 +52,8 @@ class GBufferScene : public Scene {
 
 	/// Components of the G-Buffers
 	Texture* colorAttachment;// albedo
-	Texture* positionAttachment;// ws position
-	Texture* normalAttachment;// ws normals
+	Texture* positionAttachment = NULL;// ws position; NULL in the compact layout, which reconstructs positions from the depth buffer
+	Texture* normalAttachment;// ws normals (octahedral in the compact layout)
 
 	/// Uniform buffers sent to shaders
 	LightBuffer* lightBuffer;
@@ -54,6 +62,12 @@ class GBufferScene : public Scene {
 	/// Particle system.
 	ParticleSystem* particles;
 
+	/// Point lights binned in clusters each frame, added by the lighting pass
+	ClusteredLights* clusteredLights;
+
+	/// Reconstruction of the swapchain resolution from jittered frames rendered at a reduced scale; NULL when rendering at the swapchain resolution
+	TemporalUpscaler* temporalUpscaler = NULL;
+
 	/// Whether to hide everything other than particles
 	bool particlesOnly = true;
 
@@ -63,10 +77,13 @@ class GBufferScene : public Scene {
 	uint8_t debugView = 0;// shaded or raw view of albedo, position, etc.
 #endif
 
+	/// Whether the G-Buffers of both G-Buffer renderers are in the compact layout (mirrors GBUFFER_COMPACT in __.defines)
+	static bool compactLayout;
+
 public:
 
-	/// Returns (only) render pass
-	inline RenderPass* getRenderPass() override { return renderPass; }
+	/// Returns (only) render pass, or the overlay pass of the temporal upscaling (in which the UI is drawn)
+	inline RenderPass* getRenderPass() override { return temporalUpscaler ? temporalUpscaler->getRenderPass() : renderPass; }
 
 	/// Initializer
 	GBufferScene(VulkanAppBase* vulkanApp);
@@ -84,6 +101,21 @@ public:
 	RenderPass* cmdBind(const VkCommandBuffer& cmdBuffer, int index) override;
 
 	/// Used to update the compute command buffer with current scene data
-	void cmdBindCompute(const VkCommandBuffer& cmdBuffer) override;
+	void cmdBindCompute(const VkCommandBuffer& cmdBuffer, int index) override;
+
+	/// Whether the compute command buffer for this image index must be submitted this frame
+	bool computeRequired(uint32_t imageIndex) override;
+
+	/// Resets the layout of the G-Buffers of both G-Buffer renderers (see Shaders/gbuffer.glsl): compact (no position attachment, as positions are
+	/// reconstructed from the depth buffer, and octahedral normals) or full; this is static and will cause a re-compile of the G-Buffer shaders automatically.
+	/// Returns true if the swapchain should be rebuilt
+	static bool setCompactLayout(bool compact, bool noRecompile = false);
+	/// Whether the G-Buffers are in the compact layout
+	static bool usesCompactLayout();
+	/// Format of the normal attachment in the compact layout, as supported by the device
+	static VkFormat getCompactNormalFormat(const VkPhysicalDevice& physicalDevice);
+
+	/// Layout checkbox, with the bytes per pixel of the G-Buffers (extraBytes: those of the renderer's further attachments); returns true if the scene must be rebuilt
+	static bool compactLayoutUI(int extraBytes);
 
 };// class GBufferScene
@@ -74,7 +74,7 @@ VkPipelineShaderStageCreateInfo GraphicsPipeline_Template<VertexType, topology>:
 
 /// Creates the graphics pipeline, given the shader filenames for the different stages.
 template<typename VertexType, VkPrimitiveTopology topology>
-GraphicsPipeline_Template<VertexType, topology>::GraphicsPipeline_Template(const std::string& vertexShaderFile, const std::string& fragmentShaderFile, const std::string* geometryShaderFile, const VkExtent2D& viewportSize, const VkPipelineLayout& pipelineLayout, const RenderPass* renderPass, uint32_t subpassId, bool depthWrite, uint32_t outputAttachmentCount, VkDevice* logicalDevice) : logicalDevice(logicalDevice) {
+GraphicsPipeline_Template<VertexType, topology>::GraphicsPipeline_Template(const std::string& vertexShaderFile, const std::string& fragmentShaderFile, const std::string* geometryShaderFile, const VkExtent2D& viewportSize, const VkPipelineLayout& pipelineLayout, const RenderPass* renderPass, uint32_t subpassId, bool depthWrite, uint32_t outputAttachmentCount, VkDevice* logicalDevice, VkCompareOp depthCompareOp, bool colourWrite, BlendMode blendMode) : logicalDevice(logicalDevice) {
 
 	ASSERT_IS_VERTEX_TYPE(VertexType)//assert that the template argument is a type derived from Vertex_Template
 
@@ -137,6 +137,13 @@ GraphicsPipeline_Template<VertexType, topology>::GraphicsPipeline_Template(const
 	viewportInfo.scissorCount = 1;
 	viewportInfo.pScissors = &scissor;
 
+	// viewport & scissor are set when render passes begin (see RenderPass::renderScale), so that the render resolution changes without new pipelines
+	std::array<VkDynamicState, 2> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+	VkPipelineDynamicStateCreateInfo dynamicInfo = {};
+	dynamicInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicInfo.dynamicStateCount = (uint32_t)dynamicStates.size();
+	dynamicInfo.pDynamicStates = dynamicStates.data();
+
 	VkPipelineRasterizationStateCreateInfo rastInfo = {};
 	rastInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
 	rastInfo.depthClampEnable = VK_FALSE;
@@ -162,14 +169,19 @@ GraphicsPipeline_Template<VertexType, topology>::GraphicsPipeline_Template(const
 	std::vector<VkPipelineColorBlendAttachmentState> blendAttachments;
 	for (unsigned int i = 0; i < outputAttachmentCount; ++i) {
 
+		// destination factor: none when opaque, summed for the accumulation of weighted blended transparency, otherwise premultiplied alpha
+		VkBlendFactor dstFactor =	blendMode == BlendMode::Opaque ?						VK_BLEND_FACTOR_ZERO :
+									blendMode == BlendMode::WeightedBlended && i == 0 ?	VK_BLEND_FACTOR_ONE :
+																						VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+
 		VkPipelineColorBlendAttachmentState blendAttachment = {};
-		blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-		blendAttachment.blendEnable = VK_FALSE;
+		blendAttachment.colorWriteMask = colourWrite ? VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT : 0;
+		blendAttachment.blendEnable = blendMode != BlendMode::Opaque ? VK_TRUE : VK_FALSE;
 		blendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
-		blendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+		blendAttachment.dstColorBlendFactor = dstFactor;
 		blendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
 		blendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-		blendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+		blendAttachment.dstAlphaBlendFactor = dstFactor;
 		blendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
 
 		blendAttachments.push_back(blendAttachment);
@@ -186,8 +198,8 @@ GraphicsPipeline_Template<VertexType, topology>::GraphicsPipeline_Template(const
 	VkPipelineDepthStencilStateCreateInfo depthInfo = {};
 	depthInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
 	depthInfo.depthTestEnable = depthWrite ? VK_TRUE : VK_FALSE;
-	depthInfo.depthWriteEnable = depthWrite? VK_TRUE : VK_FALSE;
-	depthInfo.depthCompareOp = VK_COMPARE_OP_LESS;
+	depthInfo.depthWriteEnable = depthWrite && blendMode != BlendMode::WeightedBlended ? VK_TRUE : VK_FALSE;// translucent surfaces must not hide each other
+	depthInfo.depthCompareOp = depthCompareOp;
 	depthInfo.depthBoundsTestEnable = VK_FALSE;
 	depthInfo.stencilTestEnable = VK_FALSE;
 
@@ -205,7 +217,7 @@ GraphicsPipeline_Template<VertexType, topology>::GraphicsPipeline_Template(const
 	info.pMultisampleState = &multiSampleInfo;
 	info.pDepthStencilState = &depthInfo;
 	info.pColorBlendState = &blendInfo;
-	info.pDynamicState = NULL;
+	info.pDynamicState = &dynamicInfo;
 	info.layout = pipelineLayout;
 	info.renderPass = renderPass->getRenderPass();
 	info.subpass = subpassId;
@@ -227,8 +239,8 @@ GraphicsPipeline_Template<VertexType, topology>::GraphicsPipeline_Template(const
 
 
 //Template pre-definitions
-template GraphicsPipeline_Template<Vertex, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST>::GraphicsPipeline_Template(const std::string&, const std::string&, const std::string*, const VkExtent2D&, const VkPipelineLayout&, const RenderPass*, uint32_t, bool, uint32_t, VkDevice*);
-template GraphicsPipeline_Template<VisibilityVertex, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST>::GraphicsPipeline_Template(const std::string&, const std::string&, const std::string*, const VkExtent2D&, const VkPipelineLayout&, const RenderPass*, uint32_t, bool, uint32_t, VkDevice*);
-template GraphicsPipeline_Template<PointVertex, VK_PRIMITIVE_TOPOLOGY_POINT_LIST>::GraphicsPipeline_Template(const std::string&, const std::string&, const std::string*, const VkExtent2D&, const VkPipelineLayout&, const RenderPass*, uint32_t, bool, uint32_t, VkDevice*);
-template GraphicsPipeline_Template<NulVertex, VK_PRIMITIVE_TOPOLOGY_POINT_LIST>::GraphicsPipeline_Template(const std::string&, const std::string&, const std::string*, const VkExtent2D&, const VkPipelineLayout&, const RenderPass*, uint32_t, bool, uint32_t, VkDevice*);
-template GraphicsPipeline_Template<NulVertex, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST>::GraphicsPipeline_Template(const std::string&, const std::string&, const std::string*, const VkExtent2D&, const VkPipelineLayout&, const RenderPass*, uint32_t, bool, uint32_t, VkDevice*);
+template GraphicsPipeline_Template<Vertex, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST>::GraphicsPipeline_Template(const std::string&, const std::string&, const std::string*, const VkExtent2D&, const VkPipelineLayout&, const RenderPass*, uint32_t, bool, uint32_t, VkDevice*, VkCompareOp, bool, BlendMode);
+template GraphicsPipeline_Template<VisibilityVertex, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST>::GraphicsPipeline_Template(const std::string&, const std::string&, const std::string*, const VkExtent2D&, const VkPipelineLayout&, const RenderPass*, uint32_t, bool, uint32_t, VkDevice*, VkCompareOp, bool, BlendMode);
+template GraphicsPipeline_Template<PointVertex, VK_PRIMITIVE_TOPOLOGY_POINT_LIST>::GraphicsPipeline_Template(const std::string&, const std::string&, const std::string*, const VkExtent2D&, const VkPipelineLayout&, const RenderPass*, uint32_t, bool, uint32_t, VkDevice*, VkCompareOp, bool, BlendMode);
+template GraphicsPipeline_Template<NulVertex, VK_PRIMITIVE_TOPOLOGY_POINT_LIST>::GraphicsPipeline_Template(const std::string&, const std::string&, const std::string*, const VkExtent2D&, const VkPipelineLayout&, const RenderPass*, uint32_t, bool, uint32_t, VkDevice*, VkCompareOp, bool, BlendMode);
+template GraphicsPipeline_Template<NulVertex, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST>::GraphicsPipeline_Template(const std::string&, const std::string&, const std::string*, const VkExtent2D&, const VkPipelineLayout&, const RenderPass*, uint32_t, bool, uint32_t, VkDevice*, VkCompareOp, bool, BlendMode);
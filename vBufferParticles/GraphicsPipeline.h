@@ -19,6 +19,14 @@ void CompileShader(std::string filename);// compiles a single shader to spir-v
 
 
 
+/// How the outputs of a pipeline are blended with the contents of its attachments
+enum class BlendMode {
+	Opaque,			// outputs overwrite the attachments
+	Premultiplied,	// outputs are blended over the attachments as premultiplied alpha (eg. to composite an off-screen layer)
+	WeightedBlended	// weighted blended transparency (see ParticleOIT.h): the first output is summed, the others blended as premultiplied coverage; depth is tested, never written
+};// enum class BlendMode
+
+
 /// Abstract base class for graphics pipelines
 class GraphicsPipeline_Base : public Bindable {
 public:
@@ -51,14 +59,18 @@ public:
 	/// vertexShaderFile: filename for the vertex shader source
 	/// fragmentShaderFile: filename for the fragment shader source
 	/// geometryShaderFile: optional filename for the geometry shader source, or NULL
-	/// viewportSize: the current size of the viewport
+	/// viewportSize: the current size of the viewport (dynamic state: the viewport actually used is set by RenderPass::begin)
 	/// pipelineLayout: the pipeline layout to use for this graphics pipeline
 	/// renderPass: the renderPass this pipeline will be used in
 	/// subpassId: the subpass index this pipeline will be used in
 	/// depthWrite: whether this pipeline should write to depth buffer
 	/// outputAttachmentCount: how many output attachments the fragment shader will be writing to
 	/// logicalDevice: the current VkDevice.
-	GraphicsPipeline_Template(const std::string& vertexShaderFile, const std::string& fragmentShaderFile, const std::string* geometryShaderFile, const VkExtent2D& viewportSize, const VkPipelineLayout& pipelineLayout, const RenderPass* renderPass, uint32_t subpassId, bool depthWrite, uint32_t outputAttachmentCount, VkDevice* logicalDevice);
+	/// depthCompareOp: optional depth test (eg. LESS_OR_EQUAL to shade over a depth prepass)
+	/// colourWrite: optionally mask all colour writes (eg. for a depth prepass)
+	/// blendMode: optionally blend the outputs with the attachment contents (see BlendMode)
+	GraphicsPipeline_Template(const std::string& vertexShaderFile, const std::string& fragmentShaderFile, const std::string* geometryShaderFile, const VkExtent2D& viewportSize, const VkPipelineLayout& pipelineLayout, const RenderPass* renderPass, uint32_t subpassId, bool depthWrite, uint32_t outputAttachmentCount, VkDevice* logicalDevice,
+		VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS, bool colourWrite = true, BlendMode blendMode = BlendMode::Opaque);
 
 	/// Cleans up Vulkan pipeline resource
 	inline virtual ~GraphicsPipeline_Template() { vkDestroyPipeline(*logicalDevice, pipeline, NULL); }
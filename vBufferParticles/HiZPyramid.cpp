@@ -0,0 +1,105 @@
+#include "HiZPyramid.h"
+
+
+HiZPyramid::HiZPyramid(VulkanAppBase* vulkanApp) : vulkanApp(vulkanApp), devices(vulkanApp->devices) {
+
+	int swapchainSize = vulkanApp->getSwapchain()->getSize();
+
+	/// Pyramid sized for the whole swapchain extent (the levels of a reduced render area are no larger, and lie at no further offsets)
+	std::vector<glm::ivec2> offsets, sizes;
+	getLevels(vulkanApp->getSwapchain()->getExtent(), offsets, sizes);
+	glm::ivec2 extent = sizes[0];
+	for (size_t i = 1; i < sizes.size(); ++i) extent = glm::max(extent, offsets[i] + sizes[i]);
+	pyramid = new Texture(HIZ_FORMAT, { (uint32_t)extent.x, (uint32_t)extent.y }, VK_IMAGE_USAGE_STORAGE_BIT, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_GENERAL,
+		devices(), devices->getPhysicalDevice(), *vulkanApp->getCommandPool(), devices->getGraphicsQueue());
+
+	/// Reduction (same bindings as Shaders/hiz_reduce.comp): depth buffer, pyramid
+	DESCRIPTOR_BINDING_ARRAY bindings = { DESCRIPTOR_BINDING_SAMPLER_COMPUTE, DESCRIPTOR_BINDING_STORAGE_IMAGE_COMPUTE };
+	descriptor = new Descriptor(bindings, devices(), VK_PIPELINE_BIND_POINT_COMPUTE);
+	descriptor->createPipelineLayout(sizeof(HiZConstants), VK_SHADER_STAGE_COMPUTE_BIT);
+	descriptor->createDescriptorSets(swapchainSize, {/* no buffers */ }, {// own pool, leaving the few storage images of the shared pool to the other passes
+		Descriptor::ImageInfoDescriptor(vulkanApp->getDepthBuffer(), vulkanApp->getSampler(), VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL),
+		Descriptor::ImageInfoDescriptor(pyramid, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL) });
+	pipeline = new ComputePipeline("hiz_reduce", descriptor->getPipelineLayout(), devices());
+
+}
+
+HiZPyramid::~HiZPyramid() {
+	DELETE(pipeline);
+	DELETE(descriptor);
+	DELETE(pyramid);
+}
+
+void HiZPyramid::getLevels(VkExtent2D renderArea, std::vector<glm::ivec2>& offsets, std::vector<glm::ivec2>& sizes) {
+
+	offsets.clear();
+	sizes.clear();
+
+	/// Level 0 at the origin, half the render area; further levels in a column to its right, down to a single texel
+	glm::ivec2 size = (glm::ivec2(renderArea.width, renderArea.height) + 1) / 2;
+	offsets.push_back(glm::ivec2(0));
+	sizes.push_back(size);
+	while (size.x > 1 || size.y > 1) {
+		glm::ivec2 offset = sizes.size() == 1 ? glm::ivec2(sizes[0].x, 0) : offsets.back() + glm::ivec2(0, size.y);
+		size = glm::max((size + 1) / 2, glm::ivec2(1));
+		offsets.push_back(offset);
+		sizes.push_back(size);
+	}
+
+}
+
+int HiZPyramid::cmdBuild(const VkCommandBuffer& cmdBuffer, int index) {
+
+	std::vector<glm::ivec2> offsets, sizes;
+	VkExtent2D renderArea = getRenderArea();
+	getLevels(renderArea, offsets, sizes);
+
+	/// Depth buffer: from attachment to read-only, once the meshes are drawn; the pyramid may still be read by the culling of the previous frame
+	VkImageMemoryBarrier depthBarrier = {};
+	depthBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	depthBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	depthBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	depthBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	depthBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	depthBarrier.image = vulkanApp->getDepthBuffer()->getImage();
+	depthBarrier.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+	VkMemoryBarrier pyramidBarrier = {};
+	pyramidBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	pyramidBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	pyramidBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &pyramidBarrier, 0, NULL, 1, &depthBarrier);
+
+	descriptor->cmdBind(cmdBuffer, index);
+	pipeline->cmdBind(cmdBuffer, index);
+
+	/// One dispatch per level, each reading the level written before it
+	for (size_t level = 0; level < sizes.size(); ++level) {
+		HiZConstants constants = {};
+		constants.sourceOffset = level == 0 ? glm::ivec2(0) : offsets[level - 1];
+		constants.sourceSize = level == 0 ? glm::ivec2(renderArea.width, renderArea.height) : sizes[level - 1];
+		constants.offset = offsets[level];
+		constants.size = sizes[level];
+		constants.fromDepth = level == 0 ? 1 : 0;
+		descriptor->cmdPushConstants(cmdBuffer, &constants);
+		vkCmdDispatch(cmdBuffer, (sizes[level].x + HIZ_GROUP - 1) / HIZ_GROUP, (sizes[level].y + HIZ_GROUP - 1) / HIZ_GROUP, 1);
+
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, NULL, 0, NULL);
+	}
+
+	/// Depth buffer back to an attachment, for the render pass instance the particles are drawn in
+	depthBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	depthBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+		0, 0, NULL, 0, NULL, 1, &depthBarrier);
+
+	return (int)sizes.size();
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include "VulkanAppBase.h"
+#include "ComputePipeline.h"
+#include "Descriptor.h"
+#include "Utils.h"
+
+
+// pixels per side of the workgroups of the reduction (must match Shaders/hiz_reduce.comp)
+#define HIZ_GROUP 8
+// format of the pyramid: furthest depth of each texel's footprint
+#define HIZ_FORMAT VK_FORMAT_R32_SFLOAT
+
+
+/// Push constants of the reduction of one level (same layout as Shaders/hiz_reduce.comp)
+struct HiZConstants {
+	glm::ivec2 sourceOffset;// level read, within the pyramid (ignored when reading the depth buffer)
+	glm::ivec2 sourceSize;
+	glm::ivec2 offset;// level written, within the pyramid
+	glm::ivec2 size;
+	int32_t fromDepth;// 1 -> the level is reduced from the depth buffer
+};// struct HiZConstants
+
+
+/// Hierarchical depth of the meshes of a scene, against which particles are culled before they are drawn (see ParticleSystem::usesOcclusionCulling()).
+/// Level 0 holds the furthest depth of each 2x2 pixels of the depth buffer (over the render area), and each further level the furthest of 2x2 texels of the
+/// level below, down to a single texel; sizes are rounded up, so that every texel covers its whole footprint. All levels are packed in a single storage image:
+/// level 0 at its origin, and the further levels stacked in a column to its right (see hizLevel() in Shaders/particles_cull.comp).
+/// The owning scene draws its meshes in the first subpass of a render pass created with RenderPass::Chaining::First; the particle system then ends it,
+/// records cmdBuild() and its culling pass, and draws in a continuation instance.
+class HiZPyramid {
+
+	VulkanAppBase* vulkanApp;
+	DevicesPtr devices;
+
+	/// All levels of the pyramid (one copy, as frames are ordered by barriers)
+	Texture* pyramid;
+
+	/// Reduction of one level: depth buffer, pyramid
+	Descriptor* descriptor;
+	ComputePipeline* pipeline;
+
+public:
+
+	/// Creates the pyramid for the swapchain extent, and the reduction pass
+	HiZPyramid(VulkanAppBase* vulkanApp);
+	/// Cleanup
+	~HiZPyramid();
+
+	/// Size of each level, and where it lies within the pyramid, for a depth buffer whose render area is renderArea
+	static void getLevels(VkExtent2D renderArea, std::vector<glm::ivec2>& offsets, std::vector<glm::ivec2>& sizes);
+
+	/// Records the reduction of the depth written so far (outside of a render pass); the depth buffer is left as a depth attachment, and the pyramid
+	/// readable by compute shaders. Returns the amount of levels built.
+	int cmdBuild(const VkCommandBuffer& cmdBuffer, int index);
+
+	/// Pyramid, read as a storage image (VK_IMAGE_LAYOUT_GENERAL) by the culling pass
+	inline Texture* getPyramid() { return pyramid; }
+	/// Render area covered by level 0 at the current render scale
+	inline VkExtent2D getRenderArea() { return RenderPass::getRenderArea(vulkanApp->getSwapchain()->getExtent()); }
+
+};// class HiZPyramid
@@ -8,29 +8,38 @@ struct MatrixBufferObject {
 	alignas(16) glm::mat4 view;// view matrix
 	alignas(16) glm::mat4 proj;// projection matrix
 	alignas(4) float time;// time since startup
+	alignas(16) glm::mat4 previousView;// view matrix of the previous update (motion vectors)
+	alignas(8) glm::vec2 jitter;// sub-pixel offset of the frame, in clip space (temporal upscaling)
+	alignas(16) glm::mat4 views[MULTIVIEW_VIEWS];// view matrix of each eye in multiview stereo, indexed by the view rendered (all equal to view otherwise)
 };// struct MatrixBufferObject
 
 // The world, projection, view matrices sent to shaders. Also includes time for ease of access in shaders.
 struct MatrixBuffer : public UniformBuffer<MatrixBufferObject> {
 
-	MatrixBufferObject ubo;// the uniform buffer object sent to shaders
+	MatrixBufferObject ubo = {};// the uniform buffer object sent to shaders (zero until the first update)
 	int noUpdatesCount = 0;
 
 	inline MatrixBuffer(UNIFORM_BUFFER_CONSTRUCTOR) {}
 
-	/// Updates and uploads the matrices to the GPU.
-	inline void updateBuffer(uint32_t currentImage, float time, const glm::mat4& world, const glm::mat4& view, const glm::mat4& proj) {
+	/// Updates and uploads the matrices to the GPU; the previous view is the view of the last update (motion vectors), and jitter the frame's sub-pixel offset (see TemporalUpscaler).
+	/// eyeViews: MULTIVIEW_VIEWS view matrices of the eyes in multiview stereo (see Multiview.h); NULL renders every view from view.
+	inline void updateBuffer(uint32_t currentImage, float time, const glm::mat4& world, const glm::mat4& view, const glm::mat4& proj, const glm::vec2& jitter = glm::vec2(0.f), const glm::mat4* eyeViews = NULL) {
 
 		// Check whether we should send any data to the gpu
-		if (ubo.model == world && ubo.view == view && ubo.proj == proj && ubo.time == time) ++noUpdatesCount;
+		bool sameViews = true;
+		for (int i = 0; i < MULTIVIEW_VIEWS; ++i) sameViews &= ubo.views[i] == (eyeViews ? eyeViews[i] : view);
+		if (ubo.model == world && ubo.view == view && ubo.proj == proj && ubo.time == time && ubo.previousView == view && ubo.jitter == jitter && sameViews) ++noUpdatesCount;
 		else noUpdatesCount = 0;
 		if (noUpdatesCount > getBuffers().size()) return;// nothing to update on the GPU.
 
 		// copy the data into the UBO.
+		ubo.previousView = ubo.view != glm::mat4(0.f) ? ubo.view : view;// first update: no motion
+		ubo.jitter = jitter;
 		ubo.model = world;
 		ubo.view = view;
 		ubo.proj = proj;
 		ubo.time = time;
+		for (int i = 0; i < MULTIVIEW_VIEWS; ++i) ubo.views[i] = eyeViews ? eyeViews[i] : view;
 
 		copyBuffer(currentImage, ubo);// send to GPU
 	}
@@ -46,7 +46,7 @@ public:
 	}
 
 	/// Quad mesh for visibility vertices. triId will be increased by 2. See UberVMesh class.
-	static inline UberVMesh* createVisibilityQuadMesh(glm::vec3 origin, glm::vec2 size, uint16_t& triId, uint16_t matId, VkDevice* logicalDevice, const VkPhysicalDevice& physicalDevice, const VkCommandPool& commandPool, const VkQueue& graphicsQueue) {
+	static inline UberVMesh* createVisibilityQuadMesh(glm::vec3 origin, glm::vec2 size, uint32_t& triId, uint16_t matId, VkDevice* logicalDevice, const VkPhysicalDevice& physicalDevice, const VkCommandPool& commandPool, const VkQueue& graphicsQueue) {
 		const std::vector<UberVVertex> vertices = {
 			UberVVertex(origin + glm::vec3(-0.5f * size.x, -0.5f * size.y, 0.f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec2(0.0f, 1.0f), triId, matId),
 			UberVVertex(origin + glm::vec3(0.5f * size.x, -0.5f * size.y, 0.f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec2(1.0f, 1.0f), triId, matId),
@@ -110,7 +110,7 @@ public:
 	}
 
 	/// Same as normal cube mesh, used to create specifically visibility mesh.
-	static inline UberVMesh* createVisibilityCubeMesh(glm::vec3 origin, glm::vec3 size, uint16_t& triId, uint16_t matId, VkDevice* logicalDevice, const VkPhysicalDevice& physicalDevice, const VkCommandPool& commandPool, const VkQueue& graphicsQueue) {
+	static inline UberVMesh* createVisibilityCubeMesh(glm::vec3 origin, glm::vec3 size, uint32_t& triId, uint16_t matId, VkDevice* logicalDevice, const VkPhysicalDevice& physicalDevice, const VkCommandPool& commandPool, const VkQueue& graphicsQueue) {
 		std::vector<UberVVertex> vertices;
 		std::vector<uint16_t> indices;
 
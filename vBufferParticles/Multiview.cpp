@@ -0,0 +1,185 @@
+#include "Multiview.h"
+#include "VBufferScene.h"
+
+
+bool Multiview::active = false;
+bool Multiview::supported = false;
+bool Multiview::geometrySupported = false;
+
+
+Multiview::Multiview(VulkanAppBase* vulkanApp, const RenderPass* compositeRenderPass, uint32_t compositeSubpass, const std::vector<VkFormat>& bufferFormats) : vulkanApp(vulkanApp), devices(vulkanApp->devices) {
+
+	int swapchainSize = vulkanApp->getSwapchain()->getSize();
+	VkExtent2D extent = vulkanApp->getSwapchain()->getExtent();
+	eyeExtent = { (extent.width + 1) / 2, extent.height };// eyes side by side on screen
+	VkFormat format = vulkanApp->getSwapchain()->getFormat();
+
+	/// Stereo target, one layer per view; colour sampled by the composite once the pass is over
+	colour = new Texture(format, eyeExtent, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT,
+		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, devices(), devices->getPhysicalDevice(), *vulkanApp->getCommandPool(), devices->getGraphicsQueue(), MULTIVIEW_VIEWS);
+	for (VkFormat bufferFormat : bufferFormats)
+		buffers.push_back(new Texture(bufferFormat, eyeExtent, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, devices(), devices->getPhysicalDevice(), *vulkanApp->getCommandPool(), devices->getGraphicsQueue(), MULTIVIEW_VIEWS));
+	depth = new Texture(VK_FORMAT_D32_SFLOAT, eyeExtent, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT,
+		VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, devices(), devices->getPhysicalDevice(), *vulkanApp->getCommandPool(), devices->getGraphicsQueue(), MULTIVIEW_VIEWS);
+
+	/// Render passes broadcast to every view: a single subpass, or a subpass writing the buffers then one shading the eyes from them
+	std::vector<RenderPass::RenderPassAttachmentDesc> attachments = {
+		RenderPass::RenderPassAttachmentDesc(format, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ATTACHMENT_STORE_OP_STORE) };
+	for (VkFormat bufferFormat : bufferFormats)
+		attachments.push_back(RenderPass::RenderPassAttachmentDesc(bufferFormat, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_ATTACHMENT_STORE_OP_DONT_CARE));
+	attachments.push_back(RENDERPASS_ATTACHMENT_DESC_DEPTH);
+	int subpassCount = buffers.empty() ? 1 : 2;
+	renderPass = new RenderPass(devices(), attachments, subpassCount, eyeExtent, ParticleSystem::isStreaming() ? RenderPass::Chaining::First : RenderPass::Chaining::None, MULTIVIEW_VIEWS);
+	renderPass->setScaled(true);// draws the scene, of which each eye covers the render area
+	if (ParticleSystem::isStreaming()) {// particles will be drawn in further render pass instances, in between their compute dispatches
+		continuationRenderPass = new RenderPass(devices(), attachments, subpassCount, eyeExtent, RenderPass::Chaining::Continuation, MULTIVIEW_VIEWS);
+		continuationRenderPass->setScaled(true);
+	}
+
+	/// Framebuffer (a single layer: the views of multiview render passes address the layers of the attachments)
+	std::vector<VkImageView> views = { colour->getImageView() };
+	for (Texture* buffer : buffers) views.push_back(buffer->getImageView());
+	views.push_back(depth->getImageView());
+	VkFramebufferCreateInfo framebufferInfo = {};
+	framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	framebufferInfo.renderPass = renderPass->getRenderPass();
+	framebufferInfo.attachmentCount = (uint32_t)views.size();
+	framebufferInfo.pAttachments = views.data();
+	framebufferInfo.width = eyeExtent.width;
+	framebufferInfo.height = eyeExtent.height;
+	framebufferInfo.layers = 1;
+	if (vkCreateFramebuffer(*devices(), &framebufferInfo, NULL, &framebuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create stereo framebuffer");
+	}
+
+	/// Composite (same bindings as Shaders/multiview_composite.frag): both eyes; push constant: width rendered of each eye
+	DESCRIPTOR_BINDING_ARRAY compositeBindings = { DESCRIPTOR_BINDING_SAMPLER_FRAGMENT };
+	compositeDescriptor = new Descriptor(compositeBindings, devices());
+	compositeDescriptor->createPipelineLayout(sizeof(int32_t), VK_SHADER_STAGE_FRAGMENT_BIT);
+	compositeDescriptor->createDescriptorSets(swapchainSize, *vulkanApp->getDescriptorPool(), {/* no buffers */ }, { Descriptor::ImageInfoDescriptor(colour, vulkanApp->getSampler()) });
+	compositePipeline = new GraphicsPipeline("pp", "multiview_composite", NULL, extent, compositeDescriptor->getPipelineLayout(), compositeRenderPass, compositeSubpass, false, 1, devices());
+
+}
+
+Multiview::~Multiview() {
+	DELETE(compositePipeline);
+	DELETE(compositeDescriptor);
+	vkDestroyFramebuffer(*devices(), framebuffer, NULL);
+	DELETE(renderPass);
+	DELETE(continuationRenderPass);
+	DELETE(colour);
+	for (Texture*& buffer : buffers) { DELETE(buffer); }
+	DELETE(depth);
+}
+
+void Multiview::begin(const VkCommandBuffer& cmdBuffer) {
+
+	/// The eyes may still be read by the composite of the previous frame
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, NULL, 0, NULL, 0, NULL);
+
+	renderPass->begin(cmdBuffer, framebuffer);
+
+}
+
+void Multiview::end(const VkCommandBuffer& cmdBuffer) {
+
+	renderPass->end(cmdBuffer);// also ends the last continuation instance when streaming
+
+	/// Make the eyes readable by the composite (bottom of pipe chains with the layout transitions at the end of the render pass)
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		0, 1, &barrier, 0, NULL, 0, NULL);
+
+}
+
+void Multiview::cmdBindComposite(const VkCommandBuffer& cmdBuffer, int index) {
+
+	int32_t eyeWidth = (int32_t)RenderPass::getRenderArea(eyeExtent).width;// each eye covers the render area of the stereo pass
+
+	compositeDescriptor->cmdBind(cmdBuffer, index);
+	compositeDescriptor->cmdPushConstants(cmdBuffer, &eyeWidth);
+	compositePipeline->cmdBind(cmdBuffer, index);
+	vkCmdDraw(cmdBuffer, 3, 1, 0, 0);// full-screen quad
+
+}
+
+void Multiview::eyeViews(const glm::mat4& view, glm::mat4 views[MULTIVIEW_VIEWS]) {
+	for (int i = 0; i < MULTIVIEW_VIEWS; ++i) {
+		float offset = ((MULTIVIEW_VIEWS - 1) * 0.5f - i) * MULTIVIEW_EYE_SEPARATION;// the world moves right as the eye moves left
+		views[i] = glm::translate(glm::mat4(1), glm::vec3(offset, 0, 0)) * view;
+	}
+}
+
+bool Multiview::setEnabled(bool enable, bool noRecompile) {
+
+	// Read the current mode from __.defines (the source of truth for the shaders)
+	std::string definesContents = U::readFileStr("__.defines");
+	std::vector<std::string> splitDefinesContents = U::splitStr("MULTIVIEW_", definesContents);
+	if (splitDefinesContents.size() != 2 || splitDefinesContents[1].length() < 1) throw std::runtime_error("Could not modify __.defines to recompile shaders for multiview.");
+	bool compiled = splitDefinesContents[1][0] == '1';
+
+	if (enable == active && enable == compiled) return false;// nothing to change!
+	active = enable;
+	if (enable == compiled) return true;// the shaders already match: only the scene is rebuilt
+
+	// Change __.defines to mirror the new mode
+	std::string multiviewDef = (enable ? "1" : "0");
+	std::string newDefinesContents = splitDefinesContents[0] + "MULTIVIEW_" + multiviewDef + splitDefinesContents[1].substr(1);
+	U::writeFile("__.defines", newDefinesContents);
+	printf(("Wrote to __.defines: #define MULTIVIEW_" + multiviewDef + ".\n").c_str());
+
+	// Recompile the vertex stages projecting with the matrix of the view rendered (meshes, and particle generation stages of all modes), and the V-Buffer
+	// lighting pass, which shades each view with its own triangle setup
+	if (!noRecompile) {
+		CompileShader("Shaders/default.vert");
+		CompileShader("Shaders/default_v.vert");
+		CompileShader("Shaders/vert_particles_fwd.vert");
+		CompileShader("Shaders/particles_fwd.vert");
+		CompileShader("Shaders/vertgeom_particles_fwd.vert");
+		CompileShader("Shaders/particles.geom");
+		VBufferScene::compileLightingShaders();
+	}
+
+	// Force rebuilding pipelines & swapchain (using newly compiled shaders)
+	return true;
+}
+
+bool Multiview::enabled() {
+	return active && !ParticleUpsampler::enabled() && !ParticleOIT::enabled();
+}
+
+bool Multiview::stereo() {
+	return enabled() && (geometrySupported || !ParticleSystem::usesGeometryShader());
+}
+
+void Multiview::checkSupport(DevicesPtr devices) {
+
+	supported = devices->supportsMultiview();
+	geometrySupported = devices->supportsMultiviewGeometry();
+
+	/// Shaders reading the view index need the multiview feature, even outside of multiview render passes
+	if (!supported && setEnabled(false))
+		printf("Warning: the device does not support multiview; disabling stereo rendering.\n");
+
+}
+
+bool Multiview::UI() {
+
+	if (!supported) return false;
+
+	bool enable = active;
+	bool rebuild = false;
+	if (ImGui::Checkbox("Stereo (Multiview)", &enable))
+		rebuild = setEnabled(enable);
+
+	if (active && !enabled())
+		ImGui::Text("(off with reduced resolution or transparent particles)");
+	else if (active && !stereo())
+		ImGui::Text("(mono: no multiview with geometry shaders)");
+
+	return rebuild;
+}
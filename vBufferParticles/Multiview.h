@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include "VulkanAppBase.h"
+#include "Descriptor.h"
+#include "Particles.h"
+#include "ParticleUpsampler.h"
+#include "ParticleOIT.h"
+#include "Utils.h"
+#include <imgui.h>
+
+
+#define MULTIVIEW_EYE_SEPARATION 0.064f // distance between the eyes, in world units (metres)
+
+
+/// Renders a scene in stereo in a single pass with VK_KHR_multiview: every draw of the scene's render pass is broadcast to the MULTIVIEW_VIEWS layers of an
+/// off-screen target, one per eye, each vertex being projected with the view matrix of the layer it is drawn to (views[VIEW_INDEX] in the UBOs, see
+/// Shaders/multiview.glsl). Commands are recorded once for both eyes, and the particles are generated, LOD-selected and culled once from the camera: only
+/// their projection differs between views. The eyes are then presented side by side in the scene's swapchain render pass.
+/// The owning scene creates its pipelines and particle system in getRenderPass() (at getEyeExtent()), records its draws between begin() and end(), and
+/// cmdBindComposite() in the subpass given at creation. The shaders read the view index under MULTIVIEW_1 (see setEnabled()).
+/// Deferred scenes also get layered buffers in the stereo pass: its first subpass writes them, and its second reads them as input attachments, each view
+/// from its own layer, to shade the eyes (the V-Buffer's lighting pass, with the triangles set up once per view).
+/// The forward (ForwardRendererScene) and V-Buffer (VBufferScene) renderers render in stereo, and show the setting; the other scenes ignore it and render
+/// in mono (their UBOs then hold the camera's view for every view).
+class Multiview {
+
+	VulkanAppBase* vulkanApp;
+	DevicesPtr devices;
+
+	/// Stereo target: colour, buffers of deferred scenes, and depth of each eye in the layers of 2D array images, at half the swapchain width
+	VkExtent2D eyeExtent;
+	Texture* colour;
+	std::vector<Texture*> buffers;// written by the first subpass, read by the second as input attachments; empty for forward scenes (single subpass)
+	Texture* depth;
+	RenderPass* renderPass;// broadcast to all layers (view mask covering every view)
+	RenderPass* continuationRenderPass = NULL;// chained continuation of the render pass, only created when streaming particles in chunks
+	VkFramebuffer framebuffer;
+
+	/// Composite of the eyes side by side
+	Descriptor* compositeDescriptor;
+	GraphicsPipeline* compositePipeline;
+
+	/// Whether scenes supporting it render in stereo (mirrors MULTIVIEW_ in __.defines, unless the scene was rebuilt since)
+	static bool active;
+	/// Whether the device supports multiview, and multiview with geometry shaders (see checkSupport())
+	static bool supported;
+	static bool geometrySupported;
+
+public:
+
+	/// Creates the stereo target and the composite pipeline, for use in the subpass given of compositeRenderPass. Deferred scenes pass the formats of
+	/// their buffers, which makes the stereo pass a two-subpass pass reading them in its second subpass.
+	Multiview(VulkanAppBase* vulkanApp, const RenderPass* compositeRenderPass, uint32_t compositeSubpass, const std::vector<VkFormat>& bufferFormats = {});
+	~Multiview();
+
+	/// Getters of the stereo pass, in which the scene creates its pipelines and particle system
+	inline RenderPass* getRenderPass() const { return renderPass; }
+	inline RenderPass* getContinuationRenderPass() const { return continuationRenderPass; }
+	inline const VkFramebuffer& getFramebuffer() const { return framebuffer; }
+	inline VkExtent2D getEyeExtent() const { return eyeExtent; }
+	/// Layered buffer i of a deferred scene, to bind as an input attachment of the second subpass
+	inline Texture* getBuffer(int i) const { return buffers[i]; }
+
+	/// Begins the stereo pass; the scene's draws recorded until end() are rendered to every eye.
+	void begin(const VkCommandBuffer& cmdBuffer);
+	/// Ends the stereo pass (or the last continuation instance when streaming), and makes the eyes readable by the composite.
+	void end(const VkCommandBuffer& cmdBuffer);
+
+	/// Records the composite of the eyes side by side, in the subpass given at creation.
+	void cmdBindComposite(const VkCommandBuffer& cmdBuffer, int index);
+
+	/// Writes the view matrices of the eyes, offset from the camera's view along its x axis (first eye on the left).
+	static void eyeViews(const glm::mat4& view, glm::mat4 views[MULTIVIEW_VIEWS]);
+
+	/// Toggles stereo rendering (forward and V-Buffer renderers); will re-compile the stages reading the view index. Returns true if scenes must be rebuilt.
+	static bool setEnabled(bool enable, bool noRecompile = false);
+	/// Whether stereo rendering is on (the particle upsampler and transparency composite a single view, and take precedence)
+	static bool enabled();
+	/// Whether scenes render in stereo with the current settings: geometry shaders (geom/geom and vert/geom generation) may not be supported in multiview,
+	/// in which case scenes render in mono.
+	static bool stereo();
+	/// Records the multiview support of the device, and turns stereo rendering off if it is not supported; must be called before creating any scene.
+	static void checkSupport(DevicesPtr devices);
+
+	/// Stereo checkbox; returns true if the scene must be rebuilt.
+	static bool UI();
+
+};// class Multiview
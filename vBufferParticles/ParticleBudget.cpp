@@ -0,0 +1,95 @@
+#include "ParticleBudget.h"
+
+
+float ParticleBudget::targetTime = 0.f;
+float ParticleBudget::fraction = 1.f;
+
+
+ParticleBudget::ParticleBudget(VulkanAppBase* vulkanApp) : devices(vulkanApp->devices) {
+
+	int swapchainSize = vulkanApp->getSwapchain()->getSize();
+
+	/// Timestamp queries, 2 per image
+	VkQueryPoolCreateInfo queryInfo = {};
+	queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryInfo.queryCount = 2 * swapchainSize;
+	if (vkCreateQueryPool(*devices(), &queryInfo, NULL, &queryPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create timestamp query pool");
+	}
+	timed.assign(swapchainSize, false);
+
+	/// Timestamp resolution, and valid bits on the graphics queue (none: the count is left as is)
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(devices->getPhysicalDevice(), &properties);
+	timestampPeriod = properties.limits.timestampPeriod;
+	uint32_t familyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(devices->getPhysicalDevice(), &familyCount, NULL);
+	std::vector<VkQueueFamilyProperties> families(familyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(devices->getPhysicalDevice(), &familyCount, families.data());
+	uint32_t validBits = families[devices->getGraphicsQueueFamily()].timestampValidBits;
+	timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+	if (validBits == 0)
+		printf("Particle budget: the graphics queue has no timestamps, the particle count will not change.\n");
+
+}
+
+ParticleBudget::~ParticleBudget() {
+	vkDestroyQueryPool(*devices(), queryPool, NULL);
+}
+
+void ParticleBudget::Update(uint32_t imageIndex) {
+
+	/// GPU time of the last frame of this image (complete: its fence was waited upon)
+	if (timed[imageIndex] && timestampMask != 0) {
+		uint64_t timestamps[2];
+		if (vkGetQueryPoolResults(*devices(), queryPool, 2 * imageIndex, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+			gpuTime = (float)((timestamps[1] - timestamps[0]) & timestampMask) * timestampPeriod * 1e-6f;
+
+			/// PI in velocity form on log(fraction): holds once the target is met, and saturates at its bounds without windup
+			float error = glm::clamp((targetTime - gpuTime) / targetTime, -1.f, 1.f);// > 0: time to spare
+			fraction *= exp(PARTICLE_BUDGET_KP * (error - previousError) + PARTICLE_BUDGET_KI * error);
+			fraction = glm::clamp(fraction, PARTICLE_BUDGET_MIN_FRACTION, 1.f);
+			previousError = error;
+		}
+	}
+	timed[imageIndex] = true;// written by this frame
+
+}
+
+void ParticleBudget::cmdBeginFrame(const VkCommandBuffer& cmdBuffer, int index) {
+	vkCmdResetQueryPool(cmdBuffer, queryPool, 2 * index, 2);
+	vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 2 * index);
+}
+
+void ParticleBudget::cmdEndFrame(const VkCommandBuffer& cmdBuffer, int index) {
+	vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 2 * index + 1);
+}
+
+uint32_t ParticleBudget::drawnCount(uint32_t capacity) {
+	if (!enabled() || fraction >= 1.f) return capacity;
+	uint32_t count = (uint32_t)(fraction * capacity);
+	count -= count % PARTICLE_BUDGET_GRANULE;
+	return glm::clamp(count, glm::min((uint32_t)PARTICLE_BUDGET_GRANULE, capacity), capacity);
+}
+
+bool ParticleBudget::UI(ParticleBudget* particleBudget) {
+
+	/// Target kept while disabled
+	static float target = PARTICLE_BUDGET_DEFAULT_TARGET;
+	if (enabled()) target = targetTime;
+
+	bool rebuild = false;
+	bool budget = enabled();
+	if (ImGui::Checkbox("Particle Budget", &budget)) {
+		setTarget(budget ? target : 0.f);
+		rebuild = true;// particle systems draw through indirect commands (or no longer do)
+	}
+
+	if (particleBudget) {
+		ImGui::SliderFloat("Particle GPU Time (ms)", &targetTime, 2.f, 33.f, "%.1f");
+		ImGui::Text("Particles Drawn: %.1f%%, GPU %.2f ms", fraction * 100.f, particleBudget->gpuTime);
+	}
+
+	return rebuild;
+}
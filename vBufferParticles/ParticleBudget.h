@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include "VulkanAppBase.h"
+#include "Utils.h"
+#include <imgui.h>
+
+
+// lower bound of the fraction of the particles drawn (their size is compensated by up to 1 / sqrt of it)
+#define PARTICLE_BUDGET_MIN_FRACTION (1.f / 16.f)
+// drawn particle counts are multiples of this (whole compute workgroups of 256, and whole geometry shader batches of 28)
+#define PARTICLE_BUDGET_GRANULE 1792
+// gains of the controller, applied each frame to the relative error of the GPU frame time ((target - time) / target, clamped to -1..1), in velocity
+// form on the logarithm of the fraction drawn (the count follows the frame time multiplicatively, over orders of magnitude)
+#define PARTICLE_BUDGET_KP 0.3f
+#define PARTICLE_BUDGET_KI 0.1f
+// GPU frame time targeted by default, in milliseconds
+#define PARTICLE_BUDGET_DEFAULT_TARGET 16.0f
+
+
+/// Holds a target GPU frame time by adapting the amount of particles drawn, without rebuilding the particle system.
+/// The particle system is created for its full count (its capacity); while the budget is enabled, it draws (and generates) the particles through
+/// indirect draws & dispatches whose counts are written along with its UBO each frame, so that changing the count re-records nothing.
+/// Particles are drawn by index from the first one: as all their attributes are hashed from their index, any prefix is a uniform random subset.
+/// Their half size is scaled by sqrt(capacity / drawn), so that the area covered (and the density perceived) holds as particles are dropped.
+/// Timestamps around the scene commands give the GPU time of each image's last frame, turned into the fraction drawn by a PI controller.
+/// Compute work submitted to the compute queue (comp/comp generation) is not timed, and streamed particles are always drawn in full.
+class ParticleBudget {
+
+	DevicesPtr devices;
+
+	/// Timestamps before and after the scene commands of each image
+	VkQueryPool queryPool;
+	float timestampPeriod;// nanoseconds per timestamp tick
+	uint64_t timestampMask;// valid bits of the timestamps
+	std::vector<bool> timed;// whether the timestamps of each image were written by a previous frame
+
+	/// Controller state: error of the previous frame, and the last GPU time measured (in ms)
+	float previousError = 0.f;
+	float gpuTime = 0.f;
+
+	/// GPU frame time targeted, in milliseconds (0 -> all particles are drawn), and fraction of the particles drawn (shared by all scenes)
+	static float targetTime;
+	static float fraction;
+
+public:
+
+	/// Creates the timestamp queries
+	ParticleBudget(VulkanAppBase* vulkanApp);
+	/// Cleanup
+	~ParticleBudget();
+
+	/// Reads the GPU time of the last frame of this image, and updates the fraction of the particles drawn. Call from frame(), once the previous frame
+	/// of the image has completed, and before the scene's particles are updated.
+	void Update(uint32_t imageIndex);
+
+	/// Records the timestamps around the scene commands
+	void cmdBeginFrame(const VkCommandBuffer& cmdBuffer, int index);
+	void cmdEndFrame(const VkCommandBuffer& cmdBuffer, int index);
+
+	/// Change the GPU frame time targeted, in milliseconds (0 disables the budget); particle systems must be rebuilt to apply enabling/disabling it.
+	static inline void setTarget(float ms) { targetTime = ms > 0.f ? ms : 0.f; fraction = 1.f; }
+	/// Whether particle systems draw a budgeted amount of particles
+	static inline bool enabled() { return targetTime > 0.f; }
+
+	/// Amount of particles drawn out of a particle system's capacity
+	static uint32_t drawnCount(uint32_t capacity);
+
+	/// Particle budget checkbox, target and current state (particleBudget may be NULL); returns true if the scene must be rebuilt.
+	static bool UI(ParticleBudget* particleBudget);
+
+};// class ParticleBudget
@@ -0,0 +1,149 @@
+#include "ParticleOIT.h"
+
+
+bool ParticleOIT::active = false;
+
+
+ParticleOIT::ParticleOIT(VulkanAppBase* vulkanApp, const RenderPass* compositeRenderPass, uint32_t compositeSubpass) : vulkanApp(vulkanApp), devices(vulkanApp->devices) {
+
+	int swapchainSize = vulkanApp->getSwapchain()->getSize();
+	VkExtent2D extent = vulkanApp->getSwapchain()->getExtent();
+
+	/// Attachments, sampled by the composite once the render pass is over (accumulation: RGBA16F, as weights scale it well above 1)
+	accumulation = new Texture(VK_FORMAT_R16G16B16A16_SFLOAT, extent, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT,
+		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, devices(), devices->getPhysicalDevice(), *vulkanApp->getCommandPool(), devices->getGraphicsQueue());
+	coverage = new Texture(VK_FORMAT_R16_SFLOAT, extent, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT,
+		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, devices(), devices->getPhysicalDevice(), *vulkanApp->getCommandPool(), devices->getGraphicsQueue());
+	depth = new Texture(VK_FORMAT_D32_SFLOAT, extent, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT,
+		VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, devices(), devices->getPhysicalDevice(), *vulkanApp->getCommandPool(), devices->getGraphicsQueue());
+
+	/// Render passes: a single subpass writing to both colour attachments, in which the scene depth is copied then the particles drawn
+	std::vector<RenderPass::RenderPassAttachmentDesc> attachments = {
+		RenderPass::RenderPassAttachmentDesc(VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ATTACHMENT_STORE_OP_STORE),
+		RenderPass::RenderPassAttachmentDesc(VK_FORMAT_R16_SFLOAT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ATTACHMENT_STORE_OP_STORE),
+		RENDERPASS_ATTACHMENT_DESC_DEPTH };
+	renderPass = new RenderPass(devices(), attachments, 1, extent, ParticleSystem::isStreaming() ? RenderPass::Chaining::First : RenderPass::Chaining::None);
+	renderPass->setScaled(true);// composited texel for texel in the scene's render area
+	if (ParticleSystem::isStreaming()) {// particles will be drawn in further render pass instances, in between their compute dispatches
+		continuationRenderPass = new RenderPass(devices(), attachments, 1, extent, RenderPass::Chaining::Continuation);
+		continuationRenderPass->setScaled(true);
+	}
+
+	/// Framebuffer
+	std::vector<VkImageView> views = { accumulation->getImageView(), coverage->getImageView(), depth->getImageView() };
+	VkFramebufferCreateInfo framebufferInfo = {};
+	framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	framebufferInfo.renderPass = renderPass->getRenderPass();
+	framebufferInfo.attachmentCount = (uint32_t)views.size();
+	framebufferInfo.pAttachments = views.data();
+	framebufferInfo.width = extent.width;
+	framebufferInfo.height = extent.height;
+	framebufferInfo.layers = 1;
+	if (vkCreateFramebuffer(*devices(), &framebufferInfo, NULL, &framebuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create particle transparency framebuffer");
+	}
+
+	/// Scene depth copy (same bindings as Shaders/particles_lowres_depth.frag): always written, colour untouched (cleared by the render pass)
+	DESCRIPTOR_BINDING_ARRAY depthBindings = { DESCRIPTOR_BINDING_SAMPLER_FRAGMENT };
+	depthDescriptor = new Descriptor(depthBindings, devices());
+	depthDescriptor->createPipelineLayout(sizeof(UpsampleConstants), VK_SHADER_STAGE_FRAGMENT_BIT);
+	depthDescriptor->createDescriptorSets(swapchainSize, *vulkanApp->getDescriptorPool(), {/* no buffers */ },
+		{ Descriptor::ImageInfoDescriptor(vulkanApp->getDepthBuffer(), vulkanApp->getSampler(), VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL) });
+	depthPipeline = new GraphicsPipeline("pp", "particles_lowres_depth", NULL, extent, depthDescriptor->getPipelineLayout(), renderPass, 0, true, 2, devices(), VK_COMPARE_OP_ALWAYS, false);
+
+	/// Composite (same bindings as Shaders/particles_oit_composite.frag): accumulation, coverage; blended over the scene as premultiplied alpha
+	DESCRIPTOR_BINDING_ARRAY compositeBindings = { DESCRIPTOR_BINDING_SAMPLER_FRAGMENT, DESCRIPTOR_BINDING_SAMPLER_FRAGMENT };
+	compositeDescriptor = new Descriptor(compositeBindings, devices());
+	compositeDescriptor->createPipelineLayout();
+	compositeDescriptor->createDescriptorSets(swapchainSize, *vulkanApp->getDescriptorPool(), {/* no buffers */ }, {
+		Descriptor::ImageInfoDescriptor(accumulation, vulkanApp->getSampler()),
+		Descriptor::ImageInfoDescriptor(coverage, vulkanApp->getSampler()) });
+	compositePipeline = new GraphicsPipeline("pp", "particles_oit_composite", NULL, extent, compositeDescriptor->getPipelineLayout(),
+		compositeRenderPass, compositeSubpass, false, 1, devices(), VK_COMPARE_OP_LESS, true, BlendMode::Premultiplied);
+
+}
+
+ParticleOIT::~ParticleOIT() {
+	DELETE(compositePipeline);
+	DELETE(compositeDescriptor);
+	DELETE(depthPipeline);
+	DELETE(depthDescriptor);
+	vkDestroyFramebuffer(*devices(), framebuffer, NULL);
+	DELETE(renderPass);
+	DELETE(continuationRenderPass);
+	DELETE(accumulation);
+	DELETE(coverage);
+	DELETE(depth);
+}
+
+ParticleSystem::ParticlesConstructorParams ParticleOIT::getParticlesParams() {
+	return ParticleSystem::ParticlesConstructorParams(ParticleRenderingMode::ForwardOITRen, devices, vulkanApp->getDescriptorPool(), vulkanApp->getSwapchain()->getSize(),
+		vulkanApp->getSwapchain()->getExtent(), renderPass, *vulkanApp->getCommandPool(), vulkanApp->getSampler(), continuationRenderPass);
+}
+
+void ParticleOIT::cmdBindParticles(const VkCommandBuffer& cmdBuffer, int index, ParticleSystem* particles) {
+
+	/// Scene depth: from attachment to read-only, as it is copied by the layer and attached to the composite; scene colour: loaded by the composite.
+	/// The layer itself may still be read by the composite of the previous frame.
+	VkImageMemoryBarrier depthBarrier = {};
+	depthBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	depthBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	depthBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+	depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	depthBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	depthBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	depthBarrier.image = vulkanApp->getDepthBuffer()->getImage();
+	depthBarrier.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+	VkMemoryBarrier colourBarrier = {};
+	colourBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	colourBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	colourBarrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	VkPipelineStageFlags stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	vkCmdPipelineBarrier(cmdBuffer, stages, stages, 0, 1, &colourBarrier, 0, NULL, 1, &depthBarrier);
+
+	UpsampleConstants constants = { glm::vec2(0), 1 };// depth copied texel for texel
+
+	renderPass->begin(cmdBuffer, framebuffer); {
+
+		/// Scene depth, against which the particles are tested
+		depthDescriptor->cmdBind(cmdBuffer, index);
+		depthDescriptor->cmdPushConstants(cmdBuffer, &constants);
+		depthPipeline->cmdBind(cmdBuffer, index);
+		vkCmdDraw(cmdBuffer, 3, 1, 0, 0);// full-screen quad
+
+		/// Particles, blended in any order
+		particles->cmdBind(cmdBuffer, index, framebuffer);
+
+	} renderPass->end(cmdBuffer);// also ends the last continuation instance when streaming
+
+	/// Make the layer readable by the composite (bottom of pipe chains with the layout transitions at the end of the render pass)
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		0, 1, &barrier, 0, NULL, 0, NULL);
+
+}
+
+void ParticleOIT::cmdBindComposite(const VkCommandBuffer& cmdBuffer, int index) {
+
+	compositeDescriptor->cmdBind(cmdBuffer, index);
+	compositePipeline->cmdBind(cmdBuffer, index);
+	vkCmdDraw(cmdBuffer, 3, 1, 0, 0);// full-screen quad
+
+}
+
+bool ParticleOIT::UI() {
+
+	/// Disabled while the upsampler draws the particles at reduced resolution
+	if (ParticleUpsampler::enabled()) return false;
+
+	bool enable = active;
+	if (ImGui::Checkbox("Transparent Particles (OIT)", &enable)) {
+		setEnabled(enable);
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include "VulkanAppBase.h"
+#include "Descriptor.h"
+#include "Particles.h"
+#include "ParticleUpsampler.h"
+#include "Utils.h"
+#include <imgui.h>
+
+
+/// Draws the particles of a scene as translucent surfaces with weighted blended order-independent transparency (McGuire & Bavoil, JCGT 2013), then
+/// composites them over the finished scene. The particles are shaded forward in an off-screen layer at full resolution, depth tested (not written) against
+/// a copy of the scene depth: each fragment adds its weighted premultiplied colour to an accumulation attachment (RGBA16F, summed) and its opacity to a
+/// coverage attachment (R16F, composited as 1 - product of transparencies); neither depends on the order the particles are drawn in, so that no sorting is needed.
+/// The owning scene creates its particle system with getParticlesParams(), records cmdBindParticles() once its own render pass has ended (outside of
+/// any render pass), and cmdBindComposite() in a continuation of its render pass whose depth attachment is read-only (RENDERPASS_ATTACHMENT_DESC_DEPTH_READ_ONLY).
+/// The scene depth buffer is left in DEPTH_STENCIL_READ_ONLY_OPTIMAL layout from cmdBindParticles() on.
+class ParticleOIT {
+
+	VulkanAppBase* vulkanApp;
+	DevicesPtr devices;
+
+	/// Off-screen target of the particles: accumulation, coverage and depth, with their own render passes and framebuffer
+	Texture* accumulation;
+	Texture* coverage;
+	Texture* depth;
+	RenderPass* renderPass;// clears the layer, then the scene depth is copied before the particles are drawn
+	RenderPass* continuationRenderPass = NULL;// chained continuation of the render pass, only created when streaming particles in chunks
+	VkFramebuffer framebuffer;
+
+	/// Scene depth copy (same shader as the upsampler's layers, at full resolution; colour writes are masked)
+	Descriptor* depthDescriptor;
+	GraphicsPipeline* depthPipeline;
+
+	/// Composite of the layer over the scene: accumulation, coverage
+	Descriptor* compositeDescriptor;
+	GraphicsPipeline* compositePipeline;
+
+	/// Whether particles are drawn with weighted blended transparency (shared by all scenes)
+	static bool active;
+
+public:
+
+	/// Creates the layer and the composite pipeline, for use in the subpass given of compositeRenderPass.
+	ParticleOIT(VulkanAppBase* vulkanApp, const RenderPass* compositeRenderPass, uint32_t compositeSubpass);
+	~ParticleOIT();
+
+	/// Params for the particle system drawn in the layer (forward shaded with weighted blending, in the layer's render passes)
+	ParticleSystem::ParticlesConstructorParams getParticlesParams();
+
+	/// Records the particle layer; must be recorded outside of any render pass, once the scene depth is complete.
+	void cmdBindParticles(const VkCommandBuffer& cmdBuffer, int index, ParticleSystem* particles);
+
+	/// Records the composite of the layer over the scene, in the subpass given at creation.
+	void cmdBindComposite(const VkCommandBuffer& cmdBuffer, int index);
+
+	/// Toggle weighted blended transparency; scenes must be rebuilt to apply it.
+	static inline void setEnabled(bool enable) { active = enable; }
+	/// Whether particles are drawn with weighted blended transparency (particles drawn at reduced resolution by the upsampler stay opaque)
+	static inline bool enabled() { return active && !ParticleUpsampler::enabled(); }
+
+	/// Transparency checkbox; returns true if the scene must be rebuilt.
+	static bool UI();
+
+};// class ParticleOIT
@@ -0,0 +1,292 @@
+#include "ParticleUpsampler.h"
+
+
+int ParticleUpsampler::factor = 1;
+
+
+ParticleUpsampler::ParticleUpsampler(VulkanAppBase* vulkanApp, const RenderPass* compositeRenderPass, uint32_t compositeSubpass) : vulkanApp(vulkanApp), devices(vulkanApp->devices) {
+
+	/// Depth terms do not depend on the aspect ratio
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1.0f, NEAR, FAR);
+	depthTerms = glm::vec2(projection[2][2], projection[3][2]);
+
+	int swapchainSize = vulkanApp->getSwapchain()->getSize();
+
+	/// Scene depth, copied into the layers (read-only from cmdBindParticles() on)
+	DESCRIPTOR_BINDING_ARRAY depthBindings = { DESCRIPTOR_BINDING_SAMPLER_FRAGMENT };
+	depthDescriptor = new Descriptor(depthBindings, devices());
+	depthDescriptor->createPipelineLayout(sizeof(UpsampleConstants), VK_SHADER_STAGE_FRAGMENT_BIT);
+	depthDescriptor->createDescriptorSets(swapchainSize, *vulkanApp->getDescriptorPool(), {/* no buffers */ },
+		{ Descriptor::ImageInfoDescriptor(vulkanApp->getDepthBuffer(), vulkanApp->getSampler(), VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL) });
+
+	layer = createLayer(factor);
+
+	/// Composite (same bindings as Shaders/particles_upsample.glsl): scene depth, layer colour and depth; blended over the scene as premultiplied alpha
+	DESCRIPTOR_BINDING_ARRAY compositeBindings = { DESCRIPTOR_BINDING_SAMPLER_FRAGMENT, DESCRIPTOR_BINDING_SAMPLER_FRAGMENT, DESCRIPTOR_BINDING_SAMPLER_FRAGMENT };
+	compositeDescriptor = new Descriptor(compositeBindings, devices());
+	compositeDescriptor->createPipelineLayout(sizeof(UpsampleConstants), VK_SHADER_STAGE_FRAGMENT_BIT);
+	compositeDescriptor->createDescriptorSets(swapchainSize, *vulkanApp->getDescriptorPool(), {/* no buffers */ }, {
+		Descriptor::ImageInfoDescriptor(vulkanApp->getDepthBuffer(), vulkanApp->getSampler(), VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL),
+		Descriptor::ImageInfoDescriptor(layer->colour, vulkanApp->getSampler()),
+		Descriptor::ImageInfoDescriptor(layer->depth, vulkanApp->getSampler(), VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL) });
+	compositePipeline = new GraphicsPipeline("pp", "particles_upsample", NULL, vulkanApp->getSwapchain()->getExtent(), compositeDescriptor->getPipelineLayout(),
+		compositeRenderPass, compositeSubpass, false, 1, devices(), VK_COMPARE_OP_LESS, true, BlendMode::Premultiplied);
+
+}
+
+ParticleUpsampler::~ParticleUpsampler() {
+	DELETE(compositePipeline);
+	DELETE(compositeDescriptor);
+	destroyLayer(layer);
+	DELETE(depthDescriptor);
+}
+
+ParticleUpsampler::Layer* ParticleUpsampler::createLayer(int32_t factor) {
+
+	Layer* l = new Layer;
+	l->factor = factor;
+	VkExtent2D extent = vulkanApp->getSwapchain()->getExtent();
+	l->extent = { (extent.width + factor - 1) / factor, (extent.height + factor - 1) / factor };
+
+	/// Attachments, sampled by the upsample once the render pass is over (colour: RGBA16F, as empty texels are marked with a negative alpha)
+	l->colour = new Texture(VK_FORMAT_R16G16B16A16_SFLOAT, l->extent, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT,
+		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, devices(), devices->getPhysicalDevice(), *vulkanApp->getCommandPool(), devices->getGraphicsQueue());
+	l->depth = new Texture(VK_FORMAT_D32_SFLOAT, l->extent, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_DEPTH_BIT,
+		VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, devices(), devices->getPhysicalDevice(), *vulkanApp->getCommandPool(), devices->getGraphicsQueue());
+
+	/// Render passes: a single subpass, in which the scene depth is copied then the particles drawn
+	std::vector<RenderPass::RenderPassAttachmentDesc> attachments = {
+		RenderPass::RenderPassAttachmentDesc(VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ATTACHMENT_STORE_OP_STORE),
+		RenderPass::RenderPassAttachmentDesc(VK_FORMAT_D32_SFLOAT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_ATTACHMENT_STORE_OP_STORE) };
+	l->renderPass = new RenderPass(devices(), attachments, 1, l->extent, ParticleSystem::isStreaming() ? RenderPass::Chaining::First : RenderPass::Chaining::None);
+	l->renderPass->setScaled(true);// composited texel for texel in the scene's render area
+	if (ParticleSystem::isStreaming()) {// particles will be drawn in further render pass instances, in between their compute dispatches
+		l->continuationRenderPass = new RenderPass(devices(), attachments, 1, l->extent, RenderPass::Chaining::Continuation);
+		l->continuationRenderPass->setScaled(true);
+	}
+
+	/// Framebuffer
+	std::vector<VkImageView> views = { l->colour->getImageView(), l->depth->getImageView() };
+	VkFramebufferCreateInfo framebufferInfo = {};
+	framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	framebufferInfo.renderPass = l->renderPass->getRenderPass();
+	framebufferInfo.attachmentCount = (uint32_t)views.size();
+	framebufferInfo.pAttachments = views.data();
+	framebufferInfo.width = l->extent.width;
+	framebufferInfo.height = l->extent.height;
+	framebufferInfo.layers = 1;
+	if (vkCreateFramebuffer(*devices(), &framebufferInfo, NULL, &l->framebuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create particle layer framebuffer");
+	}
+
+	/// Scene depth copy: always written, colour marked as empty
+	l->depthPipeline = new GraphicsPipeline("pp", "particles_lowres_depth", NULL, l->extent, depthDescriptor->getPipelineLayout(), l->renderPass, 0, true, 1, devices(), VK_COMPARE_OP_ALWAYS);
+
+	return l;
+}
+
+void ParticleUpsampler::destroyLayer(Layer* l) {
+	DELETE(l->depthPipeline);
+	vkDestroyFramebuffer(*devices(), l->framebuffer, NULL);
+	DELETE(l->renderPass);
+	DELETE(l->continuationRenderPass);
+	DELETE(l->colour);
+	DELETE(l->depth);
+	delete l;
+}
+
+ParticleSystem::ParticlesConstructorParams ParticleUpsampler::getParticlesParams() {
+	return getParticlesParams(layer);
+}
+
+ParticleSystem::ParticlesConstructorParams ParticleUpsampler::getParticlesParams(Layer* l) {
+	return ParticleSystem::ParticlesConstructorParams(ParticleRenderingMode::ForwardRen, devices, vulkanApp->getDescriptorPool(), vulkanApp->getSwapchain()->getSize(),
+		l->extent, l->renderPass, *vulkanApp->getCommandPool(), vulkanApp->getSampler(), l->continuationRenderPass);
+}
+
+void ParticleUpsampler::Update(uint32_t imageIndex, float time, const glm::mat4& view, const glm::mat4& proj, ParticleSystem* particles) {
+
+	/// Measure once the first frames have left a scene depth to compare against, then whenever requested
+	if (frames < PARTICLE_DIFFERENCE_FRAME && ++frames == PARTICLE_DIFFERENCE_FRAME)
+		measureRequested = true;
+	if (measureRequested && frames == PARTICLE_DIFFERENCE_FRAME) {
+		measureRequested = false;
+		measureDifference(particles, imageIndex, time, view, proj);
+	}
+
+}
+
+void ParticleUpsampler::cmdBindParticles(const VkCommandBuffer& cmdBuffer, int index, ParticleSystem* particles) {
+
+	/// Scene depth: from attachment to read-only, as it is sampled by the layer and attached to the composite; scene colour: loaded by the composite.
+	/// The layer itself may still be read by the composite of the previous frame.
+	VkImageMemoryBarrier depthBarrier = {};
+	depthBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	depthBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	depthBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+	depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	depthBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	depthBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	depthBarrier.image = vulkanApp->getDepthBuffer()->getImage();
+	depthBarrier.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+	VkMemoryBarrier colourBarrier = {};
+	colourBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	colourBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	colourBarrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	VkPipelineStageFlags stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	vkCmdPipelineBarrier(cmdBuffer, stages, stages, 0, 1, &colourBarrier, 0, NULL, 1, &depthBarrier);
+
+	cmdBindLayer(cmdBuffer, index, layer, particles);
+
+}
+
+void ParticleUpsampler::cmdBindLayer(const VkCommandBuffer& cmdBuffer, int index, Layer* l, ParticleSystem* particles) {
+
+	UpsampleConstants constants = { depthTerms, l->factor };
+
+	l->renderPass->begin(cmdBuffer, l->framebuffer); {
+
+		/// Scene depth at the layer resolution (furthest of each footprint)
+		depthDescriptor->cmdBind(cmdBuffer, index);
+		depthDescriptor->cmdPushConstants(cmdBuffer, &constants);
+		l->depthPipeline->cmdBind(cmdBuffer, index);
+		vkCmdDraw(cmdBuffer, 3, 1, 0, 0);// full-screen quad
+
+		/// Particles, depth tested against it
+		particles->cmdBind(cmdBuffer, index, l->framebuffer);
+
+	} l->renderPass->end(cmdBuffer);// also ends the last continuation instance when streaming
+
+	/// Make the layer readable by the upsample (bottom of pipe chains with the layout transitions at the end of the render pass)
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, NULL, 0, NULL);
+
+}
+
+void ParticleUpsampler::cmdBindComposite(const VkCommandBuffer& cmdBuffer, int index) {
+
+	UpsampleConstants constants = { depthTerms, layer->factor };
+
+	compositeDescriptor->cmdBind(cmdBuffer, index);
+	compositeDescriptor->cmdPushConstants(cmdBuffer, &constants);
+	compositePipeline->cmdBind(cmdBuffer, index);
+	vkCmdDraw(cmdBuffer, 3, 1, 0, 0);// full-screen quad
+
+}
+
+void ParticleUpsampler::measureDifference(ParticleSystem* particles, uint32_t imageIndex, float time, const glm::mat4& view, const glm::mat4& proj) {
+
+	/// The scene depth left by the last frame is compared against, and the layer redrawn: wait for all frames in flight
+	vkDeviceWaitIdle(*devices());
+
+	/// Reference: the same particles drawn at full resolution, by a temporary particle system
+	Layer* reference = createLayer(1);
+	ParticleSystem::ParticlesConstructorParams args = getParticlesParams(reference);
+	ParticleSystem* referenceParticles = new ParticleSystem(args);
+	referenceParticles->Update(imageIndex, 0, time, view, proj);
+
+	/// Sums of each workgroup (squared error, covered pixels), read back by the host
+	VkExtent2D extent = vulkanApp->getSwapchain()->getExtent();
+	uint32_t groupsX = (extent.width + PARTICLE_DIFFERENCE_GROUP - 1) / PARTICLE_DIFFERENCE_GROUP;
+	uint32_t groupsY = (extent.height + PARTICLE_DIFFERENCE_GROUP - 1) / PARTICLE_DIFFERENCE_GROUP;
+	UniformBuffer<glm::vec2> sumsBuffer(1, devices(), devices->getPhysicalDevice(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, groupsX * groupsY);
+
+	/// Temporary difference pipeline (same bindings as Shaders/particles_upsample_diff.comp)
+	DESCRIPTOR_BINDING_ARRAY diffBindings = { DESCRIPTOR_BINDING_SAMPLER_COMPUTE, DESCRIPTOR_BINDING_SAMPLER_COMPUTE, DESCRIPTOR_BINDING_SAMPLER_COMPUTE, DESCRIPTOR_BINDING_SAMPLER_COMPUTE,
+		DESCRIPTOR_BINDING_STORAGE_BUFFER_COMPUTE };
+	Descriptor diffDescriptor(diffBindings, devices(), VK_PIPELINE_BIND_POINT_COMPUTE);
+	diffDescriptor.createPipelineLayout(sizeof(UpsampleConstants), VK_SHADER_STAGE_COMPUTE_BIT);
+	diffDescriptor.createDescriptorSets(1, *vulkanApp->getDescriptorPool(), { Descriptor::UBODescriptor(sumsBuffer.getBuffers(), (int)(sizeof(glm::vec2) * groupsX * groupsY)) }, {
+		Descriptor::ImageInfoDescriptor(vulkanApp->getDepthBuffer(), vulkanApp->getSampler(), VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL),
+		Descriptor::ImageInfoDescriptor(layer->colour, vulkanApp->getSampler()),
+		Descriptor::ImageInfoDescriptor(layer->depth, vulkanApp->getSampler(), VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL),
+		Descriptor::ImageInfoDescriptor(reference->colour, vulkanApp->getSampler()) });
+	ComputePipeline diffPipeline("particles_upsample_diff", diffDescriptor.getPipelineLayout(), devices());
+
+	/// Generate the particles of this frame (Compute mode), draw both layers over the scene depth (already read-only), then compare them (blocking)
+	VkCommandBuffer cmdBuffer = U::beginSingleTimeCommands(*vulkanApp->getCommandPool(), *devices(), devices->getGraphicsQueue()); {
+
+		particles->cmdBindCompute(cmdBuffer, imageIndex);
+		referenceParticles->cmdBindCompute(cmdBuffer, imageIndex);
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT, 0, 1, &barrier, 0, NULL, 0, NULL);
+
+		cmdBindLayer(cmdBuffer, imageIndex, layer, particles);
+		cmdBindLayer(cmdBuffer, imageIndex, reference, referenceParticles);
+
+		UpsampleConstants constants = { depthTerms, layer->factor };
+		diffDescriptor.cmdBind(cmdBuffer, 0);
+		diffDescriptor.cmdPushConstants(cmdBuffer, &constants);
+		diffPipeline.cmdBind(cmdBuffer, 0);
+		vkCmdDispatch(cmdBuffer, groupsX, groupsY, 1);
+
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, NULL, 0, NULL);
+
+	} U::endSingleTimeCommands(cmdBuffer, *vulkanApp->getCommandPool(), *devices(), devices->getGraphicsQueue());
+
+	/// Add the sums of all workgroups up (in double precision: millions of pixels)
+	std::vector<glm::vec2> sums(groupsX * groupsY);
+	sumsBuffer.readBuffer(0, sums.data(), sums.size());
+	double squaredError = 0, covered = 0;
+	for (const glm::vec2& sum : sums) {
+		squaredError += sum.x;
+		covered += sum.y;
+	}
+	double pixels = (double)extent.width * extent.height;
+	double mse = squaredError / pixels;
+	rmse = (float)sqrt(mse);
+	psnr = mse > 0 ? (float)(10.0 * log10(1.0 / mse)) : 100.f;// identical images: capped
+	coverage = (float)(covered / pixels);
+
+	printf("Particles at 1/%d resolution: RMSE %.5f, PSNR %.2f dB over full resolution (%.1f%% of the screen covered).\n", layer->factor, rmse, psnr, coverage * 100.f);
+	U::writeFile(PARTICLE_DIFFERENCE_FILE, "factor,rmse,psnr,coverage\n" + std::to_string(layer->factor) + "," + std::to_string(rmse) + "," + std::to_string(psnr) + "," + std::to_string(coverage) + "\n");
+
+	DELETE(referenceParticles);
+	destroyLayer(reference);
+
+}
+
+void ParticleUpsampler::setFactor(int f) {
+	factor = f >= PARTICLE_UPSAMPLE_MAX_FACTOR ? PARTICLE_UPSAMPLE_MAX_FACTOR : f >= 2 ? 2 : 1;
+}
+
+bool ParticleUpsampler::UI(ParticleUpsampler* upsampler) {
+
+	/// Drop-down list for the resolution particles are drawn at
+	static const char* resolutions[] = { "Full", "Half", "Quarter" };
+	int current = factor == 4 ? 2 : factor == 2 ? 1 : 0;
+	bool rebuild = false;
+	if (ImGui::BeginCombo("Particle Resolution", resolutions[current])) {
+		for (int i = 0; i < IM_ARRAYSIZE(resolutions); ++i) {
+			bool isSelected = current == i;
+			if (ImGui::Selectable(resolutions[i], isSelected) && !isSelected) {
+				/// Switch resolution (the scene must be rebuilt)
+				setFactor(1 << i);
+				rebuild = true;
+			}
+			if (isSelected) {
+				ImGui::SetItemDefaultFocus();
+			}
+		}
+		ImGui::EndCombo();
+	}// Particle resolutions drop down
+
+	/// Difference with full resolution particles
+	if (upsampler && upsampler->rmse >= 0) {
+		ImGui::Text("Difference: RMSE %.4f, PSNR %.1f dB", upsampler->rmse, upsampler->psnr);
+		if (ImGui::Button("Measure Difference")) upsampler->measureRequested = true;
+	}
+
+	return rebuild;
+}
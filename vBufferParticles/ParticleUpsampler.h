@@ -0,0 +1,116 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include "VulkanAppBase.h"
+#include "ComputePipeline.h"
+#include "UniformBuffer.h"
+#include "Descriptor.h"
+#include "Particles.h"
+#include "Utils.h"
+#include <imgui.h>
+
+
+// largest resolution divisor of the particle layer
+#define PARTICLE_UPSAMPLE_MAX_FACTOR 4
+// frame (since the upsampler was created) at which the difference with full resolution particles is measured; the scene depth must have been drawn by then
+#define PARTICLE_DIFFERENCE_FRAME 8
+// file the last difference measured is written to (read by the benchmarks)
+#define PARTICLE_DIFFERENCE_FILE "particle_difference.txt"
+// pixels per side of the workgroups of the difference measurement (must match Shaders/particles_upsample_diff.comp)
+#define PARTICLE_DIFFERENCE_GROUP 16
+
+
+/// Push constants of the layer depth copy, composite and difference passes (same layout as Shaders/particles_upsample.glsl)
+struct UpsampleConstants {
+	glm::vec2 depthTerms;// proj[2][2], proj[3][2] (view depth from depth buffer values)
+	int32_t factor;// full resolution pixels per layer texel, along x and y
+};// struct UpsampleConstants
+
+
+/// Draws the particles of a scene in a layer at half or quarter resolution, then composites them over the finished scene with a depth-aware upsample
+/// (see Shaders/particles_upsample.glsl). The particles are rasterized and shaded forward in the layer, against the furthest scene depth of each texel
+/// footprint; the upsample then drops the texels lying behind the full resolution depth of each pixel, so that particles keep the exact scene edges.
+/// The owning scene creates its particle system with getParticlesParams(), records cmdBindParticles() once its own render pass has ended (outside of
+/// any render pass), and cmdBindComposite() in a continuation of its render pass whose depth attachment is read-only (RENDERPASS_ATTACHMENT_DESC_DEPTH_READ_ONLY).
+/// The scene depth buffer is left in DEPTH_STENCIL_READ_ONLY_OPTIMAL layout from cmdBindParticles() on.
+/// Once after creation (and on request), the difference with particles drawn at full resolution is measured and reported (RMSE and PSNR).
+class ParticleUpsampler {
+
+	VulkanAppBase* vulkanApp;
+	DevicesPtr devices;
+
+	/// Off-screen target of the particles: colour (alpha -1 where no particle was drawn) and depth, with their own render passes and framebuffer
+	struct Layer {
+		int32_t factor;
+		VkExtent2D extent;
+		Texture* colour;
+		Texture* depth;
+		RenderPass* renderPass;// clears the layer, then the scene depth is copied before the particles are drawn
+		RenderPass* continuationRenderPass = NULL;// chained continuation of the render pass, only created when streaming particles in chunks
+		VkFramebuffer framebuffer;
+		GraphicsPipeline* depthPipeline;// scene depth copy, at the layer resolution
+	};// struct Layer
+	Layer* layer;
+
+	/// Creates (and destroys) a layer at a resolution divided by factor
+	Layer* createLayer(int32_t factor);
+	void destroyLayer(Layer* l);
+
+	/// Params for a particle system drawn in the layer given
+	ParticleSystem::ParticlesConstructorParams getParticlesParams(Layer* l);
+
+	/// Scene depth, read by the depth copy of any layer
+	Descriptor* depthDescriptor;
+
+	/// Composite of the layer over the scene: scene depth, layer colour and depth
+	Descriptor* compositeDescriptor;
+	GraphicsPipeline* compositePipeline;
+
+	/// Depth terms of the projection (same for all scenes, as NEAR and FAR)
+	glm::vec2 depthTerms;
+
+	/// Difference with full resolution particles, as last measured (rmse < 0 until measured)
+	uint32_t frames = 0;
+	bool measureRequested = false;
+	float rmse = -1.f;
+	float psnr = 0.f;
+	float coverage = 0.f;// fraction of the screen covered by particles in either image
+
+	/// Records the depth copy and the particles of a layer (outside of a render pass), and makes the layer readable by the upsample
+	void cmdBindLayer(const VkCommandBuffer& cmdBuffer, int index, Layer* l, ParticleSystem* particles);
+
+	/// Draws the particles at full resolution (with a temporary particle system) and in the layer, compares the upsampled layer with them, and reports
+	/// the difference; blocking, as it waits for all frames in flight (the scene depth of the last frame is reused)
+	void measureDifference(ParticleSystem* particles, uint32_t imageIndex, float time, const glm::mat4& view, const glm::mat4& proj);
+
+	/// Resolution divisor of the particle layer (shared by all scenes); 1 -> particles are drawn in the scene directly
+	static int factor;
+
+public:
+
+	/// Creates the layer and the composite pipeline, for use in the subpass given of compositeRenderPass.
+	ParticleUpsampler(VulkanAppBase* vulkanApp, const RenderPass* compositeRenderPass, uint32_t compositeSubpass);
+	~ParticleUpsampler();
+
+	/// Params for the particle system drawn in the layer (forward shaded, in the layer's render passes)
+	ParticleSystem::ParticlesConstructorParams getParticlesParams();
+
+	/// Counts frames, and measures the difference with full resolution particles when due; call after the particles were updated.
+	void Update(uint32_t imageIndex, float time, const glm::mat4& view, const glm::mat4& proj, ParticleSystem* particles);
+
+	/// Records the particle layer; must be recorded outside of any render pass, once the scene depth is complete.
+	void cmdBindParticles(const VkCommandBuffer& cmdBuffer, int index, ParticleSystem* particles);
+
+	/// Records the composite of the layer over the scene, in the subpass given at creation.
+	void cmdBindComposite(const VkCommandBuffer& cmdBuffer, int index);
+
+	/// Change the resolution divisor (1, 2 or 4); scenes must be rebuilt to apply it.
+	static void setFactor(int f);
+	static inline int getFactor() { return factor; }
+	/// Whether particles are drawn at reduced resolution
+	static inline bool enabled() { return factor > 1; }
+
+	/// Particle resolution drop-down, and the difference last measured by upsampler (may be NULL); returns true if the scene must be rebuilt.
+	static bool UI(ParticleUpsampler* upsampler);
+
+};// class ParticleUpsampler
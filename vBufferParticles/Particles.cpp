@@ -1,6 +1,10 @@
 #include "Particles.h"
 
 #include "StaticSettings.h"
+#include "VBufferScene.h"
+#include "ParticleBudget.h"
+#include "HiZPyramid.h"
+#include <stb_image.h>
 
 
 ParticleSystemSettings ParticleSystem::settings = ParticleSystemSettings();
@@ -31,14 +35,17 @@ bool ParticleSystem::setParticlesComplexity(int complexity, bool noRecompile) {
 	// Recompile shaders
 	if (!noRecompile) {
 		CompileShader("Shaders/comp_particles_fwd.frag");
+		CompileShader("Shaders/comp_particles_oit.frag");
 		CompileShader("Shaders/comp_particles_g3.frag");
 		CompileShader("Shaders/comp_particles_g6.frag");
 		CompileShader("Shaders/comp_particles_v.frag");
 		CompileShader("Shaders/particles_fwd.frag");
+		CompileShader("Shaders/particles_oit.frag");
 		CompileShader("Shaders/particles_g3.frag");
 		CompileShader("Shaders/particles_g6.frag");
 		CompileShader("Shaders/particles_v.frag");
-		CompileShader("Shaders/pp_lighting_v.frag");
+		CompileShader("Shaders/particles_sprite.comp");
+		VBufferScene::compileLightingShaders();
 	}
 
 	// Force rebuilding pipelines & swapchain (using newly compiled shaders)
@@ -68,20 +75,177 @@ bool ParticleSystem::setParticlesCutout(bool cutout, bool noRecompile) {
 	// Recompile shaders
 	if (!noRecompile) {
 		CompileShader("Shaders/comp_particles_fwd.frag");
+		CompileShader("Shaders/comp_particles_oit.frag");
 		CompileShader("Shaders/comp_particles_g3.frag");
 		CompileShader("Shaders/comp_particles_g6.frag");
 		CompileShader("Shaders/comp_particles_v.frag");
 		CompileShader("Shaders/particles_fwd.frag");
+		CompileShader("Shaders/particles_oit.frag");
 		CompileShader("Shaders/particles_g3.frag");
 		CompileShader("Shaders/particles_g6.frag");
 		CompileShader("Shaders/particles_v.frag");
-		CompileShader("Shaders/pp_lighting_v.frag");
+		VBufferScene::compileLightingShaders();
+		std::vector<std::string> splitHull = U::splitStr("PARTICLE_HULL_", newDefinesContents);// mirror the cut-out polygon mode (which may not have been read yet at start-up)
+		settings.hull = splitHull.size() == 2 && splitHull[1].length() > 0 && splitHull[1][0] == '1';
+		if (settings.hull) compileGenerationShaders();// cut-out polygons apply to cut-out particles only
 	}
 
 	// Force rebuilding pipelines & swapchain (using newly compiled shaders)
 	return true;
 }
 
+bool ParticleSystem::setParticlesBaked(bool baked, bool noRecompile) {
+
+	// Read the current mode from __.defines (the source of truth, which may differ from the default settings at start-up)
+	std::string definesContents = U::readFileStr("__.defines");
+	std::vector<std::string> splitDefinesContents = U::splitStr("PARTICLE_BAKED_STATICS_", definesContents);
+	if (splitDefinesContents.size() != 2 || splitDefinesContents[1].length() < 1) throw std::runtime_error("Could not modify __.defines to recompile shaders for baked particle statics.");
+	ParticleSystem::settings.bakeStatics = splitDefinesContents[1][0] == '1';
+
+	if (baked == ParticleSystem::settings.bakeStatics) return false;// nothing to change!
+
+	ParticleSystem::settings.bakeStatics = baked;
+
+	// Change __.defines to mirror the new mode
+	std::string bakedDef = (baked ? "1" : "0");
+	std::string newDefinesContents = splitDefinesContents[0] + "PARTICLE_BAKED_STATICS_" + bakedDef + splitDefinesContents[1].substr(1);
+	U::writeFile("__.defines", newDefinesContents);
+	printf(("Wrote to __.defines: #define PARTICLE_BAKED_STATICS_" + bakedDef + ".\n").c_str());
+
+	// Recompile shaders (particle generation, and fragment shaders whose texture binding follows the baked statics)
+	if (!noRecompile) {
+		CompileShader("Shaders/particles.comp");
+		CompileShader("Shaders/vert_particles_fwd.vert");
+		CompileShader("Shaders/vertgeom_particles_fwd.vert");
+		CompileShader("Shaders/particles.geom");
+		CompileShader("Shaders/particles_fwd.frag");
+		CompileShader("Shaders/particles_oit.frag");
+		CompileShader("Shaders/particles_g3.frag");
+		CompileShader("Shaders/particles_g6.frag");
+		CompileShader("Shaders/particles_v.frag");
+		VBufferScene::compileLightingShaders();// re-generates particles with V-Buffer particle IDs
+	}
+
+	// Force rebuilding pipelines & swapchain (using newly compiled shaders)
+	return true;
+}
+
+bool ParticleSystem::setParticlesSpriteCache(bool cached, bool noRecompile) {
+
+	// Read the current mode from __.defines (the source of truth, which may differ from the default settings at start-up)
+	std::string definesContents = U::readFileStr("__.defines");
+	std::vector<std::string> splitDefinesContents = U::splitStr("PARTICLE_SPRITE_CACHE_", definesContents);
+	if (splitDefinesContents.size() != 2 || splitDefinesContents[1].length() < 1) throw std::runtime_error("Could not modify __.defines to recompile shaders for the particle sprite cache.");
+	ParticleSystem::settings.spriteCache = splitDefinesContents[1][0] == '1';
+
+	if (cached == ParticleSystem::settings.spriteCache) return false;// nothing to change!
+
+	ParticleSystem::settings.spriteCache = cached;
+
+	// Change __.defines to mirror the new mode
+	std::string cachedDef = (cached ? "1" : "0");
+	std::string newDefinesContents = splitDefinesContents[0] + "PARTICLE_SPRITE_CACHE_" + cachedDef + splitDefinesContents[1].substr(1);
+	U::writeFile("__.defines", newDefinesContents);
+	printf(("Wrote to __.defines: #define PARTICLE_SPRITE_CACHE_" + cachedDef + ".\n").c_str());
+
+	// Recompile shaders (every particle fragment shader either samples the sprite or shades the particle)
+	if (!noRecompile) {
+		CompileShader("Shaders/comp_particles_fwd.frag");
+		CompileShader("Shaders/comp_particles_oit.frag");
+		CompileShader("Shaders/comp_particles_g3.frag");
+		CompileShader("Shaders/comp_particles_g6.frag");
+		CompileShader("Shaders/particles_fwd.frag");
+		CompileShader("Shaders/particles_oit.frag");
+		CompileShader("Shaders/particles_g3.frag");
+		CompileShader("Shaders/particles_g6.frag");
+		VBufferScene::compileLightingShaders();// V-Buffer particles are shaded in the lighting pass
+	}
+
+	// Force rebuilding pipelines & swapchain (using newly compiled shaders)
+	return true;
+}
+
+bool ParticleSystem::setParticlesLod(bool lod, bool noRecompile) {
+
+	// Read the current mode from __.defines (the source of truth, which may differ from the default settings at start-up)
+	std::string definesContents = U::readFileStr("__.defines");
+	std::vector<std::string> splitDefinesContents = U::splitStr("PARTICLE_LOD_", definesContents);
+	if (splitDefinesContents.size() != 2 || splitDefinesContents[1].length() < 1) throw std::runtime_error("Could not modify __.defines to recompile shaders for the particle LOD.");
+	ParticleSystem::settings.lod = splitDefinesContents[1][0] == '1';
+
+	if (lod == ParticleSystem::settings.lod) return false;// nothing to change!
+
+	ParticleSystem::settings.lod = lod;
+
+	// Change __.defines to mirror the new mode
+	std::string lodDef = (lod ? "1" : "0");
+	std::string newDefinesContents = splitDefinesContents[0] + "PARTICLE_LOD_" + lodDef + splitDefinesContents[1].substr(1);
+	U::writeFile("__.defines", newDefinesContents);
+	printf(("Wrote to __.defines: #define PARTICLE_LOD_" + lodDef + ".\n").c_str());
+
+	// Recompile shaders (particle generation stages, and fragment shaders whose texture binding follows the culled particles counter)
+	if (!noRecompile) {
+		compileGenerationShaders();
+		CompileShader("Shaders/comp_particles_fwd.frag");
+		CompileShader("Shaders/comp_particles_oit.frag");
+		CompileShader("Shaders/comp_particles_g3.frag");
+		CompileShader("Shaders/comp_particles_g6.frag");
+		CompileShader("Shaders/comp_particles_v.frag");
+		CompileShader("Shaders/particles_fwd.frag");
+		CompileShader("Shaders/particles_oit.frag");
+		CompileShader("Shaders/particles_g3.frag");
+		CompileShader("Shaders/particles_g6.frag");
+		CompileShader("Shaders/particles_v.frag");
+		VBufferScene::compileLightingShaders();// re-generates particles with V-Buffer particle IDs
+	}
+
+	// Force rebuilding pipelines & swapchain (using newly compiled shaders)
+	return true;
+}
+
+void ParticleSystem::checkSupport(DevicesPtr devices) {
+
+	settings.lodSupported = devices->supportsVertexStores();
+
+	/// The distance LOD counts the particles it drops with stores from the vertex or geometry stage
+	if (!settings.lodSupported && setParticlesLod(false))
+		printf("Warning: the device does not support stores from vertex & geometry shaders, which the particle LOD statistics need; disabling the particle LOD.\n");
+
+}
+
+bool ParticleSystem::setParticlesHull(bool hull, bool noRecompile) {
+
+	// Read the current mode from __.defines (the source of truth, which may differ from the default settings at start-up)
+	std::string definesContents = U::readFileStr("__.defines");
+	std::vector<std::string> splitDefinesContents = U::splitStr("PARTICLE_HULL_", definesContents);
+	if (splitDefinesContents.size() != 2 || splitDefinesContents[1].length() < 1) throw std::runtime_error("Could not modify __.defines to recompile shaders for cut-out polygons.");
+	ParticleSystem::settings.hull = splitDefinesContents[1][0] == '1';
+
+	if (hull == ParticleSystem::settings.hull) return false;// nothing to change!
+
+	ParticleSystem::settings.hull = hull;
+
+	// Change __.defines to mirror the new mode
+	std::string hullDef = (hull ? "1" : "0");
+	std::string newDefinesContents = splitDefinesContents[0] + "PARTICLE_HULL_" + hullDef + splitDefinesContents[1].substr(1);
+	U::writeFile("__.defines", newDefinesContents);
+	printf(("Wrote to __.defines: #define PARTICLE_HULL_" + hullDef + ".\n").c_str());
+
+	// Recompile shaders (particle generation stages only: fragments are unchanged)
+	if (!noRecompile) compileGenerationShaders();
+
+	// Force rebuilding pipelines & swapchain (using newly compiled shaders)
+	return true;
+}
+
+void ParticleSystem::compileGenerationShaders() {
+	CompileShader("Shaders/vert_particles_fwd.vert");
+	CompileShader("Shaders/vertgeom_particles_fwd.vert");
+	CompileShader("Shaders/quadexpand.geom");
+	CompileShader("Shaders/particles_fwd.vert");
+	CompileShader("Shaders/particles.geom");
+}
+
 ParticleSystem::ParticleSystem(ParticlesConstructorParams& args) : params(args) {
 
 	// lazy init pattern:
@@ -97,7 +261,21 @@ ParticleSystem::ParticleSystem(ParticlesConstructorParams& args) : params(args)
 							   ParticleGenerationMode::VertexGenGeometryExp;
 			settings.halfSize = RC_SETTINGS->pHalfSize;
 			settings.particleCount = RC_SETTINGS->pCount;
+			settings.streamBudgetMB = RC_SETTINGS->pStreamBudget;
 		}
+		std::string definesContents = U::readFileStr("__.defines");
+		std::vector<std::string> splitDefinesContents = U::splitStr("PARTICLE_BAKED_STATICS_", definesContents);
+		if (splitDefinesContents.size() == 2 && splitDefinesContents[1].length() > 0)
+			settings.bakeStatics = splitDefinesContents[1][0] == '1';// mirror the baking mode the shaders were compiled with
+		splitDefinesContents = U::splitStr("PARTICLE_SPRITE_CACHE_", definesContents);
+		if (splitDefinesContents.size() == 2 && splitDefinesContents[1].length() > 0)
+			settings.spriteCache = splitDefinesContents[1][0] == '1';// mirror the sprite cache mode the shaders were compiled with
+		splitDefinesContents = U::splitStr("PARTICLE_LOD_", definesContents);
+		if (splitDefinesContents.size() == 2 && splitDefinesContents[1].length() > 0)
+			settings.lod = splitDefinesContents[1][0] == '1';// mirror the LOD mode the shaders were compiled with
+		splitDefinesContents = U::splitStr("PARTICLE_HULL_", definesContents);
+		if (splitDefinesContents.size() == 2 && splitDefinesContents[1].length() > 0)
+			settings.hull = splitDefinesContents[1][0] == '1';// mirror the cut-out polygon mode the shaders were compiled with
 	}// only executes first time around.
 
 	renMode = args.rMode;
@@ -106,6 +284,7 @@ ParticleSystem::ParticleSystem(ParticlesConstructorParams& args) : params(args)
 	particlesUBO.gravity = settings.gravity;
 	particlesUBO.halfSize = settings.halfSize;
 	particlesUBO.initialUpwardsForce = settings.initialUpwardsForce;
+	particlesUBO.staticsBaked = 0;// until bakeStatics() succeeds
 	this->devices = args.devices;
 
 	/// Ensure static Complexity field is the same as what we expect from the __.defines file.
@@ -118,28 +297,69 @@ ParticleSystem::ParticleSystem(ParticlesConstructorParams& args) : params(args)
 		printf(("Read complexity from __.defines as: " + std::to_string(settings.complexity) + "\n").c_str());
 	}
 
+	// Bake the time-invariant attributes of the particles once; particle() then reads them back in all generation modes
+	if (settings.bakeStatics) bakeStatics();
+
+	// Shade the sprite once; particle fragments then sample it in all renderers
+	if (usesSpriteCache()) bakeSprite();
+
+	// Fit the polygon drawn in place of the quad of cut-out particles (in all generation modes, from the UBO)
+	if (usesHull()) buildHull("Textures/leaf.png");
+
+	// The distance LOD counts the particles it drops from the vertex or geometry stage (turned off ahead of construction on devices lacking such stores, see checkSupport())
+	if (settings.lod) {
+		lodStatsBuffer = new UniformBuffer<ParticleLodStats>(args.swapchainSize, devices(), devices->getPhysicalDevice(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+		lodStatsBuffer->copyAllBuffers({});// read back (and reset) before the first frame of each image completes
+	}
+
+	// Occlusion culling lists the particles visible over the depth pyramid of the scene ahead of their draw (see cmdBindCulled); the generation stages always
+	// bind the visible list, which is only a placeholder when the particles are not culled
+	bool culled = args.hiZ && args.continuationRenderPass && !isStreaming();
+	if (culled && settings.particleCount > affordableParticles(args.swapchainSize, sizeof(uint32_t))) {
+		printf("Warning: cannot list %u visible particles within the device budget; drawing them without occlusion culling.\n", settings.particleCount);
+		culled = false;
+	}
+	uint32_t visibleCapacity = culled ? settings.particleCount : 1;
+	visibleBuffer = new UniformBuffer<uint32_t>(args.swapchainSize, devices(), devices->getPhysicalDevice(),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,	// written by the culling pass (reset by transfer), read by the draw
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, PARTICLE_VISIBLE_HEADER + visibleCapacity);
+	int visibleSize = (int)(sizeof(uint32_t) * (PARTICLE_VISIBLE_HEADER + visibleCapacity));
+
 	// Select different options based on rendering mode
-	int outputAttachmentCount =	renMode == ParticleRenderingMode::DeferredG3Ren ?	3 :
-								renMode == ParticleRenderingMode::DeferredG6Ren ?	6 :
+	int outputAttachmentCount =	renMode == ParticleRenderingMode::DeferredG3Ren ?	(args.compactGBuffer ? 2 : 3) + (args.motionVectors ? 1 : 0) :
+								renMode == ParticleRenderingMode::DeferredG6Ren ?	(args.compactGBuffer ? 5 : 6) + (args.motionVectors ? 1 : 0) :
+								renMode == ParticleRenderingMode::ForwardOITRen ?	2 :
 																					1;
+	BlendMode blendMode = renMode == ParticleRenderingMode::ForwardOITRen ? BlendMode::WeightedBlended : BlendMode::Opaque;
 	// determine which fragment shader to use to render the particles in the first subpass, depending on modes.
 	std::string frag =	renMode == ParticleRenderingMode::DeferredG3Ren ?	"particles_g3" :
 						renMode == ParticleRenderingMode::DeferredG6Ren ?	"particles_g6" :
 						renMode == ParticleRenderingMode::DeferredVRen ?	"particles_v" :
+						renMode == ParticleRenderingMode::ForwardOITRen ?	"particles_oit" :
 																			"particles_fwd";
 	if (settings.genMode == ParticleGenerationMode::ComputeGenExp)
 		frag = "comp_" + frag; // fragment shader will need slight changes as textures aren't bound in the same locations.
 
 	std::vector<Descriptor::ImageInfoDescriptor> imageDescriptors = {};
-	bool uploadTexture = settings.complexity == 2 && (settings.cutout || renMode != ParticleRenderingMode::DeferredVRen); // in V-Buffer rendering, no need to upload the texture in the particle pass - texturing is done in the lighting pass (which already has the texture)
+	bool uploadTexture = settings.complexity == 2 && renMode != ParticleRenderingMode::DeferredVRen; // in V-Buffer rendering, no need to upload the texture in the particle pass - texturing is done in the lighting pass (which already has the texture)
 	if (uploadTexture) {
 		particlesTexture = new Texture(settings.cutout ? "Textures/leaf.png" : "Textures/shrimp.png", devices(), devices->getPhysicalDevice(), args.commandPool, devices->getGraphicsQueue());
 		imageDescriptors.push_back(Descriptor::ImageInfoDescriptor(particlesTexture, args.sampler));
+	} else if (spriteCache && renMode != ParticleRenderingMode::DeferredVRen) {// bound in place of the texture (the V-Buffer lighting pass binds it itself)
+		uploadTexture = true;
+		imageDescriptors.push_back(Descriptor::ImageInfoDescriptor(spriteCache, args.sampler));
+	}
+	if (settings.complexity == 2 && settings.cutout && renMode == ParticleRenderingMode::DeferredVRen) {// cut-out particles in the V-Buffer only test the coverage of the leaf, bound in place of the texture
+		ParticleCoverageMask mask = buildCoverageMask("Textures/leaf.png");
+		coverageMaskBuffer = new UniformBuffer<ParticleCoverageMask>(1, devices(), devices->getPhysicalDevice());
+		coverageMaskBuffer->copyBuffer(0, mask);
 	}
 
 
 
 	// setup differently based on mode:
+	std::vector<VkBuffer> imageStatics(args.swapchainSize, staticsBuffer ? staticsBuffer->getBuffers()[0] : VK_NULL_HANDLE);// baked statics bound for each swapchain image (same buffer)
+	std::vector<VkBuffer> imageCoverageMask(args.swapchainSize, coverageMaskBuffer ? coverageMaskBuffer->getBuffers()[0] : VK_NULL_HANDLE);// coverage mask bound for each swapchain image (same buffer)
 
 	if (settings.genMode == ParticleGenerationMode::ComputeGenExp) {
 
@@ -148,29 +368,92 @@ ParticleSystem::ParticleSystem(ParticlesConstructorParams& args) : params(args)
 		// we'll need the compute fields.
 		computeFields = new ComputeFields;
 
+		// Streaming: chunks are generated & drawn in turn from the graphics command buffers, cycling through a few SSBO slices per swapchain image sized to fit the budget
+		bool streaming = isStreaming();
+		if (streaming && !args.continuationRenderPass) {
+			printf("Warning: cannot stream particles without a continuation render pass; allocating all particles at once.\n");
+			streaming = false;
+		}
+		if (streaming) {
+			uint64_t budgetBytes = (uint64_t)settings.streamBudgetMB * 1024 * 1024;
+			uint64_t chunkSize = budgetBytes / ((uint64_t)args.swapchainSize * STREAMING_RING_SLICES * sizeof(ComputeSSBO));
+			chunkSize -= chunkSize % 256;// whole workgroups only
+			// at least a workgroup, at most the particles (fewer than a workgroup when there are less than 256 particles)
+			computeFields->chunkSize = (uint32_t)glm::min(glm::max(chunkSize, (uint64_t)256), (uint64_t)glm::min(settings.particleCount, (unsigned int)PARTICLES_PER_CALL));
+			printf("Streaming particles in chunks of %u (%u chunks per frame).\n", computeFields->chunkSize, (settings.particleCount + computeFields->chunkSize - 1) / computeFields->chunkSize);
+		}
+		if (!streaming) {
+			/// Memory budget check: every particle is stored in each swapchain image's SSBO; reduce the count if that cannot fit before allocating
+			uint64_t maxParticles = affordableParticles(args.swapchainSize, sizeof(ComputeSSBO));
+			if (settings.particleCount > maxParticles) {
+				printf("Warning: %u comp/comp particles need %llu MB of SSBOs, over the device budget; reducing to %llu particles (stream them with -pstream to render more).\n",
+					settings.particleCount, (unsigned long long)((uint64_t)settings.particleCount * args.swapchainSize * sizeof(ComputeSSBO) / (1024 * 1024)), (unsigned long long)maxParticles);
+				settings.particleCount = (unsigned int)maxParticles;
+				particlesUBO.particleCount = settings.particleCount;
+			}
+		}
+		int ssboSlots = streaming ? args.swapchainSize * STREAMING_RING_SLICES : args.swapchainSize;// descriptor sets / SSBO slices
+		uint32_t particlesPerSlot = streaming ? computeFields->chunkSize : settings.particleCount;
+
 		// Compute pipeline
-		uboBuffer = new UniformBuffer<ParticlesUBO>(1, devices(), devices->getPhysicalDevice());
-		computeFields->ssboBuffer = new UniformBuffer<ComputeSSBO>(1, devices(), devices->getPhysicalDevice(),
-			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,	// usage as an SSBO for compute, and as a VBO for the vertex shader that uses that data
+		// (UBO and SSBO are both buffered per swapchain image: the compute pass for one image may run while the graphics pass of another still reads its own SSBO)
+		std::vector<uint32_t> sharedQueueFamilies = {};
+		if (!streaming && devices->getGraphicsQueueFamily() != devices->getComputeQueueFamily())
+			sharedQueueFamilies = { devices->getGraphicsQueueFamily(), devices->getComputeQueueFamily() };// written on the compute queue, read on the graphics queue; no ownership transfers needed.
+		uboBuffer = new UniformBuffer<ParticlesUBO>(args.swapchainSize, devices(), devices->getPhysicalDevice());
+		computeFields->ssboBuffer = new UniformBuffer<ComputeSSBO>(ssboSlots, devices(), devices->getPhysicalDevice(),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,	// written to as an SSBO by compute, read as an SSBO by the vertex shader
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,	// on the GPU
-			settings.particleCount * 6		// amount of vertices that will need to be passed from Compute to Vertex shader.
+			particlesPerSlot,		// one element per particle; the vertex shader expands it to a quad.
+			sharedQueueFamilies
 			);// SSBO setup
+		std::vector<VkBuffer> slotUBOs = {};// UBO used by each descriptor set (shared by the slices of a same swapchain image)
+		for (int i = 0; i < ssboSlots; ++i) slotUBOs.push_back(uboBuffer->getBuffers()[i * args.swapchainSize / ssboSlots]);
+		computeFields->generatedStates.resize(args.swapchainSize);
+		computeFields->generated.resize(args.swapchainSize, false);
 		DESCRIPTOR_BINDING_ARRAY computeBindings = { DESCRIPTOR_BINDING_UBO_COMPUTE, DESCRIPTOR_BINDING_STORAGE_BUFFER_COMPUTE };
+		std::vector<Descriptor::UBODescriptor> computeUBODescriptors = {
+							Descriptor::UBODescriptor(slotUBOs, sizeof(ParticlesUBO)),						// Uniform buffer
+							Descriptor::UBODescriptor(computeFields->ssboBuffer->getBuffers(), sizeof(ComputeSSBO) * particlesPerSlot)		// Storage buffer
+		};
+		std::vector<VkBuffer> slotStatics(ssboSlots, staticsBuffer ? staticsBuffer->getBuffers()[0] : VK_NULL_HANDLE);
+		if (staticsBuffer) {
+			computeBindings.push_back(DESCRIPTOR_BINDING_STORAGE_BUFFER_COMPUTE);
+			computeUBODescriptors.push_back(Descriptor::UBODescriptor(slotStatics, getStaticsSize()));// Baked statics
+		}
 		computeFields->descriptor = new Descriptor(computeBindings, devices(), VK_PIPELINE_BIND_POINT_COMPUTE);
-		computeFields->descriptor->createPipelineLayout();
-		computeFields->descriptor->createDescriptorSets(1, *args.descriptorPool, {
-							Descriptor::UBODescriptor(uboBuffer->getBuffers(), sizeof(ParticlesUBO)),						// Uniform buffer
-							Descriptor::UBODescriptor(computeFields->ssboBuffer->getBuffers(), sizeof(ComputeSSBO) * settings.particleCount * 6)		// Storage buffer
-			}, {/* no samplers */ });
+		computeFields->descriptor->createPipelineLayout(sizeof(ParticleRange), VK_SHADER_STAGE_COMPUTE_BIT);
+		computeFields->descriptor->createDescriptorSets(ssboSlots, *args.descriptorPool, computeUBODescriptors, {/* no samplers */ });
 		computeFields->pipeline = new ComputePipeline("particles", computeFields->descriptor->getPipelineLayout(), devices());
 
-		// Graphics pipeline
-		DESCRIPTOR_BINDING_ARRAY particlesBindings = {};
+		// Graphics pipeline (reads the same UBO for view & projection, and the SSBO generated for the same image index)
+		DESCRIPTOR_BINDING_ARRAY particlesBindings = { DESCRIPTOR_BINDING_UBO_VERTEX, DESCRIPTOR_BINDING_STORAGE_BUFFER_VERTEX };
+		std::vector<Descriptor::UBODescriptor> particlesUBODescriptors = {
+							Descriptor::UBODescriptor(slotUBOs, sizeof(ParticlesUBO)),
+							Descriptor::UBODescriptor(computeFields->ssboBuffer->getBuffers(), sizeof(ComputeSSBO) * particlesPerSlot)
+		};
+		std::vector<VkBuffer> slotLodStats = {};// culled particles counter used by each descriptor set (shared by the slices of a same swapchain image)
+		if (lodStatsBuffer) {
+			for (int i = 0; i < ssboSlots; ++i) slotLodStats.push_back(lodStatsBuffer->getBuffers()[i * args.swapchainSize / ssboSlots]);
+			particlesBindings.push_back(DESCRIPTOR_BINDING_STORAGE_BUFFER_VERTEX);
+			particlesUBODescriptors.push_back(Descriptor::UBODescriptor(slotLodStats, sizeof(ParticleLodStats)));
+		}
+		std::vector<VkBuffer> slotVisible = {};// visible list used by each descriptor set (as the counter above)
+		for (int i = 0; i < ssboSlots; ++i) slotVisible.push_back(visibleBuffer->getBuffers()[i * args.swapchainSize / ssboSlots]);
+		particlesBindings.push_back(DESCRIPTOR_BINDING_STORAGE_BUFFER_VERTEX);
+		particlesUBODescriptors.push_back(Descriptor::UBODescriptor(slotVisible, visibleSize));
 		if (uploadTexture) particlesBindings.push_back(DESCRIPTOR_BINDING_SAMPLER_FRAGMENT);
+		std::vector<VkBuffer> slotCoverageMask(ssboSlots, coverageMaskBuffer ? coverageMaskBuffer->getBuffers()[0] : VK_NULL_HANDLE);// same coverage mask in every descriptor set
+		if (coverageMaskBuffer) {
+			particlesBindings.push_back(DESCRIPTOR_BINDING_UBO_FRAGMENT);
+			particlesUBODescriptors.push_back(Descriptor::UBODescriptor(slotCoverageMask, sizeof(ParticleCoverageMask)));
+		}
 		graphicsDescriptor = new Descriptor(particlesBindings, devices());
-		graphicsDescriptor->createPipelineLayout();
-		graphicsDescriptor->createDescriptorSets(args.swapchainSize, *args.descriptorPool, {}, imageDescriptors);
-		graphicsPipeline = new GraphicsPipeline("particles_fwd", frag, NULL, args.swapchainExtent, graphicsDescriptor->getPipelineLayout(), args.renderPass, 0, true, outputAttachmentCount, devices());
+		graphicsDescriptor->createPipelineLayout(sizeof(ParticleRange), rangeStages());
+		graphicsDescriptor->createDescriptorSets(ssboSlots, *args.descriptorPool, particlesUBODescriptors, imageDescriptors);
+		graphicsPipeline = new NulTriangleGraphicsPipeline("particles_fwd", frag, NULL, args.swapchainExtent, graphicsDescriptor->getPipelineLayout(), args.renderPass, 0, true, outputAttachmentCount, devices(), VK_COMPARE_OP_LESS, true, blendMode);
+		vertexBufferMesh = new Mesh_Base<NulVertex>({ NulVertex() }, { 0 }, devices(), devices->getPhysicalDevice(), args.commandPool, devices->getGraphicsQueue());
+		vertexBufferMesh->bindOnlyVertexBuffer = true;
 
 	} else if (settings.genMode == ParticleGenerationMode::VertexGenExp) {
 
@@ -178,12 +461,22 @@ ParticleSystem::ParticleSystem(ParticlesConstructorParams& args) : params(args)
 
 		// Graphics pipeline setup
 		DESCRIPTOR_BINDING_ARRAY particlesBindings = { DESCRIPTOR_BINDING_UBO_VERTEX };
+		if (staticsBuffer) particlesBindings.push_back(DESCRIPTOR_BINDING_STORAGE_BUFFER_VERTEX);
+		if (lodStatsBuffer) particlesBindings.push_back(DESCRIPTOR_BINDING_STORAGE_BUFFER_VERTEX);
+		particlesBindings.push_back(DESCRIPTOR_BINDING_STORAGE_BUFFER_VERTEX);// visible list
 		if(uploadTexture) particlesBindings.push_back(DESCRIPTOR_BINDING_SAMPLER_FRAGMENT);
+		if (coverageMaskBuffer) particlesBindings.push_back(DESCRIPTOR_BINDING_UBO_FRAGMENT);
 		graphicsDescriptor = new Descriptor(particlesBindings, devices());
-		graphicsDescriptor->createPipelineLayout();
+		graphicsDescriptor->createPipelineLayout(sizeof(ParticleRange), rangeStages());
+		std::vector<Descriptor::UBODescriptor> particlesUBODescriptors = {};
 		uboBuffer = new UniformBuffer<ParticlesUBO>(args.swapchainSize, devices(), devices->getPhysicalDevice());
-		graphicsDescriptor->createDescriptorSets(args.swapchainSize, *args.descriptorPool, { Descriptor::UBODescriptor(uboBuffer->getBuffers(), sizeof(ParticlesUBO)) }, imageDescriptors);
-		graphicsPipeline = new NulTriangleGraphicsPipeline("vert_particles_fwd", frag, NULL, args.swapchainExtent, graphicsDescriptor->getPipelineLayout(), args.renderPass, 0, true, outputAttachmentCount, devices());
+		particlesUBODescriptors.push_back(Descriptor::UBODescriptor(uboBuffer->getBuffers(), sizeof(ParticlesUBO)));
+		if (staticsBuffer) particlesUBODescriptors.push_back(Descriptor::UBODescriptor(imageStatics, getStaticsSize()));
+		if (lodStatsBuffer) particlesUBODescriptors.push_back(Descriptor::UBODescriptor(lodStatsBuffer->getBuffers(), sizeof(ParticleLodStats)));
+		particlesUBODescriptors.push_back(Descriptor::UBODescriptor(visibleBuffer->getBuffers(), visibleSize));
+		if (coverageMaskBuffer) particlesUBODescriptors.push_back(Descriptor::UBODescriptor(imageCoverageMask, sizeof(ParticleCoverageMask)));
+		graphicsDescriptor->createDescriptorSets(args.swapchainSize, *args.descriptorPool, particlesUBODescriptors, imageDescriptors);
+		graphicsPipeline = new NulTriangleGraphicsPipeline("vert_particles_fwd", frag, NULL, args.swapchainExtent, graphicsDescriptor->getPipelineLayout(), args.renderPass, 0, true, outputAttachmentCount, devices(), VK_COMPARE_OP_LESS, true, blendMode);
 		vertexBufferMesh = new Mesh_Base<NulVertex>({ NulVertex() }, { 0 }, devices(), devices->getPhysicalDevice(), args.commandPool, devices->getGraphicsQueue());
 		vertexBufferMesh->bindOnlyVertexBuffer = true;
 
@@ -193,15 +486,23 @@ ParticleSystem::ParticleSystem(ParticlesConstructorParams& args) : params(args)
 
 		// Graphics pipeline setup
 		DESCRIPTOR_BINDING_ARRAY particlesBindings = { DESCRIPTOR_BINDING_UBO_GEOMETRY };
+		if (staticsBuffer) particlesBindings.push_back(DESCRIPTOR_BINDING_STORAGE_BUFFER_GEOMETRY);
+		if (lodStatsBuffer) particlesBindings.push_back(DESCRIPTOR_BINDING_STORAGE_BUFFER_GEOMETRY);
+		particlesBindings.push_back(DESCRIPTOR_BINDING_STORAGE_BUFFER_GEOMETRY);// visible list
 		if (uploadTexture) particlesBindings.push_back(DESCRIPTOR_BINDING_SAMPLER_FRAGMENT);
+		if (coverageMaskBuffer) particlesBindings.push_back(DESCRIPTOR_BINDING_UBO_FRAGMENT);
 		graphicsDescriptor = new Descriptor(particlesBindings, devices());
-		graphicsDescriptor->createPipelineLayout();
+		graphicsDescriptor->createPipelineLayout(sizeof(ParticleRange), rangeStages());
 		std::vector<Descriptor::UBODescriptor> particlesUBODescriptors = {};
 		uboBuffer = new UniformBuffer<ParticlesUBO>(args.swapchainSize, devices(), devices->getPhysicalDevice());
 		particlesUBODescriptors.push_back(Descriptor::UBODescriptor(uboBuffer->getBuffers(), sizeof(ParticlesUBO)));
+		if (staticsBuffer) particlesUBODescriptors.push_back(Descriptor::UBODescriptor(imageStatics, getStaticsSize()));
+		if (lodStatsBuffer) particlesUBODescriptors.push_back(Descriptor::UBODescriptor(lodStatsBuffer->getBuffers(), sizeof(ParticleLodStats)));
+		particlesUBODescriptors.push_back(Descriptor::UBODescriptor(visibleBuffer->getBuffers(), visibleSize));
+		if (coverageMaskBuffer) particlesUBODescriptors.push_back(Descriptor::UBODescriptor(imageCoverageMask, sizeof(ParticleCoverageMask)));
 		graphicsDescriptor->createDescriptorSets(args.swapchainSize, *args.descriptorPool, particlesUBODescriptors, imageDescriptors);
 		std::string gsParts = "particles";
-		graphicsPipeline = new NulPointGraphicsPipeline("geom_particles_fwd", frag, &gsParts, args.swapchainExtent, graphicsDescriptor->getPipelineLayout(), args.renderPass, 0, true, outputAttachmentCount, devices());
+		graphicsPipeline = new NulPointGraphicsPipeline("geom_particles_fwd", frag, &gsParts, args.swapchainExtent, graphicsDescriptor->getPipelineLayout(), args.renderPass, 0, true, outputAttachmentCount, devices(), VK_COMPARE_OP_LESS, true, blendMode);
 		vertexBufferMesh = new Mesh_Base<NulVertex>({ NulVertex() }, { 0 }, devices(), devices->getPhysicalDevice(), args.commandPool, devices->getGraphicsQueue());
 		vertexBufferMesh->bindOnlyVertexBuffer = true;
 
@@ -211,15 +512,23 @@ ParticleSystem::ParticleSystem(ParticlesConstructorParams& args) : params(args)
 
 		// Graphics pipeline setup
 		DESCRIPTOR_BINDING_ARRAY particlesBindings = { DESCRIPTOR_BINDING_UBO_VERTEX };
+		if (staticsBuffer) particlesBindings.push_back(DESCRIPTOR_BINDING_STORAGE_BUFFER_VERTEX);
+		if (lodStatsBuffer) particlesBindings.push_back(DESCRIPTOR_BINDING_STORAGE_BUFFER_VERTEX);
+		particlesBindings.push_back(DESCRIPTOR_BINDING_STORAGE_BUFFER_VERTEX);// visible list
 		if (uploadTexture) particlesBindings.push_back(DESCRIPTOR_BINDING_SAMPLER_FRAGMENT);
+		if (coverageMaskBuffer) particlesBindings.push_back(DESCRIPTOR_BINDING_UBO_FRAGMENT);
 		graphicsDescriptor = new Descriptor(particlesBindings, devices());
-		graphicsDescriptor->createPipelineLayout();
+		graphicsDescriptor->createPipelineLayout(sizeof(ParticleRange), rangeStages());
 		std::vector<Descriptor::UBODescriptor> particlesUBODescriptors = {};
 		uboBuffer = new UniformBuffer<ParticlesUBO>(args.swapchainSize, devices(), devices->getPhysicalDevice());
 		particlesUBODescriptors.push_back(Descriptor::UBODescriptor(uboBuffer->getBuffers(), sizeof(ParticlesUBO)));
+		if (staticsBuffer) particlesUBODescriptors.push_back(Descriptor::UBODescriptor(imageStatics, getStaticsSize()));
+		if (lodStatsBuffer) particlesUBODescriptors.push_back(Descriptor::UBODescriptor(lodStatsBuffer->getBuffers(), sizeof(ParticleLodStats)));
+		particlesUBODescriptors.push_back(Descriptor::UBODescriptor(visibleBuffer->getBuffers(), visibleSize));
+		if (coverageMaskBuffer) particlesUBODescriptors.push_back(Descriptor::UBODescriptor(imageCoverageMask, sizeof(ParticleCoverageMask)));
 		graphicsDescriptor->createDescriptorSets(args.swapchainSize, *args.descriptorPool, particlesUBODescriptors, imageDescriptors);
 		std::string gsParts = "quadexpand";
-		graphicsPipeline = new NulPointGraphicsPipeline("vertgeom_particles_fwd", frag, &gsParts, args.swapchainExtent, graphicsDescriptor->getPipelineLayout(), args.renderPass, 0, true, outputAttachmentCount, devices());
+		graphicsPipeline = new NulPointGraphicsPipeline("vertgeom_particles_fwd", frag, &gsParts, args.swapchainExtent, graphicsDescriptor->getPipelineLayout(), args.renderPass, 0, true, outputAttachmentCount, devices(), VK_COMPARE_OP_LESS, true, blendMode);
 		vertexBufferMesh = new Mesh_Base<NulVertex>({ NulVertex() }, { 0 }, devices(), devices->getPhysicalDevice(), args.commandPool, devices->getGraphicsQueue());
 		vertexBufferMesh->bindOnlyVertexBuffer = true;
 
@@ -227,6 +536,42 @@ ParticleSystem::ParticleSystem(ParticlesConstructorParams& args) : params(args)
 		throw std::runtime_error("Cannot use particles gen mode: unimplemented mode.");
 	}
 
+	// Under a particle budget, draw (and generate) the particles through indirect commands, so that the amount drawn changes without re-recording
+	if (ParticleBudget::enabled()) {
+		if (computeFields && computeFields->chunkSize > 0) {
+			printf("Warning: streamed particles are not budgeted; drawing all %u particles.\n", settings.particleCount);
+		} else {
+			uint32_t draws = (settings.particleCount + particlesPerDraw() - 1) / particlesPerDraw();
+			drawArgsBuffer = new UniformBuffer<VkDrawIndirectCommand>(args.swapchainSize, devices(), devices->getPhysicalDevice(),
+				VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, draws);
+			if (computeFields) {
+				uint32_t dispatches = (settings.particleCount + PARTICLES_PER_CALL - 1) / PARTICLES_PER_CALL;
+				computeFields->dispatchArgsBuffer = new UniformBuffer<VkDispatchIndirectCommand>(args.swapchainSize, devices(), devices->getPhysicalDevice(),
+					VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, dispatches);
+			}
+			for (uint32_t i = 0; i < args.swapchainSize; ++i) writeIndirectArgs(i);// all particles until the first update
+		}
+	}
+
+	// Occlusion culling pass (same bindings as Shaders/particles_cull.comp): UBO, visible list, depth pyramid, and baked statics
+	if (culled) {
+		printf("Culling particles against the depth pyramid of the scene.\n");
+		DESCRIPTOR_BINDING_ARRAY cullBindings = { DESCRIPTOR_BINDING_UBO_COMPUTE, DESCRIPTOR_BINDING_STORAGE_BUFFER_COMPUTE, DESCRIPTOR_BINDING_STORAGE_IMAGE_COMPUTE };
+		std::vector<Descriptor::UBODescriptor> cullUBODescriptors = {
+							Descriptor::UBODescriptor(uboBuffer->getBuffers(), sizeof(ParticlesUBO)),
+							Descriptor::UBODescriptor(visibleBuffer->getBuffers(), visibleSize)
+		};
+		if (staticsBuffer) {
+			cullBindings.push_back(DESCRIPTOR_BINDING_STORAGE_BUFFER_COMPUTE);
+			cullUBODescriptors.push_back(Descriptor::UBODescriptor(imageStatics, getStaticsSize()));
+		}
+		cullDescriptor = new Descriptor(cullBindings, devices(), VK_PIPELINE_BIND_POINT_COMPUTE);
+		cullDescriptor->createPipelineLayout(sizeof(CullConstants), VK_SHADER_STAGE_COMPUTE_BIT);
+		// own pool: the particle system is recreated from the UI without the shared pool being reset, which would run out of storage images
+		cullDescriptor->createDescriptorSets(args.swapchainSize, cullUBODescriptors, { Descriptor::ImageInfoDescriptor(args.hiZ->getPyramid(), VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL) });
+		cullPipeline = new ComputePipeline("particles_cull", cullDescriptor->getPipelineLayout(), devices());
+	}
+
 }
 
 ParticleSystem::~ParticleSystem() {
@@ -237,6 +582,7 @@ ParticleSystem::~ParticleSystem() {
 		DELETE(computeFields->pipeline);
 		DELETE(computeFields->descriptor);
 		DELETE(computeFields->ssboBuffer);
+		DELETE(computeFields->dispatchArgsBuffer);
 		DELETE(computeFields);
 	}
 
@@ -245,88 +591,524 @@ ParticleSystem::~ParticleSystem() {
 	DELETE(graphicsDescriptor);
 	DELETE(vertexBufferMesh);
 	DELETE(particlesTexture);
+	DELETE(coverageMaskBuffer);
+	DELETE(staticsBuffer);
+	DELETE(spriteCache);
+	DELETE(drawArgsBuffer);
+	DELETE(lodStatsBuffer);
+	DELETE(visibleBuffer);
+	DELETE(cullPipeline);
+	DELETE(cullDescriptor);
 
 }
 
-void ParticleSystem::Update(uint32_t imageIndex, float dt, float time, const glm::mat4& view, const glm::mat4& proj) {
+uint64_t ParticleSystem::affordableParticles(uint32_t buffers, uint32_t bytesPerParticle) const {
 
-	/// Check whether the UBO should be sent.
-	if (particlesUBO.time == time && particlesUBO.view == view && particlesUBO.proj == proj) ++uboNoUpdateCount;
-	else uboNoUpdateCount = 0;
-	if (uboNoUpdateCount > uboBuffer->getBuffers().size()) return;// nothing to update.
+	VkPhysicalDeviceProperties deviceProperties;
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceProperties(devices->getPhysicalDevice(), &deviceProperties);
+	vkGetPhysicalDeviceMemoryProperties(devices->getPhysicalDevice(), &memoryProperties);
+
+	VkDeviceSize heapSize = 0;// largest device-local heap
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i)
+		if (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) heapSize = glm::max(heapSize, memoryProperties.memoryHeaps[i].size);
 
-	/// Update UBO.
+	uint64_t maxParticles = glm::min((uint64_t)(heapSize * PARTICLES_SSBO_HEAP_FRACTION) / ((uint64_t)buffers * bytesPerParticle),// all buffers fit in the heap
+									 (uint64_t)deviceProperties.limits.maxStorageBufferRange / bytesPerParticle);// a single buffer can be bound
+	return maxParticles - maxParticles % 256;
+}
+
+void ParticleSystem::bakeStatics() {
+
+	/// Statics buffer, read from the compute queue in comp/comp mode
+	std::vector<uint32_t> sharedQueueFamilies = {};
+	if (settings.genMode == ParticleGenerationMode::ComputeGenExp && devices->getGraphicsQueueFamily() != devices->getComputeQueueFamily())
+		sharedQueueFamilies = { devices->getGraphicsQueueFamily(), devices->getComputeQueueFamily() };
+
+	/// Memory budget check: fall back to computing the attributes in the shaders if they cannot be stored (the shaders compiled for baked statics
+	/// still bind the buffer, so a placeholder is bound in its place and the UBO has them hash the attributes instead of reading it)
+	if (settings.particleCount > affordableParticles(1, sizeof(ParticleStatics))) {
+		printf("Warning: cannot bake static attributes of %u particles within the device budget; computing them in the shaders instead.\n", settings.particleCount);
+		staticsBuffer = new UniformBuffer<ParticleStatics>(1, devices(), devices->getPhysicalDevice(),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, sharedQueueFamilies);
+		return;
+	}
+
+	printf("Baking static attributes of %u particles.\n", settings.particleCount);
+
+	staticsBuffer = new UniformBuffer<ParticleStatics>(1, devices(), devices->getPhysicalDevice(),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, settings.particleCount, sharedQueueFamilies);
+	particlesUBO.staticsBaked = 1;
+
+	/// Temporary bake pipeline (its set is allocated from a pool of its own, freed once baked)
+	DESCRIPTOR_BINDING_ARRAY bakeBindings = { DESCRIPTOR_BINDING_STORAGE_BUFFER_COMPUTE };
+	Descriptor bakeDescriptor(bakeBindings, devices(), VK_PIPELINE_BIND_POINT_COMPUTE);
+	bakeDescriptor.createPipelineLayout(sizeof(ParticleRange), VK_SHADER_STAGE_COMPUTE_BIT);
+	bakeDescriptor.createDescriptorSets(1, { Descriptor::UBODescriptor(staticsBuffer->getBuffers(), getStaticsSize()) }, {/* no samplers */ });
+	ComputePipeline bakePipeline("particles_bake", bakeDescriptor.getPipelineLayout(), devices());
+
+	/// Dispatch in calls of at most PARTICLES_PER_CALL particles, and wait for completion (the statics are then only ever read)
+	VkCommandBuffer cmdBuffer = U::beginSingleTimeCommands(params.commandPool, *devices(), devices->getGraphicsQueue()); {
+		bakeDescriptor.cmdBind(cmdBuffer, 0);
+		bakePipeline.cmdBind(cmdBuffer, 0);
+		uint32_t calls = settings.particleCount / PARTICLES_PER_CALL;
+		if (calls * PARTICLES_PER_CALL != settings.particleCount) ++calls;// need one more call to cover all particles
+		for (uint32_t call = 0; call < calls; ++call) {
+			ParticleRange range = { call * PARTICLES_PER_CALL, glm::min((uint32_t)PARTICLES_PER_CALL, settings.particleCount - call * PARTICLES_PER_CALL), call * PARTICLES_PER_CALL, 0 };
+			bakeDescriptor.cmdPushConstants(cmdBuffer, &range);
+			uint32_t invocations = range.count / 256;
+			if (invocations * 256 != range.count) ++invocations;// need one more invocation to cover all particles
+			vkCmdDispatch(cmdBuffer, invocations, 1, 1);
+		}
+	} U::endSingleTimeCommands(cmdBuffer, params.commandPool, *devices(), devices->getGraphicsQueue());
+
+}
+
+void ParticleSystem::buildHull(const std::string& path) {
+
+	int width, height, channels;
+	stbi_uc* pixels = stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+	if (!pixels) throw std::runtime_error("Failed to load pixel data from texture image");
+
+	/// Opaque span of each row (texel units, y down): a filtered sample only reaches 0.5 within half a texel beyond the square of a texel of alpha >= 0.5
+	std::vector<glm::vec2> points;
+	uint32_t opaque = 0;
+	for (int y = 0; y < height; ++y) {
+		int first = -1, last = -1;
+		for (int x = 0; x < width; ++x) {
+			if (pixels[(y * width + x) * 4 + 3] < 128) continue;
+			if (first < 0) first = x;
+			last = x;
+			++opaque;
+		}
+		if (first < 0) continue;
+		float x0 = glm::max(first - 0.5f, 0.f), x1 = glm::min(last + 1.5f, (float)width);
+		float y0 = glm::max(y - 0.5f, 0.f), y1 = glm::min(y + 1.5f, (float)height);
+		points.insert(points.end(), { glm::vec2(x0, y0), glm::vec2(x1, y0), glm::vec2(x0, y1), glm::vec2(x1, y1) });
+	}
+	stbi_image_free(pixels);
+
+	/// Convex hull of the spans (monotone chain), counter-clockwise
+	auto cross = [](const glm::vec2& a, const glm::vec2& b) { return a.x * b.y - a.y * b.x; };
+	std::sort(points.begin(), points.end(), [](const glm::vec2& a, const glm::vec2& b) { return a.x < b.x || (a.x == b.x && a.y < b.y); });
+	std::vector<glm::vec2> hull(2 * points.size());
+	size_t n = 0;
+	for (size_t i = 0; i < points.size(); ++i) {// lower chain
+		while (n >= 2 && cross(hull[n - 1] - hull[n - 2], points[i] - hull[n - 2]) <= 0) --n;
+		hull[n++] = points[i];
+	}
+	size_t lower = n + 1;
+	for (int i = (int)points.size() - 2; i >= 0; --i) {// upper chain
+		while (n >= lower && cross(hull[n - 1] - hull[n - 2], points[i] - hull[n - 2]) <= 0) --n;
+		hull[n++] = points[i];
+	}
+	hull.resize(n > 0 ? n - 1 : 0);// the last point is the first one
+
+	/// Down to PARTICLE_HULL_VERTICES corners: replace the edge whose neighbouring edges, extended, meet with the least area added by a single corner
+	/// (within the quad); the polygon still contains the hull
+	while (hull.size() > PARTICLE_HULL_VERTICES) {
+		n = hull.size();
+		size_t best = n;
+		float bestArea = 0.f;
+		glm::vec2 bestCorner;
+		for (size_t i = 0; i < n; ++i) {
+			glm::vec2 a = hull[(i + n - 1) % n], b = hull[i], c = hull[(i + 1) % n], d = hull[(i + 2) % n];
+			glm::vec2 u = b - a, v = c - d;// directions of the neighbouring edges beyond the edge bc
+			float denominator = cross(u, v);
+			if (glm::abs(denominator) < 1e-6f) continue;// parallel
+			float s = cross(c - b, v) / denominator, t = cross(c - b, u) / denominator;
+			if (s < 0.f || t < 0.f) continue;// the edges diverge
+			glm::vec2 corner = b + s * u;
+			if (corner.x < 0.f || corner.y < 0.f || corner.x > width || corner.y > height) continue;// outside the quad
+			float area = 0.5f * glm::abs(cross(corner - b, c - b));
+			if (best == n || area < bestArea) {
+				best = i;
+				bestArea = area;
+				bestCorner = corner;
+			}
+		}
+		if (best == n) {
+			hull.clear();// no corner left within the quad
+			break;
+		}
+		hull[best] = bestCorner;
+		hull.erase(hull.begin() + (best + 1) % n);
+	}
+	if (hull.size() < 3) hull = { glm::vec2(0, 0), glm::vec2(width, 0), glm::vec2(width, height), glm::vec2(0, height) };// fall back to the quad
+
+	/// Covered fraction of the quad (shoelace formula)
+	float area = 0.f;
+	for (size_t i = 0; i < hull.size(); ++i) area += cross(hull[i], hull[(i + 1) % hull.size()]);
+	hullArea = 0.5f * area / ((float)width * height);
+	opaqueArea = (float)opaque / ((float)width * height);
+	printf("Fitted a %zu-corner polygon to %s: cut-out particles rasterize %.1f%% of the fragments of a quad (%.1f%% are opaque).\n", hull.size(), path.c_str(), 100.f * hullArea, 100.f * opaqueArea);
+
+	/// To quad uv multipliers (the texture is sampled at 1 - uv, which keeps the polygon counter-clockwise), padded with the last corner (degenerate triangles),
+	/// in triangle strip order: 0, 1, n-1, 2, n-2...
+	while (hull.size() < PARTICLE_HULL_VERTICES) hull.push_back(hull.back());
+	for (int k = 0; k < PARTICLE_HULL_VERTICES; ++k) {
+		glm::vec2 corner = 1.f - 2.f * hull[k == 0 ? 0 : k % 2 == 1 ? (k + 1) / 2 : PARTICLE_HULL_VERTICES - k / 2] / glm::vec2(width, height);
+		glm::vec4& corners = particlesUBO.hull[k / 2];
+		if (k % 2 == 0) {
+			corners.x = corner.x;
+			corners.y = corner.y;
+		} else {
+			corners.z = corner.x;
+			corners.w = corner.y;
+		}
+	}
+
+}
+
+ParticleSystem::ParticleCoverageMask ParticleSystem::buildCoverageMask(const std::string& path) {
+
+	int width, height, channels;
+	stbi_uc* pixels = stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+	if (!pixels) throw std::runtime_error("Failed to load pixel data from texture image");
+
+	/// Each cell covers the texels of its share of the image (at least one, for images smaller than the mask)
+	ParticleCoverageMask mask = {};
+	uint32_t covered = 0;
+	for (int y = 0; y < PARTICLE_COVERAGE_MASK_SIZE; ++y) {
+		int y0 = y * height / PARTICLE_COVERAGE_MASK_SIZE;
+		int y1 = glm::max((y + 1) * height / PARTICLE_COVERAGE_MASK_SIZE, y0 + 1);
+		for (int x = 0; x < PARTICLE_COVERAGE_MASK_SIZE; ++x) {
+			int x0 = x * width / PARTICLE_COVERAGE_MASK_SIZE;
+			int x1 = glm::max((x + 1) * width / PARTICLE_COVERAGE_MASK_SIZE, x0 + 1);
+			uint32_t alpha = 0;
+			for (int ty = y0; ty < y1; ++ty)
+				for (int tx = x0; tx < x1; ++tx)
+					alpha += pixels[(ty * width + tx) * 4 + 3];
+			if (alpha * 2 < 255u * (y1 - y0) * (x1 - x0)) continue;// alpha < 0.5: discarded
+			uint32_t cell = y * PARTICLE_COVERAGE_MASK_SIZE + x;
+			mask.words[cell / 128][(cell / 32) % 4] |= 1u << (cell % 32);
+			++covered;
+		}
+	}
+	stbi_image_free(pixels);
+
+	printf("Built the coverage mask of %s (%u of %u cells covered).\n", path.c_str(), covered, PARTICLE_COVERAGE_MASK_SIZE * PARTICLE_COVERAGE_MASK_SIZE);
+	return mask;
+}
+
+void ParticleSystem::bakeSprite() {
+
+	printf("Baking the particle sprite (%ux%u).\n", settings.spriteResolution, settings.spriteResolution);
+
+	/// Sprite cache, written as a storage image then sampled
+	spriteCache = new Texture(VK_FORMAT_R16G16B16A16_SFLOAT, { settings.spriteResolution, settings.spriteResolution }, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_GENERAL, devices(), devices->getPhysicalDevice(), params.commandPool, devices->getGraphicsQueue());
+
+	/// Temporary bake pipeline (its set is allocated from a pool of its own, freed once baked: the sprite is baked again each time the particle system is recreated)
+	DESCRIPTOR_BINDING_ARRAY bakeBindings = { DESCRIPTOR_BINDING_STORAGE_IMAGE_COMPUTE };
+	Descriptor bakeDescriptor(bakeBindings, devices(), VK_PIPELINE_BIND_POINT_COMPUTE);
+	bakeDescriptor.createPipelineLayout();
+	bakeDescriptor.createDescriptorSets(1, {/* no buffers */ }, { Descriptor::ImageInfoDescriptor(spriteCache, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL) });
+	ComputePipeline bakePipeline("particles_sprite", bakeDescriptor.getPipelineLayout(), devices());
+
+	/// One invocation per texel, then make the sprite readable by the shaders sampling it, and wait for completion (the sprite is then only ever read)
+	VkCommandBuffer cmdBuffer = U::beginSingleTimeCommands(params.commandPool, *devices(), devices->getGraphicsQueue()); {
+		bakeDescriptor.cmdBind(cmdBuffer, 0);
+		bakePipeline.cmdBind(cmdBuffer, 0);
+		uint32_t groups = (settings.spriteResolution + 15) / 16;
+		vkCmdDispatch(cmdBuffer, groups, groups, 1);
+
+		VkImageMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = spriteCache->getImage();
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
+	} U::endSingleTimeCommands(cmdBuffer, params.commandPool, *devices(), devices->getGraphicsQueue());
+
+}
+
+VkShaderStageFlags ParticleSystem::rangeStages() {
+	return settings.genMode == ParticleGenerationMode::GeometryGenExp ? VK_SHADER_STAGE_GEOMETRY_BIT : VK_SHADER_STAGE_VERTEX_BIT;// particles are generated (or fetched) in the geometry or vertex shader
+}
+
+uint32_t ParticleSystem::particlesPerDraw() {
+	uint32_t perCall = PARTICLES_PER_CALL;
+	if (settings.genMode == ParticleGenerationMode::GeometryGenExp) perCall -= perCall % geometryParticlesPerVertex();// each geometry shader call outputs a whole batch of particles
+	return perCall;
+}
+
+bool ParticleSystem::sameSimulation(const ParticlesUBO& a, const ParticlesUBO& b) {
+	return a.time == b.time && a.halfSize == b.halfSize && a.density == b.density && a.gravity == b.gravity &&
+		a.initialUpwardsForce == b.initialUpwardsForce && a.particleCount == b.particleCount;
+}
+
+void ParticleSystem::Update(uint32_t imageIndex, float dt, float time, const glm::mat4& view, const glm::mat4& proj, const glm::vec2& jitter, const glm::mat4* eyeViews) {
+
+	/// Update UBO (the previous frame's view & time give the motion of the particles; none on the first update).
+	bool firstUpdate = uboNoUpdateCount == 0;
+	particlesUBO.previousView = firstUpdate ? view : particlesUBO.view;
+	particlesUBO.previousTime = firstUpdate ? time : particlesUBO.time;
+	particlesUBO.jitter = jitter;
 	particlesUBO.time = time;
 	particlesUBO.view = view;
 	particlesUBO.proj = proj;
+	bool sameViews = true;
+	for (int i = 0; i < MULTIVIEW_VIEWS; ++i) {
+		particlesUBO.views[i] = eyeViews ? eyeViews[i] : view;
+		sameViews &= particlesUBO.views[i] == uploadedUBO.views[i];
+	}
+
+	/// Distance LOD thresholds (a projected half size of 1 in ndc spans half the swapchain height)
+	particlesUBO.lodSize = settings.lodPixels * 2.f / (float)params.swapchainExtent.height;
+	particlesUBO.lodMinKeep = settings.lodMinKeep;
+
+	/// Read back the particles dropped by the distance LOD in the last frame rendered to this image (which has completed), and reset the counter for this frame
+	if (lodStatsBuffer) {
+		ParticleLodStats stats;
+		lodStatsBuffer->readBuffer(imageIndex, stats);
+		lodCulled = stats.culled * PARTICLE_LOD_COUNT_STRIDE;
+		lodStatsBuffer->copyBuffer(imageIndex, {});
+	}
+
+	/// Under a particle budget, only the first particles are drawn (a uniform random subset, as their attributes are hashed from their index), larger so that they cover the same area.
+	if (drawArgsBuffer) {
+		particlesUBO.particleCount = ParticleBudget::drawnCount(settings.particleCount);
+		particlesUBO.halfSize = settings.halfSize * sqrt((float)settings.particleCount / (float)particlesUBO.particleCount);
+	}
+
+	/// Check whether the UBO should be sent (settings may also have been changed from the UI since the last upload).
+	if (uboNoUpdateCount > 0 && sameSimulation(particlesUBO, uploadedUBO) && particlesUBO.view == uploadedUBO.view && particlesUBO.proj == uploadedUBO.proj &&
+		particlesUBO.previousView == uploadedUBO.previousView && particlesUBO.previousTime == uploadedUBO.previousTime && particlesUBO.jitter == uploadedUBO.jitter &&
+		particlesUBO.lodSize == uploadedUBO.lodSize && particlesUBO.lodMinKeep == uploadedUBO.lodMinKeep && sameViews) ++uboNoUpdateCount;
+	else uboNoUpdateCount = 1;
+	if (uboNoUpdateCount > uboBuffer->getBuffers().size()) return;// nothing to update.
+	uploadedUBO = particlesUBO;
 
 	/// Send to required shader(s).
-	if (settings.genMode == ParticleGenerationMode::ComputeGenExp) {
-		uboBuffer->copyBuffer(0, particlesUBO); // image index doesn't matter in Compute; there is only one UBO.
-	} else {
-		uboBuffer->copyBuffer(imageIndex, particlesUBO);
+	uboBuffer->copyBuffer(imageIndex, particlesUBO);
+	if (drawArgsBuffer) writeIndirectArgs(imageIndex);
+
+}
+
+void ParticleSystem::writeIndirectArgs(uint32_t imageIndex) {
+
+	/// Draws: the same split as cmdBind, each covering what remains of the particles drawn (possibly none)
+	uint32_t perCall = particlesPerDraw();
+	uint32_t drawn = particlesUBO.particleCount;
+	std::vector<VkDrawIndirectCommand> draws((settings.particleCount + perCall - 1) / perCall);
+	for (uint32_t call = 0; call < draws.size(); ++call) {
+		uint32_t count = drawn > call * perCall ? glm::min(perCall, drawn - call * perCall) : 0;
+		draws[call].vertexCount =	settings.genMode == ParticleGenerationMode::GeometryGenExp ?		(count + geometryParticlesPerVertex() - 1) / geometryParticlesPerVertex() :
+									settings.genMode == ParticleGenerationMode::VertexGenGeometryExp ?	count :
+																										count * verticesPerParticle();// 6 vertices / particle quad (or the cut-out polygon's triangles)
+		draws[call].instanceCount = 1;
+		draws[call].firstVertex = 0;
+		draws[call].firstInstance = 0;
+	}
+	drawArgsBuffer->copyBuffer(imageIndex, draws.data(), draws.size());
+
+	/// Dispatches: the same split as cmdBindCompute
+	if (computeFields && computeFields->dispatchArgsBuffer) {
+		std::vector<VkDispatchIndirectCommand> dispatches((settings.particleCount + PARTICLES_PER_CALL - 1) / PARTICLES_PER_CALL);
+		for (uint32_t call = 0; call < dispatches.size(); ++call) {
+			uint32_t count = drawn > call * PARTICLES_PER_CALL ? glm::min((uint32_t)PARTICLES_PER_CALL, drawn - call * PARTICLES_PER_CALL) : 0;
+			dispatches[call] = { (count + 255) / 256, 1, 1 };
+		}
+		computeFields->dispatchArgsBuffer->copyBuffer(imageIndex, dispatches.data(), dispatches.size());
 	}
 
 }
 
-void ParticleSystem::cmdBind(const VkCommandBuffer& cmdBuffer, int index) {
+void ParticleSystem::cmdBind(const VkCommandBuffer& cmdBuffer, int index, const VkFramebuffer& framebuffer) {
+
+	if (computeFields && computeFields->chunkSize > 0) {
+		cmdBindStreamed(cmdBuffer, index, framebuffer);
+		return;
+	}
+	if (cullPipeline) {
+		cmdBindCulled(cmdBuffer, index, framebuffer);
+		return;
+	}
 
 	graphicsDescriptor->cmdBind(cmdBuffer, index);
 	graphicsPipeline->cmdBind(cmdBuffer, index);
 
-	if (settings.genMode == ParticleGenerationMode::ComputeGenExp) {
-		VkDeviceSize offsets[1] = { 0 };
-		vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &computeFields->ssboBuffer->getBuffers()[0], offsets);
-		vkCmdDraw(cmdBuffer, settings.particleCount * 6, 1, 0, 0);// 6 vertices / particle quad.
-	} else if (settings.genMode == ParticleGenerationMode::VertexGenExp) {
-		vertexBufferMesh->cmdBind(cmdBuffer, index);
-		vkCmdDraw(cmdBuffer, settings.particleCount * 6, 1, 0, 0);// one call/vertex -> inconvenience of generating the same particle 6 times instead of once.
-	} else if (settings.genMode == ParticleGenerationMode::GeometryGenExp) {
-		int invocations = settings.particleCount / GEOMETRY_OUTPUT_PARTICLES_PER_VERTEX;
-		if ((float)invocations != (float)settings.particleCount / GEOMETRY_OUTPUT_PARTICLES_PER_VERTEX) ++invocations;// need one more invocation to cover all particles
-		vertexBufferMesh->cmdBind(cmdBuffer, index);
-		vkCmdDraw(cmdBuffer, invocations, 1, 0, 0);
-	} else if (settings.genMode == ParticleGenerationMode::VertexGenGeometryExp) {
-		vertexBufferMesh->cmdBind(cmdBuffer, index);
-		vkCmdDraw(cmdBuffer, settings.particleCount, 1, 0, 0);
-	} else {
-		throw std::runtime_error("Cannot cmd bind with unimplemented particles gen mode.");
+	vertexBufferMesh->cmdBind(cmdBuffer, index);
+
+	/// Split the particles in several draws, each given its range as push constants (vertex counts of a single draw would overflow for large particle counts)
+	uint32_t perCall = particlesPerDraw();
+	uint32_t calls = settings.particleCount / perCall;
+	if (calls * perCall != settings.particleCount) ++calls;// need one more call to cover all particles
+
+	for (uint32_t call = 0; call < calls; ++call) {
+
+		ParticleRange range = { call * perCall, glm::min(perCall, settings.particleCount - call * perCall), call * perCall, 0 };
+		graphicsDescriptor->cmdPushConstants(cmdBuffer, &range);
+
+		if (drawArgsBuffer) {
+			vkCmdDrawIndirect(cmdBuffer, drawArgsBuffer->getBuffers()[index], call * sizeof(VkDrawIndirectCommand), 1, sizeof(VkDrawIndirectCommand));// vertex count written by Update() under a particle budget
+		} else if (settings.genMode == ParticleGenerationMode::ComputeGenExp) {
+			vkCmdDraw(cmdBuffer, range.count * verticesPerParticle(), 1, 0, 0);// 6 vertices / particle quad (or the cut-out polygon's triangles), expanded from the SSBO written by the compute command buffer of the same index.
+		} else if (settings.genMode == ParticleGenerationMode::VertexGenExp) {
+			vkCmdDraw(cmdBuffer, range.count * verticesPerParticle(), 1, 0, 0);// one call/vertex -> inconvenience of generating the same particle 6 times (or more, for cut-out polygons) instead of once.
+		} else if (settings.genMode == ParticleGenerationMode::GeometryGenExp) {
+			uint32_t invocations = range.count / geometryParticlesPerVertex();
+			if (invocations * geometryParticlesPerVertex() != range.count) ++invocations;// need one more invocation to cover all particles
+			vkCmdDraw(cmdBuffer, invocations, 1, 0, 0);
+		} else if (settings.genMode == ParticleGenerationMode::VertexGenGeometryExp) {
+			vkCmdDraw(cmdBuffer, range.count, 1, 0, 0);
+		} else {
+			throw std::runtime_error("Cannot cmd bind with unimplemented particles gen mode.");
+		}
+
 	}
 
 }
 
-void ParticleSystem::cmdBindCompute(const VkCommandBuffer& cmdBuffer) {
-	if (settings.genMode == ParticleGenerationMode::ComputeGenExp) {
+void ParticleSystem::cmdBindStreamed(const VkCommandBuffer& cmdBuffer, int index, const VkFramebuffer& framebuffer) {
+
+	uint32_t chunkSize = computeFields->chunkSize;
+	uint32_t chunks = settings.particleCount / chunkSize;
+	if (chunks * chunkSize != settings.particleCount) ++chunks;// need one more chunk to cover all particles
+
+	for (uint32_t chunk = 0; chunk < chunks; ++chunk) {
+
+		int slot = index * STREAMING_RING_SLICES + chunk % STREAMING_RING_SLICES;// SSBO slice (and descriptor sets) used for this chunk
+		ParticleRange range = { chunk * chunkSize, glm::min(chunkSize, settings.particleCount - chunk * chunkSize), 0, 0 };// stored from the start of the slice
+
+		/// Dispatches cannot happen within a render pass: go through the remaining (empty) subpasses and end the current instance.
+		for (int i = 1; i < params.renderPass->getSubpassCount(); ++i) vkCmdNextSubpass(cmdBuffer, VK_SUBPASS_CONTENTS_INLINE);
+		params.renderPass->end(cmdBuffer);
+
+		/// The slice may still be read by the draw of a previous chunk
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, 0, NULL);
+
+		/// Generate the chunk
+		computeFields->descriptor->cmdBind(cmdBuffer, slot);
+		computeFields->pipeline->cmdBind(cmdBuffer, slot);
+		computeFields->descriptor->cmdPushConstants(cmdBuffer, &range);
+		vkCmdDispatch(cmdBuffer, (chunkSize + 255) / 256, 1, 1);// extra invocations of the last workgroup return early.
+
+		/// Make the chunk visible to the vertex shader, and attachments written so far visible to the next render pass instance
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INPUT_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+								VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		vkCmdPipelineBarrier(cmdBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			0, 1, &barrier, 0, NULL, 0, NULL);
+
+		/// Resume rendering and draw the chunk
+		params.continuationRenderPass->begin(cmdBuffer, framebuffer);
+		graphicsDescriptor->cmdBind(cmdBuffer, slot);
+		graphicsPipeline->cmdBind(cmdBuffer, slot);
+		graphicsDescriptor->cmdPushConstants(cmdBuffer, &range);
+		vertexBufferMesh->cmdBind(cmdBuffer, slot);
+		vkCmdDraw(cmdBuffer, range.count * verticesPerParticle(), 1, 0, 0);// 6 vertices / particle quad (or the cut-out polygon's triangles).
 
-		/// Add memory barrier for the graphics shaders to fetch attribs before writing to compute buffer
-		VkBufferMemoryBarrier barrier = {};
-		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
-		barrier.pNext = NULL;
-		barrier.buffer = computeFields->ssboBuffer->getBuffers()[0];
-		barrier.size = sizeof(ComputeSSBO);
-		barrier.srcAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
-		barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-		barrier.srcQueueFamilyIndex = devices->getGraphicsQueueFamily();
-		barrier.dstQueueFamilyIndex = devices->getComputeQueueFamily();
-		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 1, &barrier, 0, NULL);
-
-		/// Dispatch command buffer
-		computeFields->descriptor->cmdBind(cmdBuffer, 0);
-		computeFields->pipeline->cmdBind(cmdBuffer, 0);
-		int invocations = settings.particleCount / 256;
-		if ((float)invocations != (float)settings.particleCount / 256.f) ++invocations;// need one more invocation to cover all particles
-		vkCmdDispatch(cmdBuffer, invocations, 1, 1);
-
-		// Ensure compute shader has finished writing to the buffer
-		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-		barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
-		barrier.srcQueueFamilyIndex = devices->getComputeQueueFamily();
-		barrier.dstQueueFamilyIndex = devices->getGraphicsQueueFamily();
-		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, NULL, 1, &barrier, 0, NULL);
+	}
+
+}
+
+void ParticleSystem::cmdBindCulled(const VkCommandBuffer& cmdBuffer, int index, const VkFramebuffer& framebuffer) {
+
+	/// Dispatches cannot happen within a render pass: go through the remaining (empty) subpasses and end the current instance, where the meshes were drawn.
+	for (int i = 1; i < params.renderPass->getSubpassCount(); ++i) vkCmdNextSubpass(cmdBuffer, VK_SUBPASS_CONTENTS_INLINE);
+	params.renderPass->end(cmdBuffer);
+
+	/// Furthest depth of the meshes, at every level
+	int levels = params.hiZ->cmdBuild(cmdBuffer, index);
+
+	/// Empty list (the list of this image was last read by its previous frame, which has completed), then visible to the culling pass
+	uint32_t emptyList[PARTICLE_VISIBLE_HEADER] = { 0, 1, 0, 0, 0 };// no vertices, one instance; no visible particles
+	vkCmdUpdateBuffer(cmdBuffer, visibleBuffer->getBuffers()[index], 0, sizeof(emptyList), emptyList);
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, NULL, 0, NULL);
+
+	/// List the visible particles, in calls of at most PARTICLES_PER_CALL particles (workgroup counts are limited); the draw grows by one vertex per
+	/// visible particle in vert/geom, one per batch of visible particles in geom/geom, and 6 per visible particle otherwise
+	VkExtent2D renderArea = params.hiZ->getRenderArea();
+	CullConstants constants = {};
+	constants.renderArea = glm::ivec2(renderArea.width, renderArea.height);
+	constants.levels = levels;
+	constants.verticesPerParticle = settings.genMode == ParticleGenerationMode::GeometryGenExp || settings.genMode == ParticleGenerationMode::VertexGenGeometryExp ? 1 : verticesPerParticle();
+	constants.particlesPerVertex = settings.genMode == ParticleGenerationMode::GeometryGenExp ? geometryParticlesPerVertex() : 1;
+	cullDescriptor->cmdBind(cmdBuffer, index);
+	cullPipeline->cmdBind(cmdBuffer, index);
+	uint32_t calls = settings.particleCount / PARTICLES_PER_CALL;
+	if (calls * PARTICLES_PER_CALL != settings.particleCount) ++calls;// need one more call to cover all particles
+	for (uint32_t call = 0; call < calls; ++call) {
+		constants.firstParticle = call * PARTICLES_PER_CALL;
+		constants.count = glm::min((uint32_t)PARTICLES_PER_CALL, settings.particleCount - call * PARTICLES_PER_CALL);
+		cullDescriptor->cmdPushConstants(cmdBuffer, &constants);
+		vkCmdDispatch(cmdBuffer, (constants.count + 255) / 256, 1, 1);
+	}
+
+	/// Make the list visible to the draw, and attachments written so far visible to the next render pass instance
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INPUT_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+							VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	vkCmdPipelineBarrier(cmdBuffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+		0, 1, &barrier, 0, NULL, 0, NULL);
+
+	/// Resume rendering, and draw the visible particles in a single call (the list holds the global index of each)
+	params.continuationRenderPass->begin(cmdBuffer, framebuffer);
+	graphicsDescriptor->cmdBind(cmdBuffer, index);
+	graphicsPipeline->cmdBind(cmdBuffer, index);
+	ParticleRange range = { 0, settings.particleCount, 0, 1 };
+	graphicsDescriptor->cmdPushConstants(cmdBuffer, &range);
+	vertexBufferMesh->cmdBind(cmdBuffer, index);
+	vkCmdDrawIndirect(cmdBuffer, visibleBuffer->getBuffers()[index], 0, 1, sizeof(VkDrawIndirectCommand));// vertex count written by the culling pass
+
+}
+
+void ParticleSystem::cmdBindCompute(const VkCommandBuffer& cmdBuffer, int index) {
+	if (settings.genMode == ParticleGenerationMode::ComputeGenExp && computeFields->chunkSize == 0) {// when streaming, generation is recorded in the graphics command buffers instead.
+
+		/// No barriers needed around the dispatch: the SSBO for this index is only reused once the frame that last read it has finished (in-flight fences),
+		/// and the graphics submission waits on the compute semaphore at the vertex shader stage before reading it.
+
+		/// Dispatch command buffer, split in calls of at most PARTICLES_PER_CALL particles (workgroup counts are limited)
+		computeFields->descriptor->cmdBind(cmdBuffer, index);
+		computeFields->pipeline->cmdBind(cmdBuffer, index);
+		uint32_t calls = settings.particleCount / PARTICLES_PER_CALL;
+		if (calls * PARTICLES_PER_CALL != settings.particleCount) ++calls;// need one more call to cover all particles
+		for (uint32_t call = 0; call < calls; ++call) {
+			ParticleRange range = { call * PARTICLES_PER_CALL, glm::min((uint32_t)PARTICLES_PER_CALL, settings.particleCount - call * PARTICLES_PER_CALL), call * PARTICLES_PER_CALL, 0 };
+			computeFields->descriptor->cmdPushConstants(cmdBuffer, &range);
+			if (computeFields->dispatchArgsBuffer) {
+				vkCmdDispatchIndirect(cmdBuffer, computeFields->dispatchArgsBuffer->getBuffers()[index], call * sizeof(VkDispatchIndirectCommand));// workgroup count written by Update() under a particle budget
+				continue;
+			}
+			uint32_t invocations = range.count / 256;
+			if (invocations * 256 != range.count) ++invocations;// need one more invocation to cover all particles
+			vkCmdDispatch(cmdBuffer, invocations, 1, 1);
+		}
 
 	}// in other generation modes, nothing to query the Compute pipeline.
 }
 
+bool ParticleSystem::computeRequired(uint32_t imageIndex) {
+
+	if (settings.genMode != ParticleGenerationMode::ComputeGenExp || computeFields->chunkSize > 0) return false;// nothing is recorded in the compute command buffers.
+
+	/// The SSBO for this index is still valid if it was generated with the same simulation state; only the camera may have moved.
+	if (computeFields->generated[imageIndex] && sameSimulation(computeFields->generatedStates[imageIndex], particlesUBO)) return false;
+
+	computeFields->generated[imageIndex] = true;
+	computeFields->generatedStates[imageIndex] = particlesUBO;
+	return true;
+}
+
 ParticleSystem* ParticleSystem::UI(ParticleSystem* particles, bool& rebuild) {
 
 	rebuild = false;
@@ -349,6 +1131,64 @@ ParticleSystem* ParticleSystem::UI(ParticleSystem* particles, bool& rebuild) {
 	if (setParticlesCutout(cutout)) {
 		rebuild = true;// force a swapchain rebuild to use newly compiled shaders
 	}
+
+	/// Cut-out polygons or quads (cut-out particles only), with the fragments rasterized and kept relative to quads
+	if (settings.cutout) {
+		bool hull = ParticleSystem::settings.hull;
+		ImGui::Checkbox("Fit Cut-out Polygons", &hull);
+		if (hull != ParticleSystem::settings.hull && setParticlesHull(hull)) {
+			rebuild = true;// force a rebuild to use newly compiled shaders (and fit the polygon)
+		}
+		if (usesHull()) ImGui::Text("Fragments: %.1f%% of quads (%.1f%% kept)", 100.f * particles->hullArea, 100.f * particles->opaqueArea);
+	}
+
+	/// Baked static attributes or not
+	bool baked = ParticleSystem::settings.bakeStatics;
+	ImGui::Checkbox("Bake Static Attributes", &baked);
+	if (baked != ParticleSystem::settings.bakeStatics && setParticlesBaked(baked)) {
+		rebuild = true;// force a rebuild to use newly compiled shaders (and create or drop the baked SSBO)
+	}
+	if (baked && !particles->particlesUBO.staticsBaked) ImGui::Text("Over the memory budget: hashed in the shaders");
+
+	/// Sprite cache or not (complexity levels 1 and 3 only); the resolution is applied once the slider is released
+	if (settings.complexity == 1 || settings.complexity == 3) {
+		bool cached = ParticleSystem::settings.spriteCache;
+		ImGui::Checkbox("Cache Particle Sprite", &cached);
+		if (cached != ParticleSystem::settings.spriteCache && setParticlesSpriteCache(cached)) {
+			rebuild = true;// force a rebuild to use newly compiled shaders (and create or drop the sprite cache)
+		}
+		if (cached) {
+			static int resolution = PARTICLE_SPRITE_DEFAULT_RESOLUTION;// value being edited
+			ImGui::SliderInt("Sprite Resolution", &resolution, 16, PARTICLE_SPRITE_MAX_RESOLUTION);
+			if (ImGui::IsItemDeactivatedAfterEdit()) {
+				setSpriteResolution(resolution);
+				rebuild = true;// the sprite is re-baked by the new particle system, and the V-Buffer lighting pass samples it
+			} else if (!ImGui::IsItemActive()) {
+				resolution = settings.spriteResolution;
+			}
+		}
+	}
+
+	/// Distance LOD; its thresholds apply from the next frame, and the particles it dropped are read back from the last frame of each image
+	bool lod = ParticleSystem::settings.lod;
+	if (settings.lodSupported) ImGui::Checkbox("Distance LOD", &lod);
+	if (lod != ParticleSystem::settings.lod && setParticlesLod(lod)) {
+		rebuild = true;// force a rebuild to use newly compiled shaders (and bind or drop the culled particles counter)
+	}
+	if (lod) {
+		ImGui::SliderFloat("LOD Size (px)", &settings.lodPixels, 0.25f, 8.f, "%.2f");
+		ImGui::SliderFloat("LOD Min Kept", &settings.lodMinKeep, 0.01f, 1.f, "%.2f");
+		uint32_t drawn = particles->particlesUBO.particleCount;
+		ImGui::Text("LOD culled: ~%u of %u (%.1f%%)", particles->lodCulled, drawn, drawn > 0 ? 100.f * particles->lodCulled / drawn : 0.f);
+	}
+
+	/// Occlusion culling against the depth pyramid of the meshes (not while streaming); scenes chain their render passes around the culling pass
+	bool occlusion = settings.occlusionCulling;
+	ImGui::Checkbox("Occlusion Culling", &occlusion);
+	if (occlusion != settings.occlusionCulling) {
+		setOcclusionCulling(occlusion);
+		rebuild = true;// scene render passes need (or no longer need) chaining, and the depth pyramid
+	}
 	
 	/// Drop-down list for gen mode
 	static const char* genModes[] = { "VertexGenExp", "ComputeGenExp", "GeometryGenExp", "VertexGenGeometryExp" };
@@ -362,8 +1202,10 @@ ParticleSystem* ParticleSystem::UI(ParticleSystem* particles, bool& rebuild) {
 					ParticlesConstructorParams args = particles->getConstructorParams();
 					vkDeviceWaitIdle(*particles->getDevices()());
 					delete particles;
+					bool wasStreaming = isStreaming();
 					settings.genMode = (ParticleGenerationMode)i;
 					particles = new ParticleSystem(args);
+					if (wasStreaming != isStreaming()) rebuild = true;// scene render passes need (or no longer need) chaining
 				}
 			}
 			if (isSelected) {
@@ -373,9 +1215,18 @@ ParticleSystem* ParticleSystem::UI(ParticleSystem* particles, bool& rebuild) {
 		ImGui::EndCombo();
 	}// Particles gen mode dropdown.
 
-	/// Particle count editor
+	/// Particle count editor; large scale mode edits the count in millions, applied once the slider is released (regenerating that many comp/comp particles is slow)
+	static bool largeScale = particles->getParticleCount() > 1024 * 1024 * 4;
+	ImGui::Checkbox("Large Scale", &largeScale);
 	int pCount = particles->getParticleCount();
-	ImGui::SliderInt("Count##particlecount", &pCount, 16, 1024*1024*4);
+	if (largeScale) {
+		static int pCountM = 1;// value being edited
+		ImGui::SliderInt("Count (M)##particlecount", &pCountM, 1, LARGE_SCALE_MAX_PARTICLES_M);
+		if (ImGui::IsItemDeactivatedAfterEdit()) pCount = pCountM * 1024 * 1024;
+		else if (!ImGui::IsItemActive()) pCountM = glm::max(1, pCount / (1024 * 1024));
+	} else {
+		ImGui::SliderInt("Count##particlecount", &pCount, 16, 1024 * 1024 * 4);
+	}
 	if (pCount != particles->getParticleCount()) {
 		// select this new particle count.
 		ParticlesConstructorParams args = particles->getConstructorParams();
@@ -385,6 +1236,25 @@ ParticleSystem* ParticleSystem::UI(ParticleSystem* particles, bool& rebuild) {
 		particles = new ParticleSystem(args);
 	}// particle count edit
 
+	/// Streaming in chunks (Compute mode only); changes will rebuild the scene as its render passes depend on it
+	if (settings.genMode == ParticleGenerationMode::ComputeGenExp) {
+		bool stream = settings.streamBudgetMB > 0;
+		if (ImGui::Checkbox("Stream In Chunks", &stream)) {
+			settings.streamBudgetMB = stream ? STREAMING_DEFAULT_BUDGET_MB : 0;
+			rebuild = true;
+		}
+		if (stream) {
+			static int budget = STREAMING_DEFAULT_BUDGET_MB;// value being edited
+			ImGui::SliderInt("Stream Budget (MB)", &budget, 1, 512);
+			if (ImGui::IsItemDeactivatedAfterEdit()) {// only rebuild once the slider is released
+				settings.streamBudgetMB = budget;
+				rebuild = true;
+			} else if (!ImGui::IsItemActive()) {
+				budget = settings.streamBudgetMB;
+			}
+		}
+	}// streaming
+
 	if(ImGui::SliderFloat("Particle Half Size", &settings.halfSize, 0.005f, 0.5f))
 		particles->particlesUBO.halfSize = settings.halfSize;
 
@@ -12,12 +12,23 @@
 #include "Texture.h"
 
 
+class HiZPyramid;
+
+
 #define INITIAL_PARTICLE_COUNT 1024 * 1024 // start-up particle count (unless specified in command-line arguments)
 #define INITIAL_PARTICLE_GEN_MODE ParticleGenerationMode::VertexGenExp // start-up generation mode (unless specified in command-line arguments)
 
 
 
 #define GEOMETRY_OUTPUT_PARTICLES_PER_VERTEX 28 // In Geometry generation mode, the amount of particles created by each geometry shader call - must match the value in particles.geom
+#define GEOMETRY_OUTPUT_HULLS_PER_VERTEX 14 // Same, for particles drawn as cut-out polygons (as many vertices as 28 quads) - must match the value in particles.geom
+#define PARTICLE_HULL_VERTICES 8 // corners of the polygon fitted to the opaque region of cut-out particles (see usesHull()) - must match Shaders/particles.glsl and quadexpand.geom
+
+
+
+#define PARTICLES_PER_CALL (1 << 23) // maximum amount of particles per draw/dispatch: keeps vertex indices (6 per particle) well within 32 bits, and dispatches within the 65535 workgroups guaranteed by the spec.
+#define PARTICLES_SSBO_HEAP_FRACTION 0.5 // comp/comp particles that aren't streamed may take at most this fraction of the device-local heap (count is reduced otherwise)
+#define LARGE_SCALE_MAX_PARTICLES_M 256 // upper bound of the particle count slider in large scale mode (in millions)
 
 
 
@@ -25,6 +36,27 @@
 
 
 
+#define STREAMING_RING_SLICES 2 // when streaming comp/comp particles in chunks, amount of SSBO slices per swapchain image that chunks cycle through
+#define STREAMING_DEFAULT_BUDGET_MB 32 // memory budget used when enabling streaming from the UI
+
+
+
+#define PARTICLE_SPRITE_DEFAULT_RESOLUTION 256 // width & height of the sprite cache unless specified in command-line arguments
+#define PARTICLE_SPRITE_MAX_RESOLUTION 2048 // upper bound of the sprite resolution slider
+
+
+
+#define PARTICLE_LOD_DEFAULT_PIXELS 2.0f // projected half size (in pixels) below which the distance LOD drops particles, unless specified in command-line arguments
+#define PARTICLE_LOD_DEFAULT_MIN_KEEP 0.125f // lowest fraction of the particles kept by the distance LOD
+#define PARTICLE_LOD_COUNT_STRIDE 16 // one particle out of this many counts when dropped by the distance LOD (must match Shaders/particles.glsl)
+
+
+
+#define PARTICLE_VISIBLE_HEADER 5 // uints ahead of the particle indices in the visible list of the occlusion culling: indirect draw arguments, then the visible count (must match Shaders/particles.glsl)
+#define PARTICLE_COVERAGE_MASK_SIZE 64 // cells along each side of the coverage mask tested by cut-out particles in the V-Buffer (must match Shaders/particles_frag.glsl)
+
+
+
 /// The mode with which to generate the particles
 enum ParticleGenerationMode {
 	VertexGenExp = 0,			// Call vertex shader 6 times the amount of particle, each call generating one vertex of a particle quad.
@@ -39,7 +71,8 @@ enum ParticleRenderingMode {
 	ForwardRen,		// Forward Rendering
 	DeferredG3Ren,	// Deferred Rendering with 3 framebuffers forming the G-Buffer
 	DeferredG6Ren,	// Deferred Rendering with 6 framebuffers forming the G-Buffer
-	DeferredVRen	// Deferred Rendering with Visibility Buffer
+	DeferredVRen,	// Deferred Rendering with Visibility Buffer
+	ForwardOITRen	// Forward Rendering into the accumulation and coverage of weighted blended transparency (see ParticleOIT.h)
 };// enum ParticleRenderingMode
 
 
@@ -48,11 +81,21 @@ struct ParticleSystemSettings {
 	unsigned int particleCount = INITIAL_PARTICLE_COUNT;
 	int complexity = UNDEFINED_PARTICLE_COMPLEXITY;// complexity level of fragment shader used on particles (initialized depending on value in file __.defines)
 	bool cutout = false;// whether to use cutout-style particles (mirrors value in __.defines file).
+	bool bakeStatics = true;// whether time-invariant particle attributes are baked once into an SSBO instead of recomputed by every invocation (mirrors value in __.defines file).
+	bool spriteCache = false;// whether complexity levels 1 and 3 sample a sprite shaded once instead of shading every fragment (mirrors value in __.defines file).
+	unsigned int spriteResolution = PARTICLE_SPRITE_DEFAULT_RESOLUTION;// width & height of the sprite cache
+	bool lod = false;// whether distant particles are dropped by the distance LOD (mirrors value in __.defines file).
+	bool lodSupported = true;// whether the device supports the distance LOD, which counts the particles it drops from the vertex or geometry stage (see checkSupport())
+	bool hull = false;// whether cut-out particles are drawn as polygons fitted to their opaque region instead of quads (mirrors value in __.defines file).
+	float lodPixels = PARTICLE_LOD_DEFAULT_PIXELS;// projected half size, in pixels, below which the distance LOD drops particles
+	float lodMinKeep = PARTICLE_LOD_DEFAULT_MIN_KEEP;// lowest fraction of the particles the distance LOD keeps
+	bool occlusionCulling = false;// whether scenes supporting it cull the particles against the depth of their meshes (see usesOcclusionCulling())
 	ParticleGenerationMode genMode = INITIAL_PARTICLE_GEN_MODE;
 	float halfSize = 0.03f;// half the size of each particle, in view space
 	float density = 0.4f;// how packed together the particles are
 	float gravity = 0.f;
 	float initialUpwardsForce = 0.f;
+	unsigned int streamBudgetMB = 0;// in Compute mode, caps the memory used by the generated particles by streaming them in chunks (0: no streaming)
 };// struct ParticleSystemSettings
 
 
@@ -69,16 +112,67 @@ class ParticleSystem {
 		float density;
 		float gravity;
 		float initialUpwardsForce;
-		uint32_t particleCount;// amount of particles that should be generated
+		uint32_t particleCount;// amount of particles that should be generated (fewer than settings.particleCount under a particle budget)
+		alignas(16) glm::mat4 previousView;// view matrix of the previous frame (motion vectors)
+		float previousTime;// time of the previous frame (motion vectors)
+		alignas(8) glm::vec2 jitter;// sub-pixel offset of the frame, in clip space (temporal upscaling)
+		float lodSize;// projected half size (ndc) below which the distance LOD drops particles
+		float lodMinKeep;// lowest fraction of the particles kept by the distance LOD
+		uint32_t staticsBaked;// 1 -> shaders read the baked statics back; 0 -> they hash them (see bakeStatics())
+		alignas(16) glm::vec4 hull[PARTICLE_HULL_VERTICES / 2];// corners of the cut-out polygon (quad uv multipliers, -1..1), two per element in triangle strip order (see usesHull())
+		alignas(16) glm::mat4 views[MULTIVIEW_VIEWS];// view matrix of each eye in multiview stereo, only used to project the particles (generation, LOD and culling use view)
 	} particlesUBO;// struct ParticlesUBO
+	ParticlesUBO uploadedUBO;// last state sent to the UBOs, to detect changes made from Update() as well as from the UI.
 	int uboNoUpdateCount = 0;
 
-	/// The SSBO with the position data to get as output from the compute shader in Compute generation mode
+	/// The SSBO with the particle data to get as output from the compute shader in Compute generation mode
 	struct ComputeSSBO {
-		glm::vec4 position_nX;	// rgb: particle position in screen space; a: unused (normal.x)
-		glm::vec4 nYZ_uv;		// rg: unused (normal.yz); ba: particle quad UVs
+		glm::vec4 position_halfSize;	// xyz: particle center in world space; w: particle half size (view/projection are applied in the vertex shader)
 	};// struct ComputeSSBO
 
+	/// Push constants sent to the particle shaders: range of particles covered by a single draw or dispatch (see PARTICLES_PER_CALL)
+	struct ParticleRange {
+		uint32_t firstParticle;// index of the first particle of the call
+		uint32_t count;// amount of particles in the call
+		uint32_t firstElement;// comp/comp only: index in the bound SSBO (or SSBO slice when streaming) where the call's particles are stored
+		uint32_t visibleList = 0;// 1 -> the call draws the particles listed by the occlusion culling instead of its range
+	};// struct ParticleRange
+
+	/// Push constants of the occlusion culling (same layout as Shaders/particles_cull.comp)
+	struct CullConstants {
+		uint32_t firstParticle;// range of particles culled by the dispatch
+		uint32_t count;
+		glm::ivec2 renderArea;// pixels of the depth buffer covered by the pyramid
+		int32_t levels;// levels of the pyramid
+		uint32_t verticesPerParticle;// vertices drawn every particlesPerVertex visible particles
+		uint32_t particlesPerVertex;
+	};// struct CullConstants
+
+	/// Particles dropped by the distance LOD over a frame, out of a sample of 1 in PARTICLE_LOD_COUNT_STRIDE (same layout as Shaders/particles.glsl)
+	struct ParticleLodStats {
+		uint32_t culled;
+	};// struct ParticleLodStats
+
+	/// 1 bit of coverage per cell of the cut-out texture (row-major, 32 cells per uint), tested by the V-Buffer first pass instead of sampling the texture
+	/// (same layout as Shaders/particles_frag.glsl; uvec4 as std140 pads array elements to 16 bytes)
+	struct ParticleCoverageMask {
+		glm::uvec4 words[PARTICLE_COVERAGE_MASK_SIZE * PARTICLE_COVERAGE_MASK_SIZE / 128];
+	};// struct ParticleCoverageMask
+
+	/// Time-invariant attributes of a particle baked by particles_bake.comp: direction (xyz) and lifetime offset (w), at the precision of particleStatics() in particles_statics.glsl
+	struct ParticleStatics {
+		glm::vec4 statics;
+	};// struct ParticleStatics
+
+	/// Push constant stages used by the graphics pipeline in the current generation mode
+	static VkShaderStageFlags rangeStages();
+
+	/// Maximum amount of particles drawn by a single draw call in the current generation mode (PARTICLES_PER_CALL, in whole geometry shader batches)
+	static uint32_t particlesPerDraw();
+
+	/// Returns whether both UBOs would make the particle simulation produce the same results (ie. ignoring view and projection)
+	static bool sameSimulation(const ParticlesUBO& a, const ParticlesUBO& b);
+
 
 
 	/// Modes with which to generate and render the particles
@@ -93,15 +187,59 @@ class ParticleSystem {
 	Descriptor* graphicsDescriptor;// descriptor for the graphics pipeline.
 	Mesh_Base<NulVertex>* vertexBufferMesh = NULL;// need a dummy vertex buffer bound before calling vkCmdDraw according to Vulkan spec, even if we're not using the data.
 	Texture* particlesTexture = NULL;// optional texture applied to particles in certain complexity modes.
+	UniformBuffer<ParticleCoverageMask>* coverageMaskBuffer = NULL;// coverage of the cut-out texture, bound in its place for cut-out particles in the V-Buffer (NULL otherwise); shared by all swapchain images as it is never written after creation.
+	UniformBuffer<ParticleStatics>* staticsBuffer = NULL;// baked static attributes of every particle (NULL unless settings.bakeStatics; a single placeholder element when they cannot be baked); shared by all swapchain images as it is never written after the bake.
+	Texture* spriteCache = NULL;// shaded particle sprite (NULL unless usesSpriteCache()); shared by all swapchain images as it is never written after the bake.
+	UniformBuffer<ParticleLodStats>* lodStatsBuffer = NULL;// culled particles counter of the distance LOD (NULL unless settings.lod), one per swapchain image as they are read back by the host.
+	uint32_t lodCulled = 0;// estimate of the particles dropped by the distance LOD in the last frame read back
+	float hullArea = 1.f;// fraction of the quad covered by the cut-out polygon (rasterized fragments relative to quads)
+	float opaqueArea = 1.f;// fraction of the quad where the cut-out texture is opaque (fragments kept by the cut-out test)
+	UniformBuffer<VkDrawIndirectCommand>* drawArgsBuffer = NULL;// under a particle budget (see ParticleBudget), arguments of each draw call, written with the UBO of each image; NULL otherwise.
+	UniformBuffer<uint32_t>* visibleBuffer;// visible list of the occlusion culling, one per swapchain image (PARTICLE_VISIBLE_HEADER uints, then the particle indices); a placeholder never read when not culling.
+	Descriptor* cullDescriptor = NULL;// occlusion culling pass (NULL unless the particles are culled)
+	ComputePipeline* cullPipeline = NULL;
 
 	// Fields used for Compute Generation Mode only
 	struct ComputeFields {
 		ComputePipeline* pipeline;// compute shader used to generate the particles.
 		Descriptor* descriptor;// descriptor set for the compute pipeline
-		UniformBuffer<ComputeSSBO>*	ssboBuffer;// SSBO sent to (received from) the compute shader calls.
+		UniformBuffer<ComputeSSBO>*	ssboBuffer;// SSBOs sent to (received from) the compute shader calls; one per swapchain image so compute can generate the next frame while the current one is rasterized.
+		std::vector<ParticlesUBO> generatedStates;// simulation state each SSBO was last generated with
+		std::vector<bool> generated;// whether each SSBO holds valid data yet
+		uint32_t chunkSize = 0;// when streaming: amount of particles in each chunk / SSBO slice (ssboBuffer then holds STREAMING_RING_SLICES slices per swapchain image); 0 otherwise.
+		UniformBuffer<VkDispatchIndirectCommand>* dispatchArgsBuffer = NULL;// under a particle budget, arguments of each dispatch (as drawArgsBuffer); NULL otherwise.
 	};// struct ComputeFields
 	ComputeFields* computeFields = NULL;// will be NULL unless generation mode is set to Compute.
 
+	/// Returns the largest amount of particles (multiple of 256) that fits in `buffers` storage buffers of bytesPerParticle bytes per particle on the device
+	/// (within PARTICLES_SSBO_HEAP_FRACTION of the device-local heap, and within the size a single storage buffer may be bound with)
+	uint64_t affordableParticles(uint32_t buffers, uint32_t bytesPerParticle) const;
+
+	/// Creates staticsBuffer and fills it with a one-time compute dispatch (blocking); over the memory budget, only creates a placeholder and has the shaders hash the statics
+	void bakeStatics();
+
+	/// Creates spriteCache and shades it with a one-time compute dispatch (blocking); leaves it readable by fragment and compute shaders
+	void bakeSprite();
+
+	/// Fits a convex polygon of at most PARTICLE_HULL_VERTICES corners, within the quad, around the texels of an image whose alpha may filter to 0.5 or more;
+	/// writes its corners to particlesUBO.hull and the fraction of the quad it covers to hullArea (the full quad if no such polygon is found)
+	void buildHull(const std::string& path);
+
+	/// Recompiles the particle generation stages (vertex and geometry shaders of all generation modes)
+	static void compileGenerationShaders();
+
+	/// Thresholds the alpha of an image at 0.5 over each cell of a coverage mask (alpha averaged over the texels of the cell, as a filtered sample would)
+	static ParticleCoverageMask buildCoverageMask(const std::string& path);
+
+	/// Writes the indirect draw (and dispatch) arguments of an image, covering the first particlesUBO.particleCount particles (under a particle budget)
+	void writeIndirectArgs(uint32_t imageIndex);
+
+	/// Records the chunked generation & drawing of particles when streaming (see cmdBind)
+	void cmdBindStreamed(const VkCommandBuffer& cmdBuffer, int index, const VkFramebuffer& framebuffer);
+
+	/// Records the depth pyramid, the occlusion culling and the indirect draw of the visible particles (see cmdBind)
+	void cmdBindCulled(const VkCommandBuffer& cmdBuffer, int index, const VkFramebuffer& framebuffer);
+
 public:
 
 	// Keep the constructor params that the particleSystem was generated with.
@@ -114,13 +252,17 @@ public:
 		RenderPass* renderPass;
 		VkCommandPool commandPool;
 		VkSampler sampler;
+		RenderPass* continuationRenderPass;// chained continuation of renderPass used when streaming particles in chunks (see isStreaming()); may be NULL
+		bool motionVectors = false;// G-Buffer renderers only: renderPass has a velocity attachment after the G-Buffers, written by the particles (see TemporalUpscaler)
+		bool compactGBuffer = false;// G-Buffer renderers only: renderPass has the compact layout, without the position attachment (see GBufferScene::usesCompactLayout())
+		HiZPyramid* hiZ = NULL;// depth pyramid of the meshes drawn before the particles, against which they are culled (see usesOcclusionCulling()); may be NULL
 
 		// shorthand for creating the params
 		ParticlesConstructorParams(ParticleRenderingMode rMode, DevicesPtr devices, const VkDescriptorPool* descriptorPool, uint32_t swapchainSize,
-			VkExtent2D swapchainExtent, RenderPass* renderPass, VkCommandPool commandPool, VkSampler sampler)
+			VkExtent2D swapchainExtent, RenderPass* renderPass, VkCommandPool commandPool, VkSampler sampler, RenderPass* continuationRenderPass = NULL)
 			:
 			rMode(rMode), devices(devices), descriptorPool(descriptorPool), swapchainSize(swapchainSize),
-			swapchainExtent(swapchainExtent), renderPass(renderPass), commandPool(commandPool), sampler(sampler)
+			swapchainExtent(swapchainExtent), renderPass(renderPass), commandPool(commandPool), sampler(sampler), continuationRenderPass(continuationRenderPass)
 		{ }
 
 	};// struct ParticlesConstructorParams
@@ -132,6 +274,53 @@ public:
 	/// Resets whether the particles in complexity mode 2 will use a cutout-style shader (false -> fully opaque)
 	static bool setParticlesCutout(bool cutout, bool noRecompile = false);
 
+	/// Resets whether particles read their time-invariant attributes from a baked SSBO (false -> recomputed in each invocation); will re-compile the particle shaders
+	static bool setParticlesBaked(bool baked, bool noRecompile = false);
+
+	/// Resets whether particles in complexity modes 1 and 3 sample a sprite cache (false -> shaded per fragment); will re-compile the particle shaders
+	static bool setParticlesSpriteCache(bool cached, bool noRecompile = false);
+
+	/// Resets whether distant particles are dropped by the distance LOD (false -> every particle is drawn); will re-compile the particle shaders
+	static bool setParticlesLod(bool lod, bool noRecompile = false);
+
+	/// Checks the device features the particle settings rely on, turning off (and recompiling the shaders of) those it lacks; call before creating particle systems
+	static void checkSupport(DevicesPtr devices);
+
+	/// Resets whether cut-out particles are drawn as polygons fitted to the opaque region of their texture (false -> quads); will re-compile the particle shaders
+	static bool setParticlesHull(bool hull, bool noRecompile = false);
+
+	/// Returns whether particles are drawn as cut-out polygons with the current settings
+	static inline bool usesHull() { return settings.hull && settings.cutout; }
+
+	/// Returns the vertices drawn for each particle in vert/vert and comp/comp: a quad, or the triangles of the strip of the cut-out polygon
+	static inline uint32_t verticesPerParticle() { return usesHull() ? 3 * (PARTICLE_HULL_VERTICES - 2) : 6; }
+
+	/// Returns the particles output by each geometry shader call in geom/geom
+	static inline uint32_t geometryParticlesPerVertex() { return usesHull() ? GEOMETRY_OUTPUT_HULLS_PER_VERTEX : GEOMETRY_OUTPUT_PARTICLES_PER_VERTEX; }
+
+	/// Resets the projected half size, in pixels, below which the distance LOD drops particles
+	static inline void setLodSize(float pixels) { settings.lodPixels = glm::max(pixels, 0.01f); }
+
+	/// Resets the width & height of the sprite cache; applies to particle systems created afterwards
+	static inline void setSpriteResolution(unsigned int resolution) { settings.spriteResolution = glm::clamp(resolution, 1u, (unsigned int)PARTICLE_SPRITE_MAX_RESOLUTION); }
+
+	/// Returns whether particles sample a sprite cache with the current settings
+	static inline bool usesSpriteCache() { return settings.spriteCache && (settings.complexity == 1 || settings.complexity == 3); }
+
+	/// Returns whether particles are streamed in chunks (Compute mode with a memory budget); the scene must then create its render pass with
+	/// RenderPass::Chaining::First, and provide a RenderPass::Chaining::Continuation version of it in the constructor params.
+	static inline bool isStreaming() { return settings.genMode == ParticleGenerationMode::ComputeGenExp && settings.streamBudgetMB > 0; }
+
+	/// Returns whether particles are drawn with a geometry shader (geom/geom and vert/geom generation modes)
+	static inline bool usesGeometryShader() { return settings.genMode == ParticleGenerationMode::GeometryGenExp || settings.genMode == ParticleGenerationMode::VertexGenGeometryExp; }
+
+	/// Resets whether particles are culled against the depth of the meshes drawn before them; applies to scenes created afterwards
+	static inline void setOcclusionCulling(bool culled) { settings.occlusionCulling = culled; }
+
+	/// Returns whether particles are culled against the depth of the meshes (never when streaming); the scene must then create its render pass with
+	/// RenderPass::Chaining::First, a HiZPyramid, and provide both the pyramid and a RenderPass::Chaining::Continuation version of the render pass in the constructor params.
+	static inline bool usesOcclusionCulling() { return settings.occlusionCulling && !isStreaming(); }
+
 protected:
 	ParticlesConstructorParams params;
 public:
@@ -142,14 +331,23 @@ public:
 	/// Clean up routine
 	virtual ~ParticleSystem();
 
-	/// Update the particle UBOs, called each frame.
-	void Update(uint32_t imageIndex, float dt, float time, const glm::mat4& view, const glm::mat4& proj);
+	/// Update the particle UBOs, called each frame; jitter is the frame's sub-pixel offset in clip space (see TemporalUpscaler).
+	/// eyeViews: MULTIVIEW_VIEWS view matrices the particles are projected with in multiview stereo (see Multiview.h); NULL projects every view with view.
+	void Update(uint32_t imageIndex, float dt, float time, const glm::mat4& view, const glm::mat4& proj, const glm::vec2& jitter = glm::vec2(0.f), const glm::mat4* eyeViews = NULL);
 
-	/// Bind to a graphics command buffer to render
-	void cmdBind(const VkCommandBuffer& cmdBuffer, int index);
+	/// Bind to a graphics command buffer to render, from within the first subpass of the renderPass passed in the constructor params.
+	/// When streaming, this ends the current render pass instance and continues in new instances of continuationRenderPass (using the framebuffer given),
+	/// generating and drawing one chunk at a time; recording then carries on in the first subpass of the last instance. When culling, this likewise ends the
+	/// current instance to build the depth pyramid and cull the particles, and draws them in a single instance of continuationRenderPass.
+	void cmdBind(const VkCommandBuffer& cmdBuffer, int index, const VkFramebuffer& framebuffer);
 
 	/// Bind to a compute command buffer to update (only in Compute mode)
-	void cmdBindCompute(const VkCommandBuffer& cmdBuffer);
+	void cmdBindCompute(const VkCommandBuffer& cmdBuffer, int index);
+
+	/// Returns whether the compute command buffer for this image index needs to be submitted this frame; this is only the case in Compute mode,
+	/// when the SSBO for that index was generated with a different time or different particle settings (camera movement alone never requires it).
+	/// Must be called after Update(), and the compute work must then be submitted if this returns true.
+	bool computeRequired(uint32_t imageIndex);
 
 
 
@@ -159,6 +357,15 @@ public:
 	inline ParticlesConstructorParams getConstructorParams() { return params; }
 	inline DevicesPtr getDevices() { return devices; }
 
+	/// Buffers read by particle(), for passes that re-generate particles from their index (eg. V-Buffer lighting with particle IDs)
+	inline std::vector<VkBuffer>& getUBOBuffers() { return uboBuffer->getBuffers(); }
+	inline int getUBOSize() const { return (int)sizeof(ParticlesUBO); }
+	/// Baked statics buffer once per swapchain image (empty unless the statics are baked)
+	inline std::vector<VkBuffer> getStaticsBuffers() const { return staticsBuffer ? std::vector<VkBuffer>(params.swapchainSize, staticsBuffer->getBuffers()[0]) : std::vector<VkBuffer>(); }
+	inline int getStaticsSize() const { return (int)(sizeof(ParticleStatics) * (particlesUBO.staticsBaked ? settings.particleCount : 1)); }
+	/// Sprite cache, for passes that shade particles from their uv (eg. V-Buffer lighting); NULL unless usesSpriteCache()
+	inline Texture* getSpriteCache() const { return spriteCache; }
+
 
 
 	/// Static method for selecting different settings for a ParticleSystem, reinitializing it whenever needed as selected by user.
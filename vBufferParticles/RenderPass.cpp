@@ -1,6 +1,9 @@
 #include "RenderPass.h"
 
 
+float RenderPass::renderScale = 1.f;
+
+
 /// Creates the descriptor for a single render pass attachment image.
 RenderPass::RenderPassAttachmentDesc::RenderPassAttachmentDesc(VkFormat colorFormat, VkImageLayout layout, VkImageLayout finalLayout, VkAttachmentStoreOp storeOp) {
 
@@ -21,7 +24,7 @@ RenderPass::RenderPassAttachmentDesc::RenderPassAttachmentDesc(VkFormat colorFor
 
 
 /// Creates a render pass, given the attachments that will be accessible to it and the number of subpasses that should be created.
-RenderPass::RenderPass(VkDevice* logicalDevice, std::vector<RenderPassAttachmentDesc>& attachmentDescs, int subpassCount, VkExtent2D extent) : logicalDevice(logicalDevice), extent(extent), subpassCount(subpassCount) {
+RenderPass::RenderPass(VkDevice* logicalDevice, std::vector<RenderPassAttachmentDesc>& attachmentDescs, int subpassCount, VkExtent2D extent, Chaining chaining, uint32_t viewCount, bool depthInput) : logicalDevice(logicalDevice), extent(extent), subpassCount(subpassCount), viewCount(viewCount), depthInput(depthInput) {
 
 	assert(attachmentDescs.size() >= 2);
 
@@ -32,7 +35,15 @@ RenderPass::RenderPass(VkDevice* logicalDevice, std::vector<RenderPassAttachment
 	std::vector<VkAttachmentDescription> attachments = {};
 	std::vector<VkAttachmentReference> attachmentRefs = {};
 	for (int i = 0; i < attachmentDescs.size(); ++i) {
-		attachments.push_back(attachmentDescs[i]());
+		VkAttachmentDescription desc = attachmentDescs[i]();
+		if (chaining != Chaining::None) {// keep all contents around for the next render pass instance
+			desc.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		}
+		if (chaining == Chaining::Continuation) {// resume from the contents (and layout) left by the previous render pass instance
+			desc.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+			desc.initialLayout = desc.finalLayout;
+		}
+		attachments.push_back(desc);
 		VkAttachmentReference ref = {};
 		ref.attachment = i;
 		ref.layout = attachmentDescs[i].layout();
@@ -48,11 +59,19 @@ RenderPass::RenderPass(VkDevice* logicalDevice, std::vector<RenderPassAttachment
 	for (int i = 1; i < attachmentRefs.size() - 1; ++i) colourRefs.push_back(attachmentRefs[i]);//copy over the attachment references for the rest of the attachments
 	//input refs for last subpass will be all attachments, except their layout will be transitioned to SHADER_READ_ONLY_OPTIMAL for reading as input attachments
 	std::vector<VkAttachmentReference> inputRefs = {};
+	if (depthInput) {//depth first, so that the indices of the others do not depend on how many there are
+		VkAttachmentReference r = depthRef;
+		r.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		inputRefs.push_back(r);
+	}
 	for (int i = 1; i < attachmentRefs.size() - 1; ++i) {
 		VkAttachmentReference r = attachmentRefs[i];
 		r.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 		inputRefs.push_back(r);
 	}
+	//an only subpass writes to the present attachment, then the rest of the colour attachments (eg. off-screen layers with several outputs)
+	std::vector<VkAttachmentReference> onlySubpassRefs = { presentRef };
+	onlySubpassRefs.insert(onlySubpassRefs.end(), colourRefs.begin(), colourRefs.end());
 
 
 	// Create subpasses
@@ -72,7 +91,9 @@ RenderPass::RenderPass(VkDevice* logicalDevice, std::vector<RenderPassAttachment
 		} else {// last subpass
 			subpass.colorAttachmentCount = 1;
 			subpass.pColorAttachments = &presentRef;
-			if (subpassCount == 1) {// if it's the only subpass, it needs depth
+			if (subpassCount == 1) {// if it's the only subpass, it needs depth, and writes to all colour attachments
+				subpass.colorAttachmentCount = (uint32_t)onlySubpassRefs.size();
+				subpass.pColorAttachments = onlySubpassRefs.data();
 				subpass.pDepthStencilAttachment = &depthRef;
 			} else {// if it's the last of several subpasses, it needs the input attachments and no depth
 				subpass.inputAttachmentCount = (uint32_t)inputRefs.size();
@@ -90,7 +111,12 @@ RenderPass::RenderPass(VkDevice* logicalDevice, std::vector<RenderPassAttachment
 			dependency.dstStageMask = i != subpassCount - 1 ? VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
 			dependency.srcAccessMask = i == 0 ? VK_ACCESS_MEMORY_READ_BIT : VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 			dependency.dstAccessMask = i != subpassCount - 1 ? VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT : VK_ACCESS_SHADER_READ_BIT;
+			if (depthInput && i != 0 && i == subpassCount - 1) {//depth tests of the previous subpass complete before depth is read
+				dependency.srcStageMask |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+				dependency.srcAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+			}
 			dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+			if (viewCount > 1 && i != 0) dependency.dependencyFlags |= VK_DEPENDENCY_VIEW_LOCAL_BIT;// multiview: each view only reads its own layer of the previous subpass
 			subpassDependencies.push_back(dependency);
 		}
 
@@ -129,6 +155,17 @@ RenderPass::RenderPass(VkDevice* logicalDevice, std::vector<RenderPassAttachment
 	info.dependencyCount = (uint32_t)subpassDependencies.size();
 	info.pDependencies = subpassDependencies.data();
 
+	// Multiview: every subpass renders all views, which are rendered from close viewpoints (correlated, so that implementations may share work between them)
+	std::vector<uint32_t> viewMasks(subpassDescs.size(), (1u << viewCount) - 1);
+	uint32_t correlationMask = (1u << viewCount) - 1;
+	VkRenderPassMultiviewCreateInfoKHR multiviewInfo = {};
+	multiviewInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO_KHR;
+	multiviewInfo.subpassCount = (uint32_t)viewMasks.size();
+	multiviewInfo.pViewMasks = viewMasks.data();
+	multiviewInfo.correlationMaskCount = 1;
+	multiviewInfo.pCorrelationMasks = &correlationMask;
+	if (viewCount > 1) info.pNext = &multiviewInfo;
+
 	if (vkCreateRenderPass(*logicalDevice, &info, NULL, &renderPass) != VK_SUCCESS) {
 		throw std::runtime_error("Cannot create render pass!");
 	}
@@ -140,9 +177,16 @@ RenderPass::~RenderPass(){
 	vkDestroyRenderPass(*logicalDevice, renderPass, NULL);
 }
 
+/// Part of an extent covered at the current render scale
+VkExtent2D RenderPass::getRenderArea(VkExtent2D extent) {
+	return { (uint32_t)ceil(extent.width * renderScale), (uint32_t)ceil(extent.height * renderScale) };
+}
+
 /// Binds the render pass to the command buffer
 void RenderPass::begin(const VkCommandBuffer& cmdBuffer, const VkFramebuffer& framebuffer) {
 
+	VkExtent2D area = scaled ? getRenderArea(extent) : extent;
+
 	// Clear framebuffers
 	std::vector<VkClearValue> clearValues = {};
 	clearValues.resize(attachmentCount);
@@ -156,11 +200,17 @@ void RenderPass::begin(const VkCommandBuffer& cmdBuffer, const VkFramebuffer& fr
 	info.renderPass = renderPass;
 	info.framebuffer = framebuffer;
 	info.renderArea.offset = { 0, 0 };
-	info.renderArea.extent = extent;
+	info.renderArea.extent = area;
 	info.clearValueCount = (uint32_t)clearValues.size();
 	info.pClearValues = clearValues.data();
 	vkCmdBeginRenderPass(cmdBuffer, &info, VK_SUBPASS_CONTENTS_INLINE);
 
+	// Viewport & scissor of all pipelines (dynamic states, kept through subpasses)
+	VkViewport viewport = { 0.f, 0.f, (float)area.width, (float)area.height, 0.f, 1.f };
+	VkRect2D scissor = { { 0, 0 }, area };
+	vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+	vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+
 }
 
 /// Stop recording commands specific to this render pass
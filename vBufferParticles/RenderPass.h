@@ -13,6 +13,9 @@ class RenderPass {
 	VkDevice* logicalDevice;
 	int subpassCount;
 	int attachmentCount;
+	uint32_t viewCount;
+	bool depthInput;
+	bool scaled = false;// whether begin() covers the part of the extent given by the render scale (see setScaled())
 
 public:
 
@@ -32,19 +35,47 @@ public:
 		inline VkImageLayout layout() { return _layout; }
 	};// struct RenderPassAttachmentDesc
 
+	/// How a render pass instance relates to other instances rendering to the same framebuffer within a frame.
+	enum class Chaining {
+		None,			// only instance: attachments are cleared, and only stored according to their descriptions
+		First,			// first of a chain: attachments are cleared, then all stored for the next instance
+		Continuation	// continues a previous instance: attachments are all loaded and stored, nothing is cleared
+	};// enum class Chaining
+
 	/// Creates a render pass. it is assumed that the first attachment desc is the present attachment, and the last is the depth attachment.
-	RenderPass(VkDevice* logicalDevice, std::vector<RenderPassAttachmentDesc>& attachmentDescs, int subpassCount, VkExtent2D extent);
+	/// With several subpasses, all but the last write to the attachments in between, which the last reads as input attachments; an only subpass writes to them all.
+	/// Render passes created from the same attachment descriptions with different chaining are compatible (same framebuffers and pipelines can be used).
+	/// With several views (VK_KHR_multiview, see Multiview.h), every subpass is broadcast to that many layers of the attachments, whose views must be 2D arrays.
+	/// With depthInput, the last of several subpasses also reads the depth attachment (read-only) as its first input attachment, ahead of the others
+	/// (eg. to reconstruct positions from depth); the depth image must then be created with VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT.
+	RenderPass(VkDevice* logicalDevice, std::vector<RenderPassAttachmentDesc>& attachmentDescs, int subpassCount, VkExtent2D extent, Chaining chaining = Chaining::None, uint32_t viewCount = 1, bool depthInput = false);
 	virtual ~RenderPass();// cleanup resources.
 
 	/// Returns the vulkan resource handle
 	inline const VkRenderPass& getRenderPass() const { return renderPass; }
 	/// Returns the number of subpasses used in this pass
 	inline int getSubpassCount() const { return subpassCount; }
+	/// Returns the number of views each subpass renders (1 unless multiview)
+	inline uint32_t getViewCount() const { return viewCount; }
+	/// Returns whether the last subpass reads the depth attachment as an input attachment
+	inline bool readsDepth() const { return depthInput; }
+
+	/// Makes the render area, viewport and scissor cover the part of the extent given by the render scale when the render pass begins. Only the passes
+	/// drawing the scene are scaled, along with the particle layers their composites read texel for texel; other passes (eg. drawing over the upscaled
+	/// image) always cover their whole extent.
+	inline void setScaled(bool scaled) { this->scaled = scaled; }
 
-	/// Binds and unbinds the render pass at command buffer recording time
+	/// Binds and unbinds the render pass at command buffer recording time; the render area, viewport and scissor cover the whole extent, or the part
+	/// given by the render scale if the render pass is scaled (see setScaled())
 	void begin(const VkCommandBuffer& cmdBuffer, const VkFramebuffer& framebuffer);
 	void end(const VkCommandBuffer& cmdBuffer);
 
+	/// Fraction of their extent (along x and y, from the top-left corner) that scaled render passes draw to when they begin; set by the dynamic resolution
+	/// controller (see DynamicResolution.h), and baked into command buffers at recording time. Pipelines use a dynamic viewport & scissor for it.
+	static float renderScale;
+	/// Part of an extent covered at the current render scale (rounded up)
+	static VkExtent2D getRenderArea(VkExtent2D extent);
+
 };// class RenderPass
 
 /// Useful default renderpass attachment descriptors
@@ -54,5 +85,9 @@ public:
 #define RENDERPASS_ATTACHMENT_DESC_COLOUR					RenderPass::RenderPassAttachmentDesc(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_ATTACHMENT_STORE_OP_DONT_CARE)
 ///		Vector4 attachment for use in between subpasses
 #define RENDERPASS_ATTACHMENT_DESC_VEC4						RenderPass::RenderPassAttachmentDesc(VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_ATTACHMENT_STORE_OP_DONT_CARE)
+///		Attachment of any format for use in between subpasses (eg. V-Buffer integer formats)
+#define RENDERPASS_ATTACHMENT_DESC_FORMAT(format)			RenderPass::RenderPassAttachmentDesc(format, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_ATTACHMENT_STORE_OP_DONT_CARE)
 ///		Depth attachment
 #define RENDERPASS_ATTACHMENT_DESC_DEPTH					RenderPass::RenderPassAttachmentDesc(VK_FORMAT_D32_SFLOAT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_ATTACHMENT_STORE_OP_DONT_CARE)
+///		Read-only depth attachment, which shaders may sample while it is attached (eg. in continuations compositing over a finished scene)
+#define RENDERPASS_ATTACHMENT_DESC_DEPTH_READ_ONLY			RenderPass::RenderPassAttachmentDesc(VK_FORMAT_D32_SFLOAT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_ATTACHMENT_STORE_OP_DONT_CARE)
@@ -39,8 +39,11 @@ public:
 	/// Used to update a command buffer with the scene data; returns the last render pass, which must not have been ended yet (for UI overlay)
 	virtual RenderPass* cmdBind(const VkCommandBuffer& cmdBuffer, int index) = 0;
 
-	/// Used to update a compute command buffer with the scene data
-	virtual void cmdBindCompute(const VkCommandBuffer& cmdBuffer) = 0;
+	/// Used to update a compute command buffer with the scene data (one compute command buffer per swapchain image index)
+	virtual void cmdBindCompute(const VkCommandBuffer& cmdBuffer, int index) = 0;
+
+	/// Returns whether the compute command buffer for this image index must be submitted this frame (called after Update)
+	virtual bool computeRequired(uint32_t imageIndex) = 0;
 
 	/// Returns the (last) render pass used by this scene
 	virtual RenderPass* getRenderPass() = 0;
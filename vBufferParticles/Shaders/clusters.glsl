@@ -0,0 +1,94 @@
+/// Clustered point lights, shared by the deferred lighting passes and the light binning pass (light_clusters.comp). The view frustum is split in a
+/// froxel grid (CLUSTERS_X x CLUSTERS_Y screen tiles, CLUSTERS_Z exponential depth slices), and each cluster lists the lights whose range touches it;
+/// a pixel then only loops over the lights of its own cluster, so that lighting cost stays flat as the amount of lights in the scene grows.
+/// #define CLUSTERS_BINDING before including this file: the cluster UBO, light SSBO and cluster SSBO take 3 bindings from there.
+/// With CLUSTERS_NO_GRID defined, only the lights (UBO + light SSBO) are declared, for passes that list lights in their own structure (see light_tiles.glsl).
+
+
+#define CLUSTERS_X 16
+#define CLUSTERS_Y 9
+#define CLUSTERS_Z 24
+#define CLUSTER_COUNT (CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z) // must be a multiple of the light binning workgroup size
+#define CLUSTER_MAX_LIGHTS 64 // lights listed per cluster; any further lights touching the cluster are ignored
+#define CLUSTER_NEAR 0.1 // view depth from which slices are spaced exponentially; closer pixels all fall in slice 0
+#define CLUSTER_FAR 100.0 // view depth of the end of the last slice (camera far plane)
+
+#ifndef CLUSTERS_ACCESS
+#define CLUSTERS_ACCESS readonly
+#endif
+
+
+/// Data for one point light
+struct PointLight{
+	vec4 position_range;// xyz: world position; w: range, beyond which the light has no effect
+	vec4 colour;// rgb: colour, scaled by intensity; w: unused
+};
+
+/// Camera and light count of the frame
+layout(binding = CLUSTERS_BINDING) uniform ClusterUBO{
+	mat4 view;
+	vec4 projScale;// xy: projection scale along x and y (proj[0][0], proj[1][1]); zw: depth terms (proj[2][2], proj[3][2])
+	uint lightCount;
+} uboClusters;
+
+/// All point lights of the scene
+layout(std430, set = 0, binding = CLUSTERS_BINDING + 1) readonly buffer PointLightsSSBO{
+	PointLight lights[];
+} ssboLights;
+
+#ifndef CLUSTERS_NO_GRID
+
+/// Light lists of all clusters: amount of lights in each cluster, then CLUSTER_MAX_LIGHTS light indices per cluster
+layout(std430, set = 0, binding = CLUSTERS_BINDING + 2) CLUSTERS_ACCESS buffer ClustersSSBO{
+	uint counts[CLUSTER_COUNT];
+	uint lightIndices[CLUSTER_COUNT * CLUSTER_MAX_LIGHTS];
+} ssboClusters;
+
+#endif // CLUSTERS_NO_GRID
+
+
+/// Diffuse contribution of a point light; inverse square falloff, windowed to reach 0 at the light's range
+vec3 lightPoint(PointLight light, vec3 albedo, vec3 worldPos, vec3 n){
+	vec3 toLight = light.position_range.xyz - worldPos;
+	float dist2 = max(dot(toLight, toLight), 1e-6);
+	float range = light.position_range.w;
+	float window = clamp(1.0 - pow(dist2 / (range * range), 2.0), 0.0, 1.0);
+	float atten = window * window / (dist2 + 1.0);
+	float nDotL = max(0.0, dot(n, toLight * inversesqrt(dist2)));
+	return light.colour.rgb * albedo * nDotL * atten;
+}
+
+
+#ifndef CLUSTERS_NO_GRID
+
+/// Depth slice of a view depth; slices are spaced exponentially between CLUSTER_NEAR and CLUSTER_FAR
+uint getClusterSlice(float depth){
+	return uint(clamp(log(depth / CLUSTER_NEAR) / log(CLUSTER_FAR / CLUSTER_NEAR) * CLUSTERS_Z, 0.0, CLUSTERS_Z - 1.0));
+}
+
+/// View depth at the start of a depth slice
+float getClusterSliceDepth(uint slice){
+	return slice == 0 ? 0.0 : CLUSTER_NEAR * pow(CLUSTER_FAR / CLUSTER_NEAR, float(slice) / CLUSTERS_Z);
+}
+
+/// Cluster containing a world space position, found by projecting it (so that any lighting pass can use it, with or without a screen position)
+uint getCluster(vec3 worldPos){
+	vec3 viewPos = (uboClusters.view * vec4(worldPos, 1.0)).xyz;
+	float depth = -viewPos.z;
+	vec2 screenUv = viewPos.xy * uboClusters.projScale.xy / depth * 0.5 + 0.5;
+	uvec2 tile = uvec2(clamp(screenUv * vec2(CLUSTERS_X, CLUSTERS_Y), vec2(0.0), vec2(CLUSTERS_X - 1, CLUSTERS_Y - 1)));
+	return (getClusterSlice(depth) * CLUSTERS_Y + tile.y) * CLUSTERS_X + tile.x;
+}
+
+/// Sums the contributions of all lights in the cluster of a fragment
+vec3 lightClusters(vec3 albedo, vec3 worldPos, vec3 worldNormal){
+	uint cluster = getCluster(worldPos);
+	uint count = min(ssboClusters.counts[cluster], CLUSTER_MAX_LIGHTS);
+	vec3 n = normalize(worldNormal);
+	vec3 colour = vec3(0.0);
+	for(uint i = 0; i < count; ++i)
+		colour += lightPoint(ssboLights.lights[ssboClusters.lightIndices[cluster * CLUSTER_MAX_LIGHTS + i]], albedo, worldPos, n);
+	return colour;
+}
+
+#endif // CLUSTERS_NO_GRID
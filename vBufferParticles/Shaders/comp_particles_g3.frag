@@ -4,13 +4,17 @@
 
 #define COMP_PARTICLE_FRAGMENT // <- set this flag as comp/comp pipelines bind textures to different locations
 #include "particles_frag.glsl"
+#include "gbuffer.glsl"
 
 layout (location = 0) in vec2 iUv;
+#ifdef TEMPORAL_UPSCALING_1
+layout (location = 2) in vec2 iVelocity;
+#endif
 
-// G-Buffer writes
-layout(location = 0) out vec4 oAlbedo;
-layout(location = 1) out vec4 oPosition;
-layout(location = 2) out vec4 oNormal;
+// G-Buffer writes (albedo, position & normal: see gbuffer.glsl)
+#ifdef TEMPORAL_UPSCALING_1
+layout(location = GBUFFER_EXTRA_LOCATION) out vec2 oVelocity;// screen uv motion since the previous frame (see TemporalUpscaler.h)
+#endif
 
 void main(){
 	
@@ -20,6 +24,10 @@ void main(){
 	if(oAlbedo.a < 0.5) discard; // discard fragments based on transparency of texel
 	#endif
 
-	oPosition = oNormal = (0).xxxx; // no need for position or normal information for particle geometry
+	gBufferWriteUnlit(); // particles are not lit: no position or normal information for particle geometry
+
+#ifdef TEMPORAL_UPSCALING_1
+	oVelocity = iVelocity;
+#endif
 
 }// main
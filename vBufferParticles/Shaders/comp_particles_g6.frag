@@ -4,16 +4,20 @@
 
 #define COMP_PARTICLE_FRAGMENT // <- set this flag as comp/comp pipelines bind textures to different locations
 #include "particles_frag.glsl"
+#include "gbuffer.glsl"
 
 layout (location = 0) in vec2 iUv;
-
-// G-Buffer writes
-layout(location = 0) out vec4 oAlbedo;
-layout(location = 1) out vec4 oPosition;
-layout(location = 2) out vec4 oNormal;
-layout(location = 3) out vec4 oEmission;
-layout(location = 4) out vec4 oSpecular;
-layout(location = 5) out vec4 oMetallicRoughness;
+#ifdef TEMPORAL_UPSCALING_1
+layout (location = 2) in vec2 iVelocity;
+#endif
+
+// G-Buffer writes (albedo, position & normal: see gbuffer.glsl)
+layout(location = GBUFFER_EXTRA_LOCATION) out vec4 oEmission;
+layout(location = GBUFFER_EXTRA_LOCATION + 1) out vec4 oSpecular;
+layout(location = GBUFFER_EXTRA_LOCATION + 2) out vec4 oMetallicRoughness;
+#ifdef TEMPORAL_UPSCALING_1
+layout(location = GBUFFER_EXTRA_LOCATION + 3) out vec2 oVelocity;// screen uv motion since the previous frame (see TemporalUpscaler.h)
+#endif
 
 void main(){
 	
@@ -23,6 +27,11 @@ void main(){
 	if(oAlbedo.a < 0.5) discard; // discard fragments based on transparency of texel
 	#endif
 
-	oPosition = oNormal = oSpecular = oMetallicRoughness = (0).xxxx; // no need for position, normal, etc. information for particle geometry
+	gBufferWriteUnlit(); // particles are not lit
+	oSpecular = oMetallicRoughness = (0).xxxx; // no need for specular, etc. information for particle geometry
+
+#ifdef TEMPORAL_UPSCALING_1
+	oVelocity = iVelocity;
+#endif
 
 }// main
@@ -0,0 +1,17 @@
+#version 450
+
+/// Fragment shader for comp/comp particles drawn with weighted blended transparency.
+
+#define COMP_PARTICLE_FRAGMENT // <- set this flag as comp/comp pipelines bind textures to different locations
+#include "particles_oit.glsl"
+
+layout (location = 0) in vec2 iUv;
+
+layout (location = 0) out vec4 oAccumulation;
+layout (location = 1) out vec4 oCoverage;
+
+void main(){
+
+	particleTransparency(iUv, oAccumulation, oCoverage);
+
+}// main
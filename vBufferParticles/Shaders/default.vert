@@ -3,12 +3,18 @@
 
 /// Default vertex shader for static meshes
 
+#include "../__.defines"
+#include "multiview.glsl"
+
 /// Uniform matrix buffer
 layout(binding = 0) uniform UniformBufferObject{
 	mat4 model;
 	mat4 view;
 	mat4 proj;
 	float time;
+	mat4 previousView;// view of the previous frame (motion vectors)
+	vec2 jitter;// sub-pixel offset of the frame, in clip space (temporal upscaling)
+	mat4 views[MULTIVIEW_VIEWS];// view matrix of each eye in multiview stereo (the camera's otherwise)
 } ubo;
 
 /// Input per vertex; position, normal, uv
@@ -21,6 +27,11 @@ layout(location = 0) out vec2 oUv;
 layout(location = 1) out vec3 oWorldNormal;
 layout(location = 2) out vec4 oWorldPosition;
 layout(location = 3) out float oTime;
+#ifdef TEMPORAL_UPSCALING_1
+/// Clip positions of this frame and the previous one, unjittered (velocity of the G-Buffer renderers)
+layout(location = 4) out vec4 oClip;
+layout(location = 5) out vec4 oPreviousClip;
+#endif
 
 
 /// Transforms vertex position and normal from model space to clip space. Pass time and uvs through to next shader in pipeline.
@@ -29,5 +40,10 @@ void main(){
 	oTime = ubo.time;
 	oUv = iUv;
 	oWorldNormal = normalize((ubo.model * vec4(iNormal, 0.0)).rgb);
-	gl_Position = ubo.proj * ubo.view * oWorldPosition;
+	gl_Position = ubo.proj * ubo.views[VIEW_INDEX] * oWorldPosition;
+#ifdef TEMPORAL_UPSCALING_1
+	oClip = gl_Position;
+	oPreviousClip = ubo.proj * ubo.previousView * oWorldPosition;// meshes are static: only the camera moves
+	gl_Position.xy += ubo.jitter * gl_Position.w;
+#endif
 }
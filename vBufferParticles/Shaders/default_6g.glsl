@@ -1,6 +1,8 @@
 
 /// Default fragment shader for g-buffer pipeline; must be included in a .frag after defining TEXTURE_BINDING to a valid uint.
 
+#include "../__.defines"
+#include "gbuffer.glsl"
 
 
 // near and far plane distances, for linear depth calculation
@@ -14,14 +16,18 @@ layout(location = 0) in vec2 iUv;
 layout(location = 1) in vec3 iWorldNormal;
 layout(location = 2) in vec4 iWorldPosition;
 layout(location = 3) in float iTime;
-
-// G-Buffer writes
-layout(location = 0) out vec4 oAlbedo;
-layout(location = 1) out vec4 oPosition;
-layout(location = 2) out vec4 oNormal;
-layout(location = 3) out vec4 oEmission;
-layout(location = 4) out vec4 oSpecular;
-layout(location = 5) out vec4 oMetallicRoughness;
+#ifdef TEMPORAL_UPSCALING_1
+layout(location = 4) in vec4 iClip;
+layout(location = 5) in vec4 iPreviousClip;
+#endif
+
+// G-Buffer writes (albedo, position & normal: see gbuffer.glsl)
+layout(location = GBUFFER_EXTRA_LOCATION) out vec4 oEmission;
+layout(location = GBUFFER_EXTRA_LOCATION + 1) out vec4 oSpecular;
+layout(location = GBUFFER_EXTRA_LOCATION + 2) out vec4 oMetallicRoughness;
+#ifdef TEMPORAL_UPSCALING_1
+layout(location = GBUFFER_EXTRA_LOCATION + 3) out vec2 oVelocity;// screen uv motion since the previous frame (see TemporalUpscaler.h)
+#endif
 
 layout(binding = TEXTURE_BINDING) uniform sampler2D texSampler;
 
@@ -39,10 +45,7 @@ float linearDepth(float depth){
 /// Writes ws position & normal, and albedo (texture read) to G-Buffers
 void main(){
 
-	oPosition = vec4(iWorldPosition.xyz, 1.0);
-	oPosition.w = linearDepth(gl_FragCoord.z);
-	
-	oNormal = vec4(normalize(iWorldNormal), 1.0);
+	gBufferWriteSurface(iWorldPosition.xyz, linearDepth(gl_FragCoord.z), iWorldNormal);
 	
 	oAlbedo = texture(texSampler, iUv);
 	oAlbedo.a = 1.0;
@@ -51,4 +54,7 @@ void main(){
 	oSpecular = vec4(1, 0, 1, 1);
 	oMetallicRoughness = vec4(0.5);
 	
+#ifdef TEMPORAL_UPSCALING_1
+	oVelocity = (iClip.xy / iClip.w - iPreviousClip.xy / iPreviousClip.w) * 0.5;
+#endif
 }
\ No newline at end of file
@@ -1,6 +1,9 @@
 
 /// Default fragment shader for g-buffer pipeline; must be included in a .frag after defining TEXTURE_BINDING to a valid uint.
 
+#include "../__.defines"
+#include "gbuffer.glsl"
+
 
 
 // near and far plane distances, for linear depth calculation
@@ -14,11 +17,15 @@ layout(location = 0) in vec2 iUv;
 layout(location = 1) in vec3 iWorldNormal;
 layout(location = 2) in vec4 iWorldPosition;
 layout(location = 3) in float iTime;
+#ifdef TEMPORAL_UPSCALING_1
+layout(location = 4) in vec4 iClip;
+layout(location = 5) in vec4 iPreviousClip;
+#endif
 
-// G-Buffer writes
-layout(location = 0) out vec4 oAlbedo;
-layout(location = 1) out vec4 oPosition;
-layout(location = 2) out vec4 oNormal;
+// G-Buffer writes (albedo, position & normal: see gbuffer.glsl)
+#ifdef TEMPORAL_UPSCALING_1
+layout(location = GBUFFER_EXTRA_LOCATION) out vec2 oVelocity;// screen uv motion since the previous frame (see TemporalUpscaler.h)
+#endif
 
 layout(binding = TEXTURE_BINDING) uniform sampler2D texSampler;
 
@@ -36,12 +43,12 @@ float linearDepth(float depth){
 /// Writes ws position & normal, and albedo (texture read) to G-Buffers
 void main(){
 
-	oPosition = vec4(iWorldPosition.xyz, 1.0);
-	oPosition.w = linearDepth(gl_FragCoord.z);
-	
-	oNormal = vec4(normalize(iWorldNormal), 1.0);
+	gBufferWriteSurface(iWorldPosition.xyz, linearDepth(gl_FragCoord.z), iWorldNormal);
 	
 	oAlbedo = texture(texSampler, iUv);
 	oAlbedo.a = 1.0;
 	
+#ifdef TEMPORAL_UPSCALING_1
+	oVelocity = (iClip.xy / iClip.w - iPreviousClip.xy / iPreviousClip.w) * 0.5;
+#endif
 }
\ No newline at end of file
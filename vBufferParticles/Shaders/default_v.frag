@@ -3,14 +3,17 @@
 
 /// Fragment shader for static meshes in V-Buffer renderer first pass
 
+#include "visibility.glsl"
+
 layout(location = 0) in vec4 iVisibility;
+layout(location = 1) flat in uvec2 iIds; // x: triangle id offset of the draw call, y: material id
 
 // V-Buffer writes
-layout(location = 0) out vec4 oVisibility;
+layout(location = 0) out VISIBILITY_TYPE oVisibility;
 
 
 /// Pass-through fragment shader to output visibility data per fragment to Visibility Buffer.
 void main(){
-	oVisibility = iVisibility;
-	oVisibility.z += gl_PrimitiveID; // add the primitive ID within the current draw call (before this, the value is the offset of ids from other draw calls).
+	// add the primitive ID within the current draw call to the offset of ids from other draw calls.
+	oVisibility = packMeshVisibility(iVisibility.xy, iIds.x + uint(gl_PrimitiveID), iIds.y);
 }
\ No newline at end of file
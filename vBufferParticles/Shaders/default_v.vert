@@ -3,12 +3,18 @@
 
 /// Default vertex shader for static meshes in V-Buffer pipeline
 
+#include "../__.defines"
+#include "multiview.glsl"
+
 /// Uniform matrix buffer
 layout(binding = 0) uniform UniformBufferObject{
 	mat4 model;
 	mat4 view;
 	mat4 proj;
 	float time;
+	mat4 previousView;// view of the previous frame (unused)
+	vec2 jitter;// sub-pixel offset of the frame (unused)
+	mat4 views[MULTIVIEW_VIEWS];// view matrix of each eye in multiview stereo (the camera's otherwise)
 } ubo;
 
 /// Input per vertex; position, uv, ids
@@ -18,12 +24,15 @@ layout(location = 2) in vec2 iIds; // x: triangle id, y: material id
 
 /// Output per vertex; uv, triangle id, material id
 layout(location = 0) out vec4 oVisibility;
+/// Same ids as integers (x: triangle id, y: material id), used by the packed integer V-Buffer formats; flat, as interpolated ids are inexact
+layout(location = 1) flat out uvec2 oIds;
 
 
 /// Compute visibility data for this fragment, and transform position from world space to clip space. Pass visibility data out to fragment shader for write to V-Buffer.
 void main(){
-	gl_Position = ubo.proj * ubo.view * ubo.model * vec4(iPosition, 1.0);
+	gl_Position = ubo.proj * ubo.views[VIEW_INDEX] * ubo.model * vec4(iPosition, 1.0);
 	
 	oVisibility = vec4(iUv, iIds);
+	oIds = uvec2(iIds + 0.5);
 	
 }
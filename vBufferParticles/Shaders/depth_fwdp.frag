@@ -0,0 +1,8 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+/// Fragment shader of the Forward+ depth prepass: static meshes only write depth (colour writes are masked by the pipeline).
+
+
+void main(){
+}
@@ -0,0 +1,125 @@
+/// Layout of the G-Buffers shared by the G-Buffer (3) and (6) renderers, selected by GBUFFER_COMPACT (see GBufferScene::setCompactLayout()):
+///		full (MODE 0): albedo (RGBA8), ws position with linear depth (RGBA16F), ws normal (RGBA16F); unlit fragments (particles) write a null normal.
+///		compact (MODE 1): albedo (RGBA8), octahedral ws normal (RG16_SNORM); positions are reconstructed from the depth buffer by the lighting pass,
+///		which reads it as its first input attachment, and unlit fragments scale their albedo alpha by GBUFFER_UNLIT_ALPHA (lit ones write 1).
+/// The writers' further attachments (velocity, materials) follow from GBUFFER_EXTRA_LOCATION, in both layouts.
+/// The lighting passes #define GBUFFER_LIGHTING and GBUFFER_MATRIX_BINDING (matrix UBO, compact layout only) before including this file, and read
+/// the first G-Buffers with gBufferLoad(); their further input attachments keep the same indices & bindings in both layouts (from 3 on).
+
+
+#include "../__.defines"
+
+#ifdef GBUFFER_COMPACT_1
+	#define GBUFFER_EXTRA_LOCATION 2
+#else
+	#define GBUFFER_EXTRA_LOCATION 3
+#endif
+
+#define GBUFFER_UNLIT_ALPHA 0.5 // compact layout: scale of the albedo alpha of unlit fragments, below that of lit ones (1)
+
+
+/// Octahedral encoding of a unit vector to -1..1 (Cigolle et al., JCGT 2014): projected on the octahedron, whose lower half is folded over the upper
+vec2 octEncode(vec3 n){
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	if(n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return n.xy;
+}
+
+/// Decodes a unit vector encoded by octEncode()
+vec3 octDecode(vec2 e){
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+
+#ifndef GBUFFER_LIGHTING
+
+// G-Buffer writes
+layout(location = 0) out vec4 oAlbedo;
+#ifdef GBUFFER_COMPACT_1
+layout(location = 1) out vec2 oNormal;
+#else
+layout(location = 1) out vec4 oPosition;
+layout(location = 2) out vec4 oNormal;
+#endif
+
+/// Writes the ws position (with its linear depth) and normal of a lit fragment; only the normal is stored by the compact layout
+void gBufferWriteSurface(vec3 position, float linearDepth, vec3 normal){
+#ifdef GBUFFER_COMPACT_1
+	oNormal = octEncode(normalize(normal));
+#else
+	oPosition = vec4(position, linearDepth);
+	oNormal = vec4(normalize(normal), 1.0);
+#endif
+}
+
+/// Marks a fragment as unlit (particles), once its albedo is written
+void gBufferWriteUnlit(){
+#ifdef GBUFFER_COMPACT_1
+	oAlbedo.a *= GBUFFER_UNLIT_ALPHA;
+	oNormal = (0).xx;
+#else
+	oPosition = oNormal = (0).xxxx;
+#endif
+}
+
+#else
+
+// G-Buffer reads
+#ifdef GBUFFER_COMPACT_1
+layout(input_attachment_index = 1, set = 0, binding = 0) uniform subpassInput iAlbedo;
+layout(input_attachment_index = 0, set = 0, binding = 1) uniform subpassInput iDepth;// in place of the position attachment (see RenderPass: depth input)
+layout(input_attachment_index = 2, set = 0, binding = 2) uniform subpassInput iNormal;
+
+/// Matrices the G-Buffers were rendered with (same layout as MatrixBufferObject)
+layout(binding = GBUFFER_MATRIX_BINDING) uniform MatrixUBO{
+	mat4 model;
+	mat4 view;
+	mat4 proj;
+	float time;
+	mat4 previousView;
+	vec2 jitter;
+} uboMatrix;
+#else
+layout(input_attachment_index = 0, set = 0, binding = 0) uniform subpassInput iAlbedo;
+layout(input_attachment_index = 1, set = 0, binding = 1) uniform subpassInput iPosition;
+layout(input_attachment_index = 2, set = 0, binding = 2) uniform subpassInput iNormal;
+#endif
+
+/// G-Buffer data of a fragment
+struct GBufferSample{
+	vec4 albedo;		// alpha: 0 where nothing was drawn
+	vec3 position;		// ws
+	vec3 normal;		// ws
+	float linearDepth;	// distance from the camera plane
+	float lit;			// 1 where the fragment receives light, 0 otherwise (particles)
+};
+
+/// Loads the G-Buffer data of the fragment at screen uv (0..1 over the render area)
+GBufferSample gBufferLoad(vec2 uv){
+	GBufferSample g;
+	g.albedo = subpassLoad(iAlbedo);
+#ifdef GBUFFER_COMPACT_1
+	g.lit = step(0.75, g.albedo.a);// between lit (1) and unlit (<= GBUFFER_UNLIT_ALPHA) alphas
+	g.albedo.a = g.lit > 0.0 ? 1.0 : g.albedo.a / GBUFFER_UNLIT_ALPHA;
+	g.normal = octDecode(subpassLoad(iNormal).xy);
+
+	// View space position from the depth, on the unjittered ray of the fragment (GLM_FORCE_DEPTH_ZERO_TO_ONE projection)
+	vec2 ndc = uv * 2.0 - 1.0 - uboMatrix.jitter;
+	float viewZ = -uboMatrix.proj[3][2] / (subpassLoad(iDepth).r + uboMatrix.proj[2][2]);
+	vec3 viewPosition = vec3(ndc * -viewZ / vec2(uboMatrix.proj[0][0], uboMatrix.proj[1][1]), viewZ);
+	g.position = transpose(mat3(uboMatrix.view)) * (viewPosition - uboMatrix.view[3].xyz);
+	g.linearDepth = -viewZ;
+#else
+	vec4 position_depth = subpassLoad(iPosition);
+	g.position = position_depth.xyz;
+	g.linearDepth = position_depth.w;
+	g.normal = subpassLoad(iNormal).rgb;
+	g.lit = clamp(length(g.normal * 999), 0, 1);// 0 where normal == (0,0,0), 1 otherwise.
+#endif
+	return g;
+}
+
+#endif
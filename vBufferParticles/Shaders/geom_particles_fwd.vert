@@ -3,7 +3,7 @@
 
 /// (almost passthrough) Vertex shader for geom/geom particles.
 
-layout (location = 0) out float oVertexIndex;
+layout (location = 0) flat out uint oVertexIndex;
 
 void main(){
 	
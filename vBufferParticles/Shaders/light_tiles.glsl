@@ -0,0 +1,46 @@
+/// Tiled light lists of the Forward+ renderer: the screen is split in LIGHT_TILE_SIZE x LIGHT_TILE_SIZE tiles, and after the depth prepass, a compute pass
+/// (light_tiles_fwdp.comp) lists the point lights (see clusters.glsl) touching the depth range of each tile; forward shading then only loops over the lights of
+/// its pixel's tile.
+/// #define LIGHT_TILES_BINDING before including this file: the cluster UBO, light SSBO and tile SSBO take 3 bindings from there.
+
+
+#define CLUSTERS_BINDING LIGHT_TILES_BINDING
+#define CLUSTERS_NO_GRID
+#include "clusters.glsl"
+
+
+#define LIGHT_TILE_SIZE 16 // pixels per tile side; must match ForwardPlusScene.h
+#define LIGHT_TILE_MAX_LIGHTS 64 // lights listed per tile; must match ForwardPlusScene.h
+
+#ifndef LIGHT_TILES_ACCESS
+#define LIGHT_TILES_ACCESS readonly
+#endif
+
+
+/// Light lists of all tiles, row by row: for each tile, its amount of lights then LIGHT_TILE_MAX_LIGHTS light indices
+layout(std430, set = 0, binding = LIGHT_TILES_BINDING + 2) LIGHT_TILES_ACCESS buffer LightTilesSSBO{
+	uint tilesX;// tiles per row
+	uint lists[];
+} ssboTiles;
+
+
+/// Start of the list of a tile in ssboTiles.lists
+uint getLightTileList(uvec2 tile){
+	return (tile.y * ssboTiles.tilesX + tile.x) * (LIGHT_TILE_MAX_LIGHTS + 1);
+}
+
+
+#ifndef LIGHT_TILES_NO_SHADING
+
+/// Sums the contributions of all lights in the tile of a fragment
+vec3 lightTile(vec3 albedo, vec3 worldPos, vec3 worldNormal){
+	uint list = getLightTileList(uvec2(gl_FragCoord.xy) / LIGHT_TILE_SIZE);
+	uint count = min(ssboTiles.lists[list], LIGHT_TILE_MAX_LIGHTS);
+	vec3 n = normalize(worldNormal);
+	vec3 colour = vec3(0.0);
+	for(uint i = 1; i <= count; ++i)
+		colour += lightPoint(ssboLights.lights[ssboTiles.lists[list + i]], albedo, worldPos, n);
+	return colour;
+}
+
+#endif // LIGHT_TILES_NO_SHADING
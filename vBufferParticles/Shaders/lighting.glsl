@@ -14,6 +14,14 @@ uniform LightUBO{
 
 */
 
+// Deferred lighting passes may also #define CLUSTERS_BINDING (see clusters.glsl) to add the point lights of the fragment's cluster,
+// and Forward+ shading LIGHT_TILES_BINDING (see light_tiles.glsl) to add the point lights of the fragment's screen tile.
+#if defined(LIGHT_TILES_BINDING)
+#include "light_tiles.glsl"
+#elif defined(CLUSTERS_BINDING)
+#include "clusters.glsl"
+#endif
+
 /// Given information about a fragment, returns its lit version
 vec3 lightFragment(vec3 albedo, vec3 worldPos, vec3 worldNormal){
 	
@@ -41,6 +49,12 @@ vec3 lightFragment(vec3 albedo, vec3 worldPos, vec3 worldNormal){
 		
 	}
 
+#if defined(LIGHT_TILES_BINDING)
+	fragColor += lightTile(albedo, worldPos, worldNormal);
+#elif defined(CLUSTERS_BINDING)
+	fragColor += lightClusters(albedo, worldPos, worldNormal);
+#endif
+
 	return fragColor;
 
 }
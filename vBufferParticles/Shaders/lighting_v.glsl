@@ -0,0 +1,341 @@
+/// Shading of the V-Buffer renderer, shared by the lighting pass (pp_lighting_v.frag) and the tiled shading kernels (tile_shade_v.glsl).
+/// Binding 0 is left to the visibility buffer, whose type depends on the includer; LIGHTING_V_BINDINGS_END is the first binding left free after the shading resources.
+/// #define LIGHTING_V_MATERIAL before including this file to only shade one material.
+/// #define LIGHTING_V_LOAD_TRIANGLE to the name of a function with the signature of loadTriangle (defined after including this file) to provide mesh vertices from elsewhere.
+/// In multiview stereo, the full-screen lighting pass shades each view in its own layer (VIEW_INDEX, see multiview.glsl); the tiled kernels shade a single view.
+
+
+#include "../__.defines"
+#include "multiview.glsl" // ahead of any code, as it may enable an extension
+#include "visibility.glsl"
+#include "triangle_setup.glsl"
+
+
+#define EXPECT_DEBUG_BUFFER // comment out to prevent receiving debug uniform data from CPU. See GBufferScene.h for CPU equivalent SEND_DEBUG_BUFFER
+
+
+#define DEBUG_TRIANGLE_ID_RANGE 64 // triangle ID debug view cycles through grey levels every DEBUG_TRIANGLE_ID_RANGE triangles
+
+
+#define CLEAR_COLOUR vec4(0.4, 0.4, 0.3, 1.0) // yellowish 'clear' colour for fragments with no triangles drawn.
+
+
+
+
+#include "raymarch.glsl"
+
+
+
+/// Data for one light
+layout(binding = 1) uniform LightUBO{
+	vec4 position;// xyz = position / w = radius
+	vec4 diffuse;
+	vec4 ambient;
+} uboLight;
+
+
+/// Uniform matrix buffer
+layout(binding = 2) uniform MatrixUBO{
+	mat4 model;
+	mat4 view;
+	mat4 proj;
+	float time;
+	mat4 previousView;
+	vec2 jitter;
+	mat4 views[MULTIVIEW_VIEWS];// view matrix of each eye in multiview stereo (the camera's otherwise)
+} uboMatrix;
+
+
+
+
+/// Data for one stored vertex
+struct VertexInput{
+	vec4 position_u; // xyz: position; w: u
+	vec4 normal_v; // xyz: normal; w: v
+};
+
+/// Index and Vertex buffers (global to the scene, sized to the scene's geometry)
+layout(std430, set = 0, binding = 3) readonly buffer IndicesSSBO{
+	uint indices[];
+} ssboIndices;
+layout(std430, set = 0, binding = 4) readonly buffer VerticesSSBO{
+	VertexInput vertices[];
+} ssboVertices;
+
+vec4 getVertexPos(VertexInput v){
+	return vec4(v.position_u.xyz, 1.0);
+}
+vec4 getVertexNormal(VertexInput v){
+	return vec4(v.normal_v.xyz, 0.0);
+}
+vec2 getVertexUV(VertexInput v){
+	return vec2(v.position_u.w, v.normal_v.w);
+}
+
+
+
+#ifdef EXPECT_DEBUG_BUFFER
+layout(binding = 8) uniform DebugUBO{
+	float value;
+} uboDebug;
+#endif
+
+
+#ifdef VISIBILITY_PARTICLE_IDS
+// particles are re-generated from their index: particle UBO (and baked statics) bound after the debug buffer
+	#ifdef EXPECT_DEBUG_BUFFER
+		#define PARTICLES_UBO_BINDING 9
+	#else
+		#define PARTICLES_UBO_BINDING 8
+	#endif
+	#define STATICS_BINDING (PARTICLES_UBO_BINDING + 1)
+	#include "particles.glsl"
+#endif
+
+
+/// Triangle setup of the frame (see triangle_setup_v.comp), bound after all other resources; in multiview stereo, it holds the triangles of each view one after the other
+#ifdef VISIBILITY_PARTICLE_IDS
+	#ifdef PARTICLE_BAKED_STATICS_1
+		#define TRIANGLE_SETUP_BINDING (STATICS_BINDING + 1)
+	#else
+		#define TRIANGLE_SETUP_BINDING (PARTICLES_UBO_BINDING + 1)
+	#endif
+#elif defined(EXPECT_DEBUG_BUFFER)
+	#define TRIANGLE_SETUP_BINDING 9
+#else
+	#define TRIANGLE_SETUP_BINDING 8
+#endif
+layout(std430, set = 0, binding = TRIANGLE_SETUP_BINDING) readonly buffer TriangleSetupSSBO{
+	TriangleSetup triangles[];
+} ssboSetup;
+
+/// Clustered point lights (3 bindings), after the triangle setup
+#define CLUSTERS_BINDING (TRIANGLE_SETUP_BINDING + 1)
+#include "lighting.glsl"
+
+#define LIGHTING_V_BINDINGS_END (CLUSTERS_BINDING + 3)
+
+
+
+
+
+/// Shrimp texture
+layout(binding = 5) uniform sampler2D shrimpSampler;
+/// Raccoon texture
+layout(binding = 6) uniform sampler2D raccoonSampler;
+/// Particle texture (leaf for cut-out particles, or the sprite cache)
+layout(binding = 7) uniform sampler2D particleSampler;
+
+
+
+
+
+
+
+
+
+// multiply and add, should get compiled to MAD instruction (hopefully :))
+float mad(float a, float b, float c){ return a*b + c; }
+vec3 mad(vec3 a, vec3 b, vec3 c){ return a*b + c; }
+vec4 mad(vec4 a, vec4 b, vec4 c){ return a*b + c; }
+vec4 mad(vec4 a, float b, vec4 c){ return a*b + c; }
+
+/// Linear interpolation between 3 vertices
+VertexInput lerp3V(VertexInput vert0, VertexInput vert1, VertexInput vert2, vec3 h){
+	VertexInput vIn;
+	vIn.position_u = mad(vert0.position_u, h.x, mad(vert1.position_u, h.y, (vert2.position_u * h.z)));
+	vIn.normal_v = mad(vert0.normal_v, h.x, mad(vert1.normal_v, h.y, (vert2.normal_v * h.z)));
+	return vIn;
+}
+
+/// Loads the vertex corresponding to the triangle index passed + the vertex index offset. Returns the vertex in world space
+VertexInput loadVertex(uint triId, uint vId){
+	
+	// find the vertex in the buffer based on the index buffer at correct offset.
+	uint index = ssboIndices.indices[triId * 3 + vId];
+	VertexInput vert = ssboVertices.vertices[index];
+
+	vert.position_u = vec4((uboMatrix.model * getVertexPos(vert)).xyz, vert.position_u.w);//set world space position
+
+	return vert;
+
+}
+
+/// Loads the 3 vertices of a triangle, in world space
+void loadTriangle(uint triId, out VertexInput v0, out VertexInput v1, out VertexInput v2){
+	v0 = loadVertex(triId, 0);
+	v1 = loadVertex(triId, 1);
+	v2 = loadVertex(triId, 2);
+}
+
+/// Perspective-correct barycentric coordinates of a pixel in its triangle, and their differences with the next pixels along x and y
+struct Barycentrics{
+	vec3 b;
+	vec3 ddx;
+	vec3 ddy;
+};
+
+/// Returns the barycentric coordinates of the pixel at screen position screenUv (0..1) in a triangle, from the triangle setup of the frame;
+/// pixelSize is the size of a pixel in screen uv
+Barycentrics getTriangleBarycentrics(uint triId, vec2 screenUv, vec2 pixelSize){
+	uint viewOffset = uint(VIEW_INDEX) * (uint(ssboSetup.triangles.length()) / MULTIVIEW_VIEWS);// triangles set up for the view shaded
+	TriangleSetup setup = ssboSetup.triangles[viewOffset + triId];
+	vec2 ndc = screenUv * 2.0 - 1.0;
+
+	Barycentrics barycentrics;
+	barycentrics.b = getSetupBarycentrics(setup, ndc);
+	barycentrics.ddx = getSetupBarycentrics(setup, ndc + vec2(pixelSize.x * 2.0, 0.0)) - barycentrics.b;
+	barycentrics.ddy = getSetupBarycentrics(setup, ndc + vec2(0.0, pixelSize.y * 2.0)) - barycentrics.b;
+	return barycentrics;
+}
+
+/// Vertex interpolated at a pixel, with the screen-space derivatives of its uv (for texture filtering)
+struct Interpolated{
+	VertexInput v;
+	vec2 uvDx;
+	vec2 uvDy;
+};
+
+/// Interpolates the 3 world space vertices of a triangle at a pixel
+Interpolated interpolateTriangle(VertexInput v0, VertexInput v1, VertexInput v2, Barycentrics barycentrics){
+	Interpolated i;
+	i.v = lerp3V(v0, v1, v2, barycentrics.b);
+	mat3x2 uvs = mat3x2(getVertexUV(v0), getVertexUV(v1), getVertexUV(v2));
+	i.uvDx = uvs * barycentrics.ddx;
+	i.uvDy = uvs * barycentrics.ddy;
+	return i;
+}
+
+
+
+
+/// Shade a fragment by applying a texture (filtered with the analytic uv derivatives, as the pixels of a quad may belong to different triangles) and lighting.
+vec3 shadeTextured(Interpolated i, sampler2D tex){
+	vec3 worldPos = getVertexPos(i.v).xyz;
+	vec3 worldNormal = getVertexNormal(i.v).xyz;
+	vec2 uv = getVertexUV(i.v);
+
+	
+	vec3 albedo = textureGrad(tex, uv, i.uvDx, i.uvDy).rgb;
+
+	return lightFragment(albedo, worldPos, worldNormal);
+}
+
+
+// Shrimp fragment shader
+vec3 shadeFragmentShrimp(Interpolated i){
+	return shadeTextured(i, shrimpSampler);
+}
+
+// Raccoon fragment shader
+vec3 shadeFragmentRaccoon(Interpolated i){
+	return shadeTextured(i, raccoonSampler);
+}
+
+
+
+#ifdef VISIBILITY_PARTICLE_IDS
+/// Reconstructs the uv of the particle with the index given at screen position screenUv, by intersecting the fragment's view ray with the particle's view-facing quad
+/// (as drawn to the view shaded)
+vec2 reconstructParticleUV(uint particleIndex, vec2 screenUv){
+	
+	vec4 p = particle(particleIndex);
+#ifdef PARTICLE_LOD_1
+	p.w *= particleLod(p, particleIndex, false);// size drawn by the particle pass (particles in the V-Buffer were kept)
+#endif
+	vec3 centre = (ubo.views[VIEW_INDEX] * vec4(p.xyz, 1)).xyz;
+
+	// view space position on the plane of the quad (z = centre.z) that projects onto this fragment; assumes a projection without skew
+	vec2 ndc = screenUv * 2.0 - 1.0;
+	float w = ubo.proj[2][3] * centre.z + ubo.proj[3][3];
+	vec2 xy = (ndc * w - ubo.proj[2].xy * centre.z - ubo.proj[3].xy) / vec2(ubo.proj[0][0], ubo.proj[1][1]);
+
+	return clamp((xy - centre.xy) / p.w * 0.5 + 0.5, 0.0, 1.0);
+}
+#endif
+
+
+
+/// Depending on the particle mode, use different textures
+#define VISIBILITY_BUFFER_PARTICLE_FRAGMENT
+#if defined(PARTICLE_CUTOUT_MODE_1) || (defined(PARTICLE_SPRITE_CACHE_1) && (defined(PARTICLE_COMPLEXITY_1) || defined(PARTICLE_COMPLEXITY_3)))
+#define texSampler particleSampler // leaf texture, or sprite cache of the particle system
+#else
+#define texSampler shrimpSampler
+#endif
+#include "particles_v.glsl" // provides the definition for shadeParticleFragment().
+#undef texSampler
+
+
+
+#ifdef LIGHTING_V_LOAD_TRIANGLE
+void LIGHTING_V_LOAD_TRIANGLE(uint triId, out VertexInput v0, out VertexInput v1, out VertexInput v2);// defined by the includer
+#endif
+
+/// Shades the visible surface decoded from the V-Buffer at screen position screenUv (0..1): albedo + lighting, or one of the debug views;
+/// pixelSize is the size of a pixel in screen uv
+vec4 shadeVisibility(Visibility visibility, vec2 screenUv, vec2 pixelSize){
+
+	vec2 uv = visibility.uv;
+	uint triId = visibility.id;
+#ifdef LIGHTING_V_MATERIAL
+	const uint matId = LIGHTING_V_MATERIAL;// specialized shading: the branches of other materials are compiled out
+#else
+	uint matId = visibility.matId;
+#endif
+	vec4 colour;
+
+
+	// Caution: potential wavefront divergence here :)
+
+	
+	// A material ID of 0 means no objects on the current fragment.
+	if(matId == 0){
+		colour = CLEAR_COLOUR;
+	}else if(matId == PARTICLES_MAT){
+		
+		// Particle fragment here
+#ifdef VISIBILITY_PARTICLE_IDS
+		uv = reconstructParticleUV(visibility.id, screenUv);
+#endif
+		colour = shadeParticleFragment(uv);
+
+	}else{
+		
+		// load the vertices of the triangle in world space, and interpolate them at the pixel (barycentrics from the triangle setup, whatever the V-Buffer stores)
+		VertexInput v0, v1, v2;
+#ifdef LIGHTING_V_LOAD_TRIANGLE
+		LIGHTING_V_LOAD_TRIANGLE(triId, v0, v1, v2);
+#else
+		loadTriangle(triId, v0, v1, v2);
+#endif
+		Interpolated i = interpolateTriangle(v0, v1, v2, getTriangleBarycentrics(triId, screenUv, pixelSize));
+		VertexInput v = i.v;
+		uv = getVertexUV(v);
+
+		//execute "fragment" shader code for vertex to get final fragment color
+		if(matId == SHRIMP_MAT){// Shrimp
+			colour = vec4(shadeFragmentShrimp(i), 1.0);
+		}else if(matId == RAYMARCH_MAT){// Raymarch
+			colour = vec4(lightFragment(raymarch(getVertexUV(v), uboMatrix.time), getVertexPos(v).xyz, getVertexNormal(v).xyz), 1.0);
+		}else if(matId == RACCOON_MAT){// Raccoon
+			colour = vec4(shadeFragmentRaccoon(i), 1.0);
+		}else{// Undefined material
+			colour = vec4(1.0, 0.0, 1.0, 0.0);// magenta.
+		}
+	}
+
+
+#ifdef EXPECT_DEBUG_BUFFER
+	// Show debug views
+	if(uboDebug.value == 1){// Visibility UV
+		colour = vec4(uv, 0, 1);
+	}else if(uboDebug.value == 2){// Primitive ID
+		colour = vec4(float(triId % uint(DEBUG_TRIANGLE_ID_RANGE)) / DEBUG_TRIANGLE_ID_RANGE);
+	}else if(uboDebug.value == 3){// Material ID
+		colour = vec4(float(matId) / 4);
+	}
+#endif
+
+	return colour;
+}
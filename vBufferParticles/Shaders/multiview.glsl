@@ -0,0 +1,22 @@
+
+/// Multiview stereo (see Multiview.h): the UBOs of the drawing shaders end with the view matrix of each of the MULTIVIEW_VIEWS views, which the vertex and
+/// geometry stages select with VIEW_INDEX (the view being rendered under MULTIVIEW_1, always 0 otherwise, where every view matrix is the camera's).
+/// The full-screen lighting pass of the V-Buffer renderer shades each view in its own layer too, with VIEW_INDEX selecting its matrices.
+/// Stages outside of the draws (compute, other passes) #define MULTIVIEW_NO_VIEW_INDEX before including this file: they have no view index (the V-Buffer triangle
+/// setup picks the matrix of each view explicitly).
+/// Only the first inclusion counts, so that VIEW_INDEX is decided by the stage (see lighting_v.glsl, which includes particles.glsl afterwards).
+
+#ifndef MULTIVIEW_VIEWS
+
+#include "../__.defines"
+
+#define MULTIVIEW_VIEWS 2 // must match Utils.h
+
+#if defined(MULTIVIEW_1) && !defined(MULTIVIEW_NO_VIEW_INDEX)
+	#extension GL_EXT_multiview : require
+	#define VIEW_INDEX gl_ViewIndex
+#else
+	#define VIEW_INDEX 0
+#endif
+
+#endif // MULTIVIEW_VIEWS
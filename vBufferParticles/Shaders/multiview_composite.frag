@@ -0,0 +1,29 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+/// Presents the eyes rendered at once by multiview stereo (see Multiview.h) side by side: the first layer of the stereo target (left eye) on the left half
+/// of the render area, the second on the right half.
+
+
+/// Colour of the eyes, one per layer
+layout(binding = 0) uniform sampler2DArray eyes;
+
+/// Width of the area rendered in each eye (at the current render scale)
+layout(push_constant) uniform Constants {
+	int eyeWidth;
+} constants;
+
+/// Input data per fragment: screen uv coordinate
+layout(location = 0) in vec2 iSPUv;
+
+/// Output fragment colour
+layout(location = 0) out vec4 oColor;
+
+
+void main(){
+
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	int eye = pixel.x >= constants.eyeWidth ? 1 : 0;
+	oColor = texelFetch(eyes, ivec3(pixel.x - eye * constants.eyeWidth, pixel.y, eye), 0);
+
+}
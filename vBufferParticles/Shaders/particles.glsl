@@ -1,10 +1,29 @@
 
 /// Provides the definition for particle() function which, given a particle index, returns its position and half-size at time t.
+/// Shaders that only read particles generated by compute should #define PARTICLES_FROM_SSBO before including this file; particles.comp #defines STATICS_BINDING.
+/// Shaders re-generating particles outside of the particle passes (V-Buffer lighting pass) #define PARTICLES_UBO_BINDING and STATICS_BINDING.
+/// The generation stages of the particle draws #define PARTICLE_DRAW_STAGE: they count the particles dropped by the distance LOD (PARTICLE_LOD_1), and draw
+/// the particles listed by the occlusion culling (see drawnParticle()), projected with the matrix of the view they are drawn to in multiview stereo (see drawnView()).
 
 
-#include "random.glsl"
+#include "../__.defines"
+#ifndef PARTICLE_DRAW_STAGE
+	#define MULTIVIEW_NO_VIEW_INDEX // only the draws have views
+#endif
+#include "multiview.glsl" // ahead of any code, as it may enable an extension
+#include "particles_statics.glsl"
 
-layout (set = 0, binding = 0) uniform UBO {
+#ifndef PARTICLES_UBO_BINDING
+	#define PARTICLES_UBO_BINDING 0
+#endif
+
+// cut-out particles may be drawn as a polygon fitted to the opaque region of their texture instead of a quad (see ParticleSystem::usesHull())
+#if defined(PARTICLE_HULL_1) && defined(PARTICLE_CUTOUT_MODE_1)
+	#define PARTICLE_HULL
+#endif
+#define PARTICLE_HULL_VERTICES 8 // must match Particles.h
+
+layout (set = 0, binding = PARTICLES_UBO_BINDING) uniform UBO {
 	mat4 view;
 	mat4 proj;
 	float time;
@@ -13,27 +32,80 @@ layout (set = 0, binding = 0) uniform UBO {
 	float gravity;
 	float initialUpwardsForce;
 	uint particleCount;
+	mat4 previousView;// view of the previous frame (motion vectors)
+	float previousTime;// time of the previous frame (motion vectors)
+	vec2 jitter;// sub-pixel offset of the frame, in clip space (temporal upscaling)
+	float lodSize;// projected half size (ndc) below which the distance LOD drops particles
+	float lodMinKeep;// lowest fraction of the particles kept by the distance LOD
+	uint staticsBaked;// 1 -> the baked statics are read back; 0 -> they could not be baked (only a placeholder is bound) and are hashed instead
+	vec4 hull[PARTICLE_HULL_VERTICES / 2];// corners of the cut-out polygon (quad uv multipliers, -1..1), two per element in triangle strip order
+	mat4 views[MULTIVIEW_VIEWS];// view matrix of each eye in multiview stereo (see drawnView())
 } ubo;
 
-#define VERTICES_PER_PARTICLE 6
+// vertices drawn per particle as a triangle list: a quad, or the triangles of the strip of the cut-out polygon
+#ifdef PARTICLE_HULL
+	#define VERTICES_PER_PARTICLE (3 * (PARTICLE_HULL_VERTICES - 2))
+#else
+	#define VERTICES_PER_PARTICLE 6
+#endif
 
+/// Returns the uv multipliers (-1..1) of the i-th corner of the cut-out polygon, in triangle strip order
+vec2 hullCorner(uint i){
+	vec4 corners = ubo.hull[i / 2];
+	return i % 2 == 0 ? corners.xy : corners.zw;
+}
 
-/// Returns the center of a particle based on the particle's index in view space
-/// The half-size of the particle is returned as the w coordinate
-vec4 particle(uint particleIndex){
+/// Returns the uv multipliers (-1..1) of a vertex of a particle drawn as a triangle list (VERTICES_PER_PARTICLE vertices)
+vec2 particleCorner(uint vIndex){
+#ifdef PARTICLE_HULL
+	uint triangle = vIndex / 3;
+	uint corner = vIndex % 3;
+	if(triangle % 2 == 1 && corner < 2) corner = 1 - corner;// odd triangles of a strip swap their first two corners, to keep the winding
+	return hullCorner(triangle + corner);
+#else
+	const vec2 quadUVs[6] = {vec2(-1, -1), vec2(1, -1), vec2(1, 1), vec2(-1, -1), vec2(1, 1), vec2(-1, 1)};
+	return quadUVs[vIndex];
+#endif
+}
+
+/// Range of particles covered by the current draw or dispatch; work is split into several calls so per-call vertex/invocation indices stay small for large particle counts
+/// (left out by includers with push constants of their own, which never draw ranges of particles: PARTICLES_NO_RANGE)
+#ifndef PARTICLES_NO_RANGE
+layout(push_constant) uniform Range {
+	uint firstParticle;	// index of the first particle of the call
+	uint count;			// amount of particles in the call
+	uint firstElement;	// (comp/comp only) index in the bound SSBO at which the call's particles are stored
+	uint visibleList;	// 1 -> the call draws the particles listed by the occlusion culling (particles_cull.comp) rather than its range
+} range;
+#endif
+
+#if defined(PARTICLE_BAKED_STATICS_1) && !defined(PARTICLES_FROM_SSBO)
+	// static attributes baked by particles_bake.comp, bound after the UBO (and after the particles SSBO in comp/comp)
+	#ifndef STATICS_BINDING
+		#define STATICS_BINDING 1
+	#endif
+	layout(std430, set = 0, binding = STATICS_BINDING) readonly buffer Statics {
+		vec4 bakedStatics [];
+	};
+#endif
+
+
+/// Returns the time-invariant attributes of a particle: direction (xyz) and lifetime offset (w)
+vec4 staticsOf(uint particleIndex){
+#if defined(PARTICLE_BAKED_STATICS_1) && !defined(PARTICLES_FROM_SSBO)
+	if(ubo.staticsBaked != 0) return bakedStatics[particleIndex];// single load instead of hashing
+#endif
+	return particleStatics(particleIndex);
+}
+
+/// Returns the center of a particle with the given attributes at a point of its lifetime (0..1), with its half-size as the w coordinate
+vec4 particleAt(vec4 statics, float lifetime){
 	vec3 position;
 	float size;
 
 	vec3 origin = (0).xxx;
 
-	vec3 seed = float(particleIndex).xxx + vec3(0, 1928.219, 2109.3002);
-	vec3 rand = vec3(random(seed.x), random(seed.y), random(seed.z));// 0..1
-
-	
-
-	vec3 direction = normalize(rand-0.5)*2;// random point on sphere of radius 1 and center 0
-	direction *= random(rand.x) * ubo.density; // map length of direction to 0..density
-	float lifetime = mod(ubo.time+random(seed.x+seed.y), 1); // from 0 to 1 over the particle's lifetime
+	vec3 direction = statics.xyz * ubo.density; // map length of direction to 0..density
 
 	position = origin + (direction+vec3(0, ubo.initialUpwardsForce, 0)) * lifetime + vec3(0, -ubo.gravity, 0) * lifetime * lifetime;
 	size = 1-abs(0.5-lifetime)*2;// 0 -> 1 -> 0
@@ -41,3 +113,93 @@ vec4 particle(uint particleIndex){
 
 	return vec4(position, size);
 }
+
+/// Returns the center of a particle based on the particle's index in view space
+/// The half-size of the particle is returned as the w coordinate
+vec4 particle(uint particleIndex){
+	vec4 statics = staticsOf(particleIndex);
+	float lifetime = mod(ubo.time+statics.w, 1); // from 0 to 1 over the particle's lifetime
+	return particleAt(statics, lifetime);
+}
+
+#ifdef PARTICLE_LOD_1
+#define PARTICLE_LOD_COUNT_STRIDE 16 // one particle out of this many counts when dropped (must match Particles.h)
+
+#ifdef PARTICLE_DRAW_STAGE
+	// culled particles counter, bound after the UBO and the particles SSBO or baked statics (reset by the host)
+	#if defined(PARTICLES_FROM_SSBO) || defined(PARTICLE_BAKED_STATICS_1)
+		#define PARTICLE_LOD_BINDING 2
+	#else
+		#define PARTICLE_LOD_BINDING 1
+	#endif
+	layout(std430, set = 0, binding = PARTICLE_LOD_BINDING) buffer LodStats {
+		uint culled;// particles dropped out of a sample of 1 in PARTICLE_LOD_COUNT_STRIDE
+	} lodStats;
+#endif
+
+/// Distance LOD: returns the factor scaling the half size of a particle, 0 if it is dropped. A particle whose projected half size s is below ubo.lodSize is
+/// kept with probability k = max((s / lodSize)^2, lodMinKeep), selected by a hash of its index, and grows by 1 / sqrt(k) so that the area covered holds
+/// (below the minimum, survivors reach lodSize). count: whether a dropped particle adds to the culled counter (once per particle).
+float particleLod(vec4 p, uint particleIndex, bool count){
+	float depth = max(-(ubo.view * vec4(p.xyz, 1)).z, 1e-4);
+	float projected = p.w * abs(ubo.proj[1][1]) / depth;
+	float keep = clamp((projected * projected) / (ubo.lodSize * ubo.lodSize), ubo.lodMinKeep, 1.0);
+	if(keep >= 1.0) return 1.0;
+	if(floatConstruct(hash(uvec2(particleIndex, 6u))) < keep) return inversesqrt(keep);
+#ifdef PARTICLE_DRAW_STAGE
+	if(count && particleIndex % PARTICLE_LOD_COUNT_STRIDE == 0 && VIEW_INDEX == 0) atomicAdd(lodStats.culled, 1u);// once over all views
+#endif
+	return 0.0;
+}
+#endif
+
+#ifdef PARTICLE_DRAW_STAGE
+// particles listed by the occlusion culling, bound after the buffers above (a placeholder when the particles are not culled)
+#if defined(PARTICLE_LOD_1)
+	#define PARTICLE_VISIBLE_BINDING (PARTICLE_LOD_BINDING + 1)
+#elif defined(PARTICLES_FROM_SSBO) || defined(PARTICLE_BAKED_STATICS_1)
+	#define PARTICLE_VISIBLE_BINDING 2
+#else
+	#define PARTICLE_VISIBLE_BINDING 1
+#endif
+layout(std430, set = 0, binding = PARTICLE_VISIBLE_BINDING) readonly buffer VisibleList {
+	uvec4 drawArgs;// indirect draw arguments of the call
+	uint visibleCount;
+	uint visibleIndices [];
+} visibleList;
+
+/// Returns the index of the n-th particle drawn by the current call
+uint drawnParticle(uint n){
+	return range.visibleList != 0 ? visibleList.visibleIndices[n] : range.firstParticle + n;
+}
+
+/// Returns the amount of particles drawn by the current call
+uint drawnCount(){
+	return range.visibleList != 0 ? visibleList.visibleCount : range.count;
+}
+
+/// Returns the view matrix the particles are projected with: that of the eye rendered in multiview stereo, the camera's otherwise. Only the projection
+/// depends on the view: particles are generated, LOD-selected and culled once from the camera (ubo.view), the same for every view.
+mat4 drawnView(){
+	return ubo.views[VIEW_INDEX];
+}
+#endif
+
+#ifdef TEMPORAL_UPSCALING_1
+/// Returns the particle as it was at the previous frame; its lifetime is not wrapped, so that particles respawning in between move continuously from before their birth (size clamped to 0)
+vec4 previousParticle(uint particleIndex){
+	vec4 statics = staticsOf(particleIndex);
+	float lifetime = mod(ubo.time+statics.w, 1) - (ubo.time - ubo.previousTime);
+	vec4 p = particleAt(statics, lifetime);
+	return vec4(p.xyz, max(p.w, 0));
+}
+
+/// Returns the jittered clip position of a quad corner (uv: -1..1) of a particle, and its screen uv motion since the previous frame (unjittered).
+/// Quads face the camera, so w is constant over each quad and the motion of the corners interpolates linearly: it is passed as a vertex output.
+vec4 particleCornerMotion(vec4 p, vec4 previous, vec2 uv, out vec2 velocity){
+	vec4 clip = ubo.proj * ((ubo.view * vec4(p.xyz, 1)) + vec4(uv * p.w, 0, 0));
+	vec4 previousClip = ubo.proj * ((ubo.previousView * vec4(previous.xyz, 1)) + vec4(uv * previous.w, 0, 0));
+	velocity = (clip.xy / clip.w - previousClip.xy / previousClip.w) * 0.5;
+	return clip + vec4(ubo.jitter * clip.w, 0, 0);
+}
+#endif
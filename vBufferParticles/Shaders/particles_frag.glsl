@@ -1,37 +1,69 @@
 
 
 /// Provides definition for particleFragment() function which, given a particle's UVs, returns the final colour; output will heavily depend on contents of __.defines file, modified at runtime each time this shader is recompiled.
+/// Includers that only test the coverage of cut-out particles (V-Buffer first pass) #define PARTICLE_COVERAGE_MASK: particleCovered() then replaces particleFragment().
 
 
 #include "../__.defines"
 
 
+// with the sprite cache, complexity levels that only depend on the uv sample the sprite baked by particles_sprite.comp (which defines PARTICLE_SPRITE_BAKE to shade it)
+#if defined(PARTICLE_SPRITE_CACHE_1) && (defined(PARTICLE_COMPLEXITY_1) || defined(PARTICLE_COMPLEXITY_3)) && !defined(PARTICLE_SPRITE_BAKE)
+	#define PARTICLE_SPRITE_CACHED
+#endif
 
 
 #ifndef VISIBILITY_BUFFER_PARTICLE_FRAGMENT // in V-Buffer, texture is provided by lighting pass' fragment shader instead.
-	#ifdef PARTICLE_COMPLEXITY_2
-		// determine where the texture is bound (0 if the particles were created via compute only, 1 otherwise)
+	#if defined(PARTICLE_COMPLEXITY_2) || defined(PARTICLE_SPRITE_CACHED)
+		// determine where the texture is bound (2 if the particles were created via compute, after the UBO and particles SSBO; otherwise after the UBO and baked statics if any)
 		#ifdef COMP_PARTICLE_FRAGMENT
-			#define TEX_BINDING 0
+			#define TEX_BINDING_AFTER_BUFFERS 2
+		#elif defined(PARTICLE_BAKED_STATICS_1)
+			#define TEX_BINDING_AFTER_BUFFERS 2
+		#else
+			#define TEX_BINDING_AFTER_BUFFERS 1
+		#endif
+		// (and after the culled particles counter of the distance LOD, then the visible list of the occlusion culling)
+		#ifdef PARTICLE_LOD_1
+			#define TEX_BINDING (TEX_BINDING_AFTER_BUFFERS + 2)
 		#else
-			#define TEX_BINDING 1
+			#define TEX_BINDING (TEX_BINDING_AFTER_BUFFERS + 1)
 		#endif
+		#ifdef PARTICLE_COVERAGE_MASK
+		// coverage of the cut-out texture, in place of the texture (see ParticleSystem::buildCoverageMask())
+		#define PARTICLE_COVERAGE_MASK_SIZE 64 // must match Particles.h
+		layout(binding = TEX_BINDING) uniform CoverageMask {
+			uvec4 words[PARTICLE_COVERAGE_MASK_SIZE * PARTICLE_COVERAGE_MASK_SIZE / 128];// 32 cells per uint, row-major
+		} coverageMask;
+		#else
 		// texture attachment
 		layout(binding = TEX_BINDING) uniform sampler2D texSampler;
+		#endif
 	#endif
 #endif
 
-#ifdef PARTICLE_COMPLEXITY_3
+#if defined(PARTICLE_COMPLEXITY_3) && !defined(PARTICLE_SPRITE_CACHED) && !defined(PARTICLE_COVERAGE_MASK)
 	#include "raymarch.glsl"
 #endif
 
 
 
+#ifdef PARTICLE_COVERAGE_MASK
+/// Returns whether the cut-out texture is opaque (alpha >= 0.5) at a particle's UV coordinate: a single bit of a uniform, instead of a texture sample
+bool particleCovered(vec2 uv){
+	uvec2 cell = min(uvec2((1 - uv) * PARTICLE_COVERAGE_MASK_SIZE), uvec2(PARTICLE_COVERAGE_MASK_SIZE - 1));// same orientation as the sample in particleFragment()
+	uint bit = cell.y * PARTICLE_COVERAGE_MASK_SIZE + cell.x;
+	return (coverageMask.words[bit / 128][(bit / 32) % 4] & (1u << (bit % 32))) != 0;
+}
+#else
 
 /// Shades a particle fragment from its UV coordinate.
 vec4 particleFragment(vec2 uv){
 	
-#ifdef PARTICLE_COMPLEXITY_0
+#ifdef PARTICLE_SPRITE_CACHED
+	vec2 halfTexel = 0.5 / vec2(textureSize(texSampler, 0));
+	return texture(texSampler, clamp(uv, halfTexel, 1 - halfTexel)); // single sample of the cached sprite (clamped, as the sampler repeats)
+#elif defined(PARTICLE_COMPLEXITY_0)
 	return vec4(uv, 1, 1); // simple passing of argument
 #elif defined(PARTICLE_COMPLEXITY_1)
 	return vec4(uv.x < 0.9 && uv.y < 0.9 ? sqrt(sqrt(sqrt(sqrt(sqrt(sqrt(sqrt(sqrt(sqrt(sqrt(uv)))))))))) : uv.xy, 0, 1); // lots of sqrt's, and trivial wavefront divergence
@@ -44,4 +76,5 @@ vec4 particleFragment(vec2 uv){
 #endif
 
 }
+#endif
 
@@ -1,17 +1,46 @@
-
 #version 450
 
-/// Vertex shader for comp/comp particles
+/// Vertex shader for comp/comp particles: expands the world-space particles generated by particles.comp into view-facing quads.
+
+#define PARTICLES_FROM_SSBO // particles are read from the SSBO rather than generated here
+#define PARTICLE_DRAW_STAGE // counts the particles dropped by the distance LOD (applied here, as the generated particles do not depend on the camera), and draws the particles listed by the occlusion culling
+#include "particles.glsl"
 
-layout(location = 0) in vec3 iPosition;
-layout(location = 1) in vec3 iNormal; // unused - iNormal.x contains position.w in clip space.
-layout(location = 2) in vec2 iUv;
+// Particle storage buffer written by the compute pass
+layout(std430, set = 0, binding = 1) readonly buffer Particles {
+   vec4 particles []; // xyz: world-space center; w: half size
+};
 
 layout (location = 0) out vec2 oUv;
+layout (location = 1) flat out uint oParticleId;// global particle index (V-Buffer particle ID encoding)
+#ifdef TEMPORAL_UPSCALING_1
+layout (location = 2) out vec2 oVelocity;// screen uv motion since the previous frame (velocity of the G-Buffer renderers)
+#endif
 
 void main(){
 	
-	gl_Position = vec4(iPosition, iNormal.x);
-	oUv = iUv;
+	// find particle index (within the draw's range, or the visible list) and vertex index within the particle
+	uint index = gl_VertexIndex;
+	uint pIndex = index / VERTICES_PER_PARTICLE;
+	uint vIndex = index % VERTICES_PER_PARTICLE;
+	uint particleIndex = drawnParticle(pIndex);
+
+	vec2 uv = particleCorner(vIndex);// quad corner, or corner of the cut-out polygon
+
+	// fetch the particle's position and size as generated by the compute pass
+	vec4 p = particles[range.firstElement + (particleIndex - range.firstParticle)];
+	float lod = 1.0;
+#ifdef PARTICLE_LOD_1
+	lod = particleLod(p, particleIndex, vIndex == 0);// dropped particles collapse to a point (degenerate triangles are discarded before rasterization)
+	p.w *= lod;
+#endif
+
+	// fill output data
+	gl_Position = ubo.proj * ((drawnView() * vec4(p.xyz, 1)) + vec4(uv * p.w, 0, 0)); // expand to quad in view space before projecting to clip space.
+#ifdef TEMPORAL_UPSCALING_1
+	gl_Position = particleCornerMotion(p, previousParticle(particleIndex) * vec4(1, 1, 1, lod), uv, oVelocity);// previous state re-generated from the hashed statics
+#endif
+	oUv = uv * 0.5 + 0.5;
+	oParticleId = particleIndex;
 
 }// main
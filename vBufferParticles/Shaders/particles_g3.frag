@@ -3,13 +3,17 @@
 /// Common fragment shader for particles in G-Buffer (3) renderer, except comp/comp particles.
 
 #include "particles_frag.glsl"
+#include "gbuffer.glsl"
 
 layout (location = 0) in vec2 iUv;
+#ifdef TEMPORAL_UPSCALING_1
+layout (location = 2) in vec2 iVelocity;
+#endif
 
-// G-Buffer writes
-layout(location = 0) out vec4 oAlbedo;
-layout(location = 1) out vec4 oPosition;
-layout(location = 2) out vec4 oNormal;
+// G-Buffer writes (albedo, position & normal: see gbuffer.glsl)
+#ifdef TEMPORAL_UPSCALING_1
+layout(location = GBUFFER_EXTRA_LOCATION) out vec2 oVelocity;// screen uv motion since the previous frame (see TemporalUpscaler.h)
+#endif
 
 void main(){
 	
@@ -19,6 +23,10 @@ void main(){
 	if(oAlbedo.a < 0.5) discard; // <- selectively discard fragments based on texel transparency
 	#endif
 
-	oPosition = oNormal = (0).xxxx; // <- no need for this data for particles
+	gBufferWriteUnlit(); // <- particles are not lit: no need for position or normal data
+
+#ifdef TEMPORAL_UPSCALING_1
+	oVelocity = iVelocity;
+#endif
 
 }// main
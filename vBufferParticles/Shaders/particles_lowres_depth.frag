@@ -0,0 +1,37 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+/// First draw of the particle layer (see ParticleUpsampler.h): copies the scene depth at the layer resolution, keeping the furthest depth of each texel footprint
+/// so that particles are only rejected where the scene hides all of it (the upsample then tests them against each full resolution pixel). The colour is
+/// marked as empty (alpha -1) until a particle overwrites it.
+
+
+/// Scene depth at full resolution
+layout(binding = 0) uniform sampler2D sceneDepth;
+
+/// Full resolution pixels per layer texel along x and y (same layout as UpsampleConstants in ParticleUpsampler.h)
+layout(push_constant) uniform UpsampleConstants{
+	vec2 depthTerms;
+	int factor;
+} constants;
+
+/// Input data per fragment: screen uv coordinate
+layout(location = 0) in vec2 iSPUv;
+
+/// Output fragment colour
+layout(location = 0) out vec4 oColor;
+
+
+void main(){
+
+	ivec2 sceneSize = textureSize(sceneDepth, 0);
+	ivec2 first = ivec2(gl_FragCoord.xy) * constants.factor;
+
+	float depth = 0;
+	for(int y = 0; y < constants.factor; ++y)
+		for(int x = 0; x < constants.factor; ++x)
+			depth = max(depth, texelFetch(sceneDepth, min(first + ivec2(x, y), sceneSize - 1), 0).r);
+
+	gl_FragDepth = depth;
+	oColor = vec4(0, 0, 0, -1);
+}
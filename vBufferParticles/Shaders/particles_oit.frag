@@ -0,0 +1,16 @@
+#version 450
+
+/// Fragment shader for particles drawn with weighted blended transparency (except comp/comp particles).
+
+#include "particles_oit.glsl"
+
+layout (location = 0) in vec2 iUv;
+
+layout (location = 0) out vec4 oAccumulation;
+layout (location = 1) out vec4 oCoverage;
+
+void main(){
+
+	particleTransparency(iUv, oAccumulation, oCoverage);
+
+}// main
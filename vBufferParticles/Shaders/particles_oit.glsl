@@ -0,0 +1,31 @@
+/// Weighted blended transparency of the particles (see ParticleOIT.h), shared by the forward fragment shaders of all generation modes. Each fragment adds its
+/// premultiplied colour and opacity, scaled by a weight falling off with its view depth, to the accumulation, and composites its opacity into the coverage;
+/// the composite then divides the accumulated colour by the accumulated opacity, so that the result does not depend on the order fragments were blended in.
+
+
+#include "particles_frag.glsl"
+
+/// Opacity of the particles, applied over the alpha of their shading
+#define PARTICLE_OIT_OPACITY 0.5
+/// Weights are clamped so that the sum of a few hundred overlapping particles still fits in the 16-bit float accumulation
+#define PARTICLE_OIT_MIN_WEIGHT 1e-2
+#define PARTICLE_OIT_MAX_WEIGHT 3e2
+
+
+/// Returns the weight of a fragment of the given opacity: close fragments dominate the average colour (McGuire & Bavoil, JCGT 2013, eq. 9)
+float particleWeight(float alpha){
+	float viewDepth = 1.0 / gl_FragCoord.w;// w of the clip position, ie. the view depth
+	return alpha * clamp(10.0 / (1e-5 + pow(viewDepth / 5.0, 2.0) + pow(viewDepth / 200.0, 6.0)), PARTICLE_OIT_MIN_WEIGHT, PARTICLE_OIT_MAX_WEIGHT);
+}
+
+/// Writes the accumulation (premultiplied colour and opacity, weighted) and coverage (opacity) of a particle fragment from its UV coordinate
+void particleTransparency(vec2 uv, out vec4 accumulation, out vec4 coverage){
+
+	vec4 colour = particleFragment(uv);
+	float alpha = colour.a * PARTICLE_OIT_OPACITY;// cut-out particles fade out with their texture instead of being discarded at 0.5
+	if(alpha < 1.0 / 255.0) discard;
+
+	accumulation = vec4(colour.rgb * alpha, alpha) * particleWeight(alpha);
+	coverage = vec4(alpha);// 1 - product of (1 - alpha), as blended over the coverage cleared to 0
+
+}
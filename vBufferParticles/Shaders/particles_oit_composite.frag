@@ -0,0 +1,29 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+/// Composites the weighted blended transparency of the particles (see ParticleOIT.h) over the scene: the accumulated colour, divided by the accumulated
+/// opacity, is the weighted average colour of the particles over the pixel, and covers the scene by the opacity composited in the coverage.
+
+
+/// Accumulation (weighted premultiplied colour and opacity) and coverage of the particle layer
+layout(binding = 0) uniform sampler2D accumulation;
+layout(binding = 1) uniform sampler2D coverage;
+
+/// Input data per fragment: screen uv coordinate
+layout(location = 0) in vec2 iSPUv;
+
+/// Output fragment colour (blended over the scene as premultiplied alpha)
+layout(location = 0) out vec4 oColor;
+
+
+void main(){
+
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	float covered = texelFetch(coverage, pixel, 0).r;
+	if(covered <= 0) discard;// no particle
+
+	vec4 accumulated = texelFetch(accumulation, pixel, 0);
+	vec3 average = accumulated.rgb / max(accumulated.a, 1e-5);
+	oColor = vec4(average * covered, covered);
+
+}
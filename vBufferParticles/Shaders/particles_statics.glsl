@@ -0,0 +1,19 @@
+/// Provides the definition for particleStatics() function which, given a particle index, returns the attributes of the particle that do not change over time,
+/// as baked once per particle by particles_bake.comp.
+
+
+#include "random.glsl"
+
+
+/// Returns the time-invariant attributes of a particle: xyz is its direction of travel (before scaling by the spread/density), w its lifetime offset (0..1)
+vec4 particleStatics(uint particleIndex){
+
+	// seeds are hashed from the integer index (the hash is a bijection, so every particle gets distinct values; float indices lose precision past 2^24 particles)
+	vec3 rand = vec3(floatConstruct(hash(uvec2(particleIndex, 1u))), floatConstruct(hash(uvec2(particleIndex, 2u))), floatConstruct(hash(uvec2(particleIndex, 3u))));// 0..1
+
+	vec3 direction = normalize(rand-0.5)*2;// random point on sphere of radius 1 and center 0
+	direction *= floatConstruct(hash(uvec2(particleIndex, 4u))); // random length 0..1 (scaled by density in particle())
+	float lifetimeOffset = floatConstruct(hash(uvec2(particleIndex, 5u)));
+
+	return vec4(direction, lifetimeOffset);
+}
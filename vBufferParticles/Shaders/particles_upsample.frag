@@ -0,0 +1,18 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+/// Composites the reduced resolution particle layer over the scene (blended as premultiplied alpha), upsampled against the full resolution scene depth.
+
+
+#include "particles_upsample.glsl"
+
+/// Input data per fragment: screen uv coordinate
+layout(location = 0) in vec2 iSPUv;
+
+/// Output fragment colour
+layout(location = 0) out vec4 oColor;
+
+
+void main(){
+	oColor = upsampleParticles(ivec2(gl_FragCoord.xy));
+}
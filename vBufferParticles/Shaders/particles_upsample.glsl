@@ -0,0 +1,50 @@
+/// Depth-aware upsampling of the reduced resolution particle layer (see ParticleUpsampler.h), shared by the composite pass and the difference measurement.
+/// Each full resolution pixel blends the 4 nearest layer texels bilinearly, dropping those whose particle lies behind the scene depth of the pixel itself:
+/// particles then stop at the exact edges of the scene geometry, even though they were only rasterized against the furthest depth of each texel footprint.
+
+
+/// Scene depth at full resolution, and the particle layer: colour (alpha is -1 where no particle was drawn) and depth
+layout(binding = 0) uniform sampler2D sceneDepth;
+layout(binding = 1) uniform sampler2D particleColour;
+layout(binding = 2) uniform sampler2D particleDepth;
+
+/// Depth terms of the projection, and full resolution pixels per layer texel along x and y (same layout as UpsampleConstants in ParticleUpsampler.h)
+layout(push_constant) uniform UpsampleConstants{
+	vec2 depthTerms;// proj[2][2], proj[3][2]
+	int factor;
+} constants;
+
+/// Relative view depth over which a particle texel fades out once behind the scene (hides the precision lost by the layer depth)
+#define UPSAMPLE_DEPTH_TOLERANCE 0.02
+
+
+/// View depth of a depth buffer value
+float getViewDepth(float depth){
+	return constants.depthTerms.y / (depth + constants.depthTerms.x);
+}
+
+/// Premultiplied particle colour of a full resolution pixel
+vec4 upsampleParticles(ivec2 pixel){
+
+	float sceneViewDepth = getViewDepth(texelFetch(sceneDepth, pixel, 0).r);
+
+	ivec2 layerSize = textureSize(particleColour, 0);
+	vec2 coords = (vec2(pixel) + 0.5) / float(constants.factor) - 0.5;// pixel centre, in layer texels
+	ivec2 base = ivec2(floor(coords));
+	vec2 f = coords - vec2(base);
+
+	vec4 result = vec4(0);
+	for(int y = 0; y <= 1; ++y){
+		for(int x = 0; x <= 1; ++x){
+			ivec2 texel = clamp(base + ivec2(x, y), ivec2(0), layerSize - 1);
+			vec4 colour = texelFetch(particleColour, texel, 0);
+			if(colour.a < 0) continue;// no particle: contributes transparency
+
+			float weight = (x == 1 ? f.x : 1 - f.x) * (y == 1 ? f.y : 1 - f.y);
+			float particleViewDepth = getViewDepth(texelFetch(particleDepth, texel, 0).r);
+			float visibility = clamp((sceneViewDepth - particleViewDepth) / (UPSAMPLE_DEPTH_TOLERANCE * sceneViewDepth) + 1.0, 0.0, 1.0);
+			result += weight * visibility * vec4(colour.rgb, 1);// particles are opaque, as when drawn over the scene directly
+		}
+	}
+	return result;
+}
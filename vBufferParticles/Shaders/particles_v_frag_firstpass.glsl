@@ -1,28 +1,28 @@
 
 /// First pass fragment shader for particles in v-buffer pipeline. In comp/comp mode, expects COMP_PARTICLE_FRAGMENT to be #defined prior to #include-ing this file.
 
-#define PARTICLES_MAT 4 // must match other v-buffer shaders and VBufferScene.h
-
 #include "../__.defines"
+#include "visibility.glsl"
 
 layout (location = 0) in vec2 iUv;
+layout (location = 1) flat in uint iParticleId;
 
 // V-Buffer writes
-layout(location = 0) out vec4 oVisibility;
+layout(location = 0) out VISIBILITY_TYPE oVisibility;
 
 #ifdef PARTICLE_CUTOUT_MODE_1
+#define PARTICLE_COVERAGE_MASK // bit lookup in place of the texture sample (the lighting pass samples the texture)
 #include "particles_frag.glsl"
 #endif
 
 void main(){
 	
 	#ifdef PARTICLE_CUTOUT_MODE_1
-	// should this fragment be discarded based on texture
-	vec4 tex = particleFragment(iUv);
-	if(tex.a < 0.5) discard;
+	// should this fragment be discarded based on the coverage of the texture
+	if(!particleCovered(iUv)) discard;
 	#endif
 	
-	oVisibility = vec4(iUv, 0, PARTICLES_MAT);
+	oVisibility = packParticleVisibility(iUv, iParticleId, PARTICLES_MAT);
 
 
 }// main
@@ -24,16 +24,23 @@ layout(binding = 6) uniform LightUBO{
 	vec4 diffuse;
 	vec4 ambient;
 } uboLight;
+#ifdef EXPECT_DEBUG_BUFFER
+	#define CLUSTERS_BINDING 8 // clustered point lights, after the debug buffer
+#else
+	#define CLUSTERS_BINDING 7 // clustered point lights
+#endif
 #include "lighting.glsl"
 
+/// G-Buffer reads (albedo, position or depth, normal), and the matrices positions are reconstructed with in the compact layout
+#define GBUFFER_LIGHTING
+#define GBUFFER_MATRIX_BINDING (CLUSTERS_BINDING + 3) // after the clustered point lights
+#include "gbuffer.glsl"
+
 
 /// Input data per fragment: screen uv coordinate
 layout(location = 0) in vec2 iUv;
 
-/// G-Buffer reads (albedo, position, normal)
-layout(input_attachment_index = 0, set = 0, binding = 0) uniform subpassInput iAlbedo;
-layout(input_attachment_index = 1, set = 0, binding = 1) uniform subpassInput iPosition;
-layout(input_attachment_index = 2, set = 0, binding = 2) uniform subpassInput iNormal;
+/// Further G-Buffer reads (emission, specular, metallic & roughness)
 layout(input_attachment_index = 3, set = 0, binding = 3) uniform subpassInput iEmission;
 layout(input_attachment_index = 4, set = 0, binding = 4) uniform subpassInput iSpecular;
 layout(input_attachment_index = 5, set = 0, binding = 5) uniform subpassInput iMetallicRoughness;
@@ -55,18 +62,17 @@ layout(binding = 7) uniform DebugUBO{
 void main(){
 	
 	// Grab all G-Buffer data from subpass input attachments.
-	vec4 albedo = subpassLoad(iAlbedo);
-	vec4 position_depth = subpassLoad(iPosition);
-	vec3 normal = subpassLoad(iNormal).rgb;
+	GBufferSample g = gBufferLoad(iUv);
+	vec4 albedo = g.albedo;
+	vec3 normal = g.normal;
 	vec3 emission = subpassLoad(iEmission).rgb;
 	vec3 specular = subpassLoad(iSpecular).rgb;
 	vec2 metallicRoughness = subpassLoad(iMetallicRoughness).rg; // Note that this data could be packed better in G-Buffer as 5 fields are unused; the point is to emulate applications with large G-Buffers.
 
-	vec3 position = position_depth.rgb;
+	vec3 position = g.position;
 	
 	// Light fragment based on normal read from G-Buffer
-	float litAmount = clamp(length(normal * 999), 0, 1);
-	oColor = mix(vec4(albedo.rgb, 1), vec4(lightFragment(albedo.rgb, position, normal), 1.0), litAmount);
+	oColor = mix(vec4(albedo.rgb, 1), vec4(lightFragment(albedo.rgb, position, normal), 1.0), g.lit);
 
 	
 	// Purple "clear" colour for areas where alpha == 0 in albedo texture
@@ -75,13 +81,13 @@ void main(){
 #ifdef EXPECT_DEBUG_BUFFER
 	// Show debug views
 	if(uboDebug.value == 1){// Depth
-		oColor = mix(position_depth.wwww / FAR, vec4(1.0, 1.0, 1.0, 1.0), 1.0-albedo.w);
+		oColor = mix(vec4(g.linearDepth / FAR), vec4(1.0, 1.0, 1.0, 1.0), 1.0-albedo.w);
 	}else if(uboDebug.value == 2){// Albedo
 		oColor = albedo;
 	}else if(uboDebug.value == 3){// WS Position
 		oColor = vec4(position, 1);
 	}else if(uboDebug.value == 4){// WS Normal
-		oColor = vec4(normal, 1);
+		oColor = vec4(normal * g.lit, 1);// null for unlit fragments
 	}else if(uboDebug.value == 5){// Emission
 		oColor = vec4(emission, 1);
 	}else if(uboDebug.value == 6){// Specular
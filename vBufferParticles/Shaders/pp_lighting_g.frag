@@ -23,17 +23,22 @@ layout(binding = 3) uniform LightUBO{
 	vec4 diffuse;
 	vec4 ambient;
 } uboLight;
+#ifdef EXPECT_DEBUG_BUFFER
+	#define CLUSTERS_BINDING 5 // clustered point lights, after the debug buffer
+#else
+	#define CLUSTERS_BINDING 4 // clustered point lights
+#endif
 #include "lighting.glsl"
 
+/// G-Buffer reads (albedo, position or depth, normal), and the matrices positions are reconstructed with in the compact layout
+#define GBUFFER_LIGHTING
+#define GBUFFER_MATRIX_BINDING (CLUSTERS_BINDING + 3) // after the clustered point lights
+#include "gbuffer.glsl"
+
 
 /// Input data per fragment: screen uv coordinate
 layout(location = 0) in vec2 iUv;
 
-/// G-Buffer reads (albedo, position, normal)
-layout(input_attachment_index = 0, set = 0, binding = 0) uniform subpassInput iAlbedo;
-layout(input_attachment_index = 1, set = 0, binding = 1) uniform subpassInput iPosition;
-layout(input_attachment_index = 2, set = 0, binding = 2) uniform subpassInput iNormal;
-
 
 /// Output fragment colour
 layout(location = 0) out vec4 oColor;
@@ -50,15 +55,13 @@ layout(binding = 4) uniform DebugUBO{
 /// Load G-Buffer data (albedo, ws position & ws normal) from subpass attachments and compute fragment colour from light info.
 void main(){
 	
-	vec4 albedo = subpassLoad(iAlbedo);
-	vec4 position_depth = subpassLoad(iPosition);
-	vec3 normal = subpassLoad(iNormal).rgb;
-
-	vec3 position = position_depth.rgb;
+	GBufferSample g = gBufferLoad(iUv);
+	vec4 albedo = g.albedo;
+	vec3 position = g.position;
+	vec3 normal = g.normal;
 	
 	// Light fragment
-	float litAmount = clamp(length(normal*999), 0, 1);// 0 where normal == (0,0,0), 1 otherwise.
-	oColor = mix(vec4(albedo.rgb, 1), vec4(lightFragment(albedo.rgb, position, normal), 1.0), litAmount);// fragments where normal == (0,0,0) receive no light, other fragments receive full light.
+	oColor = mix(vec4(albedo.rgb, 1), vec4(lightFragment(albedo.rgb, position, normal), 1.0), g.lit);// unlit fragments (particles) receive no light, other fragments receive full light.
 
 	
 	// Blue "clear" colour for areas where alpha == 0 in albedo texture
@@ -67,13 +70,13 @@ void main(){
 #ifdef EXPECT_DEBUG_BUFFER
 	// Show debug views
 	if(uboDebug.value == 1){// Depth
-		oColor = mix(position_depth.wwww / FAR, vec4(1.0, 1.0, 1.0, 1.0), 1.0-albedo.w);
+		oColor = mix(vec4(g.linearDepth / FAR), vec4(1.0, 1.0, 1.0, 1.0), 1.0-albedo.w);
 	}else if(uboDebug.value == 2){// Albedo
 		oColor = albedo;
 	}else if(uboDebug.value == 3){// WS Position
 		oColor = vec4(position, 1);
 	}else if(uboDebug.value == 4){// WS Normal
-		oColor = vec4(normal, 1);
+		oColor = vec4(normal * g.lit, 1);// null for unlit fragments
 	}
 #endif
 
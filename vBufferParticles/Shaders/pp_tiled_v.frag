@@ -0,0 +1,19 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+/// Composites the image shaded by V-Buffer tiled shading (see tile_shade_v.glsl) to the screen.
+
+
+/// Input data per fragment: screen uv coordinate
+layout(location = 0) in vec2 iSPUv;
+
+/// Shaded image, one texel per fragment
+layout(binding = 0) uniform sampler2D shadedSampler;
+
+/// Output fragment colour
+layout(location = 0) out vec4 oColor;
+
+
+void main(){
+	oColor = texelFetch(shadedSampler, ivec2(gl_FragCoord.xy), 0);
+}
@@ -0,0 +1,9 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+/// Fragment shader for static meshes with Raccoon texture applied in Forward+ renderer.
+
+// reads texture bound at location 3, and the light lists of its tile from location 4.
+#define TEXTURE_BINDING 3
+#define LIGHT_TILES_BINDING 4
+#include "default_fwd.glsl"
@@ -3,7 +3,9 @@
 
 /// Fragment shader for static meshes with Raymarch material applied in G-Buffer (6) renderer
 
+#include "../__.defines"
 #include "raymarch.glsl"
+#include "gbuffer.glsl"
 
 // near and far plane distances, for linear depth calculation
 #define NEAR 0.01
@@ -13,14 +15,18 @@ layout(location = 0) in vec2 iUv;
 layout(location = 1) in vec3 worldNormal;
 layout(location = 2) in vec4 worldPosition;
 layout(location = 3) in float iTime;
+#ifdef TEMPORAL_UPSCALING_1
+layout(location = 4) in vec4 iClip;
+layout(location = 5) in vec4 iPreviousClip;
+#endif
 
-// G-Buffer writes
-layout(location = 0) out vec4 oAlbedo;
-layout(location = 1) out vec4 oPosition;
-layout(location = 2) out vec4 oNormal;
-layout(location = 3) out vec4 oEmission;
-layout(location = 4) out vec4 oSpecular;
-layout(location = 5) out vec4 oMetallicRoughness;
+// G-Buffer writes (albedo, position & normal: see gbuffer.glsl)
+layout(location = GBUFFER_EXTRA_LOCATION) out vec4 oEmission;
+layout(location = GBUFFER_EXTRA_LOCATION + 1) out vec4 oSpecular;
+layout(location = GBUFFER_EXTRA_LOCATION + 2) out vec4 oMetallicRoughness;
+#ifdef TEMPORAL_UPSCALING_1
+layout(location = GBUFFER_EXTRA_LOCATION + 3) out vec2 oVelocity;// screen uv motion since the previous frame (see TemporalUpscaler.h)
+#endif
 
 
 float linearDepth(float depth){
@@ -37,13 +43,13 @@ void main(){
     oAlbedo = vec4(raymarch(iUv, iTime),1.0); // get albedo from common raymarch function
 	
 	
-	oPosition = vec4(worldPosition.xyz, 1.0);
-	oPosition.w = linearDepth(gl_FragCoord.z);
-	
-	oNormal = vec4(normalize(worldNormal), 1.0);
+	gBufferWriteSurface(worldPosition.xyz, linearDepth(gl_FragCoord.z), worldNormal);
 
 	oEmission = vec4(1, 1, 1, 1);
 	oSpecular = vec4(0, 0.5f, 0, 0);
 	oMetallicRoughness = vec4(0.1f, 0.9f, 0, 0);
+#ifdef TEMPORAL_UPSCALING_1
+	oVelocity = (iClip.xy / iClip.w - iPreviousClip.xy / iPreviousClip.w) * 0.5;
+#endif
 
 }
\ No newline at end of file
@@ -0,0 +1,134 @@
+/// Shading kernel of V-Buffer tiled shading: one workgroup per tile in the list of material TILE_MATERIAL (to #define before including this file),
+/// shading only the pixels of that material. As all pixels shaded share the same material, the material branch is resolved at compile time.
+/// With VBUFFER_TRIANGLE_CACHE_1 (mesh materials only; #define TILE_NO_TRIANGLES otherwise), the unique triangles of the tile are gathered first,
+/// and each of them is loaded and transformed once into shared memory; pixels are then shaded from that cache instead of loading their own triangle.
+
+
+#include "../__.defines"
+
+#if defined(VBUFFER_TRIANGLE_CACHE_1) && !defined(TILE_NO_TRIANGLES)
+	#define TILE_TRIANGLE_CACHE
+	#define LIGHTING_V_LOAD_TRIANGLE loadCachedTriangle
+#endif
+
+#define LIGHTING_V_MATERIAL TILE_MATERIAL
+#include "tile_v.glsl"
+
+
+layout(local_size_x = TILE_SIZE, local_size_y = TILE_SIZE, local_size_z = 1) in;
+
+
+/// Shaded colour output, composited to the screen after all kernels have run
+layout(set = 0, binding = LIGHTING_V_BINDINGS_END + 2, rgba16f) uniform writeonly image2D shadedImage;
+
+
+
+#ifdef TILE_TRIANGLE_CACHE
+
+#define TILE_CACHE_TRIANGLES 64 // unique triangles cached per tile (3 vertices each, at most one per invocation); pixels of further triangles load their own
+#define TILE_CACHE_HASH_BITS 8 // hash table of the triangle IDs found in the tile; one entry per pixel (2^8 = TILE_SIZE^2) so that it never fills up
+#define TILE_CACHE_HASH_SIZE (1u << TILE_CACHE_HASH_BITS)
+#define TILE_CACHE_MISS 0xFFFFFFFFu
+
+/// Vertex statistics of the frame, read back by VBufferScene (cleared each frame)
+layout(std430, set = 0, binding = LIGHTING_V_BINDINGS_END + 3) buffer TileCacheStatsSSBO{
+	uint pixels;// mesh pixels shaded: each would load and transform 3 vertices without the cache
+	uint transforms;// vertices actually loaded and transformed
+} ssboCacheStats;
+
+shared uint cacheKeys[TILE_CACHE_HASH_SIZE];// triangle ID + 1 of each hash table entry (0: empty)
+shared uint cacheSlots[TILE_CACHE_HASH_SIZE];// cache slot of each entry's triangle; TILE_CACHE_MISS if the cache was full
+shared uint cacheTriangles[TILE_CACHE_TRIANGLES];// triangle ID in each cache slot
+shared VertexInput cacheVertices[TILE_CACHE_TRIANGLES * 3];// world space vertices of each cached triangle
+shared uint cacheCount;// unique triangles found in the tile (may exceed TILE_CACHE_TRIANGLES)
+shared uint tilePixels;// statistics of the tile, added to ssboCacheStats once
+shared uint tileTransforms;
+
+/// Cache slot of the current pixel's triangle
+uint pixelCacheSlot = TILE_CACHE_MISS;
+
+
+/// Returns the hash table entry of a triangle ID, adding it (and reserving a cache slot for the triangle) for the first pixel of the triangle
+uint insertTriangle(uint triId){
+	uint entry = (triId * 2654435761u) >> (32 - TILE_CACHE_HASH_BITS);// multiplicative hash
+	for(uint probe = 0; probe < TILE_CACHE_HASH_SIZE; ++probe){
+		uint previous = atomicCompSwap(cacheKeys[entry], 0u, triId + 1u);
+		if(previous == 0u){// first pixel of the triangle
+			uint slot = atomicAdd(cacheCount, 1u);
+			if(slot < TILE_CACHE_TRIANGLES) cacheTriangles[slot] = triId;
+			cacheSlots[entry] = slot < TILE_CACHE_TRIANGLES ? slot : TILE_CACHE_MISS;
+			return entry;
+		}
+		if(previous == triId + 1u) return entry;
+		entry = (entry + 1u) & (TILE_CACHE_HASH_SIZE - 1u);// linear probing
+	}
+	return TILE_CACHE_MISS;// not reached
+}
+
+/// Loads the vertices of the current pixel's triangle from the cache (see LIGHTING_V_LOAD_TRIANGLE in lighting_v.glsl)
+void loadCachedTriangle(uint triId, out VertexInput v0, out VertexInput v1, out VertexInput v2){
+	if(pixelCacheSlot == TILE_CACHE_MISS){
+		loadTriangle(triId, v0, v1, v2);
+		return;
+	}
+	uint v = pixelCacheSlot * 3;
+	v0 = cacheVertices[v];
+	v1 = cacheVertices[v + 1];
+	v2 = cacheVertices[v + 2];
+}
+
+#endif
+
+
+
+void main(){
+
+	// find the pixel shaded from the tile list
+	uint tile = ssboTiles.tiles[(TILE_MATERIAL - 1) * getMaxTiles() + gl_WorkGroupID.x];
+	ivec2 pixel = ivec2(tile & 0xFFFFu, tile >> 16) * TILE_SIZE + ivec2(gl_LocalInvocationID.xy);
+	ivec2 size = tileConstants.renderSize;// screen uvs span the rendered part only
+
+	// other materials in the tile are shaded by their own kernels (no early return: all invocations must reach the barriers below)
+	Visibility visibility;
+	bool shaded = false;
+	if(all(lessThan(pixel, size))){
+		visibility = loadVisibility(pixel);
+		shaded = visibility.matId == TILE_MATERIAL;
+	}
+
+#ifdef TILE_TRIANGLE_CACHE
+	if(gl_LocalInvocationIndex < TILE_CACHE_HASH_SIZE) cacheKeys[gl_LocalInvocationIndex] = 0u;
+	if(gl_LocalInvocationIndex == 0){
+		cacheCount = 0u;
+		tilePixels = 0u;
+		tileTransforms = 0u;
+	}
+	memoryBarrierShared();
+	barrier();
+
+	// gather the unique triangles of the tile
+	uint entry = shaded ? insertTriangle(visibility.id) : TILE_CACHE_MISS;
+	memoryBarrierShared();
+	barrier();
+
+	// load and transform each vertex of the cached triangles once
+	uint cached = min(cacheCount, TILE_CACHE_TRIANGLES);
+	uint v = gl_LocalInvocationIndex;
+	if(v < cached * 3) cacheVertices[v] = loadVertex(cacheTriangles[v / 3], v % 3);
+	if(shaded){
+		pixelCacheSlot = cacheSlots[entry];
+		atomicAdd(tilePixels, 1u);
+		if(pixelCacheSlot == TILE_CACHE_MISS) atomicAdd(tileTransforms, 3u);
+	}
+	memoryBarrierShared();
+	barrier();
+
+	if(gl_LocalInvocationIndex == 0){
+		atomicAdd(ssboCacheStats.pixels, tilePixels);
+		atomicAdd(ssboCacheStats.transforms, tileTransforms + cached * 3);
+	}
+#endif
+
+	if(shaded) imageStore(shadedImage, pixel, shadeVisibility(visibility, (vec2(pixel) + 0.5) / vec2(size), 1.0 / vec2(size)));
+
+}
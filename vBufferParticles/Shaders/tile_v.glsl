@@ -0,0 +1,56 @@
+/// Tiled shading of the V-Buffer: the screen is split in TILE_SIZE x TILE_SIZE tiles, which are classified by the materials they contain (vbuffer_classify.comp);
+/// each material then only shades its own list of tiles, in an indirect dispatch of a kernel specialized for that material (tile_shade_v.glsl).
+
+
+#define PARTICLES_NO_RANGE // the push constants are the tile constants below
+#define MULTIVIEW_NO_VIEW_INDEX // compute kernels shade a single view (tiled shading renders in mono)
+#include "lighting_v.glsl"
+
+
+#define TILE_SIZE 16 // tile width & height in pixels; must match VBufferScene.h
+#define TILE_MATERIALS 4 // material IDs 1..TILE_MATERIALS each have a tile list (material 0 is the clear colour, filled before shading)
+
+
+
+/// V-Buffer, sampled from the visibility attachment once the visibility pass is over
+#ifdef VISIBILITY_UINT
+layout(binding = 0) uniform usampler2D visibilitySampler;
+#else
+layout(binding = 0) uniform sampler2D visibilitySampler;
+#endif
+
+/// Indirect dispatch arguments of each material kernel (xyz: workgroups; x counts the tiles in the material's list). Reset to (0, 1, 1) each frame.
+layout(std430, set = 0, binding = LIGHTING_V_BINDINGS_END) buffer TileDispatchSSBO{
+	uvec4 dispatches[TILE_MATERIALS];
+} ssboDispatches;
+
+/// Tile lists, one after the other for each material (getMaxTiles() entries each); tiles are stored as x | y << 16
+layout(std430, set = 0, binding = LIGHTING_V_BINDINGS_END + 1) buffer TileListSSBO{
+	uint tiles[];
+} ssboTiles;
+
+
+
+/// Size of the rendered part of the V-Buffer, which may be smaller than the attachment under dynamic resolution (see VBufferScene::cmdBindTiledShading)
+layout(push_constant) uniform TileConstants{
+	ivec2 renderSize;
+} tileConstants;
+
+
+
+/// Returns the number of tiles covering the whole V-Buffer, ie. the capacity of each tile list
+uint getMaxTiles(){
+	ivec2 tiles = (textureSize(visibilitySampler, 0) + TILE_SIZE - 1) / TILE_SIZE;
+	return uint(tiles.x * tiles.y);
+}
+
+/// Reads and decodes the V-Buffer at the pixel given
+Visibility loadVisibility(ivec2 pixel){
+#if defined(VBUFFER_FORMAT_2)
+	return unpackVisibility(texelFetch(visibilitySampler, pixel, 0).xy, PARTICLES_MAT);
+#elif defined(VBUFFER_FORMAT_3)
+	return unpackVisibility(texelFetch(visibilitySampler, pixel, 0).x, PARTICLES_MAT);
+#else
+	return unpackVisibility(texelFetch(visibilitySampler, pixel, 0), PARTICLES_MAT);
+#endif
+}
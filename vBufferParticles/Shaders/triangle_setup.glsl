@@ -0,0 +1,31 @@
+/// Triangle setup of the V-Buffer renderer: per triangle, the 2D homogeneous edge functions of its clip space vertices, written each frame by triangle_setup_v.comp.
+/// At a point p in normalized device coordinates, edge function i is E_i(p) = dx[i] * p.x + dy[i] * p.y + c[i]; normalizing (E_0, E_1, E_2) by their sum gives the
+/// perspective-correct barycentric coordinates of p, for any triangle (including triangles crossing the camera plane), without any vertex transform per pixel.
+
+
+/// Edge functions of one triangle; xyz hold one coefficient per vertex (w unused)
+struct TriangleSetup{
+	vec4 dx;// partial derivatives of the edge functions along ndc x
+	vec4 dy;// partial derivatives of the edge functions along ndc y
+	vec4 c;// edge functions at the ndc origin
+};
+
+
+/// Sets up a triangle from its clip space vertices: the edge functions are the rows of the adjugate of the matrix with columns (x, y, w) of each vertex
+TriangleSetup setupTriangle(vec4 c0, vec4 c1, vec4 c2){
+	vec3 e0 = cross(c1.xyw, c2.xyw);
+	vec3 e1 = cross(c2.xyw, c0.xyw);
+	vec3 e2 = cross(c0.xyw, c1.xyw);
+
+	TriangleSetup setup;
+	setup.dx = vec4(e0.x, e1.x, e2.x, 0.0);
+	setup.dy = vec4(e0.y, e1.y, e2.y, 0.0);
+	setup.c = vec4(e0.z, e1.z, e2.z, 0.0);
+	return setup;
+}
+
+/// Returns the perspective-correct barycentric coordinates of the point at ndc in a triangle
+vec3 getSetupBarycentrics(TriangleSetup setup, vec2 ndc){
+	vec3 e = setup.dx.xyz * ndc.x + setup.dy.xyz * ndc.y + setup.c.xyz;
+	return e / (e.x + e.y + e.z);
+}
@@ -3,28 +3,40 @@
 
 /// vert/vert particles vertex shader
 
+#define PARTICLE_DRAW_STAGE // counts the particles dropped by the distance LOD, and draws the particles listed by the occlusion culling
 #include "particles.glsl"
 
 layout (location = 0) out vec2 oUv;
-
-// static UV multipliers for the 6 vertices of a quad
-const vec2 staticUVs[6] = {vec2(-1, -1), vec2(1, -1), vec2(1, 1), vec2(-1, -1), vec2(1, 1), vec2(-1, 1)};
+layout (location = 1) flat out uint oParticleId;// global particle index (V-Buffer particle ID encoding)
+#ifdef TEMPORAL_UPSCALING_1
+layout (location = 2) out vec2 oVelocity;// screen uv motion since the previous frame (velocity of the G-Buffer renderers)
+#endif
 
 void main(){
 	
-	// find particle index and vertex index within the particle
+	// find particle index (within the draw's range, or the visible list) and vertex index within the particle
 	uint index = gl_VertexIndex;
-	uint pIndex = index / 6;
-	uint vIndex = index % 6;
+	uint pIndex = index / VERTICES_PER_PARTICLE;
+	uint vIndex = index % VERTICES_PER_PARTICLE;
+	uint particleIndex = drawnParticle(pIndex);
 
-	vec2 uv = staticUVs[vIndex];
+	vec2 uv = particleCorner(vIndex);// quad corner, or corner of the cut-out polygon
 	
 	// generate the particle's position and size
-	vec4 p = particle(pIndex);
-	vec4 particleCenter = ubo.proj * ((ubo.view * vec4(p.xyz, 1)) + vec4(uv * p.w, 0, 0)); // expand to quad in view space before projecting to clip space.
+	vec4 p = particle(particleIndex);
+	float lod = 1.0;
+#ifdef PARTICLE_LOD_1
+	lod = particleLod(p, particleIndex, vIndex == 0);// dropped particles collapse to a point (degenerate triangles are discarded before rasterization)
+	p.w *= lod;
+#endif
+	vec4 particleCenter = ubo.proj * ((drawnView() * vec4(p.xyz, 1)) + vec4(uv * p.w, 0, 0)); // expand to quad in view space before projecting to clip space.
 
 	// fill output data
 	gl_Position = particleCenter;
+#ifdef TEMPORAL_UPSCALING_1
+	gl_Position = particleCornerMotion(p, previousParticle(particleIndex) * vec4(1, 1, 1, lod), uv, oVelocity);
+#endif
 	oUv = uv * 0.5 + 0.5;
+	oParticleId = particleIndex;
 
 }// main
@@ -3,16 +3,40 @@
 
 /// vert/geom particles vertex shader
 
+#define PARTICLE_DRAW_STAGE // counts the particles dropped by the distance LOD, and draws the particles listed by the occlusion culling
 #include "particles.glsl"
 
 layout (location = 0) out float oHalfSize;
 layout (location = 1) out mat4 oProjection;
+layout (location = 5) flat out uint oParticleId;// global particle index (V-Buffer particle ID encoding)
+#ifdef TEMPORAL_UPSCALING_1
+/// Previous frame's view-space centre and half size, and the frame's jitter (the geometry stage has no UBO)
+layout (location = 6) out vec4 oPreviousCentre;
+layout (location = 7) out vec2 oJitter;
+#endif
+#ifdef PARTICLE_HULL
+layout (location = 8) flat out vec4 oHull[PARTICLE_HULL_VERTICES / 2];// corners of the cut-out polygon (the geometry stage has no UBO)
+#endif
 
 void main(){
 
-	vec4 p = particle(gl_VertexIndex);
-	oHalfSize = p.w;
-	gl_Position = ubo.view * vec4(p.xyz, 1);
+	uint particleIndex = drawnParticle(gl_VertexIndex);
+	vec4 p = particle(particleIndex);
+	float lod = 1.0;
+#ifdef PARTICLE_LOD_1
+	lod = particleLod(p, particleIndex, true);// dropped particles get a half size of 0, which the geometry shader does not expand
+#endif
+	oHalfSize = p.w * lod;
+	gl_Position = drawnView() * vec4(p.xyz, 1);
 	oProjection = ubo.proj;
+	oParticleId = particleIndex;
+#ifdef TEMPORAL_UPSCALING_1
+	vec4 previous = previousParticle(particleIndex);
+	oPreviousCentre = vec4((ubo.previousView * vec4(previous.xyz, 1)).xyz, previous.w * lod);
+	oJitter = ubo.jitter;
+#endif
+#ifdef PARTICLE_HULL
+	oHull = ubo.hull;
+#endif
 
 }// main
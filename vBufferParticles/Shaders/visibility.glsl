@@ -0,0 +1,91 @@
+/// Provides the encoding of the visibility buffer written by the first pass of the V-Buffer renderer and read by its lighting pass.
+/// The format is selected at run-time through __.defines (VBUFFER_FORMAT_*); see VBufferScene::VisibilityFormat for the matching attachment formats.
+
+
+#include "../__.defines"
+
+
+#if defined(VBUFFER_FORMAT_2)
+	// R32G32_UINT: x: triangle ID (particles: uv as 2x unorm16); y: material ID
+	#define VISIBILITY_TYPE uvec2
+	#define VISIBILITY_UINT
+#elif defined(VBUFFER_FORMAT_3)
+	// R32_UINT: bits 31..29: material ID; bits 28..0: triangle ID (particles: uv as 2x 14-bit unorm)
+	#define VISIBILITY_TYPE uint
+	#define VISIBILITY_UINT
+#else
+	// R16G16B16A16_SFLOAT (0) or R32G32B32A32_SFLOAT (1): xy: uv; z: triangle ID; w: material ID
+	#define VISIBILITY_TYPE vec4
+	#define VISIBILITY_FLOAT
+#endif
+
+#if defined(VBUFFER_PARTICLE_IDS_1) && defined(VISIBILITY_UINT)
+	// particles store their global index in place of their uv (integer formats only); the lighting pass reconstructs the uv
+	#define VISIBILITY_PARTICLE_IDS
+#endif
+
+/// Material IDs (must match VBufferScene.h); 0 means nothing was rendered
+#define SHRIMP_MAT 1
+#define RAYMARCH_MAT 2
+#define RACCOON_MAT 3
+#define PARTICLES_MAT 4
+
+#define VISIBILITY_PACKED_MAT_SHIFT 29u
+#define VISIBILITY_PACKED_ID_MASK 0x1FFFFFFFu
+#define VISIBILITY_PACKED_UV_MAX 16383.0 // 14 bits per uv component
+
+
+/// Decoded visibility data for one pixel
+struct Visibility {
+	vec2 uv;		// float formats: mesh or particle uv; integer formats: particle uv only (meshes reconstruct barycentrics from the pixel position)
+	uint id;		// global triangle ID for meshes; global particle index for particles (VISIBILITY_PARTICLE_IDS only)
+	uint matId;		// material ID; 0 if nothing was rendered
+};
+
+
+/// Encodes visibility data for a mesh fragment (uv is only stored by float formats)
+VISIBILITY_TYPE packMeshVisibility(vec2 uv, uint triId, uint matId){
+#if defined(VBUFFER_FORMAT_2)
+	return uvec2(triId, matId);
+#elif defined(VBUFFER_FORMAT_3)
+	return (matId << VISIBILITY_PACKED_MAT_SHIFT) | (triId & VISIBILITY_PACKED_ID_MASK);
+#else
+	return vec4(uv, triId, matId);
+#endif
+}
+
+/// Encodes visibility data for a particle fragment
+VISIBILITY_TYPE packParticleVisibility(vec2 uv, uint particleId, uint matId){
+#if defined(VISIBILITY_PARTICLE_IDS)
+	return packMeshVisibility(uv, particleId, matId);
+#elif defined(VBUFFER_FORMAT_2)
+	return uvec2(packUnorm2x16(uv), matId);
+#elif defined(VBUFFER_FORMAT_3)
+	uvec2 quantized = uvec2(clamp(uv, 0.0, 1.0) * VISIBILITY_PACKED_UV_MAX + 0.5);
+	return (matId << VISIBILITY_PACKED_MAT_SHIFT) | quantized.x | (quantized.y << 14u);
+#else
+	return vec4(uv, 0, matId);
+#endif
+}
+
+/// Decodes visibility data; particle uvs are only decoded for the material ID particlesMat (and left to the caller to reconstruct with VISIBILITY_PARTICLE_IDS)
+Visibility unpackVisibility(VISIBILITY_TYPE packedVisibility, uint particlesMat){
+	Visibility v;
+#if defined(VISIBILITY_PARTICLE_IDS)
+	particlesMat = 0xFFFFFFFFu;// no uv stored
+#endif
+#if defined(VBUFFER_FORMAT_2)
+	v.matId = packedVisibility.y;
+	v.id = packedVisibility.x;
+	v.uv = v.matId == particlesMat ? unpackUnorm2x16(packedVisibility.x) : vec2(0);
+#elif defined(VBUFFER_FORMAT_3)
+	v.matId = packedVisibility >> VISIBILITY_PACKED_MAT_SHIFT;
+	v.id = packedVisibility & VISIBILITY_PACKED_ID_MASK;
+	v.uv = v.matId == particlesMat ? vec2(packedVisibility & 0x3FFFu, (packedVisibility >> 14u) & 0x3FFFu) / VISIBILITY_PACKED_UV_MAX : vec2(0);
+#else
+	v.uv = packedVisibility.xy;
+	v.id = uint(packedVisibility.z + 0.5);
+	v.matId = uint(packedVisibility.w + 0.5);
+#endif
+	return v;
+}
@@ -9,13 +9,15 @@ struct RuntimeConstantSettings {
 	unsigned int windowWidth = 1024;
 	unsigned int windowHeight = 768;
 	bool recompileShaders = true;
-	enum class Renderer{ Fwd, G3, G6, V } renderer = Renderer::V;// which renderer to start in
+	enum class Renderer{ Fwd, G3, G6, V, FwdP } renderer = Renderer::V;// which renderer to start in
 	enum class ParticleMode{ Ve, Ge, Co, VeGe } pMode = ParticleMode::Ve;// which particle mode to use
 	uint8_t pComplexity = 0;// particle fragment shader complexity
 	float pSpread = 0.4f;// particle spread
 	float pHalfSize = 0.03f;// particle half size
 	unsigned int pCount = 1024 * 1024;// particle count
+	unsigned int pStreamBudget = 0;// memory budget (MB) for streaming comp/comp particles in chunks; 0 to allocate all particles at once
 	bool freezeTime = false;
+	bool vMeshes = false;// whether the V-Buffer scene starts with meshes shown (otherwise particles only)
 
 };// struct RuntimeConstantSettings
 
@@ -58,7 +58,7 @@ Swapchain::Swapchain(DevicesPtr devices) : devices(devices) {
 	createInfo.imageColorSpace = surfaceFormat.colorSpace;
 	createInfo.imageExtent = extent;
 	createInfo.imageArrayLayers = 1;
-	createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;//Image will be rendered directly to screen. Change to VK_IMAGE_USAGE_TRANSFER_DST_BIT for post-processing.
+	createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;//Image will be rendered directly to screen, or blitted to from a lower resolution render target (dynamic resolution), or copied from and reconstructed into (temporal upscaling).
 	uint32_t queueFamilyIndices[] = { devices->getGraphicsQueueFamily(), devices->getPresentQeueuFamily() };
 	if (devices->getGraphicsQueueFamily() != devices->getPresentQeueuFamily()) {//different queues for graphics and presentation
 		createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;//images can be shared across several queue families
@@ -122,7 +122,7 @@ void Swapchain::createFramebuffers(std::vector<VkImageView>& attachments, const
 	framebuffers.resize(imageViews.size());
 	for (int i = 0; i < imageViews.size(); ++i) {
 
-		std::vector<VkImageView> fbAttachments = { imageViews[i] };//prepend current swapchain image view as attachment #0
+		std::vector<VkImageView> fbAttachments = { renderTargets.size() > 0 ? renderTargets[i] : imageViews[i] };//prepend current swapchain image view (or its render target) as attachment #0
 		for (int i = 0; i < attachments.size(); ++i) {
 			fbAttachments.push_back(attachments[i]);
 		}
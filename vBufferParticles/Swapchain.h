@@ -28,6 +28,10 @@ struct Swapchain {
 	/// Must be called in init() and swapchainCreate() to setup framebuffer attachments and render pass
 	void createFramebuffers(std::vector<VkImageView>& attachments, const VkRenderPass& renderPass);
 
+	/// Images (one per swapchain image) that createFramebuffers() uses as attachment #0 instead of the swapchain images, eg. when rendering
+	/// at a lower resolution before an upscale (see DynamicResolution.h); must be set before any framebuffer is created
+	inline void setRenderTargets(const std::vector<VkImageView>& views) { renderTargets = views; }
+
 
 	/// Getters
 	inline const VkSwapchainKHR& getSwapchain() { return swapchain; }
@@ -35,6 +39,8 @@ struct Swapchain {
 	inline const VkFormat& getFormat() { return format; }
 	inline uint32_t getSize() { return (uint32_t)images.size(); }
 	inline const VkFramebuffer& getFramebuffer(int index) { return framebuffers[index]; }
+	inline const VkImage& getImage(int index) { return images[index]; }
+	inline const VkImageView& getImageView(int index) { return imageViews[index]; }
 
 private:
 
@@ -51,5 +57,6 @@ private:
 	std::vector<VkImage> images;
 	std::vector<VkImageView> imageViews;
 	std::vector<VkFramebuffer> framebuffers;
+	std::vector<VkImageView> renderTargets;// replace the swapchain images in framebuffers when set (not owned)
 
 };// struct Swapchain
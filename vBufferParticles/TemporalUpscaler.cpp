@@ -0,0 +1,291 @@
+#include "TemporalUpscaler.h"
+#include "DynamicResolution.h"
+#include "GraphicsPipeline.h"
+
+
+float TemporalUpscaler::scale = 1.f;
+
+
+/// Element of the Halton sequence of the given base (0..1)
+static float halton(uint32_t index, uint32_t base) {
+	float result = 0.f;
+	float fraction = 1.f;
+	while (index > 0) {
+		fraction /= base;
+		result += fraction * (index % base);
+		index /= base;
+	}
+	return result;
+}
+
+TemporalUpscaler::TemporalUpscaler(VulkanAppBase* vulkanApp) : vulkanApp(vulkanApp), devices(vulkanApp->devices) {
+
+	Swapchain* swapchain = vulkanApp->getSwapchain();
+	VkExtent2D extent = swapchain->getExtent();
+	int swapchainSize = swapchain->getSize();
+	RenderPass::renderScale = scale;
+
+	/// Velocity attachment (an input attachment of the scene's last subpass, like every G-Buffer), sampled once the render pass is over
+	velocity = new Texture(TEMPORAL_VELOCITY_FORMAT, extent, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT,
+		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, devices(), devices->getPhysicalDevice(), *vulkanApp->getCommandPool(), devices->getGraphicsQueue());
+
+	/// Samples of the frame (swapchain format, copied from the present attachment), history and reconstruction (RGBA16F)
+	current = new Texture(swapchain->getFormat(), extent, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, devices(), devices->getPhysicalDevice(), *vulkanApp->getCommandPool(), devices->getGraphicsQueue());
+	history = new Texture(VK_FORMAT_R16G16B16A16_SFLOAT, extent, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, devices(), devices->getPhysicalDevice(), *vulkanApp->getCommandPool(), devices->getGraphicsQueue());
+	resolved = new Texture(VK_FORMAT_R16G16B16A16_SFLOAT, extent, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_COLOR_BIT,
+		VK_IMAGE_LAYOUT_GENERAL, devices(), devices->getPhysicalDevice(), *vulkanApp->getCommandPool(), devices->getGraphicsQueue());
+
+	/// No history yet: cleared to a zero alpha, which the reconstruction ignores
+	VkCommandBuffer cmdBuffer = U::beginSingleTimeCommands(*vulkanApp->getCommandPool(), *devices(), devices->getGraphicsQueue()); {
+		VkClearColorValue clearColour = {};
+		VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		vkCmdClearColorImage(cmdBuffer, history->getImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColour, 1, &range);
+		U::cmdTransitionImageLayout(history->getImage(), history->getFormat(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, cmdBuffer, 0);
+	} U::endSingleTimeCommands(cmdBuffer, *vulkanApp->getCommandPool(), *devices(), devices->getGraphicsQueue());
+
+	/// Reconstruction (same bindings as Shaders/temporal_resolve.comp): frame parameters, samples, velocity, history, reconstruction
+	uboBuffer = new UniformBuffer<TemporalUBO>(swapchainSize, devices(), devices->getPhysicalDevice());
+	DESCRIPTOR_BINDING_ARRAY bindings = { DESCRIPTOR_BINDING_UBO_COMPUTE, DESCRIPTOR_BINDING_SAMPLER_COMPUTE, DESCRIPTOR_BINDING_SAMPLER_COMPUTE, DESCRIPTOR_BINDING_SAMPLER_COMPUTE, DESCRIPTOR_BINDING_STORAGE_IMAGE_COMPUTE };
+	descriptor = new Descriptor(bindings, devices(), VK_PIPELINE_BIND_POINT_COMPUTE);
+	descriptor->createPipelineLayout();
+	descriptor->createDescriptorSets(swapchainSize, *vulkanApp->getDescriptorPool(), { Descriptor::UBODescriptor(uboBuffer->getBuffers(), sizeof(TemporalUBO)) }, {
+		Descriptor::ImageInfoDescriptor(current, vulkanApp->getSampler()),
+		Descriptor::ImageInfoDescriptor(velocity, vulkanApp->getSampler()),
+		Descriptor::ImageInfoDescriptor(history, vulkanApp->getSampler()),
+		Descriptor::ImageInfoDescriptor(resolved, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL) });
+	pipeline = new ComputePipeline("temporal_resolve", descriptor->getPipelineLayout(), devices());
+
+	/// Overlay pass: continues from the reconstructed swapchain image (left in PRESENT_SRC_KHR layout by cmdResolve)
+	overlayDepth = new Texture(VK_FORMAT_D32_SFLOAT, extent, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+		devices(), devices->getPhysicalDevice(), *vulkanApp->getCommandPool(), devices->getGraphicsQueue());
+	std::vector<RenderPass::RenderPassAttachmentDesc> attachments = { RENDERPASS_ATTACHMENT_DESC_PRESENT(swapchain->getFormat()), RENDERPASS_ATTACHMENT_DESC_DEPTH };
+	overlayRenderPass = new RenderPass(devices(), attachments, 1, extent, RenderPass::Chaining::Continuation);
+	overlayFramebuffers.resize(swapchainSize);
+	for (int i = 0; i < swapchainSize; ++i) {
+		std::vector<VkImageView> fbAttachments = { swapchain->getImageView(i), overlayDepth->getImageView() };
+		VkFramebufferCreateInfo framebufferInfo = {};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = overlayRenderPass->getRenderPass();
+		framebufferInfo.attachmentCount = (uint32_t)fbAttachments.size();
+		framebufferInfo.pAttachments = fbAttachments.data();
+		framebufferInfo.width = extent.width;
+		framebufferInfo.height = extent.height;
+		framebufferInfo.layers = 1;
+		if (vkCreateFramebuffer(*devices(), &framebufferInfo, NULL, &overlayFramebuffers[i]) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create overlay framebuffer");
+		}
+	}
+
+}
+
+TemporalUpscaler::~TemporalUpscaler() {
+
+	for (VkFramebuffer framebuffer : overlayFramebuffers)
+		vkDestroyFramebuffer(*devices(), framebuffer, NULL);
+	DELETE(overlayRenderPass);
+	DELETE(overlayDepth);
+	DELETE(pipeline);
+	DELETE(descriptor);
+	DELETE(uboBuffer);
+	DELETE(resolved);
+	DELETE(history);
+	DELETE(current);
+	DELETE(velocity);
+
+	RenderPass::renderScale = 1.f;
+
+}
+
+glm::vec2 TemporalUpscaler::Update(uint32_t imageIndex) {
+
+	VkExtent2D area = RenderPass::getRenderArea(vulkanApp->getSwapchain()->getExtent());
+
+	/// Sub-pixel offset of this frame, in rendered pixels (-0.5..0.5), then in clip space
+	uint32_t phase = frame++ % TEMPORAL_JITTER_PHASES + 1;
+	TemporalUBO ubo;
+	ubo.jitter = glm::vec2(halton(phase, 2), halton(phase, 3)) - 0.5f;
+	ubo.renderSize = glm::ivec2(area.width, area.height);
+	jitter = ubo.jitter * 2.f / glm::vec2(ubo.renderSize);
+
+	uboBuffer->copyBuffer(imageIndex, ubo);
+	return jitter;
+}
+
+RenderPass* TemporalUpscaler::cmdResolve(const VkCommandBuffer& cmdBuffer, int index, RenderPass* sceneRenderPass) {
+
+	sceneRenderPass->end(cmdBuffer);
+
+	Swapchain* swapchain = vulkanApp->getSwapchain();
+	VkExtent2D extent = swapchain->getExtent();
+	VkExtent2D area = RenderPass::getRenderArea(extent);
+	VkImage swapchainImage = swapchain->getImage(index);
+
+	VkImageMemoryBarrier barriers[4] = {};
+	for (VkImageMemoryBarrier& barrier : barriers) {
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	}
+
+	/// Swapchain image: left as a present attachment by the scene; velocity: sampled; samples and reconstruction: overwritten (once the previous frame is done with them)
+	barriers[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	barriers[0].oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barriers[0].image = swapchainImage;
+	barriers[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barriers[1].oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barriers[1].image = velocity->getImage();
+	barriers[2].srcAccessMask = 0;
+	barriers[2].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barriers[2].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barriers[2].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barriers[2].image = current->getImage();
+	barriers[3].srcAccessMask = 0;
+	barriers[3].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barriers[3].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barriers[3].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barriers[3].image = resolved->getImage();
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, 4, barriers);
+
+	/// Samples of the frame (rendered part of the present attachment)
+	VkImageCopy copy = {};
+	copy.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	copy.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	copy.extent = { area.width, area.height, 1 };
+	vkCmdCopyImage(cmdBuffer, swapchainImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, current->getImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+	barriers[2].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barriers[2].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barriers[2].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barriers[2].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &barriers[2]);
+
+	/// Reconstruction, at the swapchain resolution
+	descriptor->cmdBind(cmdBuffer, index);
+	pipeline->cmdBind(cmdBuffer, index);
+	vkCmdDispatch(cmdBuffer, (extent.width + TEMPORAL_GROUP - 1) / TEMPORAL_GROUP, (extent.height + TEMPORAL_GROUP - 1) / TEMPORAL_GROUP, 1);
+
+	/// Reconstruction: copied; history: overwritten; swapchain image: written
+	barriers[3].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barriers[3].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	barriers[3].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barriers[3].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barriers[2].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barriers[2].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barriers[2].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barriers[2].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barriers[2].image = history->getImage();
+	barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	VkImageMemoryBarrier resolveBarriers[3] = { barriers[0], barriers[2], barriers[3] };
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 3, resolveBarriers);
+
+	/// History of the next frame, and the swapchain image (format conversion only)
+	copy.extent = { extent.width, extent.height, 1 };
+	vkCmdCopyImage(cmdBuffer, resolved->getImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, history->getImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+	VkImageBlit blit = {};
+	blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	blit.srcOffsets[1] = { (int32_t)extent.width, (int32_t)extent.height, 1 };
+	blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	blit.dstOffsets[1] = { (int32_t)extent.width, (int32_t)extent.height, 1 };
+	vkCmdBlitImage(cmdBuffer, resolved->getImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, swapchainImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_NEAREST);
+
+	/// History: sampled by the next frame; swapchain image: loaded by the overlay pass
+	barriers[2].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barriers[2].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barriers[2].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barriers[2].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barriers[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barriers[0].newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	VkImageMemoryBarrier finalBarriers[2] = { barriers[0], barriers[2] };
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, NULL, 0, NULL, 2, finalBarriers);
+
+	overlayRenderPass->begin(cmdBuffer, overlayFramebuffers[index]);
+	return overlayRenderPass;
+}
+
+bool TemporalUpscaler::setScale(float s, bool noRecompile) {
+
+	// Read the current mode from __.defines (the source of truth for the shaders)
+	std::string definesContents = U::readFileStr("__.defines");
+	std::vector<std::string> splitDefinesContents = U::splitStr("TEMPORAL_UPSCALING_", definesContents);
+	if (splitDefinesContents.size() != 2 || splitDefinesContents[1].length() < 1) throw std::runtime_error("Could not modify __.defines to recompile shaders for temporal upscaling.");
+	bool motionVectors = splitDefinesContents[1][0] == '1';
+
+	s = glm::clamp(s, 0.25f, 1.f);
+	if (s == scale && motionVectors == (s < 1.f)) return false;// nothing to change!
+	scale = s;
+	if (motionVectors == (s < 1.f)) return true;// the shaders already match: only the scene is rebuilt
+
+	// Change __.defines to mirror the new mode
+	std::string upscalingDef = (s < 1.f ? "1" : "0");
+	std::string newDefinesContents = splitDefinesContents[0] + "TEMPORAL_UPSCALING_" + upscalingDef + splitDefinesContents[1].substr(1);
+	U::writeFile("__.defines", newDefinesContents);
+	printf(("Wrote to __.defines: #define TEMPORAL_UPSCALING_" + upscalingDef + ".\n").c_str());
+
+	// Recompile the vertex stages (jitter, clip positions of both frames) and the G-Buffer fragment shaders writing the velocity
+	if (!noRecompile) {
+		CompileShader("Shaders/default.vert");
+		CompileShader("Shaders/vert_particles_fwd.vert");
+		CompileShader("Shaders/particles_fwd.vert");
+		CompileShader("Shaders/vertgeom_particles_fwd.vert");
+		CompileShader("Shaders/quadexpand.geom");
+		CompileShader("Shaders/particles.geom");
+		CompileShader("Shaders/shrimp_g.frag");
+		CompileShader("Shaders/raccoon_g.frag");
+		CompileShader("Shaders/raymarch_g.frag");
+		CompileShader("Shaders/particles_g3.frag");
+		CompileShader("Shaders/comp_particles_g3.frag");
+		CompileShader("Shaders/shrimp_6g.frag");
+		CompileShader("Shaders/raccoon_6g.frag");
+		CompileShader("Shaders/raymarch_6g.frag");
+		CompileShader("Shaders/particles_g6.frag");
+		CompileShader("Shaders/comp_particles_g6.frag");
+	}
+
+	// Force rebuilding pipelines & swapchain (using newly compiled shaders)
+	return true;
+}
+
+bool TemporalUpscaler::enabled() {
+	return scale < 1.f && !DynamicResolution::enabled();
+}
+
+bool TemporalUpscaler::UI() {
+
+	/// Drop-down list for the render scale
+	static const float scales[] = TEMPORAL_UPSCALING_SCALES;
+	static const char* labels[] = { "Off", "70%", "50%" };
+	int selected = 0;
+	for (int i = 0; i < IM_ARRAYSIZE(scales); ++i)
+		if (scale == scales[i]) selected = i;
+	bool rebuild = false;
+	if (ImGui::BeginCombo("Temporal Upscaling", scale == scales[selected] ? labels[selected] : "Custom")) {
+		for (int i = 0; i < IM_ARRAYSIZE(labels); ++i) {
+			bool isSelected = selected == i && scale == scales[i];
+			if (ImGui::Selectable(labels[i], isSelected) && !isSelected) {
+				/// Switch render scale (the scene must be rebuilt)
+				rebuild = setScale(scales[i]);
+			}
+			if (isSelected) {
+				ImGui::SetItemDefaultFocus();
+			}
+		}
+		ImGui::EndCombo();
+	}// Temporal upscaling drop down
+
+	if (scale < 1.f && DynamicResolution::enabled())
+		ImGui::Text("(off while Dynamic Resolution is on)");
+
+	return rebuild;
+}
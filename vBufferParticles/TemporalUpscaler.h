@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include "VulkanAppBase.h"
+#include "ComputePipeline.h"
+#include "UniformBuffer.h"
+#include "Descriptor.h"
+#include "Utils.h"
+#include <imgui.h>
+
+
+// render scale options of temporal upscaling (fraction of the swapchain extent rendered, along x and y)
+#define TEMPORAL_UPSCALING_SCALES { 1.0f, 0.7f, 0.5f }
+// length of the sequence of sub-pixel offsets (Halton 2, 3) cycled through by the jitter
+#define TEMPORAL_JITTER_PHASES 8
+// pixels per side of the workgroups of the reconstruction (must match Shaders/temporal_resolve.comp)
+#define TEMPORAL_GROUP 16
+// format of the velocity attachment: screen uv motion since the previous frame
+#define TEMPORAL_VELOCITY_FORMAT VK_FORMAT_R16G16_SFLOAT
+
+/// Velocity attachment, placed after the G-Buffers of the scene render pass; stored, as the reconstruction samples it once the render pass is over
+#define RENDERPASS_ATTACHMENT_DESC_VELOCITY RenderPass::RenderPassAttachmentDesc(TEMPORAL_VELOCITY_FORMAT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_ATTACHMENT_STORE_OP_STORE)
+
+
+/// Frame parameters of the reconstruction (same layout as Shaders/temporal_resolve.comp)
+struct TemporalUBO {
+	alignas(8) glm::vec2 jitter;// sub-pixel offset of the frame's samples, in rendered pixels
+	alignas(8) glm::ivec2 renderSize;// rendered part of the scene attachments
+};// struct TemporalUBO
+
+
+/// Renders a scene at a fixed fraction of the swapchain resolution, and reconstructs the full resolution image over several frames (see Shaders/temporal_resolve.comp).
+/// Every frame is rendered with a different sub-pixel jitter, added to the clip positions by the vertex stages, and writes the motion of each pixel since the previous
+/// frame to a velocity attachment (TEMPORAL_UPSCALING_1 in __.defines; particle motion comes from re-generating the particle at the previous frame's time). The
+/// reconstruction then reprojects the history of the previous frames along the velocity, clamps it to the neighbourhood of the new samples, and blends in the samples
+/// by their distance to each output pixel, so that detail accumulates at the swapchain resolution.
+/// The owning scene adds getVelocityAttachment() to its render pass (RENDERPASS_ATTACHMENT_DESC_VELOCITY), passes getJitter() to its matrix and particle UBOs, and
+/// records cmdResolve() in place of ending its last render pass; the UI is then drawn in getRenderPass(). Only used without dynamic resolution, which drives the
+/// render scale itself.
+class TemporalUpscaler {
+
+	VulkanAppBase* vulkanApp;
+	DevicesPtr devices;
+
+	/// Motion of each rendered pixel since the previous frame (attached to the scene render pass)
+	Texture* velocity;
+
+	/// Rendered part of the scene's present attachment, copied for sampling
+	Texture* current;
+	/// Reconstruction of the previous frames (alpha 0 until written), and of this frame (storage); one copy of each, as frames are ordered by barriers
+	Texture* history;
+	Texture* resolved;
+
+	/// Reconstruction pass
+	UniformBuffer<TemporalUBO>* uboBuffer;
+	Descriptor* descriptor;
+	ComputePipeline* pipeline;
+
+	/// UI overlay pass, over the reconstructed swapchain image (its depth attachment is only there for RenderPass, and never tested)
+	RenderPass* overlayRenderPass;
+	Texture* overlayDepth;
+	std::vector<VkFramebuffer> overlayFramebuffers;
+
+	/// Frames since creation, which select the jitter
+	uint32_t frame = 0;
+	glm::vec2 jitter = glm::vec2(0.f);// this frame's offset, in clip space
+
+	/// Render scale (shared by all scenes); 1 -> scenes render at the swapchain resolution directly
+	static float scale;
+
+public:
+
+	/// Creates the velocity attachment, the history and the reconstruction pass, and sets the render scale; must be created before the scene's render passes are recorded.
+	TemporalUpscaler(VulkanAppBase* vulkanApp);
+	/// Cleanup; render passes cover their whole extent again
+	~TemporalUpscaler();
+
+	/// Velocity attachment of the scene render pass
+	inline Texture* getVelocityAttachment() { return velocity; }
+	/// Render pass of the UI overlay (drawn at the swapchain resolution)
+	inline RenderPass* getRenderPass() { return overlayRenderPass; }
+
+	/// Moves to the jitter of the next frame, and uploads the reconstruction parameters of this image; returns the jitter (clip space offset) for the scene's UBOs.
+	glm::vec2 Update(uint32_t imageIndex);
+	inline glm::vec2 getJitter() { return jitter; }
+
+	/// Ends the last render pass of the scene, reconstructs the frame into the swapchain image, and begins the overlay pass (returned, for the UI).
+	RenderPass* cmdResolve(const VkCommandBuffer& cmdBuffer, int index, RenderPass* sceneRenderPass);
+
+	/// Change the render scale (1 disables temporal upscaling); will re-compile the shaders writing motion vectors. Returns true if the scene must be rebuilt.
+	static bool setScale(float s, bool noRecompile = false);
+	static inline float getScale() { return scale; }
+	/// Whether scenes supporting it render at a reduced scale and reconstruct the full resolution (dynamic resolution takes precedence)
+	static bool enabled();
+
+	/// Temporal upscaling drop-down; returns true if the scene must be rebuilt.
+	static bool UI();
+
+};// class TemporalUpscaler
@@ -49,14 +49,14 @@ Texture::Texture(std::string path, VkDevice* logicalDevice, const VkPhysicalDevi
 }
 
 // create texture used as framebuffer attachment
-Texture::Texture(VkFormat format, VkExtent2D size, VkImageUsageFlags usage, VkImageAspectFlags aspectFlags, VkImageLayout layout, VkDevice* logicalDevice, const VkPhysicalDevice& physicalDevice, const VkCommandPool& commandPool, const VkQueue& graphicsQueue) : logicalDevice(logicalDevice), format(format){
+Texture::Texture(VkFormat format, VkExtent2D size, VkImageUsageFlags usage, VkImageAspectFlags aspectFlags, VkImageLayout layout, VkDevice* logicalDevice, const VkPhysicalDevice& physicalDevice, const VkCommandPool& commandPool, const VkQueue& graphicsQueue, uint32_t layers) : logicalDevice(logicalDevice), format(format), layers(layers){
 
 	// create image and image view.
-	createImage(size.width, size.height, format, VK_IMAGE_TILING_OPTIMAL, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageMemory, *logicalDevice, physicalDevice);
-	imageView = createImageView(*logicalDevice, format, aspectFlags);
+	createImage(size.width, size.height, format, VK_IMAGE_TILING_OPTIMAL, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageMemory, *logicalDevice, physicalDevice, layers);
+	imageView = createImageView(*logicalDevice, format, aspectFlags, layers);
 
 	// transition image to required layout
-	U::transitionImageLayout(textureImage, format, VK_IMAGE_LAYOUT_UNDEFINED, layout, commandPool, *logicalDevice, graphicsQueue);
+	U::transitionImageLayout(textureImage, format, VK_IMAGE_LAYOUT_UNDEFINED, layout, commandPool, *logicalDevice, graphicsQueue, layers);
 
 }
 
@@ -67,7 +67,7 @@ Texture::~Texture(){
 	vkFreeMemory(*logicalDevice, textureImageMemory, NULL);
 }
 
-void Texture::createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory, VkDevice& logicalDevice, const VkPhysicalDevice& physicalDevice){
+void Texture::createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory, VkDevice& logicalDevice, const VkPhysicalDevice& physicalDevice, uint32_t layers){
 	//Create vk image object
 	VkImageCreateInfo imageInfo = {};
 	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -76,7 +76,7 @@ void Texture::createImage(uint32_t width, uint32_t height, VkFormat format, VkIm
 	imageInfo.extent.height = height;
 	imageInfo.extent.depth = 1;
 	imageInfo.mipLevels = 1;
-	imageInfo.arrayLayers = 1;
+	imageInfo.arrayLayers = layers;
 	imageInfo.format = format;
 	imageInfo.tiling = tiling;
 	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -102,19 +102,19 @@ void Texture::createImage(uint32_t width, uint32_t height, VkFormat format, VkIm
 
 }
 
-VkImageView Texture::createImageView(VkDevice logicalDevice, VkFormat format, VkImageAspectFlags aspectFlags){
+VkImageView Texture::createImageView(VkDevice logicalDevice, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t layers){
 	
 	/// Create image view from image vk resource.
 	VkImageViewCreateInfo viewInfo = {};
 	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 	viewInfo.image = textureImage;
-	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.viewType = layers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
 	viewInfo.format = format;
 	viewInfo.subresourceRange.aspectMask = aspectFlags;
 	viewInfo.subresourceRange.baseMipLevel = 0;
 	viewInfo.subresourceRange.levelCount = 1;
 	viewInfo.subresourceRange.baseArrayLayer = 0;
-	viewInfo.subresourceRange.layerCount = 1;
+	viewInfo.subresourceRange.layerCount = layers;
 	VkImageView imageView;
 	if (vkCreateImageView(logicalDevice, &viewInfo, NULL, &imageView) != VK_SUCCESS)
 		throw std::runtime_error("Could not create image view for texture");
@@ -149,10 +149,10 @@ VkSampler Texture::createSampler(VkDevice logicalDevice){
 }
 
 /// Returns a descriptor for the current texture, assuming a layout of READ_ONLY
-VkDescriptorImageInfo Texture::getDescriptor(VkSampler sampler){
+VkDescriptorImageInfo Texture::getDescriptor(VkSampler sampler, VkImageLayout layout){
 
 	VkDescriptorImageInfo info = {};
-	info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	info.imageLayout = layout;
 	info.imageView = imageView;
 	info.sampler = sampler;
 
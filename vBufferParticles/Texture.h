@@ -12,8 +12,8 @@ public:
 	// Create texture from image file
 	Texture(std::string path, VkDevice* logicalDevice, const VkPhysicalDevice& physicalDevice, const VkCommandPool& commandPool, const VkQueue& graphicsQueue);
 
-	// Create texture from swapchain size
-	Texture(VkFormat format, VkExtent2D size, VkImageUsageFlags usage, VkImageAspectFlags aspectFlags, VkImageLayout layout, VkDevice* logicalDevice, const VkPhysicalDevice& physicalDevice, const VkCommandPool& commandPool, const VkQueue& graphicsQueue);
+	// Create texture from swapchain size; with several layers, the image view is a 2D array (eg. multiview attachments, one layer per view)
+	Texture(VkFormat format, VkExtent2D size, VkImageUsageFlags usage, VkImageAspectFlags aspectFlags, VkImageLayout layout, VkDevice* logicalDevice, const VkPhysicalDevice& physicalDevice, const VkCommandPool& commandPool, const VkQueue& graphicsQueue, uint32_t layers = 1);
 
 	// Resource cleanup
 	~Texture();
@@ -22,13 +22,14 @@ public:
 	static VkSampler createSampler(VkDevice logicalDevice);
 
 	/// Get descriptor info and descriptor write entry to bind to Descriptor sets.
-	VkDescriptorImageInfo getDescriptor(VkSampler sampler);
+	VkDescriptorImageInfo getDescriptor(VkSampler sampler, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 	VkWriteDescriptorSet getDescriptorEntry(VkDescriptorImageInfo* descriptor, uint32_t binding, const VkDescriptorSet& descriptorSet);
 
 	/// Getters of the Vk resource handles
 	inline const VkImageView& getImageView() { return imageView; }
 	inline const VkImage& getImage() { return textureImage; }
 	inline const VkFormat& getFormat() { return format; }
+	inline uint32_t getLayers() const { return layers; }
 
 	// a tag accessible in Debug builds to identify texture objects. Set using SET_DEBUG_TEXTURE_IDENTIFIER macro.
 #ifndef NDEBUG
@@ -38,10 +39,10 @@ public:
 private:
 
 	/// Helper function to create an image with specified properties
-	static void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory, VkDevice& logicalDevice, const VkPhysicalDevice& physicalDevice);
+	static void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory, VkDevice& logicalDevice, const VkPhysicalDevice& physicalDevice, uint32_t layers = 1);
 
-	/// Takes care of image view creation.
-	VkImageView createImageView(VkDevice logicalDevice, VkFormat format, VkImageAspectFlags aspectFlags);
+	/// Takes care of image view creation (2D array view over all layers when there are several).
+	VkImageView createImageView(VkDevice logicalDevice, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t layers = 1);
 
 
 	VkDevice* logicalDevice;
@@ -51,6 +52,7 @@ private:
 	VkDeviceMemory textureImageMemory;
 	VkImageView imageView;
 	VkFormat format;// the image format.
+	uint32_t layers = 1;// array layers of the image.
 
 };// class Texture
 
@@ -100,5 +100,5 @@ bool UIOverlay::updateGUI() {
 
 /// Bind ui overlay to command buffer
 void UIOverlay::cmdBind(const VkCommandBuffer& cmdBuffer, int index) const {
-	ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmdBuffer);
+	ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmdBuffer, index);// buffers of this image only (command buffers may be re-recorded one at a time)
 }
@@ -6,7 +6,7 @@
 /// A mesh containing data that can be used in both subpasses of the V-Buffer render pass
 struct UberVMesh {
 
-	/// From UberVVertices, creates both a mesh with VisibilityVertex layout and uniform buffers for sending the data to the lighting pass
+	/// From UberVVertices, creates both a mesh with VisibilityVertex layout and the data for the global buffers read by the lighting pass
 	inline UberVMesh(const std::vector<UberVVertex>& vertices, const std::vector<uint16_t>& indices, VkDevice* logicalDevice, const VkPhysicalDevice& physicalDevice, const VkCommandPool& commandPool, const VkQueue& graphicsQueue) {
 		
 		this->indices = indices;
@@ -31,24 +31,23 @@ struct UberVMesh {
 	inline uint32_t getIndexCount() { return (uint32_t)indices.size(); }
 	inline uint32_t getVertexCount() { return (uint32_t)vertices.size(); }
 
-	/// Write the data that describes this mesh into the buffers that will be pushed as uniform buffers to the lighting pass' fragment shader.
+	/// Append the data that describes this mesh to the global index & vertex buffers read by the lighting pass' fragment shader.
 	inline void pushDataToUberVertexBuffer(std::vector<uint32_t>& vbIndices, std::vector<VBufferVertexInput>& vbVertices, uint32_t& indexOffset, uint32_t& vertexOffset) {
 
-		// Push indices
+		assert(vbIndices.size() == indexOffset && vbVertices.size() == vertexOffset);
+
+		// Push indices (32 bits, offset to this mesh's first vertex in the global vertex buffer)
 		for (int i = 0; i < indices.size(); ++i) {
-			assert(i + indexOffset < VBUFFER_MAX_INDICES);
-			vbIndices[i + indexOffset] = indices[i] + vertexOffset;
+			vbIndices.push_back(indices[i] + vertexOffset);
 		}
 		indexOffset += (uint32_t)indices.size();
 
 		// Push vertices
 		for (int i = 0; i < vertices.size(); ++i) {
-			assert(i + vertexOffset < VBUFFER_MAX_VERTICES);
 			glm::vec3 pos = vertices[i].vector3s[0];
 			glm::vec3 normal = vertices[i].vector3s[1];
 			glm::vec2 uv = vertices[i].vector2s[0];
-			VBufferVertexInput vertexInput(pos, normal, uv);
-			vbVertices[i + vertexOffset] = vertexInput;
+			vbVertices.push_back(VBufferVertexInput(pos, normal, uv));
 		}
 		vertexOffset += (uint32_t)vertices.size();
 
@@ -57,7 +56,7 @@ struct UberVMesh {
 private:
 
 	VisibilityMesh* vMesh;// mesh that can be bound for rendering directly
-	// buffers that can be added to the uniform buffers for shading in lighting pass.
+	// buffers that can be added to the global index & vertex buffers for shading in lighting pass.
 	std::vector<uint16_t> indices;
 	std::vector<VBufferVertex> vertices;
 
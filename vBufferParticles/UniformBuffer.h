@@ -11,7 +11,8 @@ struct UniformBuffer {
 	inline UniformBuffer(int swapchainSize, VkDevice* logicalDevice, VkPhysicalDevice physicalDevice,
 				int usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,			// Default usage is as a Uniform Buffer, but this can be optionally modified to use as SSBO also
 				int memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,	// Default memory properties for use as a Uniform Buffer
-				int size = 1	// Size multiplier for the UBO
+				int size = 1,	// Size multiplier for the UBO
+				const std::vector<uint32_t>& sharedQueueFamilies = {}	// Distinct queue families the buffers are accessed from (concurrent sharing), eg. when written by Compute and read by Graphics
 			) {
 
 		this->logicalDevice = logicalDevice;
@@ -22,7 +23,7 @@ struct UniformBuffer {
 		uniformBuffersMemory.resize(swapchainSize);
 
 		for (size_t i = 0; i < swapchainSize; ++i) {
-			U::createBuffer(bufferSize, (VkBufferUsageFlagBits)usage, (VkMemoryPropertyFlagBits)memoryProperties, uniformBuffers[i], uniformBuffersMemory[i], *logicalDevice, physicalDevice);
+			U::createBuffer(bufferSize, (VkBufferUsageFlagBits)usage, (VkMemoryPropertyFlagBits)memoryProperties, uniformBuffers[i], uniformBuffersMemory[i], *logicalDevice, physicalDevice, sharedQueueFamilies);
 		}
 
 	}
@@ -49,6 +50,32 @@ struct UniformBuffer {
 		} vkUnmapMemory(*logicalDevice, uniformBuffersMemory[currentImage]);
 	}
 
+	/// Uploads an array of count UBOs to the start of the buffer (when created with a size multiplier of at least count).
+	inline void copyBuffer(uint32_t currentImage, const UBO* ubos, size_t count) {
+		if (count == 0) return;
+		void* data;
+		vkMapMemory(*logicalDevice, uniformBuffersMemory[currentImage], 0, sizeof(UBO) * count, 0, &data); {
+			memcpy(data, ubos, sizeof(UBO) * count);
+		} vkUnmapMemory(*logicalDevice, uniformBuffersMemory[currentImage]);
+	}
+
+	/// Reads back the buffer of an image written by the GPU (host visible memory only); the frame that wrote it must have completed.
+	inline void readBuffer(uint32_t currentImage, UBO& ubo) {
+		void* data;
+		vkMapMemory(*logicalDevice, uniformBuffersMemory[currentImage], 0, sizeof(ubo), 0, &data); {
+			memcpy(&ubo, data, sizeof(ubo));
+		} vkUnmapMemory(*logicalDevice, uniformBuffersMemory[currentImage]);
+	}
+
+	/// Reads back an array of count UBOs from the start of the buffer (host visible memory only); the frame that wrote it must have completed.
+	inline void readBuffer(uint32_t currentImage, UBO* ubos, size_t count) {
+		if (count == 0) return;
+		void* data;
+		vkMapMemory(*logicalDevice, uniformBuffersMemory[currentImage], 0, sizeof(UBO) * count, 0, &data); {
+			memcpy(ubos, data, sizeof(UBO) * count);
+		} vkUnmapMemory(*logicalDevice, uniformBuffersMemory[currentImage]);
+	}
+
 	/// Call copyBuffer() for all images in swapchain.
 	inline void copyAllBuffers(const UBO& ubo) {
 		for (int i = 0; i < uniformBuffersMemory.size(); ++i)
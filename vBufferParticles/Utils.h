@@ -11,6 +11,8 @@
 
 #define U Utils // quick access to class through U::
 
+#define MULTIVIEW_VIEWS 2 // views rendered at once by multiview stereo, whose matrices the UBOs hold (see Multiview.h) - must match Shaders/multiview.glsl
+
 #ifdef NDEBUG
 #define printf(...) // In Release mode, no need for outputting to cout.
 #endif
@@ -96,7 +98,9 @@ public:
 	}
 
 	/// Create a VkBuffer and VkBufferMemory bound to each other
-	static inline void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory, const VkDevice& logicalDevice, const VkPhysicalDevice& physicalDevice) {
+	/// sharedQueueFamilies: if it holds more than one (distinct) family, the buffer is created with concurrent sharing so no queue ownership transfers are needed.
+	static inline void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory, const VkDevice& logicalDevice, const VkPhysicalDevice& physicalDevice,
+				const std::vector<uint32_t>& sharedQueueFamilies = {}) {
 
 		//Create buffer
 
@@ -106,6 +110,11 @@ public:
 		bufferInfo.usage = usage;
 		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 		bufferInfo.flags = 0;
+		if (sharedQueueFamilies.size() > 1) {
+			bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			bufferInfo.queueFamilyIndexCount = (uint32_t)sharedQueueFamilies.size();
+			bufferInfo.pQueueFamilyIndices = sharedQueueFamilies.data();
+		}
 
 		if (vkCreateBuffer(logicalDevice, &bufferInfo, NULL, &buffer) != VK_SUCCESS) {
 			throw std::runtime_error("Faield to create buffer!");
@@ -189,7 +198,7 @@ public:
 	}
 
 	/// Transition image layouts of an image as a command
-	static inline void cmdTransitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, VkCommandBuffer& cmdBuffer, VkDependencyFlags dependencyFlags) {
+	static inline void cmdTransitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, VkCommandBuffer& cmdBuffer, VkDependencyFlags dependencyFlags, uint32_t layers = 1) {
 
 		// setup memory barrier for transition command
 		VkImageMemoryBarrier barrier = {};
@@ -202,7 +211,7 @@ public:
 		barrier.subresourceRange.baseMipLevel = 0;
 		barrier.subresourceRange.levelCount = 1;
 		barrier.subresourceRange.baseArrayLayer = 0;
-		barrier.subresourceRange.layerCount = 1;
+		barrier.subresourceRange.layerCount = layers;
 
 		VkPipelineStageFlags srcStage;
 		VkPipelineStageFlags dstStage;
@@ -244,6 +253,13 @@ public:
 			srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
 			dstStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
 		}
+		// from UNDEFINED to GENERAL (to be available to compute shaders as storage image)
+		else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_GENERAL) {
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+			dstStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		}
 		// Unsupported for now, simply throw exception.
 		else {
 			throw std::invalid_argument("Unsupported layout transition.");
@@ -254,11 +270,11 @@ public:
 
 	}
 
-	/// Transition image layout in a single time command
-	static inline void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, const VkCommandPool& commandPool, const VkDevice& logicalDevice, const VkQueue& graphicsQueue) {
+	/// Transition image layout (of all layers given) in a single time command
+	static inline void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, const VkCommandPool& commandPool, const VkDevice& logicalDevice, const VkQueue& graphicsQueue, uint32_t layers = 1) {
 		VkCommandBuffer cmdBuffer = beginSingleTimeCommands(commandPool, logicalDevice, graphicsQueue); {
 
-			cmdTransitionImageLayout(image, format, oldLayout, newLayout, cmdBuffer, 0);
+			cmdTransitionImageLayout(image, format, oldLayout, newLayout, cmdBuffer, 0, layers);
 
 		} endSingleTimeCommands(cmdBuffer, commandPool, logicalDevice, graphicsQueue);
 	}
@@ -1,34 +1,206 @@
 #include "VBufferScene.h"
+#include "StaticSettings.h"
+
+VisibilityFormat VBufferScene::visibilityFormat = VisibilityFormat::VisF32x4;
+bool VBufferScene::particleIds = false;
+bool VBufferScene::tiledShading = false;
+bool VBufferScene::triangleCache = true;
+
+/// Reads __.defines, split around a V-Buffer define (its mode digit then starts the second part)
+static std::vector<std::string> splitVBufferDefine(const std::string& define) {
+	std::string definesContents = U::readFileStr("__.defines");
+	std::vector<std::string> splitDefinesContents = U::splitStr(define, definesContents);
+	if (splitDefinesContents.size() != 2 || splitDefinesContents[1].length() < 1) throw std::runtime_error("Could not modify __.defines to recompile shaders for the visibility buffer (" + define + ").");
+	return splitDefinesContents;
+}
+
+VkFormat VBufferScene::getVisibilityVkFormat(VisibilityFormat format) {
+	switch (format) {
+	case VisibilityFormat::VisF16x4: return VK_FORMAT_R16G16B16A16_SFLOAT;
+	case VisibilityFormat::VisU32x2: return VK_FORMAT_R32G32_UINT;
+	case VisibilityFormat::VisU32: return VK_FORMAT_R32_UINT;
+	default: return VK_FORMAT_R32G32B32A32_SFLOAT;
+	}
+}
+
+uint32_t VBufferScene::getVisibilityMaxTriangles(VisibilityFormat format) {
+	switch (format) {
+	case VisibilityFormat::VisF16x4: return 1 << 11;// integers exact in half floats
+	case VisibilityFormat::VisU32: return 1 << 29;// remaining bits after 3 bits of material ID
+	default: return VBUFFER_MAX_TRIANGLES;// limited by the precision of the float vertex attributes
+	}
+}
+
+bool VBufferScene::setVisibilityFormat(VisibilityFormat format, bool noRecompile) {
+
+	// Read the current format from __.defines (the source of truth, which may differ from the default at start-up)
+	std::vector<std::string> splitDefinesContents = splitVBufferDefine("VBUFFER_FORMAT_");
+	VBufferScene::visibilityFormat = (VisibilityFormat)(splitDefinesContents[1][0] - '0');
+
+	if (format == VBufferScene::visibilityFormat) return false;// nothing to change!
+
+	VBufferScene::visibilityFormat = format;
+
+	// Change __.defines to mirror the new format
+	std::string formatDef = std::to_string((int)format);
+	std::string newDefinesContents = splitDefinesContents[0] + "VBUFFER_FORMAT_" + formatDef + splitDefinesContents[1].substr(1);
+	U::writeFile("__.defines", newDefinesContents);
+	printf(("Wrote to __.defines: #define VBUFFER_FORMAT_" + formatDef + ".\n").c_str());
+
+	// Recompile shaders writing or reading the visibility buffer
+	if (!noRecompile) {
+		CompileShader("Shaders/default_v.frag");
+		CompileShader("Shaders/particles_v.frag");
+		CompileShader("Shaders/comp_particles_v.frag");
+		compileLightingShaders();
+	}
+
+	// Force rebuilding pipelines & swapchain (using newly compiled shaders)
+	return true;
+}
+
+bool VBufferScene::setParticleIds(bool ids, bool noRecompile) {
+
+	// Read the current mode from __.defines (the source of truth, which may differ from the default at start-up)
+	std::vector<std::string> splitDefinesContents = splitVBufferDefine("VBUFFER_PARTICLE_IDS_");
+	VBufferScene::particleIds = splitDefinesContents[1][0] == '1';
+
+	if (ids == VBufferScene::particleIds) return false;// nothing to change!
+
+	VBufferScene::particleIds = ids;
+
+	// Change __.defines to mirror the new mode
+	std::string idsDef = (ids ? "1" : "0");
+	std::string newDefinesContents = splitDefinesContents[0] + "VBUFFER_PARTICLE_IDS_" + idsDef + splitDefinesContents[1].substr(1);
+	U::writeFile("__.defines", newDefinesContents);
+	printf(("Wrote to __.defines: #define VBUFFER_PARTICLE_IDS_" + idsDef + ".\n").c_str());
+
+	// Recompile shaders writing or reading particle visibility
+	if (!noRecompile) {
+		CompileShader("Shaders/particles_v.frag");
+		CompileShader("Shaders/comp_particles_v.frag");
+		compileLightingShaders();
+	}
+
+	// Force rebuilding pipelines & swapchain (using newly compiled shaders)
+	return true;
+}
+
+bool VBufferScene::setTiledShading(bool tiled) {
+	if (tiled == VBufferScene::tiledShading) return false;// nothing to change!
+	VBufferScene::tiledShading = tiled;
+	return true;// both lighting paths are always compiled: only the render passes and pipelines are rebuilt
+}
+
+bool VBufferScene::setTriangleCache(bool cache, bool noRecompile) {
+
+	// Read the current mode from __.defines (the source of truth, which may differ from the default at start-up)
+	std::vector<std::string> splitDefinesContents = splitVBufferDefine("VBUFFER_TRIANGLE_CACHE_");
+	VBufferScene::triangleCache = splitDefinesContents[1][0] == '1';
+
+	if (cache == VBufferScene::triangleCache) return false;// nothing to change!
+
+	VBufferScene::triangleCache = cache;
+
+	// Change __.defines to mirror the new mode
+	std::string cacheDef = (cache ? "1" : "0");
+	std::string newDefinesContents = splitDefinesContents[0] + "VBUFFER_TRIANGLE_CACHE_" + cacheDef + splitDefinesContents[1].substr(1);
+	U::writeFile("__.defines", newDefinesContents);
+	printf(("Wrote to __.defines: #define VBUFFER_TRIANGLE_CACHE_" + cacheDef + ".\n").c_str());
+
+	// Recompile the tile kernels of mesh materials (the particle kernel never caches triangles)
+	if (!noRecompile) {
+		CompileShader("Shaders/tile_shrimp_v.comp");
+		CompileShader("Shaders/tile_raymarch_v.comp");
+		CompileShader("Shaders/tile_raccoon_v.comp");
+	}
+
+	// Force rebuilding pipelines (using newly compiled shaders)
+	return true;
+}
+
+void VBufferScene::compileLightingShaders() {
+	CompileShader("Shaders/pp_lighting_v.frag");
+	CompileShader("Shaders/vbuffer_classify.comp");
+	CompileShader("Shaders/tile_shrimp_v.comp");
+	CompileShader("Shaders/tile_raymarch_v.comp");
+	CompileShader("Shaders/tile_raccoon_v.comp");
+	CompileShader("Shaders/tile_particles_v.comp");
+}
+
+void VBufferScene::appendLightingBindings(DESCRIPTOR_BINDING_ARRAY& bindings, VkShaderStageFlags stage) {
+	// light, matrices, indices, vertices, shrimp / raccoon / particle textures
+	for (VkDescriptorType type : { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+								   VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER })
+		bindings.push_back({ type, stage });
+#ifdef SEND_DEBUG_BUFFER_V
+	bindings.push_back({ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, stage });
+#endif
+	// with particle IDs, particles are re-generated from their index and need the particle UBO (and baked statics)
+	if (usesParticleIds()) {
+		bindings.push_back({ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, stage });
+		if (particleStatics.size() > 0) bindings.push_back({ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stage });
+	}
+	// triangle setup of the frame
+	bindings.push_back({ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stage });
+	// clustered point lights
+	ClusteredLights::appendBindings(bindings, stage);
+}
+
+void VBufferScene::appendLightingDescriptors(std::vector<Descriptor::UBODescriptor>& uboDescriptors, std::vector<Descriptor::ImageInfoDescriptor>& imgDescriptors) {
+	uboDescriptors.push_back(Descriptor::UBODescriptor(lightBuffer->getBuffers(), (int)sizeof(LightBufferObject)));
+	uboDescriptors.push_back(Descriptor::UBODescriptor(matrixBuffer->getBuffers(), sizeof(MatrixBufferObject)));
+	uboDescriptors.push_back(Descriptor::UBODescriptor(vertexBuffer->getIndexBuffers(), vertexBuffer->getIndexBufferSize()));
+	uboDescriptors.push_back(Descriptor::UBODescriptor(vertexBuffer->getVertexBuffers(), vertexBuffer->getVertexBufferSize()));
+#ifdef SEND_DEBUG_BUFFER_V
+	uboDescriptors.push_back(Descriptor::UBODescriptor(debugBuffer->getBuffers(), (int)sizeof(DebugBufferObject)));
+#endif
+	if (usesParticleIds()) {
+		uboDescriptors.push_back(Descriptor::UBODescriptor(particles->getUBOBuffers(), particles->getUBOSize()));
+		if (particleStatics.size() > 0) uboDescriptors.push_back(Descriptor::UBODescriptor(particleStatics, particles->getStaticsSize()));
+	}
+	uboDescriptors.push_back(Descriptor::UBODescriptor(triangleSetupBuffer->getBuffers(), (int)sizeof(TriangleSetup) * vertexBuffer->getTriangleCount() * getViewCount()));
+	clusteredLights->appendDescriptors(uboDescriptors);
+	imgDescriptors.push_back(Descriptor::ImageInfoDescriptor(shrimpTex, vulkanApp->getSampler()));
+	imgDescriptors.push_back(Descriptor::ImageInfoDescriptor(raccoonTex, vulkanApp->getSampler()));
+	imgDescriptors.push_back(Descriptor::ImageInfoDescriptor(particles->getSpriteCache() ? particles->getSpriteCache() : leafTex, vulkanApp->getSampler()));// particles sample their sprite cache in place of the leaf
+}
 
 VBufferScene::VBufferScene(VulkanAppBase* vulkanApp) : Scene(vulkanApp) {
+
+	// lazy init pattern: mirror the visibility format saved in __.defines
+	static bool firstTime = true;
+	if (firstTime) {
+		firstTime = false;
+		visibilityFormat = (VisibilityFormat)(splitVBufferDefine("VBUFFER_FORMAT_")[1][0] - '0');
+		particleIds = splitVBufferDefine("VBUFFER_PARTICLE_IDS_")[1][0] == '1';
+		triangleCache = splitVBufferDefine("VBUFFER_TRIANGLE_CACHE_")[1][0] == '1';
+	}
+	if (RC_SETTINGS) particlesOnly = !RC_SETTINGS->vMeshes;
+
 	/// Create objects that do not rely on a specific swapchain layout
 
 	//descriptor set & pipeline layouts
 	DESCRIPTOR_BINDING_ARRAY firstSubpassBindings = { DESCRIPTOR_BINDING_UBO_VERTEX };
 	firstSubpassDescriptor = new Descriptor(firstSubpassBindings, devices());
-	DESCRIPTOR_BINDING_ARRAY secondSubpassBindings = { DESCRIPTOR_BINDING_INPUT_ATTACHMENT_FRAGMENT, DESCRIPTOR_BINDING_UBO_FRAGMENT, DESCRIPTOR_BINDING_UBO_FRAGMENT, DESCRIPTOR_BINDING_UBO_FRAGMENT, DESCRIPTOR_BINDING_SAMPLER_FRAGMENT, DESCRIPTOR_BINDING_SAMPLER_FRAGMENT, DESCRIPTOR_BINDING_SAMPLER_FRAGMENT };
-#ifdef SEND_DEBUG_BUFFER_V
-	secondSubpassBindings.push_back(DESCRIPTOR_BINDING_UBO_FRAGMENT);
-#endif
-	secondSubpassDescriptor = new Descriptor(secondSubpassBindings, devices());
 
 	// create visibility meshes; each vertex keeps track of its primitive id
-	uint16_t triId = 0;
+	uint32_t triId = 0;
 	vQuad = MeshFactory::createVisibilityQuadMesh(glm::vec3(-0.5f, 0, 0), glm::vec2(0.5f, 0.5f), triId, SHRIMP_MAT, devices(), devices->getPhysicalDevice(), *commandPool, devices->getGraphicsQueue());
 	vCube = MeshFactory::createVisibilityCubeMesh(glm::vec3(0.5f, 0, -3.0f), glm::vec3(2.5f, 2.5f, 2.5f), triId, SHRIMP_MAT, devices(), devices->getPhysicalDevice(), *commandPool, devices->getGraphicsQueue());
 	vCube2 = MeshFactory::createVisibilityCubeMesh(glm::vec3(2.0f, 0.3f, 2.0f), glm::vec3(1.0f, 1.5f, 1.0f), triId, SHRIMP_MAT, devices(), devices->getPhysicalDevice(), *commandPool, devices->getGraphicsQueue());
 	vCube3 = MeshFactory::createVisibilityCubeMesh(glm::vec3(-2.0f, 0.3f, 2.0f), glm::vec3(1.5f, 1.5f, 1.5f), triId, RACCOON_MAT, devices(), devices->getPhysicalDevice(), *commandPool, devices->getGraphicsQueue());
 	vGround = MeshFactory::createVisibilityCubeMesh(glm::vec3(0, -2.5f, 0), glm::vec3(20, 0.2f, 20), triId, SHRIMP_MAT, devices(), devices->getPhysicalDevice(), *commandPool, devices->getGraphicsQueue());
 	vRaymarchCube = MeshFactory::createVisibilityCubeMesh(glm::vec3(3.0f, 0, -2.0f), glm::vec3(2, 2, 2), triId, RAYMARCH_MAT, devices(), devices->getPhysicalDevice(), *commandPool, devices->getGraphicsQueue());
-	// check that we haven't gone over the allowed limit for the vertex & index uniform buffers
-	assert(triId < VBUFFER_MAX_TRIANGLES);
-	assert(vQuad->getIndexCount() + vCube->getIndexCount() + vCube2->getIndexCount() + vCube3->getIndexCount() + vGround->getIndexCount() + vRaymarchCube->getIndexCount() < VBUFFER_MAX_INDICES);
-	assert(vQuad->getVertexCount() + vCube->getVertexCount() + vCube2->getVertexCount() + vCube3->getVertexCount() + vGround->getVertexCount() + vRaymarchCube->getVertexCount() < VBUFFER_MAX_VERTICES);
+	// check all triangle IDs can be stored exactly in the V-Buffer
+	if (triId > getVisibilityMaxTriangles(visibilityFormat))
+		printf("Warning: %u triangles cannot all be identified in the current visibility buffer format (max %u).\n", triId, getVisibilityMaxTriangles(visibilityFormat));
+	assert(triId <= VBUFFER_MAX_TRIANGLES);
 
 	//Create vertex buffer that will be used in lighting pass
 	{
-		std::vector<uint32_t> indices(VBUFFER_MAX_INDICES);
-		std::vector<VBufferVertexInput> vertices(VBUFFER_MAX_VERTICES);
+		std::vector<uint32_t> indices;
+		std::vector<VBufferVertexInput> vertices;
 
 		uint32_t indicesOffset = 0;
 		uint32_t verticesOffset = 0;
@@ -43,12 +215,8 @@ VBufferScene::VBufferScene(VulkanAppBase* vulkanApp) : Scene(vulkanApp) {
 		PUSHDATA(vRaymarchCube);
 #undef PUSHDATA
 
-		/// Create uniform buffer from the data
-		vertexBuffer = new VBufferVertexBuffer(indices, vertices, vulkanApp->getSwapchain()->getSize(), devices(), devices->getPhysicalDevice());
-
-		// Update vertex UBO immediately
-		for (int i = 0; i < vertexBuffer->getBuffers().size(); ++i)
-			vertexBuffer->updateBuffer(i);
+		/// Create the device-local storage buffers from the data (uploaded immediately)
+		vertexBuffer = new VBufferVertexBuffer(indices, vertices, vulkanApp->getSwapchain()->getSize(), devices(), devices->getPhysicalDevice(), *commandPool, devices->getGraphicsQueue());
 
 	}
 
@@ -59,20 +227,63 @@ VBufferScene::VBufferScene(VulkanAppBase* vulkanApp) : Scene(vulkanApp) {
 
 
 	/// Create objects and layouts dependant on swapchain size
-	// Create render pass & attachments
-	std::vector<RenderPass::RenderPassAttachmentDesc> attachments = { RENDERPASS_ATTACHMENT_DESC_PRESENT(vulkanApp->getSwapchain()->getFormat()), RENDERPASS_ATTACHMENT_DESC_VEC4, RENDERPASS_ATTACHMENT_DESC_DEPTH };
-	renderPass = new RenderPass(devices(), attachments, 2, vulkanApp->getSwapchain()->getExtent());
+	// Create render pass & attachments; with tiled shading, the V-Buffer is left readable by compute shaders at the end of each render pass instance
+	VkImageLayout visibilityFinalLayout = tiledShading ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	std::vector<RenderPass::RenderPassAttachmentDesc> attachments = { RENDERPASS_ATTACHMENT_DESC_PRESENT(vulkanApp->getSwapchain()->getFormat()),
+		RenderPass::RenderPassAttachmentDesc(getVisibilityVkFormat(visibilityFormat), VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, visibilityFinalLayout, VK_ATTACHMENT_STORE_OP_DONT_CARE), RENDERPASS_ATTACHMENT_DESC_DEPTH };
+	bool stereo = Multiview::stereo() && !tiledShading;// the V-Buffer is written and shaded in the stereo pass, and only the eyes are composited in the render pass
+	bool composited = ParticleUpsampler::enabled() || ParticleOIT::enabled();// reduced resolution or transparent particles are drawn in a layer of their own
+	bool culled = ParticleSystem::usesOcclusionCulling() && !composited && !stereo;// the depth pyramid holds a single view
+	bool continued = !stereo && ((ParticleSystem::isStreaming() && !composited) || tiledShading || culled);
+	bool chained = continued || composited;
+	if (stereo) attachments.erase(attachments.begin() + 1);// the V-Buffer of each eye is a layer of the stereo pass
+	renderPass = new RenderPass(devices(), attachments, stereo ? 1 : 2, vulkanApp->getSwapchain()->getExtent(), chained ? RenderPass::Chaining::First : RenderPass::Chaining::None);
+	renderPass->setScaled(true);
+	if (stereo)
+		multiview = new Multiview(vulkanApp, renderPass, 0, { getVisibilityVkFormat(visibilityFormat) });
+	if (continued) {// particles will be drawn in further render pass instances, in between their compute dispatches (or after their culling); tiled shading is composited in a further instance after its dispatches
+		continuationRenderPass = new RenderPass(devices(), attachments, 2, vulkanApp->getSwapchain()->getExtent(), RenderPass::Chaining::Continuation);
+		continuationRenderPass->setScaled(true);
+	}
+	if (composited) {// reduced resolution or transparent particles are composited in a further instance (second subpass), which reads the scene depth
+		std::vector<RenderPass::RenderPassAttachmentDesc> compositeAttachments = attachments;
+		compositeAttachments.back() = RENDERPASS_ATTACHMENT_DESC_DEPTH_READ_ONLY;
+		compositeRenderPass = new RenderPass(devices(), compositeAttachments, 2, vulkanApp->getSwapchain()->getExtent(), RenderPass::Chaining::Continuation);
+		compositeRenderPass->setScaled(true);
+	}
+
+	/// Setup particles (before the lighting pass layout, which may read the particle buffers); at reduced resolution, they are drawn forward in the layer of the upsampler,
+	/// and transparent ones in the layer of the OIT; in stereo, they are written to the V-Buffer of the stereo pass
+	RenderPass* scenePass = multiview ? multiview->getRenderPass() : renderPass;
+	VkExtent2D sceneExtent = multiview ? multiview->getEyeExtent() : vulkanApp->getSwapchain()->getExtent();
+	if (ParticleUpsampler::enabled())
+		upsampler = new ParticleUpsampler(vulkanApp, compositeRenderPass, 1);
+	else if (ParticleOIT::enabled())
+		oit = new ParticleOIT(vulkanApp, compositeRenderPass, 1);
+	ParticleSystem::ParticlesConstructorParams args = upsampler ? upsampler->getParticlesParams() : oit ? oit->getParticlesParams() : ParticleSystem::ParticlesConstructorParams(ParticleRenderingMode::DeferredVRen, devices, descriptorPool,
+		vulkanApp->getSwapchain()->getSize(), sceneExtent, scenePass, *commandPool, vulkanApp->getSampler(), multiview ? multiview->getContinuationRenderPass() : continuationRenderPass);
+	if (culled) {
+		hiZ = new HiZPyramid(vulkanApp);
+		args.hiZ = hiZ;
+	}
+	particles = new ParticleSystem(args);
+	particleStatics = particles->getStaticsBuffers();
+
+	// Lighting pass descriptor: V-Buffer input attachment + shading resources; with tiled shading, the shaded image is composited instead
+	DESCRIPTOR_BINDING_ARRAY secondSubpassBindings = { tiledShading ? DESCRIPTOR_BINDING_SAMPLER_FRAGMENT : DESCRIPTOR_BINDING_INPUT_ATTACHMENT_FRAGMENT };
+	if (!tiledShading) appendLightingBindings(secondSubpassBindings, VK_SHADER_STAGE_FRAGMENT_BIT);
+	secondSubpassDescriptor = new Descriptor(secondSubpassBindings, devices());
 
 	// Create pipeline layouts
 	firstSubpassDescriptor->createPipelineLayout();
 	secondSubpassDescriptor->createPipelineLayout();
 
-	// Create pipelines
-	visibilityPipeline = new VisibilityGraphicsPipeline("default_v", "default_v", NULL, vulkanApp->getSwapchain()->getExtent(), firstSubpassDescriptor->getPipelineLayout(), renderPass, 0, true, 1, devices());
-	ppPipeline = new GraphicsPipeline("pp", "pp_lighting_v", NULL, vulkanApp->getSwapchain()->getExtent(), secondSubpassDescriptor->getPipelineLayout(), renderPass, 1, false, 1, devices());
+	// Create pipelines (in the stereo pass when rendering both eyes)
+	visibilityPipeline = new VisibilityGraphicsPipeline("default_v", "default_v", NULL, sceneExtent, firstSubpassDescriptor->getPipelineLayout(), scenePass, 0, true, 1, devices());
+	ppPipeline = new GraphicsPipeline("pp", tiledShading ? "pp_tiled_v" : "pp_lighting_v", NULL, sceneExtent, secondSubpassDescriptor->getPipelineLayout(), scenePass, 1, false, 1, devices());
 
 	//Create attachments
-	visibilityAttachment = new Texture(VK_FORMAT_R16G16B16A16_SFLOAT, vulkanApp->getSwapchain()->getExtent(), VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, devices(), devices->getPhysicalDevice(), *commandPool, devices->getGraphicsQueue());
+	if (!multiview) visibilityAttachment = new Texture(getVisibilityVkFormat(visibilityFormat), vulkanApp->getSwapchain()->getExtent(), VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | (tiledShading ? VK_IMAGE_USAGE_SAMPLED_BIT : 0), VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, devices(), devices->getPhysicalDevice(), *commandPool, devices->getGraphicsQueue());
 
 	// Create uniform buffers
 	lightBuffer = new LightBuffer(glm::vec3(2, 2, 2), 20, glm::vec3(1, 1, 0), glm::vec3(0.1f, 0.1f, 0.5f), vulkanApp->getSwapchain()->getSize(), devices(), devices->getPhysicalDevice());
@@ -81,35 +292,122 @@ VBufferScene::VBufferScene(VulkanAppBase* vulkanApp) : Scene(vulkanApp) {
 	debugBuffer = new DebugBuffer(vulkanApp->getSwapchain()->getSize(), devices(), devices->getPhysicalDevice());
 #endif
 
+	// Create the triangle setup pass: matrices, indices, vertices in; edge functions of each view out
+	triangleSetupBuffer = new UniformBuffer<TriangleSetup>(vulkanApp->getSwapchain()->getSize(), devices(), devices->getPhysicalDevice(),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer->getTriangleCount() * getViewCount());
+	DESCRIPTOR_BINDING_ARRAY triangleSetupBindings = { DESCRIPTOR_BINDING_UBO_COMPUTE, DESCRIPTOR_BINDING_STORAGE_BUFFER_COMPUTE, DESCRIPTOR_BINDING_STORAGE_BUFFER_COMPUTE, DESCRIPTOR_BINDING_STORAGE_BUFFER_COMPUTE };
+	triangleSetupDescriptor = new Descriptor(triangleSetupBindings, devices(), VK_PIPELINE_BIND_POINT_COMPUTE);
+	triangleSetupDescriptor->createPipelineLayout();
+	std::vector<Descriptor::UBODescriptor> triangleSetupUboDescriptors = {
+		Descriptor::UBODescriptor(matrixBuffer->getBuffers(), sizeof(MatrixBufferObject)),
+		Descriptor::UBODescriptor(vertexBuffer->getIndexBuffers(), vertexBuffer->getIndexBufferSize()),
+		Descriptor::UBODescriptor(vertexBuffer->getVertexBuffers(), vertexBuffer->getVertexBufferSize()),
+		Descriptor::UBODescriptor(triangleSetupBuffer->getBuffers(), (int)sizeof(TriangleSetup) * vertexBuffer->getTriangleCount() * getViewCount())
+	};
+	std::vector<Descriptor::ImageInfoDescriptor> triangleSetupImgDescriptors = {};
+	triangleSetupDescriptor->createDescriptorSets(vulkanApp->getSwapchain()->getSize(), *descriptorPool, triangleSetupUboDescriptors, triangleSetupImgDescriptors);
+	triangleSetupPipeline = new ComputePipeline("triangle_setup_v", triangleSetupDescriptor->getPipelineLayout(), devices());
+
+	// Create the point lights and their binning pass
+	clusteredLights = new ClusteredLights(devices, *descriptorPool, vulkanApp->getSwapchain()->getSize());
+
 	// Create framebuffer attachments / note: attachment images will be prepended with present image
-	std::vector<VkImageView> attachmentImages = { visibilityAttachment->getImageView(), vulkanApp->getDepthBuffer()->getImageView() };
+	std::vector<VkImageView> attachmentImages = { vulkanApp->getDepthBuffer()->getImageView() };
+	if (!multiview) attachmentImages.insert(attachmentImages.begin(), visibilityAttachment->getImageView());
 	vulkanApp->getSwapchain()->createFramebuffers(attachmentImages, renderPass->getRenderPass());
 
 	// Create subpass descriptor sets
 	std::vector<Descriptor::UBODescriptor> uboDescriptors1 = { Descriptor::UBODescriptor(matrixBuffer->getBuffers(), sizeof(MatrixBufferObject)) };
 	std::vector<Descriptor::ImageInfoDescriptor> imgDescriptors1 = { };
 	firstSubpassDescriptor->createDescriptorSets(vulkanApp->getSwapchain()->getSize(), *descriptorPool, uboDescriptors1, imgDescriptors1);
-	std::vector<Descriptor::UBODescriptor> uboDescriptors2 = { Descriptor::UBODescriptor(lightBuffer->getBuffers(), (int)sizeof(LightBufferObject)), Descriptor::UBODescriptor(matrixBuffer->getBuffers(), sizeof(MatrixBufferObject)), Descriptor::UBODescriptor(vertexBuffer->getBuffers(), sizeof(VBufferVertexBufferObject)) };
-#ifdef SEND_DEBUG_BUFFER_V
-	uboDescriptors2.push_back(Descriptor::UBODescriptor(debugBuffer->getBuffers(), (int)sizeof(DebugBufferObject)));
-#endif
-	std::vector<Descriptor::ImageInfoDescriptor> imgDescriptors2 = { DESCRIPTOR_IMG_ATTACHMENT_INFO(visibilityAttachment), Descriptor::ImageInfoDescriptor(shrimpTex, vulkanApp->getSampler()), Descriptor::ImageInfoDescriptor(raccoonTex, vulkanApp->getSampler()), Descriptor::ImageInfoDescriptor(leafTex, vulkanApp->getSampler()) };
+	std::vector<Descriptor::UBODescriptor> uboDescriptors2 = {};
+	std::vector<Descriptor::ImageInfoDescriptor> imgDescriptors2 = {};
+	if (tiledShading) {
+		createTiledShading();
+		imgDescriptors2.push_back(Descriptor::ImageInfoDescriptor(tiledFields->shadedImage, vulkanApp->getSampler(), VK_IMAGE_LAYOUT_GENERAL));// read with texelFetch (unfiltered)
+	} else {
+		imgDescriptors2.push_back(DESCRIPTOR_IMG_ATTACHMENT_INFO(multiview ? multiview->getBuffer(0) : visibilityAttachment));// in stereo, each view reads its own layer
+		appendLightingDescriptors(uboDescriptors2, imgDescriptors2);
+	}
 	secondSubpassDescriptor->createDescriptorSets(vulkanApp->getSwapchain()->getSize(), *descriptorPool, uboDescriptors2, imgDescriptors2);
 
-	/// Setup particles
-	ParticleSystem::ParticlesConstructorParams args(ParticleRenderingMode::DeferredVRen, devices, descriptorPool, vulkanApp->getSwapchain()->getSize(),
-		vulkanApp->getSwapchain()->getExtent(), renderPass, *commandPool, vulkanApp->getSampler());
-	particles = new ParticleSystem(args);
+}
+
+void VBufferScene::createTiledShading() {
+
+	tiledFields = new TiledShadingFields;
+
+	VkExtent2D extent = vulkanApp->getSwapchain()->getExtent();
+	int swapchainSize = vulkanApp->getSwapchain()->getSize();
+	tiledFields->tilesX = (extent.width + VBUFFER_TILE_SIZE - 1) / VBUFFER_TILE_SIZE;
+	tiledFields->tilesY = (extent.height + VBUFFER_TILE_SIZE - 1) / VBUFFER_TILE_SIZE;
+	uint32_t maxTiles = tiledFields->tilesX * tiledFields->tilesY;
+
+	/// Buffers & shaded image; only one copy of each, as the frames using them are recorded in the same queue and ordered by barriers (see cmdBindTiledShading)
+	tiledFields->dispatchBuffer = new UniformBuffer<glm::uvec4>(1, devices(), devices->getPhysicalDevice(),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VBUFFER_TILE_MATERIALS);
+	tiledFields->tileListBuffer = new UniformBuffer<uint32_t>(1, devices(), devices->getPhysicalDevice(),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VBUFFER_TILE_MATERIALS * maxTiles);
+	tiledFields->dispatchBuffers.resize(swapchainSize, tiledFields->dispatchBuffer->getBuffers()[0]);
+	tiledFields->tileListBuffers.resize(swapchainSize, tiledFields->tileListBuffer->getBuffers()[0]);
+	tiledFields->shadedImage = new Texture(VK_FORMAT_R16G16B16A16_SFLOAT, extent, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_GENERAL, devices(), devices->getPhysicalDevice(), *commandPool, devices->getGraphicsQueue());
+	tiledFields->statsBuffer = new UniformBuffer<TileCacheStats>(swapchainSize, devices(), devices->getPhysicalDevice(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+	tiledFields->statsBuffer->copyAllBuffers({});// read back before the first frame of each image completes
+
+	/// Descriptor (same bindings as Shaders/tile_v.glsl & tile_shade_v.glsl): V-Buffer, lighting resources, dispatch arguments, tile lists, shaded image, cache statistics
+	DESCRIPTOR_BINDING_ARRAY tileBindings = { DESCRIPTOR_BINDING_SAMPLER_COMPUTE };
+	appendLightingBindings(tileBindings, VK_SHADER_STAGE_COMPUTE_BIT);
+	tileBindings.push_back(DESCRIPTOR_BINDING_STORAGE_BUFFER_COMPUTE);
+	tileBindings.push_back(DESCRIPTOR_BINDING_STORAGE_BUFFER_COMPUTE);
+	tileBindings.push_back(DESCRIPTOR_BINDING_STORAGE_IMAGE_COMPUTE);
+	tileBindings.push_back(DESCRIPTOR_BINDING_STORAGE_BUFFER_COMPUTE);
+	tiledFields->descriptor = new Descriptor(tileBindings, devices(), VK_PIPELINE_BIND_POINT_COMPUTE);
+	tiledFields->descriptor->createPipelineLayout(sizeof(glm::ivec2), VK_SHADER_STAGE_COMPUTE_BIT);// size of the rendered part of the V-Buffer (see RenderPass::renderScale)
+
+	std::vector<Descriptor::UBODescriptor> uboDescriptors = {};
+	std::vector<Descriptor::ImageInfoDescriptor> imgDescriptors = { Descriptor::ImageInfoDescriptor(visibilityAttachment, vulkanApp->getSampler()) };// read with texelFetch (unfiltered)
+	appendLightingDescriptors(uboDescriptors, imgDescriptors);
+	uboDescriptors.push_back(Descriptor::UBODescriptor(tiledFields->dispatchBuffers, (int)sizeof(glm::uvec4) * VBUFFER_TILE_MATERIALS));
+	uboDescriptors.push_back(Descriptor::UBODescriptor(tiledFields->tileListBuffers, (int)sizeof(uint32_t) * VBUFFER_TILE_MATERIALS * maxTiles));
+	uboDescriptors.push_back(Descriptor::UBODescriptor(tiledFields->statsBuffer->getBuffers(), (int)sizeof(TileCacheStats)));
+	imgDescriptors.push_back(Descriptor::ImageInfoDescriptor(tiledFields->shadedImage, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL));
+	tiledFields->descriptor->createDescriptorSets(swapchainSize, *descriptorPool, uboDescriptors, imgDescriptors);
+
+	/// Pipelines; material kernels are indexed by material ID - 1
+	tiledFields->classifyPipeline = new ComputePipeline("vbuffer_classify", tiledFields->descriptor->getPipelineLayout(), devices());
+	static const char* materialKernels[VBUFFER_TILE_MATERIALS] = { "tile_shrimp_v", "tile_raymarch_v", "tile_raccoon_v", "tile_particles_v" };
+	for (int m = 0; m < VBUFFER_TILE_MATERIALS; ++m)
+		tiledFields->materialPipelines[m] = new ComputePipeline(materialKernels[m], tiledFields->descriptor->getPipelineLayout(), devices());
 
 }
 
 VBufferScene::~VBufferScene() {
 
 	DELETE(particles);
+	DELETE(upsampler);
+	DELETE(oit);
+	DELETE(hiZ);
+	DELETE(multiview);
+
+	if (tiledFields) {
+		DELETE(tiledFields->classifyPipeline);
+		for (ComputePipeline*& pipeline : tiledFields->materialPipelines) { DELETE(pipeline); }
+		DELETE(tiledFields->descriptor);
+		DELETE(tiledFields->dispatchBuffer);
+		DELETE(tiledFields->tileListBuffer);
+		DELETE(tiledFields->shadedImage);
+		DELETE(tiledFields->statsBuffer);
+		DELETE(tiledFields);
+	}
 
 	/// Objects dependant on swapchain
 	DELETE(visibilityAttachment);
 
+	DELETE(triangleSetupPipeline);
+	DELETE(triangleSetupDescriptor);
+	DELETE(triangleSetupBuffer);
+	DELETE(clusteredLights);
+
 	DELETE(lightBuffer);
 	DELETE(matrixBuffer);
 	DELETE(vertexBuffer);
@@ -120,6 +418,8 @@ VBufferScene::~VBufferScene() {
 	DELETE(visibilityPipeline);
 	DELETE(ppPipeline);
 	DELETE(renderPass);
+	DELETE(continuationRenderPass);
+	DELETE(compositeRenderPass);
 
 	/// Objects independant from swapchain
 	delete vQuad;
@@ -138,24 +438,36 @@ VBufferScene::~VBufferScene() {
 
 void VBufferScene::Update(uint32_t imageIndex, float dt, float time) {
 
-	/// Setup matrices
+	/// Setup matrices (in stereo, each eye covers half of the screen, and sees from its own view)
 	const glm::mat4& view = vulkanApp->getCamera().getViewMatrix();
-	glm::mat4 projection = glm::perspective(glm::radians(45.0f), vulkanApp->getSwapchain()->getExtent().width / (float)vulkanApp->getSwapchain()->getExtent().height, NEAR, FAR);
+	VkExtent2D extent = multiview ? multiview->getEyeExtent() : vulkanApp->getSwapchain()->getExtent();
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), extent.width / (float)extent.height, NEAR, FAR);
 	projection[1][1] *= -1;//fix ogl upside-down y coordinate scaling
+	glm::mat4 eyeViews[MULTIVIEW_VIEWS];
+	if (multiview) Multiview::eyeViews(view, eyeViews);
 
 	/// Update uniform buffers
 	if (!particlesOnly)
-		matrixBuffer->updateBuffer(imageIndex, time, glm::mat4(1), view, projection);
+		matrixBuffer->updateBuffer(imageIndex, time, glm::mat4(1), view, projection, glm::vec2(0.f), multiview ? eyeViews : NULL);
 
 	lightBuffer->updateBuffer(imageIndex, dt, time);
 
 	/// Update particles
-	particles->Update(imageIndex, dt, time, view, projection);
+	particles->Update(imageIndex, dt, time, view, projection, glm::vec2(0.f), multiview ? eyeViews : NULL);
+	if (upsampler)
+		upsampler->Update(imageIndex, time, view, projection, particles);
+
+	/// Update point lights (binned once from the camera: clusters are looked up by world position, which serves both eyes)
+	clusteredLights->Update(imageIndex, time, view, projection);
 
 #ifdef SEND_DEBUG_BUFFER_V
 	debugBuffer->updateBuffer(imageIndex, { (float)debugView });//send debug data to shaders
 #endif
 
+	/// Read back the triangle cache statistics of the last frame rendered to this image (which has completed)
+	if (tiledFields)
+		tiledFields->statsBuffer->readBuffer(imageIndex, tiledFields->stats);
+
 }
 
 bool VBufferScene::UI() {
@@ -178,17 +490,82 @@ bool VBufferScene::UI() {
 		ImGui::EndCombo();
 	}// Debug views drop down
 
+	/// Drop-down list for the visibility buffer format
+	static const char* visibilityFormats[] = { "F16 x4", "F32 x4", "U32 x2", "U32" };
+	if (ImGui::BeginCombo("Format##vbufferFormats", visibilityFormats[visibilityFormat])) {
+		bool rebuild = false;
+		for (int i = 0; i < IM_ARRAYSIZE(visibilityFormats); ++i) {
+			bool isSelected = visibilityFormat == i;
+			if (ImGui::Selectable(visibilityFormats[i], isSelected)) {
+				/// Potentially switch format (re-compiles V-Buffer shaders)
+				rebuild = setVisibilityFormat((VisibilityFormat)i);
+			}
+			if (isSelected) {
+				ImGui::SetItemDefaultFocus();
+			}
+		}
+		ImGui::EndCombo();
+		if (rebuild) return true;
+	}// Visibility formats drop down
+
+	/// Particle encoding (integer formats only)
+	if (visibilityFormat == VisibilityFormat::VisU32x2 || visibilityFormat == VisibilityFormat::VisU32) {
+		bool ids = particleIds;
+		ImGui::Checkbox("Particle IDs", &ids);
+		if (ids != particleIds && setParticleIds(ids)) return true;
+	}
+
+	/// Lighting pass: full-screen subpass, or tiles shaded by per-material compute kernels
+	bool tiled = tiledShading;
+	ImGui::Checkbox("Tiled Shading", &tiled);
+	if (setTiledShading(tiled)) return true;
+
+	/// Triangle cache of the tiled shading kernels, and the vertex transforms it saves
+	if (tiledShading) {
+		bool cache = triangleCache;
+		ImGui::Checkbox("Triangle Cache", &cache);
+		if (cache != triangleCache && setTriangleCache(cache)) return true;
+		if (triangleCache && tiledFields) {
+			uint32_t uncached = tiledFields->stats.pixels * 3;// transforms without the cache
+			uint32_t saved = uncached > tiledFields->stats.transforms ? uncached - tiledFields->stats.transforms : 0;
+			ImGui::Text("Vertex transforms: %u (saved %u, %.1f%%)", tiledFields->stats.transforms, saved, uncached > 0 ? 100.0f * saved / uncached : 0.0f);
+		}
+	}
+
 	ImGui::Checkbox("Particles Only", &particlesOnly);
 
+	ClusteredLights::UI();
+
+	if (ParticleUpsampler::UI(upsampler)) return true;
+	if (ParticleOIT::UI()) return true;
+	if (Multiview::UI()) return true;
+	if (Multiview::stereo() && tiledShading)
+		ImGui::Text("(mono: tiled shading shades a single view)");
+	else if (multiview && ParticleSystem::usesOcclusionCulling())
+		ImGui::Text("(particles are not culled in stereo)");
+
 	bool rebuild;
+	ParticleSystem* previousParticles = particles;
 	particles = ParticleSystem::UI(particles, rebuild);
 	if (rebuild) return true;
+	if (particles != previousParticles && (usesParticleIds() || particles->getSpriteCache())) return true;// the lighting pass descriptors reference the buffers (or sprite cache) of the previous particle system
 
 	return false;
 }
 
 RenderPass* VBufferScene::cmdBind(const VkCommandBuffer& cmdBuffer, int index) {
-	renderPass->begin(cmdBuffer, vulkanApp->getSwapchain()->getFramebuffer(index)); {
+
+	// Triangle setup of the frame (dispatches cannot happen within a render pass); no triangles are shaded when only particles are drawn
+	if (!particlesOnly)
+		cmdBindTriangleSetup(cmdBuffer, index);
+
+	// bin the point lights before they are read by the lighting pass
+	clusteredLights->cmdBindCompute(cmdBuffer, index);
+
+	const VkFramebuffer& framebuffer = multiview ? multiview->getFramebuffer() : vulkanApp->getSwapchain()->getFramebuffer(index);
+	if (multiview) multiview->begin(cmdBuffer);// every draw below is rendered to both eyes, and each eye is shaded from its own layer
+	else renderPass->begin(cmdBuffer, framebuffer);
+	{
 
 		//Geometry subpass:
 		{	//vkCmdFirstSubpass
@@ -207,25 +584,129 @@ RenderPass* VBufferScene::cmdBind(const VkCommandBuffer& cmdBuffer, int index) {
 				vRaymarchCube->getVMesh().cmdBind(cmdBuffer, index);
 			}
 
-			// Particles are done separately with their own shader sets
-			particles->cmdBind(cmdBuffer, index);
+			// Particles are done separately with their own shader sets (at reduced resolution or transparent: drawn once the scene is lit)
+			if (!upsampler && !oit)
+				particles->cmdBind(cmdBuffer, index, framebuffer);
 
 		}
 
 		// Post-processing subpass:
 		{	vkCmdNextSubpass(cmdBuffer, VK_SUBPASS_CONTENTS_INLINE);
 
+		if (tiledShading) {// dispatches cannot happen within a render pass: end this instance, shade the tiles, and composite them in the continuation instance
+			renderPass->end(cmdBuffer);
+			cmdBindTiledShading(cmdBuffer, index);
+			continuationRenderPass->begin(cmdBuffer, vulkanApp->getSwapchain()->getFramebuffer(index));
+			vkCmdNextSubpass(cmdBuffer, VK_SUBPASS_CONTENTS_INLINE);
+		}
+
 		secondSubpassDescriptor->cmdBind(cmdBuffer, index);
 
-		/// Lighting, full screen pass.
+		/// Lighting (or composite of tiled shading), full screen pass.
 		ppPipeline->cmdBind(cmdBuffer, index);
 		vkCmdDraw(cmdBuffer, 3, 1, 0, 0);// full-screen quad
 		}
 
 	}
+
+	// stereo: both eyes composited side by side in the render pass
+	if (multiview) {
+		multiview->end(cmdBuffer);
+		renderPass->begin(cmdBuffer, vulkanApp->getSwapchain()->getFramebuffer(index));
+		multiview->cmdBindComposite(cmdBuffer, index);
+		return renderPass;
+	}
+
+	// reduced resolution particles: drawn in the layer of the upsampler, then composited over the lit scene in the second subpass of a further instance
+	if (upsampler) {
+		renderPass->end(cmdBuffer);
+		upsampler->cmdBindParticles(cmdBuffer, index, particles);
+		compositeRenderPass->begin(cmdBuffer, vulkanApp->getSwapchain()->getFramebuffer(index));
+		vkCmdNextSubpass(cmdBuffer, VK_SUBPASS_CONTENTS_INLINE);
+		upsampler->cmdBindComposite(cmdBuffer, index);
+		return compositeRenderPass;
+	}
+	// transparent particles: blended in the layer of the OIT, then composited over the lit scene in the second subpass of a further instance
+	if (oit) {
+		renderPass->end(cmdBuffer);
+		oit->cmdBindParticles(cmdBuffer, index, particles);
+		compositeRenderPass->begin(cmdBuffer, vulkanApp->getSwapchain()->getFramebuffer(index));
+		vkCmdNextSubpass(cmdBuffer, VK_SUBPASS_CONTENTS_INLINE);
+		oit->cmdBindComposite(cmdBuffer, index);
+		return compositeRenderPass;
+	}
 	return renderPass;
 }
 
-void VBufferScene::cmdBindCompute(const VkCommandBuffer& cmdBuffer) {
-	particles->cmdBindCompute(cmdBuffer);
+void VBufferScene::cmdBindTriangleSetup(const VkCommandBuffer& cmdBuffer, int index) {
+
+	/// One invocation per triangle of the scene, for each view
+	triangleSetupDescriptor->cmdBind(cmdBuffer, index);
+	triangleSetupPipeline->cmdBind(cmdBuffer, index);
+	vkCmdDispatch(cmdBuffer, (vertexBuffer->getTriangleCount() + VBUFFER_TRIANGLE_SETUP_GROUP - 1) / VBUFFER_TRIANGLE_SETUP_GROUP, getViewCount(), 1);
+
+	/// Make the edge functions visible to the lighting pass (full-screen subpass or tiled shading kernels)
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, NULL, 0, NULL);
+
+}
+
+void VBufferScene::cmdBindTiledShading(const VkCommandBuffer& cmdBuffer, int index) {
+
+	/// Reset the dispatch arguments and the shaded image once the previous frame is done with them
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, NULL, 0, NULL);
+
+	glm::uvec4 dispatches[VBUFFER_TILE_MATERIALS];
+	for (glm::uvec4& dispatch : dispatches) dispatch = glm::uvec4(0, 1, 1, 0);// x: tiles of the material, counted by the classification pass
+	vkCmdUpdateBuffer(cmdBuffer, tiledFields->dispatchBuffers[index], 0, sizeof(dispatches), dispatches);
+
+	VkClearColorValue clearColour = { VBUFFER_CLEAR_COLOUR };// empty tiles are never shaded
+	VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	vkCmdClearColorImage(cmdBuffer, tiledFields->shadedImage->getImage(), VK_IMAGE_LAYOUT_GENERAL, &clearColour, 1, &range);
+	vkCmdFillBuffer(cmdBuffer, tiledFields->statsBuffer->getBuffers()[index], 0, sizeof(TileCacheStats), 0);
+
+	/// Make the V-Buffer and the resets visible to the classification pass (bottom of pipe chains with the transition of the V-Buffer at the end of the render pass)
+	barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, NULL, 0, NULL);
+
+	/// Classification: one workgroup per tile of the rendered part of the V-Buffer (all of it, unless under dynamic resolution)
+	VkExtent2D renderArea = RenderPass::getRenderArea(vulkanApp->getSwapchain()->getExtent());
+	glm::ivec2 renderSize = glm::ivec2(renderArea.width, renderArea.height);
+	tiledFields->descriptor->cmdBind(cmdBuffer, index);
+	tiledFields->descriptor->cmdPushConstants(cmdBuffer, &renderSize);
+	tiledFields->classifyPipeline->cmdBind(cmdBuffer, index);
+	vkCmdDispatch(cmdBuffer, (renderArea.width + VBUFFER_TILE_SIZE - 1) / VBUFFER_TILE_SIZE, (renderArea.height + VBUFFER_TILE_SIZE - 1) / VBUFFER_TILE_SIZE, 1);
+
+	/// Make the tile lists and dispatch arguments visible to the material kernels
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, NULL, 0, NULL);
+
+	/// Material kernels, each over the tiles of its own material only (kernels never write the same pixel, so no barriers are needed in between)
+	for (int m = 0; m < VBUFFER_TILE_MATERIALS; ++m) {
+		tiledFields->materialPipelines[m]->cmdBind(cmdBuffer, index);
+		vkCmdDispatchIndirect(cmdBuffer, tiledFields->dispatchBuffers[index], sizeof(glm::uvec4) * m);
+	}
+
+	/// Make the shaded image visible to the composite pass, and the cache statistics to the host
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, NULL, 0, NULL);
+
+}
+
+void VBufferScene::cmdBindCompute(const VkCommandBuffer& cmdBuffer, int index) {
+	particles->cmdBindCompute(cmdBuffer, index);
+}
+
+bool VBufferScene::computeRequired(uint32_t imageIndex) {
+	return particles->computeRequired(imageIndex);
 }
@@ -3,6 +3,11 @@
 #include "Scene.h"
 #include "VBufferVertexBuffer.h"
 #include "Particles.h"
+#include "ClusteredLights.h"
+#include "ParticleUpsampler.h"
+#include "ParticleOIT.h"
+#include "Multiview.h"
+#include "HiZPyramid.h"
 
 
 #define SEND_DEBUG_BUFFER_V // comment out to prevent sending debug data to lighting shader. Shader must reflect this.
@@ -14,6 +19,29 @@
 #endif
 
 
+/// Encoding of the visibility buffer (mirrors value in __.defines file, VBUFFER_FORMAT_*; see Shaders/visibility.glsl)
+enum VisibilityFormat {
+	VisF16x4 = 0,	// R16G16B16A16_SFLOAT: uv, triangle ID, material ID (IDs exact up to 2048)
+	VisF32x4 = 1,	// R32G32B32A32_SFLOAT: uv, triangle ID, material ID (IDs exact up to 2^24)
+	VisU32x2 = 2,	// R32G32_UINT: triangle ID, material ID; barycentrics are reconstructed in the lighting pass
+	VisU32 = 3		// R32_UINT: 3 bits of material ID, 29 bits of triangle ID; barycentrics are reconstructed in the lighting pass
+};// enum VisibilityFormat
+
+
+/// Edge functions of one triangle, written each frame by the triangle setup pass (same layout as Shaders/triangle_setup.glsl)
+struct TriangleSetup {
+	glm::vec4 dx;// partial derivatives of the edge functions along ndc x (one per vertex)
+	glm::vec4 dy;// partial derivatives of the edge functions along ndc y
+	glm::vec4 c;// edge functions at the ndc origin
+};// struct TriangleSetup
+
+/// Vertex statistics of the tiled shading kernels over a frame, when caching triangles (same layout as Shaders/tile_shade_v.glsl)
+struct TileCacheStats {
+	uint32_t pixels;// mesh pixels shaded: each would load and transform 3 vertices without the cache
+	uint32_t transforms;// vertices actually loaded and transformed
+};// struct TileCacheStats
+
+
 /// A simple scene to demonstrate the Visibility Buffer
 class VBufferScene : public Scene {
 
@@ -23,10 +51,40 @@ class VBufferScene : public Scene {
 #define RACCOON_MAT 3
 #define PARTICLES_MAT 4
 
-	/// a single render pass
+	// triangle IDs are passed to the first pass as 32-bit float vertex attributes, exact up to 2^24
+#define VBUFFER_MAX_TRIANGLES (1 << 24)
+
+	// triangle setup pass: triangles per workgroup (must match Shaders/triangle_setup_v.comp)
+#define VBUFFER_TRIANGLE_SETUP_GROUP 64
+
+	// tiled shading: tile width & height in pixels, and amount of materials with a tile list (must match Shaders/tile_v.glsl)
+#define VBUFFER_TILE_SIZE 16
+#define VBUFFER_TILE_MATERIALS 4
+	// colour of pixels where nothing was rendered (must match CLEAR_COLOUR in Shaders/lighting_v.glsl)
+#define VBUFFER_CLEAR_COLOUR { 0.4f, 0.4f, 0.3f, 1.0f }
+
+	/// Encoding of the visibility buffer, shared by all instances
+	static VisibilityFormat visibilityFormat;
+	/// Whether particles write their index instead of their uv to integer visibility formats (mirrors value in __.defines file, VBUFFER_PARTICLE_IDS_*)
+	static bool particleIds;
+	/// Whether the lighting pass is shaded in tiles by compute kernels specialized per material (see Shaders/tile_v.glsl), instead of a single full-screen subpass
+	static bool tiledShading;
+	/// Whether the tiled shading kernels transform each triangle of a tile once into shared memory (mirrors value in __.defines file, VBUFFER_TRIANGLE_CACHE_*)
+	static bool triangleCache;
+
+	/// Whether the lighting pass re-generates particles from their index (particle IDs requested, and an integer format used)
+	static inline bool usesParticleIds() { return particleIds && (visibilityFormat == VisibilityFormat::VisU32x2 || visibilityFormat == VisibilityFormat::VisU32); }
+
+	/// Attachment format and amount of triangles that can be identified for each visibility format
+	static VkFormat getVisibilityVkFormat(VisibilityFormat format);
+	static uint32_t getVisibilityMaxTriangles(VisibilityFormat format);
+
+	/// a single render pass (in stereo, a single subpass compositing the eyes of the stereo pass)
 	RenderPass* renderPass;
+	RenderPass* continuationRenderPass = NULL;// chained continuation of the render pass, only created when streaming or culling particles, or with tiled shading
+	RenderPass* compositeRenderPass = NULL;// continuation compositing reduced resolution or transparent particles over the read-only scene depth, only created with the upsampler or OIT
 
-	/// first subpass for visibility, second for lighting/shading/texturing work
+	/// first subpass for visibility, second for lighting/shading/texturing work (with tiled shading: composite of the shaded image)
 	Descriptor* firstSubpassDescriptor;
 	Descriptor* secondSubpassDescriptor;
 
@@ -46,19 +104,55 @@ class VBufferScene : public Scene {
 	Texture* raccoonTex;
 	Texture* leafTex;
 
-	/// Lighting pass pipeline
+	/// Lighting pass pipeline (with tiled shading: composite pipeline)
 	GraphicsPipeline* ppPipeline;
 
-	/// Visibility buffer
-	Texture* visibilityAttachment;
+	/// Visibility buffer; NULL in stereo, where each eye has its own layer of the buffer of the stereo pass
+	Texture* visibilityAttachment = NULL;
 
-	/// Uniform buffers for light, matrices, vertices (for lighting pass)
+	/// Uniform buffers for light, matrices; storage buffers for indices & vertices (for lighting pass)
 	LightBuffer* lightBuffer;
 	MatrixBuffer* matrixBuffer;
 	VBufferVertexBuffer* vertexBuffer;
 
+	/// Triangle setup pass, run before the render pass: edge functions of every triangle (see Shaders/triangle_setup_v.comp), from which the lighting pass
+	/// interpolates pixels without transforming vertices. One buffer per swapchain image, as the matrices they are computed from; in stereo, the triangles
+	/// are set up for each view (getViewCount()).
+	Descriptor* triangleSetupDescriptor;
+	ComputePipeline* triangleSetupPipeline;
+	UniformBuffer<TriangleSetup>* triangleSetupBuffer;
+
+	/// Point lights binned in clusters each frame, added by the lighting pass
+	ClusteredLights* clusteredLights;
+
 	/// Particles
 	ParticleSystem* particles;
+	std::vector<VkBuffer> particleStatics;// baked particle statics read by the lighting pass (with particle IDs), kept alive for the descriptor sets
+	ParticleUpsampler* upsampler = NULL;// draws the particles forward at reduced resolution after the lighting pass; NULL when they are written to the V-Buffer
+	ParticleOIT* oit = NULL;// draws the particles forward with weighted blended transparency after the lighting pass; NULL when they are written to the V-Buffer
+	HiZPyramid* hiZ = NULL;// depth pyramid of the meshes, only created when culling particles written to the V-Buffer (in mono)
+
+	/// Stereo pass in which the V-Buffer of both eyes is written and shaded at once (one layer per eye), then composited side by side in the render pass;
+	/// NULL in mono. Tiled shading shades a single view: the scene then renders in mono.
+	Multiview* multiview = NULL;
+	/// Amount of views rendered (and of triangle setups per frame)
+	inline uint32_t getViewCount() const { return multiview ? MULTIVIEW_VIEWS : 1; }
+
+	// Fields used for tiled shading only
+	struct TiledShadingFields {
+		Descriptor* descriptor;// shared by the classification pass and the material kernels: V-Buffer sampler, lighting pass resources, tile lists, shaded image
+		ComputePipeline* classifyPipeline;// sorts the tiles into the list of each material they contain
+		ComputePipeline* materialPipelines[VBUFFER_TILE_MATERIALS];// one shading kernel per material, dispatched indirectly over the tiles in the material's list
+		UniformBuffer<glm::uvec4>* dispatchBuffer;// indirect dispatch arguments of each material kernel, counted by the classification pass
+		UniformBuffer<uint32_t>* tileListBuffer;// tile lists of all materials, tilesX * tilesY entries each
+		std::vector<VkBuffer> dispatchBuffers;// dispatchBuffer, once per swapchain image (for descriptor sets)
+		std::vector<VkBuffer> tileListBuffers;// tileListBuffer, once per swapchain image (for descriptor sets)
+		uint32_t tilesX, tilesY;// amount of tiles across the screen at the swapchain resolution (capacity of the tile lists)
+		Texture* shadedImage;// written by the material kernels, then drawn to the screen by the second subpass of the continuation render pass
+		UniformBuffer<TileCacheStats>* statsBuffer;// vertex statistics of the triangle cache, one per swapchain image as they are read back by the host
+		TileCacheStats stats = {};// last statistics read back
+	};// struct TiledShadingFields
+	TiledShadingFields* tiledFields = NULL;// will be NULL unless tiledShading is set.
 
 	/// Whether to hide everything other than particles
 	bool particlesOnly = true;
@@ -70,6 +164,19 @@ class VBufferScene : public Scene {
 #endif
 
 
+	/// Appends the bindings (accessed from the shader stage given) and the descriptors of the resources read by the V-Buffer shading (Shaders/lighting_v.glsl, from binding 1)
+	void appendLightingBindings(DESCRIPTOR_BINDING_ARRAY& bindings, VkShaderStageFlags stage);
+	void appendLightingDescriptors(std::vector<Descriptor::UBODescriptor>& uboDescriptors, std::vector<Descriptor::ImageInfoDescriptor>& imgDescriptors);
+
+	/// Records the triangle setup pass, and makes its output visible to the lighting pass
+	void cmdBindTriangleSetup(const VkCommandBuffer& cmdBuffer, int index);
+
+	/// Creates tiledFields: buffers, shaded image, descriptor and pipelines of tiled shading
+	void createTiledShading();
+
+	/// Records the tiled shading of the V-Buffer (classification, then material kernels) in between the visibility pass and the composite pass
+	void cmdBindTiledShading(const VkCommandBuffer& cmdBuffer, int index);
+
 public:
 
 	/// Returns (only) render pass
@@ -87,11 +194,32 @@ public:
 	/// Scene settings
 	bool UI() override;
 
+	/// Resets the encoding of the visibility buffer; this is static and will cause a re-compile of the V-Buffer shaders automatically.
+	/// Returns true if the swapchain should be rebuilt
+	static bool setVisibilityFormat(VisibilityFormat format, bool noRecompile = false);
+
+	/// Resets whether particles are encoded by index in integer visibility formats (false -> quantized uv); will re-compile the V-Buffer particle shaders
+	static bool setParticleIds(bool ids, bool noRecompile = false);
+
+	/// Resets whether the lighting pass uses tiled shading (false -> full-screen subpass); returns true if the swapchain should be rebuilt
+	static bool setTiledShading(bool tiled);
+	/// Whether the lighting pass uses tiled shading (which renders in mono)
+	static inline bool usesTiledShading() { return tiledShading; }
+
+	/// Resets whether the tiled shading kernels cache the triangles of each tile (false -> vertices loaded per pixel); will re-compile the tile kernels
+	static bool setTriangleCache(bool cache, bool noRecompile = false);
+
+	/// Re-compiles the shaders of the lighting pass (full-screen and tiled); to be called when a define they depend on changes
+	static void compileLightingShaders();
+
 	/// Used to update a command buffer with the scene data
 	RenderPass* cmdBind(const VkCommandBuffer& cmdBuffer, int index) override;
 
 	/// Used to update the compute command buffer with current scene data
-	void cmdBindCompute(const VkCommandBuffer& cmdBuffer) override;
+	void cmdBindCompute(const VkCommandBuffer& cmdBuffer, int index) override;
+
+	/// Whether the compute command buffer for this image index must be submitted this frame
+	bool computeRequired(uint32_t imageIndex) override;
 
 };// class VBufferScene
 
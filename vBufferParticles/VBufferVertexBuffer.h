@@ -1,11 +1,6 @@
 #pragma once
 
-#include "UniformBuffer.h"
-
-// the limits of the Vertex uniform buffer available to the lighting pass; should correspond to the #defines in pp_lighting_v fragment shader.
-#define VBUFFER_MAX_TRIANGLES 64
-#define VBUFFER_MAX_INDICES VBUFFER_MAX_TRIANGLES*3
-#define VBUFFER_MAX_VERTICES VBUFFER_MAX_INDICES
+#include "Utils.h"
 
 /// Represents one vertex that can be sent to the gpu, packed into 128 bits.
 struct VBufferVertexInput {
@@ -20,28 +15,113 @@ struct VBufferVertexInput {
 	}
 };// struct VBufferVertexInput
 
-/// The UBO for all indices and vertices in the scene
-struct VBufferVertexBufferObject {
-	uint32_t indices[VBUFFER_MAX_INDICES];//global (scene-wide) index buffer
-	VBufferVertexInput vertices[VBUFFER_MAX_VERTICES];//global (scene-wide) vertex buffer
-};// struct VBufferVertexBufferObject
+/// The storage buffers holding all indices (32 bits) and vertices in the scene, read by the lighting pass of the VBuffer pipeline.
+/// Both live in device-local memory; they are uploaded once through a staging buffer, and can then be updated one range at a time.
+/// As the scene geometry is static, the same buffers are bound for all swapchain images.
+struct VBufferVertexBuffer {
+
+	/// Create the global (scene-wide) index and vertex buffers, and upload their contents
+	inline VBufferVertexBuffer(const std::vector<uint32_t>& indices, const std::vector<VBufferVertexInput>& vertices, int swapchainSize, VkDevice* logicalDevice, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, VkQueue graphicsQueue)
+		: logicalDevice(logicalDevice), physicalDevice(physicalDevice), commandPool(commandPool), graphicsQueue(graphicsQueue), indexCount((uint32_t)indices.size()), vertexCount((uint32_t)vertices.size()) {
 
-/// The uniform buffer used for sending data for indices and vertices in the scene to the lighting pass of the VBuffer pipeline.
-struct VBufferVertexBuffer : public UniformBuffer<VBufferVertexBufferObject> {
+		assert(indices.size() > 0 && vertices.size() > 0);
 
-	VBufferVertexBufferObject ubo;
+		U::createBuffer(sizeof(uint32_t) * indices.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory, *logicalDevice, physicalDevice);
+		U::createBuffer(sizeof(VBufferVertexInput) * vertices.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory, *logicalDevice, physicalDevice);
+		indexBuffers.resize(swapchainSize, indexBuffer);
+		vertexBuffers.resize(swapchainSize, vertexBuffer);
 
-	/// copy data over for indices and vertices
-	inline VBufferVertexBuffer(std::vector<uint32_t>& indices, std::vector<VBufferVertexInput>& vertices, UNIFORM_BUFFER_CONSTRUCTOR) {
-		memcpy(ubo.indices, indices.data(), VBUFFER_MAX_INDICES*sizeof(uint32_t));
-		memcpy(ubo.vertices, vertices.data(), VBUFFER_MAX_VERTICES*sizeof(VBufferVertexInput));
+		updateIndices(0, indices);
+		updateVertices(0, vertices);
 	}
 
-	/// update and upload buffer to GPU
-	inline void updateBuffer(uint32_t currentImage) {
+	/// Cleanup vk resources (buffers + memory)
+	inline ~VBufferVertexBuffer() {
+		vkDestroyBuffer(*logicalDevice, indexBuffer, NULL);
+		vkFreeMemory(*logicalDevice, indexBufferMemory, NULL);
+		vkDestroyBuffer(*logicalDevice, vertexBuffer, NULL);
+		vkFreeMemory(*logicalDevice, vertexBufferMemory, NULL);
+	}
+
+	/// Re-upload a range of the index buffer, starting at index firstIndex (only the dirty range is copied)
+	inline void updateIndices(uint32_t firstIndex, const std::vector<uint32_t>& indices) {
+		assert(firstIndex + indices.size() <= indexCount);
+		uploadRange(indexBuffer, sizeof(uint32_t) * firstIndex, indices.data(), sizeof(uint32_t) * indices.size());
+	}
+
+	/// Re-upload a range of the vertex buffer, starting at vertex firstVertex (only the dirty range is copied)
+	inline void updateVertices(uint32_t firstVertex, const std::vector<VBufferVertexInput>& vertices) {
+		assert(firstVertex + vertices.size() <= vertexCount);
+		uploadRange(vertexBuffer, sizeof(VBufferVertexInput) * firstVertex, vertices.data(), sizeof(VBufferVertexInput) * vertices.size());
+	}
+
+	/// Access underlying vk res handles (the same buffer for each swapchain image)
+	inline std::vector<VkBuffer>& getIndexBuffers() { return indexBuffers; }
+	inline std::vector<VkBuffer>& getVertexBuffers() { return vertexBuffers; }
+	/// Sizes in bytes, for descriptors
+	inline int getIndexBufferSize() const { return (int)(sizeof(uint32_t) * indexCount); }
+	inline int getVertexBufferSize() const { return (int)(sizeof(VBufferVertexInput) * vertexCount); }
+	/// Amount of triangles in the scene (3 indices each)
+	inline uint32_t getTriangleCount() const { return indexCount / 3; }
+
+private:
 
-		copyBuffer(currentImage, ubo);
+	/// Copy data to a range of one of the device-local buffers through a staging buffer; waits for the copy to complete.
+	inline void uploadRange(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size) {
+		if (size == 0) return;
 
+		// Create & fill staging buffer
+		VkBuffer stagingBuffer;
+		VkDeviceMemory stagingBufferMemory;
+		U::createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, *logicalDevice, physicalDevice);
+		void* dat;
+		vkMapMemory(*logicalDevice, stagingBufferMemory, 0, size, 0, &dat); {
+			memcpy(dat, data, (size_t)size);
+		} vkUnmapMemory(*logicalDevice, stagingBufferMemory);
+
+		VkCommandBuffer cmdBuffer = U::beginSingleTimeCommands(commandPool, *logicalDevice, graphicsQueue); {
+
+			// frames submitted earlier may still be reading the buffer in the lighting pass
+			vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 0, NULL);
+
+			VkBufferCopy copyRegion = {};
+			copyRegion.srcOffset = 0;
+			copyRegion.dstOffset = dstOffset;
+			copyRegion.size = size;
+			vkCmdCopyBuffer(cmdBuffer, stagingBuffer, dst, 1, &copyRegion);
+
+			// make the new data visible to the lighting pass
+			VkBufferMemoryBarrier barrier = {};
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.buffer = dst;
+			barrier.offset = dstOffset;
+			barrier.size = size;
+			vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 1, &barrier, 0, NULL);
+
+		} U::endSingleTimeCommands(cmdBuffer, commandPool, *logicalDevice, graphicsQueue);
+
+		// Free staging buffer
+		vkDestroyBuffer(*logicalDevice, stagingBuffer, NULL);
+		vkFreeMemory(*logicalDevice, stagingBufferMemory, NULL);
 	}
 
+	VkDevice* logicalDevice;
+	VkPhysicalDevice physicalDevice;
+	VkCommandPool commandPool;
+	VkQueue graphicsQueue;
+
+	VkBuffer indexBuffer;
+	VkDeviceMemory indexBufferMemory;
+	VkBuffer vertexBuffer;
+	VkDeviceMemory vertexBufferMemory;
+	uint32_t indexCount;
+	uint32_t vertexCount;
+
+	std::vector<VkBuffer> indexBuffers;// indexBuffer, once per swapchain image (for descriptor sets)
+	std::vector<VkBuffer> vertexBuffers;// vertexBuffer, once per swapchain image (for descriptor sets)
+
 };// struct VBufferVertexBuffer
@@ -54,7 +54,7 @@ void VulkanAppBase::initialize() {
 	createDescriptorPool();
 
 	//Create depth buffer
-	depthBuffer = new Texture(VK_FORMAT_D32_SFLOAT, swapchain->getExtent(), VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, devices(), devices->getPhysicalDevice(), *getCommandPool(), devices->getGraphicsQueue());
+	depthBuffer = new Texture(VK_FORMAT_D32_SFLOAT, swapchain->getExtent(), VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, devices(), devices->getPhysicalDevice(), *getCommandPool(), devices->getGraphicsQueue());
 
 	// Create texture sampler
 	sampler = Texture::createSampler(*devices());
@@ -105,18 +105,6 @@ void VulkanAppBase::render() {
 
 	vkWaitForFences(*devices(), 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
 
-#ifdef SUBMIT_COMPUTE
-	/// Submit compute queue
-	VkSubmitInfo computeSubmitInfo = {};
-	computeSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	computeSubmitInfo.pNext = NULL;
-	computeSubmitInfo.commandBufferCount = 1;
-	computeSubmitInfo.pCommandBuffers = &computeCommandBuffer;
-	if (vkQueueSubmit(devices->getComputeQueue(), 1, &computeSubmitInfo, computeFence) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to submit compute command buffer!");
-	}
-#endif
-
 	/// Figure out which image we need to render to on this frame (resize swapchain if necessary)
 	uint32_t imageIndex;
 	result = vkAcquireNextImageKHR(*devices(), swapchain->getSwapchain(), UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
@@ -127,17 +115,42 @@ void VulkanAppBase::render() {
 		throw std::runtime_error("Failed to acquire next image");
 	}
 
+	/// Make sure a previous frame isn't still using this image (and the buffers tied to its index)
+	if (imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
+		vkWaitForFences(*devices(), 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+	}
+	imagesInFlight[imageIndex] = inFlightFences[currentFrame];
+
 	/// Frame updates based on current image index
 	update(imageIndex);
 
+	std::vector<VkSemaphore> waitSemaphores = { imageAvailableSemaphores[currentFrame] };
+	std::vector<VkPipelineStageFlags> waitStages = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+
+#ifdef SUBMIT_COMPUTE
+	/// Submit compute queue if needed; graphics will wait on its semaphore rather than the CPU waiting on a fence
+	if (computeRequired(imageIndex)) {
+		VkSubmitInfo computeSubmitInfo = {};
+		computeSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		computeSubmitInfo.pNext = NULL;
+		computeSubmitInfo.commandBufferCount = 1;
+		computeSubmitInfo.pCommandBuffers = &computeCommandBuffers[imageIndex];
+		computeSubmitInfo.signalSemaphoreCount = 1;
+		computeSubmitInfo.pSignalSemaphores = &computeFinishedSemaphores[currentFrame];
+		if (vkQueueSubmit(devices->getComputeQueue(), 1, &computeSubmitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to submit compute command buffer!");
+		}
+		waitSemaphores.push_back(computeFinishedSemaphores[currentFrame]);
+		waitStages.push_back(VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);// compute outputs are first read from the vertex shader
+	}
+#endif
+
 	/// Submit graphics queue
 	VkSubmitInfo submitInfo = {};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame] };
-	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = waitSemaphores;
-	submitInfo.pWaitDstStageMask = waitStages;
+	submitInfo.waitSemaphoreCount = (uint32_t)waitSemaphores.size();
+	submitInfo.pWaitSemaphores = waitSemaphores.data();
+	submitInfo.pWaitDstStageMask = waitStages.data();
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
 	VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
@@ -163,15 +176,6 @@ void VulkanAppBase::render() {
 		recreateSwapchain();//window has been resized
 	} else if (result != VK_SUCCESS) {
 		throw std::runtime_error("Failed to present queue");
-	} else {
-		// don't wait for compute fences if the swapchain has been recreated!
-
-#ifdef SUBMIT_COMPUTE
-		/// Any compute operation should be finalized here!
-		vkWaitForFences(*devices(), 1, &computeFence, VK_TRUE, UINT64_MAX);
-		vkResetFences(*devices(), 1, &computeFence);
-#endif
-
 	}
 
 	++currentFrame;
@@ -193,8 +197,8 @@ void VulkanAppBase::cleanupSwapchain() {
 
 	vkFreeCommandBuffers(*devices(), commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
 	commandBuffers.clear();
-	vkFreeCommandBuffers(*devices(), computeCommandPool, 1, &computeCommandBuffer);
-	computeCommandBuffer = VK_NULL_HANDLE;
+	vkFreeCommandBuffers(*devices(), computeCommandPool, static_cast<uint32_t>(computeCommandBuffers.size()), computeCommandBuffers.data());
+	computeCommandBuffers.clear();
 
 	DELETE(swapchain);
 
@@ -223,7 +227,7 @@ void VulkanAppBase::recreateSwapchain() {
 	createDescriptorPool();
 
 	//Create depth buffer
-	depthBuffer = new Texture(VK_FORMAT_D32_SFLOAT, swapchain->getExtent(), VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, devices(), devices->getPhysicalDevice(), *getCommandPool(), devices->getGraphicsQueue());
+	depthBuffer = new Texture(VK_FORMAT_D32_SFLOAT, swapchain->getExtent(), VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, devices(), devices->getPhysicalDevice(), *getCommandPool(), devices->getGraphicsQueue());
 
 	// Re-create application-specific resources once swapchain has been re-initialized
 	onSwapchainResize();
@@ -259,9 +263,10 @@ void VulkanAppBase::createDescriptorPool() {
 	/// allow up 1000 of each descriptors used in application.
 	std::vector<VkDescriptorPoolSize> poolSizes = {
 		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 100 },
-		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 25 },
-		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 20 },
-		{ VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 20 }
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 100 },
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 100 },
+		{ VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 20 },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 20 }
 	};
 
 	VkDescriptorPoolCreateInfo poolInfo = {};
@@ -280,9 +285,10 @@ void VulkanAppBase::createDescriptorPool() {
 void VulkanAppBase::createCommandBuffers() {
 
 	assert(commandBuffers.size() == 0);// check that command buffers didn't exist prior to this function
-	assert(computeCommandBuffer == VK_NULL_HANDLE);
+	assert(computeCommandBuffers.size() == 0);
 
 	commandBuffers.resize(swapchain->getSize());
+	computeCommandBuffers.resize(swapchain->getSize());
 
 	/// Allocate command buffers.
 	VkCommandBufferAllocateInfo allocInfo = {};
@@ -294,11 +300,11 @@ void VulkanAppBase::createCommandBuffers() {
 		throw std::runtime_error("Failed to allocate command buffers");
 	}
 
-	/// Allocate compute command buffer
+	/// Allocate compute command buffers
 	allocInfo.commandPool = computeCommandPool;
-	allocInfo.commandBufferCount = 1;
-	if (vkAllocateCommandBuffers(*devices(), &allocInfo, &computeCommandBuffer) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to allocate compute command buffer!");
+	allocInfo.commandBufferCount = (uint32_t)computeCommandBuffers.size();
+	if (vkAllocateCommandBuffers(*devices(), &allocInfo, computeCommandBuffers.data()) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate compute command buffers!");
 	}
 
 	/// Record command buffers
@@ -311,7 +317,9 @@ void VulkanAppBase::createSyncObjects() {
 
 	imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
 	renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+	computeFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
 	inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+	imagesInFlight.assign(swapchain->getSize(), VK_NULL_HANDLE);
 
 	VkSemaphoreCreateInfo semaphoreInfo = {};
 	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -323,25 +331,21 @@ void VulkanAppBase::createSyncObjects() {
 	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
 		if (vkCreateSemaphore(*devices(), &semaphoreInfo, NULL, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
 			vkCreateSemaphore(*devices(), &semaphoreInfo, NULL, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
+			vkCreateSemaphore(*devices(), &semaphoreInfo, NULL, &computeFinishedSemaphores[i]) != VK_SUCCESS ||
 			vkCreateFence(*devices(), &fenceInfo, NULL, &inFlightFences[i]) != VK_SUCCESS) {
 
 			throw std::runtime_error("Failed to create sync objects");
 		}
 	}
 
-	fenceInfo.flags = 0;
-	if (vkCreateFence(*devices(), &fenceInfo, NULL, &computeFence) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to create sync objects");
-	}
-
 }
 
 /// Cleans up semaphores and fences
 void VulkanAppBase::cleanupSyncObjects() {
-	vkDestroyFence(*devices(), computeFence, NULL);
 	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
 		vkDestroySemaphore(*devices(), imageAvailableSemaphores[i], NULL);
 		vkDestroySemaphore(*devices(), renderFinishedSemaphores[i], NULL);
+		vkDestroySemaphore(*devices(), computeFinishedSemaphores[i], NULL);
 		vkDestroyFence(*devices(), inFlightFences[i], NULL);
 	}
 }
@@ -356,46 +360,55 @@ void VulkanAppBase::recordCommandBuffers(bool waitIdle) {
 
 	/// Record each command buffer individually, each with the same commands.
 	for (int i = 0; i < commandBuffers.size(); ++i) {
-		VkCommandBufferBeginInfo beginInfo = {};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = 0;
-		beginInfo.pInheritanceInfo = NULL;
+		recordGraphicsCommandBuffer(i);
+	}
+
 
-		if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to begin recording command buffer");
+#ifdef SUBMIT_COMPUTE
+
+	/// Record compute command buffers, one per swapchain image
+	for (int i = 0; i < computeCommandBuffers.size(); ++i) {
+		VkCommandBufferBeginInfo computeBeginInfo = {};
+		computeBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		computeBeginInfo.pNext = NULL;
+		computeBeginInfo.flags = 0;
+		computeBeginInfo.pInheritanceInfo = NULL;
+
+		if (vkBeginCommandBuffer(computeCommandBuffers[i], &computeBeginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to begin recording compute command buffer");
 		}
 
-		/// All application-specific recording happens here.
-		recordCommandBuffer(commandBuffers[i], i);
+		/// All application-specific recording happens here
+		recordComputeCommandBuffer(computeCommandBuffers[i], i);
 
-		if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to record command buffer!");
+		if (vkEndCommandBuffer(computeCommandBuffers[i]) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to record compute command buffer!");
 		}
 	}
 
+#endif
 
-#ifdef SUBMIT_COMPUTE
+}
 
-	/// Record compute command buffer
-	VkCommandBufferBeginInfo computeBeginInfo = {};
-	computeBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	computeBeginInfo.pNext = NULL;
-	computeBeginInfo.flags = 0;
-	computeBeginInfo.pInheritanceInfo = NULL;
+/// Records the graphics command buffer of one swapchain image.
+void VulkanAppBase::recordGraphicsCommandBuffer(int index) {
 
-	if (vkBeginCommandBuffer(computeCommandBuffer, &computeBeginInfo) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to begin recording compute command buffer");
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = 0;
+	beginInfo.pInheritanceInfo = NULL;
+
+	if (vkBeginCommandBuffer(commandBuffers[index], &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to begin recording command buffer");
 	}
 
-	/// All application-specific recording happens here
-	recordComputeCommandBuffer(computeCommandBuffer);
+	/// All application-specific recording happens here.
+	recordCommandBuffer(commandBuffers[index], index);
 
-	if (vkEndCommandBuffer(computeCommandBuffer) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to record compute command buffer!");
+	if (vkEndCommandBuffer(commandBuffers[index]) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to record command buffer!");
 	}
 
-#endif
-
 }
 
 /// Immediately re-records command buffers.
@@ -406,3 +419,8 @@ void VulkanAppBase::Repaint() {
 #endif
 	recordCommandBuffers();
 }
+
+/// Re-records the graphics command buffer of the image being prepared (its fence was waited upon in render(), before frame()).
+void VulkanAppBase::Repaint(uint32_t imageIndex) {
+	recordGraphicsCommandBuffer((int)imageIndex);
+}
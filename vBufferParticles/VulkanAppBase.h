@@ -27,6 +27,9 @@
 
 #define SUBMIT_COMPUTE // undef this to prevent application from submitting any compute work
 
+// Compute work is recorded once per swapchain image (so each image owns its own compute outputs) and signals a semaphore that the graphics submission
+// of the same frame waits on: no CPU-side wait on compute work, allowing generation for frame N+1 to overlap rasterization of frame N on the compute queue.
+
 
 //max amount of frames that can be prepared at once before being rendered
 #define MAX_FRAMES_IN_FLIGHT 3
@@ -112,6 +115,9 @@ private:
 	/// waitIdle: set to false ONLY when it is guaranteed that command buffers are not in use
 	void recordCommandBuffers(bool waitIdle = true);
 
+	/// Record the graphics command buffer of a single swapchain image (must not be in use)
+	void recordGraphicsCommandBuffer(int index);
+
 protected:
 
 	/// Deletes all swapchain-tied resources and recreates them along with all command buffers
@@ -133,8 +139,11 @@ protected:
 	/// Called to record a command buffer
 	virtual void recordCommandBuffer(VkCommandBuffer cmdBuffer, int index) = 0;
 
-	/// Called to record the compute command buffer
-	virtual void recordComputeCommandBuffer(VkCommandBuffer cmdBuffer) = 0;
+	/// Called to record a compute command buffer (one per swapchain image, submitted before the graphics command buffer with the same index)
+	virtual void recordComputeCommandBuffer(VkCommandBuffer cmdBuffer, int index) = 0;
+
+	/// Called after frame() to know whether the compute command buffer for this image must be submitted; returning false skips the dispatch entirely
+	virtual bool computeRequired(uint32_t imageIndex) = 0;
 
 
 public:
@@ -142,6 +151,10 @@ public:
 	/// Call to trigger an immediate update of the command buffers.
 	void Repaint();
 
+	/// Re-records the graphics command buffer of a single image, without waiting for the device; only call from frame(), with the image index
+	/// being prepared (its previous frame has completed by then).
+	void Repaint(uint32_t imageIndex);
+
 	///
 	/// Getters
 	///
@@ -168,13 +181,14 @@ private:
 	VkCommandPool commandPool;
 	VkCommandPool computeCommandPool;
 	std::vector<VkCommandBuffer> commandBuffers;
-	VkCommandBuffer computeCommandBuffer = VK_NULL_HANDLE;
+	std::vector<VkCommandBuffer> computeCommandBuffers;
 
 	/// Sync objects
 	std::vector<VkSemaphore> imageAvailableSemaphores;
 	std::vector<VkSemaphore> renderFinishedSemaphores;
+	std::vector<VkSemaphore> computeFinishedSemaphores;// signaled by the compute submission, waited upon by the graphics submission of the same frame
 	std::vector<VkFence> inFlightFences;
-	VkFence computeFence;
+	std::vector<VkFence> imagesInFlight;// fence of the frame currently using each swapchain image (and its compute outputs), VK_NULL_HANDLE if none
 
 	/// Specific flags
 	size_t currentFrame = 0;
@@ -186,7 +200,7 @@ private:
 	/// Default texture sampler
 	VkSampler sampler;
 
-	/// Depth buffer texture
+	/// Depth buffer texture (also sampled, eg. by passes compositing over a finished scene, and read as an input attachment by compact G-Buffer lighting)
 	Texture* depthBuffer;
 
 };// class VulkanAppBase
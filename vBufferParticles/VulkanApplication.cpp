@@ -3,7 +3,9 @@
 #include "GBufferScene.h"
 #include "GBuffer6Scene.h"
 #include "ForwardRendererScene.h"
+#include "ForwardPlusScene.h"
 #include "VBufferScene.h"
+#include "Multiview.h"
 
 #include <iostream>
 #include "StaticSettings.h"
@@ -13,6 +15,7 @@
 #define GBUFFER_SCENE_INDEX 1
 #define GBUFFER_6_SCENE_INDEX 2
 #define FWD_SCENE_INDEX 3
+#define FWDP_SCENE_INDEX 4
 
 
 
@@ -26,6 +29,7 @@ void VulkanApplication::init() {
 		currentSceneIndex = RC_SETTINGS->renderer == RuntimeConstantSettings::Renderer::V ? VBUFFER_SCENE_INDEX :
 							RC_SETTINGS->renderer == RuntimeConstantSettings::Renderer::G3 ? GBUFFER_SCENE_INDEX :
 							RC_SETTINGS->renderer == RuntimeConstantSettings::Renderer::G6 ? GBUFFER_6_SCENE_INDEX :
+							RC_SETTINGS->renderer == RuntimeConstantSettings::Renderer::FwdP ? FWDP_SCENE_INDEX :
 							FWD_SCENE_INDEX;
 
 	/// Initialize GUI with callbacks
@@ -33,6 +37,12 @@ void VulkanApplication::init() {
 		ui();
 	});
 
+	/// Stereo rendering relies on multiview, which may not be supported by the device
+	Multiview::checkSupport(devices);
+
+	/// The particle LOD relies on stores from the vertex & geometry stages, which may not be supported by the device either
+	ParticleSystem::checkSupport(devices);
+
 	/// Create objects dependant on swapchain layout
 	createSwapchainResources();
 
@@ -50,6 +60,14 @@ void VulkanApplication::init() {
 
 void VulkanApplication::createSwapchainResources() {
 
+	/// Render targets of the dynamic resolution, which the scene framebuffers use
+	if (DynamicResolution::enabled())
+		dynamicResolution = new DynamicResolution(this);
+
+	/// Timing of the particle budget, which the scene's particle systems draw under
+	if (ParticleBudget::enabled())
+		particleBudget = new ParticleBudget(this);
+
 	/// Create next scene (nb: may still be the same)
 	switch (currentSceneIndex) {
 	case VBUFFER_SCENE_INDEX:
@@ -60,10 +78,12 @@ void VulkanApplication::createSwapchainResources() {
 		currentScene = new GBuffer6Scene(this); break;//deferred rendering with 6-component G-Buffer
 	case FWD_SCENE_INDEX:
 		currentScene = new ForwardRendererScene(this); break;//forward
+	case FWDP_SCENE_INDEX:
+		currentScene = new ForwardPlusScene(this); break;//forward+ (depth prepass, tiled light lists)
 	}
 
-	/// Setup GUI for current scene and swapchain
-	gui->setupGUI(*getDescriptorPool(), *getCommandPool(), getSwapchain()->getSize(), currentScene->getRenderPass());
+	/// Setup GUI for current scene and swapchain (drawn over the upscaled image with dynamic resolution)
+	gui->setupGUI(*getDescriptorPool(), *getCommandPool(), getSwapchain()->getSize(), dynamicResolution ? dynamicResolution->getRenderPass() : currentScene->getRenderPass());
 
 }
 
@@ -84,6 +104,8 @@ void VulkanApplication::releaseSwapchainResources() {
 
 	/// Release resources tied to swapchain size
 	if (currentScene) DELETE(currentScene);
+	DELETE(dynamicResolution);
+	DELETE(particleBudget);
 }
 
 
@@ -91,9 +113,16 @@ void VulkanApplication::releaseSwapchainResources() {
 
 void VulkanApplication::frame(uint32_t currentImage, float dt, float time) {
 
+	/// Follow the GPU frame time with the amount of particles drawn (written to the particle UBOs by the scene update, nothing to re-record)
+	if (particleBudget) particleBudget->Update(currentImage);
+
 	/// Update scene
 	currentScene->Update(currentImage, dt, freezeTime ? FROZEN_TIME_SECONDS : time);
 
+	/// Follow the GPU frame time with the render scale (only this image's command buffer is re-recorded; the others as they come up)
+	if (dynamicResolution && dynamicResolution->Update(currentImage))
+		Repaint(currentImage);
+
 	/// Upon pressing T, toggle UI visibility
 	if (Input::getInstance(devices->getWindow())->isKeyDown(GLFW_KEY_T)) {
 		if (!pressingToggleGui) {
@@ -126,9 +155,19 @@ void VulkanApplication::ui() {
 	/// Whether we should freeze time
 	ImGui::Checkbox("Freeze Time", &freezeTime);
 
+	/// Internal render resolution
+	if (DynamicResolution::UI(dynamicResolution)) {
+		updateSwapchain();
+	}
+
+	/// Amount of particles drawn
+	if (ParticleBudget::UI(particleBudget)) {
+		updateSwapchain();
+	}
+
 
 	/// Drop-down list for scene displayed
-	static const char* scenes[] = { "Visibility Buffer", "Geometry Buffer (3)", "Geometry Buffer (6)", "Forward Renderer" };
+	static const char* scenes[] = { "Visibility Buffer", "Geometry Buffer (3)", "Geometry Buffer (6)", "Forward Renderer", "Forward+ Renderer" };
 	if (ImGui::BeginCombo("##scenes", scenes[currentSceneIndex])) {
 		for (int i = 0; i < IM_ARRAYSIZE(scenes); ++i) {
 			bool isSelected = currentSceneIndex == i;
@@ -169,7 +208,13 @@ void VulkanApplication::onSwapchainResize() {
 void VulkanApplication::recordCommandBuffer(VkCommandBuffer cmdBuffer, int index) {
 
 	/// Record scene commands and get last render pass
+	if (dynamicResolution) dynamicResolution->cmdBeginFrame(cmdBuffer, index);
+	if (particleBudget) particleBudget->cmdBeginFrame(cmdBuffer, index);
 	RenderPass* renderPass = currentScene->cmdBind(cmdBuffer, index);
+	if (particleBudget) particleBudget->cmdEndFrame(cmdBuffer, index);
+
+	/// Upscale to the swapchain image, and continue in the overlay pass
+	if (dynamicResolution) renderPass = dynamicResolution->cmdUpscale(cmdBuffer, index, renderPass);
 
 	/// Record GUI commands
 	if(showGui) gui->cmdBind(cmdBuffer, index);
@@ -180,10 +225,16 @@ void VulkanApplication::recordCommandBuffer(VkCommandBuffer cmdBuffer, int index
 }
 
 /// Record scene-specific compute command buffers.
-void VulkanApplication::recordComputeCommandBuffer(VkCommandBuffer cmdBuffer) {
+void VulkanApplication::recordComputeCommandBuffer(VkCommandBuffer cmdBuffer, int index) {
 
 	/// Record scene commands
-	currentScene->cmdBindCompute(cmdBuffer);
+	currentScene->cmdBindCompute(cmdBuffer, index);
 
 }
 
+/// Ask the scene whether its compute work needs to run this frame.
+bool VulkanApplication::computeRequired(uint32_t imageIndex) {
+
+	return currentScene->computeRequired(imageIndex);
+
+}
\ No newline at end of file
@@ -4,6 +4,8 @@
 
 #include "Scene.h"
 #include "UIOverlay.h"
+#include "DynamicResolution.h"
+#include "ParticleBudget.h"
 
 
 
@@ -34,8 +36,11 @@ protected:
 	/// Record a command buffer
 	void recordCommandBuffer(VkCommandBuffer cmdBuffer, int index) override;
 
-	/// Record the compute command buffer
-	void recordComputeCommandBuffer(VkCommandBuffer cmdBuffer) override;
+	/// Record a compute command buffer
+	void recordComputeCommandBuffer(VkCommandBuffer cmdBuffer, int index) override;
+
+	/// Whether the compute command buffer must be submitted this frame
+	bool computeRequired(uint32_t imageIndex) override;
 
 private:
 
@@ -48,6 +53,9 @@ private:
 
 	UIOverlay* gui;// graphical user interface
 
+	DynamicResolution* dynamicResolution = NULL;// internal render resolution driven by GPU frame times; NULL when scenes render at the swapchain resolution
+	ParticleBudget* particleBudget = NULL;// amount of particles drawn driven by GPU frame times; NULL when all particles are drawn
+
 	bool freezeTime = false;// should time be frozen?
 
 	bool showGui = true;// toggle on key press to save on draw calls and updates when necessary.
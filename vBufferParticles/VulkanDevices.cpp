@@ -104,6 +104,15 @@ void VulkanDevices::createVulkanInstance(bool enableValidationLayers, const std:
 		}
 	}
 
+	//Optional extensions, enabled when available: extended feature queries (required by VK_KHR_multiview)
+	std::vector<const char*> instanceExtensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	for (const auto& extension : extensions) {
+		if (strcmp(extension.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0) {
+			instanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+			physicalDeviceProperties2 = true;
+		}
+	}
+
 	//Optional app info parameters
 	VkApplicationInfo appInfo = {};
 	appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
@@ -117,8 +126,8 @@ void VulkanDevices::createVulkanInstance(bool enableValidationLayers, const std:
 	VkInstanceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 	createInfo.pApplicationInfo = &appInfo;
-	createInfo.enabledExtensionCount = glfwExtensionCount;
-	createInfo.ppEnabledExtensionNames = glfwExtensions;
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(instanceExtensions.size());
+	createInfo.ppEnabledExtensionNames = instanceExtensions.data();
 	createInfo.enabledLayerCount = 0;
 	if (enableValidationLayers) {
 		createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -278,7 +287,7 @@ void VulkanDevices::createLogicalDevice(bool enableValidationLayers, const std::
 
 	//Information for creating the queues (will only create one if all queues are the same)
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-	std::set<uint32_t> uniqueQueueFamilies = { queueFamilies.graphicsFamily.value(), queueFamilies.presentFamily.value() };
+	std::set<uint32_t> uniqueQueueFamilies = { queueFamilies.graphicsFamily.value(), queueFamilies.presentFamily.value(), queueFamilies.computeFamily.value() };
 	float queuePriority = 1.0f;
 	for (uint32_t queueFamily : uniqueQueueFamilies) {
 		VkDeviceQueueCreateInfo queueCreateInfo = {};
@@ -294,14 +303,40 @@ void VulkanDevices::createLogicalDevice(bool enableValidationLayers, const std::
 	deviceFeatures.samplerAnisotropy = VK_TRUE;
 	deviceFeatures.geometryShader = VK_TRUE;
 
+	//Optional device features, enabled when supported
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+	deviceFeatures.vertexPipelineStoresAndAtomics = supportedFeatures.vertexPipelineStoresAndAtomics;// particle LOD statistics
+	vertexStores = supportedFeatures.vertexPipelineStoresAndAtomics == VK_TRUE;
+
+	//Optional device extensions, enabled when supported: multiview (stereo rendering, see Multiview.h), whose base feature comes with the extension
+	std::vector<const char*> enabledExtensions = deviceExtensions;
+	VkPhysicalDeviceMultiviewFeaturesKHR multiviewFeatures = {};
+	multiviewFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES_KHR;
+	if (physicalDeviceProperties2 && checkDeviceExtensionSupport(physicalDevice, { VK_KHR_MULTIVIEW_EXTENSION_NAME })) {
+		VkPhysicalDeviceMultiviewFeaturesKHR supportedMultiview = {};
+		supportedMultiview.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES_KHR;
+		VkPhysicalDeviceFeatures2KHR features2 = {};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+		features2.pNext = &supportedMultiview;
+		auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR");
+		if (getFeatures2) getFeatures2(physicalDevice, &features2);
+		multiview = supportedMultiview.multiview == VK_TRUE;
+		multiviewGeometry = multiview && supportedMultiview.multiviewGeometryShader == VK_TRUE;// particle generation modes using geometry shaders
+		multiviewFeatures.multiview = supportedMultiview.multiview;
+		multiviewFeatures.multiviewGeometryShader = supportedMultiview.multiviewGeometryShader;
+		if (multiview) enabledExtensions.push_back(VK_KHR_MULTIVIEW_EXTENSION_NAME);
+	}
+
 	//Device creation info
 	VkDeviceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	createInfo.pNext = multiview ? &multiviewFeatures : NULL;
 	createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 	createInfo.pEnabledFeatures = &deviceFeatures;
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-	createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+	createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 	//setup validation layers, although modern Vulkan ignores the following fields
 	if (enableValidationLayers) {
 		createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
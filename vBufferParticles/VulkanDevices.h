@@ -56,6 +56,12 @@ struct VulkanDevices {
 	inline const VkQueue& getGraphicsQueue() const { return graphicsQueue; }
 	inline const VkQueue& getPresentQueue() const { return presentQueue; }
 	inline const VkQueue& getComputeQueue() const { return computeQueue; }
+	/// Whether vertex and geometry shaders may write to storage buffers (optional feature, enabled when supported)
+	inline bool supportsVertexStores() const { return vertexStores; }
+	/// Whether render passes may broadcast their subpasses to several views (VK_KHR_multiview, enabled when supported)
+	inline bool supportsMultiview() const { return multiview; }
+	/// Whether pipelines with a geometry shader may be used in multiview render passes
+	inline bool supportsMultiviewGeometry() const { return multiviewGeometry; }
 
 private:
 
@@ -93,6 +99,13 @@ private:
 	VkQueue presentQueue = VK_NULL_HANDLE;
 	VkQueue computeQueue = VK_NULL_HANDLE;
 
+	/// Optional features enabled on the logical device
+	bool vertexStores = false;
+	bool multiview = false;
+	bool multiviewGeometry = false;
+
+	/// Whether the instance has extended feature queries (VK_KHR_get_physical_device_properties2)
+	bool physicalDeviceProperties2 = false;
 
 };// struct VulkanDevices
 
@@ -8,6 +8,15 @@
 #include "StaticSettings.h"
 #include "Utils.h"
 #include "Particles.h"
+#include "VBufferScene.h"
+#include "GBufferScene.h"
+#include "ClusteredLights.h"
+#include "ParticleUpsampler.h"
+#include "ParticleOIT.h"
+#include "Multiview.h"
+#include "DynamicResolution.h"
+#include "TemporalUpscaler.h"
+#include "ParticleBudget.h"
 
 //#define CATCH_EXCEPTIONS // commented out to not catch any thrown exceptions in main()
 
@@ -16,6 +25,7 @@ int main(int argc, char ** argv) {
 	// Apply command-line arguments to create runtime constant settings
 	if (argc > 0) {
 		RuntimeConstantSettings settings;
+		bool stereo = false;// stereo rendering requested
 		std::cout << "Applying command-line arguments:" << std::endl;
 		for (int i = 0; i < argc; ++i) {
 			std::string arg = argv[i];
@@ -36,7 +46,7 @@ int main(int argc, char ** argv) {
 					} else if (sn == "shadercomp") {
 						settings.recompileShaders = sv == "1";
 					} else if (sn == "renderer") {
-						settings.renderer = sv == "fwd" ? RuntimeConstantSettings::Renderer::Fwd : sv == "g3" ? RuntimeConstantSettings::Renderer::G3 : sv == "g6" ? RuntimeConstantSettings::Renderer::G6 : RuntimeConstantSettings::Renderer::V;
+						settings.renderer = sv == "fwd" ? RuntimeConstantSettings::Renderer::Fwd : sv == "fwdp" ? RuntimeConstantSettings::Renderer::FwdP : sv == "g3" ? RuntimeConstantSettings::Renderer::G3 : sv == "g6" ? RuntimeConstantSettings::Renderer::G6 : RuntimeConstantSettings::Renderer::V;
 					} else if (sn == "pmode") {
 						settings.pMode = sv == "vege" ? RuntimeConstantSettings::ParticleMode::VeGe : sv == "ge" ? RuntimeConstantSettings::ParticleMode::Ge : sv == "co" ? RuntimeConstantSettings::ParticleMode::Co : RuntimeConstantSettings::ParticleMode::Ve;
 					} else if (sn == "pspread") {
@@ -45,12 +55,53 @@ int main(int argc, char ** argv) {
 						settings.pHalfSize = std::stof(sv);
 					} else if (sn == "pcount") {
 						settings.pCount = std::stoi(sv);
+					} else if (sn == "pstream") {
+						settings.pStreamBudget = std::stoi(sv);
 					} else if (sn == "pcomplexity") {
 						settings.pComplexity = std::stoi(sv);
 					} else if (sn == "freeze") {
 						settings.freezeTime = sv == "1";
 					} else if(sn == "cutout") {
 						ParticleSystem::setParticlesCutout(sv == "1");
+					} else if (sn == "pbake") {
+						ParticleSystem::setParticlesBaked(sv == "1");
+					} else if (sn == "psprite") {
+						if (std::stoi(sv) > 0) ParticleSystem::setSpriteResolution(std::stoi(sv));
+						ParticleSystem::setParticlesSpriteCache(std::stoi(sv) > 0);
+					} else if (sn == "plod") {
+						if (std::stof(sv) > 0) ParticleSystem::setLodSize(std::stof(sv));
+						ParticleSystem::setParticlesLod(std::stof(sv) > 0);
+					} else if (sn == "phull") {
+						ParticleSystem::setParticlesHull(sv == "1");
+					} else if (sn == "vformat") {
+						VBufferScene::setVisibilityFormat(sv == "f16" ? VisibilityFormat::VisF16x4 : sv == "u32x2" ? VisibilityFormat::VisU32x2 : sv == "u32" ? VisibilityFormat::VisU32 : VisibilityFormat::VisF32x4);
+					} else if (sn == "vpids") {
+						VBufferScene::setParticleIds(sv == "1");
+					} else if (sn == "vtiled") {
+						VBufferScene::setTiledShading(sv == "1");
+					} else if (sn == "vtricache") {
+						VBufferScene::setTriangleCache(sv == "1");
+					} else if (sn == "vmeshes") {
+						settings.vMeshes = sv == "1";
+					} else if (sn == "lights") {
+						ClusteredLights::setLightCount(std::stoi(sv));
+					} else if (sn == "pres") {
+						ParticleUpsampler::setFactor(std::stoi(sv));
+					} else if (sn == "dynres") {
+						DynamicResolution::setTarget(std::stof(sv));
+					} else if (sn == "tupscale") {
+						TemporalUpscaler::setScale(std::stoi(sv) / 100.f);
+					} else if (sn == "pbudget") {
+						ParticleBudget::setTarget(std::stof(sv));
+					} else if (sn == "pcull") {
+						ParticleSystem::setOcclusionCulling(sv == "1");
+					} else if (sn == "poit") {
+						ParticleOIT::setEnabled(sv == "1");
+					} else if (sn == "stereo") {
+						stereo = sv == "1";
+						Multiview::setEnabled(stereo);
+					} else if (sn == "gcompact") {
+						GBufferScene::setCompactLayout(sv == "1");
 					} else {
 						std::cout << "Unknown setting: " << sn << std::endl;
 					}
@@ -58,6 +109,14 @@ int main(int argc, char ** argv) {
 				}
 			} // else- the argument doesn't start with a dash, ignore it.
 		}
+		if (stereo && settings.renderer != RuntimeConstantSettings::Renderer::Fwd && settings.renderer != RuntimeConstantSettings::Renderer::V)
+			std::cout << "\tOnly the Forward and V-Buffer renderers draw in stereo; the starting renderer stays in mono." << std::endl;
+		else if (stereo && !Multiview::enabled())
+			std::cout << "\tReduced resolution and transparent particles composite a single view; the scene stays in mono." << std::endl;
+		else if (stereo && settings.renderer == RuntimeConstantSettings::Renderer::V && VBufferScene::usesTiledShading())
+			std::cout << "\tTiled shading shades a single view; the V-Buffer renderer stays in mono." << std::endl;
+		if (TemporalUpscaler::getScale() < 1.f && settings.renderer != RuntimeConstantSettings::Renderer::G3 && settings.renderer != RuntimeConstantSettings::Renderer::G6)
+			std::cout << "\tOnly the G-Buffer renderers upscale temporally; the starting renderer draws at the window resolution." << std::endl;
 		std::cout << std::endl;
 		StaticSettings::createInstance(settings);// apply rc settings
 		ParticleSystem::setParticlesComplexity(RC_SETTINGS->pComplexity);// apply new particle complexity before anything else.
@@ -35,6 +35,7 @@ using namespace System::Diagnostics;
 #define GBUFFER3 1
 #define GBUFFER6 2
 #define FORWARD 3
+#define FORWARD_PLUS 4
 
 // Geometry modes
 #define VERT 0
@@ -47,7 +48,7 @@ int testLengthSeconds = 30;// total time taken for each test; must be higher tha
 
 
 int testNum = 0;
-int testAmount = 272;// 272 tests in total + 640 for full particle counts + 164 for full particle sizes
+int testAmount = 340;// 340 tests in total + 400 for full particle counts + 205 for full particle sizes + 36 for particle encodings + 18 for V-Buffer resolve modes + 24 for particle resolutions + 20 for point light counts
 
 std::chrono::time_point<std::chrono::steady_clock> startTime;
 
@@ -194,13 +195,22 @@ void runProgram() {
 
 }
 
+/// Moves the particle difference measured by the app (at reduced particle resolution) next to the Afterburner session
+void renameParticleDifferenceFile(std::string newName) {
+	rename("particle_difference.txt", ("../vbparts-benchmarks/Benchmarks/" + newName + "_diff.csv").c_str());
+}
+
 /// Starts the process vBufferParticles, and returns after stopping it a bit later.
-void openProgram(int width, int height, int renderer, int pmode, float pspread, float psize, int pcount, int pcomplexity, bool cutout) {
+void openProgram(int width, int height, int renderer, int pmode, float pspread, float psize, int pcount, int pcomplexity, bool cutout, std::string vformat, bool vpids, std::string vlighting, int pres, int lights) {
 	
 	// Determine where the results will be stored
-	std::string rendererName = (renderer == VISIBILITY ? "v" : renderer == GBUFFER3 ? "g3" : renderer == GBUFFER6 ? "g6" : "fwd");
+	std::string rendererName = (renderer == VISIBILITY ? "v" : renderer == GBUFFER3 ? "g3" : renderer == GBUFFER6 ? "g6" : renderer == FORWARD_PLUS ? "fwdp" : "fwd");
 	std::string pModeName = (pmode == VERT ? "ve" : pmode == GEOM ? "ge" : pmode == COMP ? "co" : "vege");
 	std::string filename = rendererName + "_" + pModeName + "_" + std::to_string(pcount) + "_" + std::to_string(width) + "x" + std::to_string(height) + "_" + std::to_string(pcomplexity) + "_" + std::to_string((int)(pspread*1000.0f)) + "_" + std::to_string((int)(psize*1000.0f));
+	if (vformat != "f32" || vpids) filename += "_" + vformat + (vpids ? "_pid" : "");// V-Buffer encoding, only when not the default one
+	if (vlighting.size() > 0) filename += "_" + vlighting;// V-Buffer lighting pass, only when set explicitly
+	if (pres > 0) filename += "_r" + std::to_string(pres);// particle resolution divisor, only when set explicitly
+	if (lights > 0) filename += "_l" + std::to_string(lights);// point lights, only when there are any
 	printf(("Results will be stored to " + filename + "\n").c_str());
 	
 	// Skip the test if it's already been done
@@ -226,7 +236,16 @@ void openProgram(int width, int height, int renderer, int pmode, float pspread,
 							" -pcount:" + std::to_string(pcount) +	// particle count
 							" -pcomplexity:" + std::to_string(pcomplexity) + // particle complexity
 							" -freeze:1" +	// freeze time
-							" -cutout:" + (cutout ? "1":"0");	// whether to use cutout particles
+							" -cutout:" + (cutout ? "1":"0") +	// whether to use cutout particles
+							" -vformat:" + vformat +	// V-Buffer visibility format (saved by the app: always passed so that no test inherits the previous one's)
+							" -vpids:" + (vpids ? "1" : "0") +	// whether particles write their index to the V-Buffer (saved by the app as well)
+							" -lights:" + std::to_string(lights);	// point lights of the deferred and Forward+ renderers (the forward renderer has none)
+	if (vlighting.size() > 0)
+		command += std::string(" -vmeshes:1") +	// V-Buffer resolve tests shade meshes as well as particles
+				   " -vtiled:" + (vlighting != "full" ? "1" : "0") +	// full-screen lighting subpass or tiled shading kernels
+				   " -vtricache:" + (vlighting == "cache" ? "1" : "0");	// whether the tiled shading kernels cache the triangles of each tile
+	if (pres > 0)
+		command += " -pres:" + std::to_string(pres);	// particle resolution divisor
 	system(command.c_str());
 	
 	// Wait for benchmark to be over (system() is what should stall, join() actually shouldn't block at this point if all went fine)
@@ -234,6 +253,7 @@ void openProgram(int width, int height, int renderer, int pmode, float pspread,
 	
 	// Retrieve logging file to rename it
 	renameAfterburnerSessionFile(filename);
+	if (pres > 1) renameParticleDifferenceFile(filename);// RMSE & PSNR against full resolution particles
 	
 	printf(("\n\n---> Done recording performance. Results saved in file: "+filename+".csv\n\n").c_str());
 }
@@ -261,6 +281,11 @@ struct Settings {
 	int count = 1024 * 1024;
 	int complexity = 2;
 	bool cutout = false;
+	std::string vformat = "f32";// V-Buffer visibility format: "f16", "f32", "u32x2" or "u32"
+	bool vpids = false;// whether particles write their index to the V-Buffer (integer formats only)
+	std::string vlighting = "";// V-Buffer lighting pass: "full", "tiled" or "cache" (tiled with triangle cache), with meshes shown; empty: use the app's defaults
+	int pres = 0;// particle resolution divisor: 1, 2 or 4; 0: use the app's default
+	int lights = 0;// point lights, up to 4096
 } settings;
 
 /// Starts a test with a specific set of settings
@@ -273,7 +298,7 @@ void record(Settings s) {
 	int minutesSpent = std::chrono::duration_cast<std::chrono::minutes>(elapsed).count();
 	std::cout << "\tSpent " << minutesSpent << " mins so far; expect about " << (testLengthSeconds * testAmount / 60) << " mins total." << std::endl << std::endl;
 
-	openProgram(s.width, s.height, s.renderer, s.pmode, s.spread, s.size, s.count, s.complexity, s.cutout);
+	openProgram(s.width, s.height, s.renderer, s.pmode, s.spread, s.size, s.count, s.complexity, s.cutout, s.vformat, s.vpids, s.vlighting, s.pres, s.lights);
 }
 
 
@@ -282,7 +307,7 @@ void record(Settings s) {
 /// All different tests defined here
 
 
-// 4 tests
+// 5 tests
 void rendererTests(Settings settings) {
 	settings.renderer = VISIBILITY;
 	record(settings);
@@ -295,9 +320,12 @@ void rendererTests(Settings settings) {
 
 	settings.renderer = FORWARD;
 	record(settings);
+
+	settings.renderer = FORWARD_PLUS;
+	record(settings);
 }
 
-// 16 tests (4 * 4)
+// 20 tests (4 * 5)
 void particleModeTests(Settings settings) {
 
 	settings.pmode = VERT;
@@ -313,7 +341,7 @@ void particleModeTests(Settings settings) {
 	rendererTests(settings);// test for each renderer
 }
 
-// 16 tests (1 * 16)
+// 20 tests (1 * 20)
 void noParticlesTests(Settings settings) {
 
 	settings.count = 0;
@@ -321,7 +349,7 @@ void noParticlesTests(Settings settings) {
 
 }
 
-// 48 tests (3 * 16)
+// 60 tests (3 * 20)
 void resolutionTests(Settings settings) {
 
 	settings.width = 1024;
@@ -338,7 +366,7 @@ void resolutionTests(Settings settings) {
 
 }
 
-// 64 tests (4 * 16)
+// 80 tests (4 * 20)
 void complexityTests(Settings settings) {
 
 	settings.complexity = 0;
@@ -355,7 +383,7 @@ void complexityTests(Settings settings) {
 
 }
 
-// 48 tests (3 * 16)
+// 60 tests (3 * 20)
 void particleCountTests(Settings settings) {
 
 	settings.count = 1024 * 1024 * 2;
@@ -369,7 +397,7 @@ void particleCountTests(Settings settings) {
 
 }
 
-// 320 tests (20 * 16)
+// 400 tests (20 * 20)
 void fullParticleCountTests(Settings settings) {
 
 	settings.count = 0;
@@ -380,7 +408,7 @@ void fullParticleCountTests(Settings settings) {
 
 }
 
-// 48 tests (3 * 16)
+// 60 tests (3 * 20)
 void particleSizeTests(Settings settings) {
 
 	settings.size = 0.03f;
@@ -394,7 +422,7 @@ void particleSizeTests(Settings settings) {
 
 }
 
-// 164 tests (41 * 4)
+// 205 tests (41 * 5)
 void fullParticleSizeTests(Settings settings) {
 
 	settings.size = 0;
@@ -406,7 +434,7 @@ void fullParticleSizeTests(Settings settings) {
 
 }
 
-// 48 tests (3 * 16)
+// 60 tests (3 * 20)
 void particleSpreadTests(Settings settings) {
 
 	settings.spread = 0.4f;
@@ -420,6 +448,91 @@ void particleSpreadTests(Settings settings) {
 
 }
 
+// 36 tests (2 * 3 * 3 * 2); crossover between particles written as quantized uvs or as indices to the 32-bit V-Buffer:
+// indices save first pass bandwidth but re-generate a particle per covered pixel in the lighting pass, so the cost depends on both count and size
+void particleEncodingTests(Settings settings) {
+
+	settings.renderer = VISIBILITY;
+	settings.vformat = "u32";
+	int pmodes[] = { VERT, COMP };
+	int counts[] = { 1024 * 256, 1024 * 1024, 1024 * 1024 * 4 };
+	float sizes[] = { 0.003f, 0.03f, 0.3f };
+	for (int pmode : pmodes) {
+		settings.pmode = pmode;
+		for (int count : counts) {
+			settings.count = count;
+			for (float size : sizes) {
+				settings.size = size;
+
+				settings.vpids = false;
+				record(settings);
+
+				settings.vpids = true;
+				record(settings);
+			}
+		}
+	}
+
+}
+
+// 18 tests (3 * 2 * 3); frame-time delta of the V-Buffer resolve (full-screen subpass, tiled kernels, tiled kernels caching the triangles of each tile)
+// at high resolutions, where the vertices loaded and transformed per pixel dominate the lighting pass
+void resolveTests(Settings settings) {
+
+	settings.renderer = VISIBILITY;
+	int resolutions[][2] = { { 1920, 1080 }, { 2560, 1440 }, { 3840, 2160 } };
+	int counts[] = { 0, 1024 * 1024 };// meshes only, then meshes and particles
+	std::string lightings[] = { "full", "tiled", "cache" };
+	for (auto& resolution : resolutions) {
+		settings.width = resolution[0];
+		settings.height = resolution[1];
+		for (int count : counts) {
+			settings.count = count;
+			for (const std::string& lighting : lightings) {
+				settings.vlighting = lighting;
+				record(settings);
+			}
+		}
+	}
+
+}
+
+// 24 tests (2 * 4 * 3); frame-time delta of particles drawn at full, half and quarter resolution (depth-aware upsample), as particles grow to fill the screen.
+// Reduced resolution runs also store the difference with full resolution particles (RMSE, PSNR) to <name>_diff.csv
+void particleResolutionTests(Settings settings) {
+
+	int renderers[] = { VISIBILITY, FORWARD };
+	float sizes[] = { 0.03f, 0.3f, 0.6f, 1.2f };
+	int resolutions[] = { 1, 2, 4 };
+	for (int renderer : renderers) {
+		settings.renderer = renderer;
+		for (float size : sizes) {
+			settings.size = size;
+			for (int pres : resolutions) {
+				settings.pres = pres;
+				record(settings);
+			}
+		}
+	}
+
+}
+
+// 20 tests (4 * 5); frame-time of the clustered point lights (binned in froxels for the deferred renderers, in screen tiles for Forward+) as their count grows.
+// The forward renderer has no point lights, and is left out
+void lightCountTests(Settings settings) {
+
+	int renderers[] = { VISIBILITY, GBUFFER3, GBUFFER6, FORWARD_PLUS };
+	int counts[] = { 0, 64, 256, 1024, 4096 };
+	for (int renderer : renderers) {
+		settings.renderer = renderer;
+		for (int lights : counts) {
+			settings.lights = lights;
+			record(settings);
+		}
+	}
+
+}
+
 ///----------------
 
 
@@ -428,7 +541,7 @@ void particleSpreadTests(Settings settings) {
 int main(int argc, char** argv) {
 
 	// Apply command-line params
-	bool usualTests = true, fullCountTests = false, fullSizeTests = false, cutout = false;
+	bool usualTests = true, fullCountTests = false, fullSizeTests = false, encodingTests = false, resolveModeTests = false, lowResTests = false, lightTests = false, cutout = false;
 	for (int i = 0; i < argc; ++i) {
 		std::string arg = argv[i];
 		if (arg.size() > 0){
@@ -436,16 +549,32 @@ int main(int argc, char** argv) {
 				arg = arg.substr(1);
 				if (arg == "no-usual") {
 					usualTests = false;
-					testAmount -= 272;
+					testAmount -= 340;
 					std::cout << "Will bypass usual tests." << std::endl;
 				} else if (arg == "full-count") {
 					fullCountTests = true;
-					testAmount += 320;
+					testAmount += 400;
 					std::cout << "Will execute full particle count tests." << std::endl;
 				} else if (arg == "full-size") {
 					fullSizeTests = true;
-					testAmount += 164;
+					testAmount += 205;
 					std::cout << "Will execute full particle size tests." << std::endl;
+				} else if (arg == "encoding") {
+					encodingTests = true;
+					testAmount += 36;
+					std::cout << "Will execute V-Buffer particle encoding tests." << std::endl;
+				} else if (arg == "resolve") {
+					resolveModeTests = true;
+					testAmount += 18;
+					std::cout << "Will execute V-Buffer resolve tests." << std::endl;
+				} else if (arg == "lowres") {
+					lowResTests = true;
+					testAmount += 24;
+					std::cout << "Will execute particle resolution tests." << std::endl;
+				} else if (arg == "lights") {
+					lightTests = true;
+					testAmount += 20;
+					std::cout << "Will execute point light count tests." << std::endl;
 				} else if (arg == "cutout") {
 					cutout = true;
 					std::cout << "All tests will be executed with cut-out mode turned on. Note that this may produce unexpected results for tests with particle complexity != 2." << std::endl;
@@ -474,21 +603,33 @@ int main(int argc, char** argv) {
 
 	startTime = std::chrono::high_resolution_clock::now();
 
-	// Perform tests (208 total if no extensive pCount tests are performed)
+	// Perform tests (260 total if no extensive pCount tests are performed)
 	Settings settings;
 	settings.cutout = cutout;
 	if (usualTests) {
-		noParticlesTests(settings); // 16 tests
-		resolutionTests(settings); // 48 tests
-		complexityTests(settings); // 64 tests (48 effectively)
-		particleCountTests(settings); // 48 tests (32 effectively)
-		particleSizeTests(settings); // 48 tests (32 effectively)
-		particleSpreadTests(settings); // 48 tests (32 effectively)
+		noParticlesTests(settings); // 20 tests
+		resolutionTests(settings); // 60 tests
+		complexityTests(settings); // 80 tests (60 effectively)
+		particleCountTests(settings); // 60 tests (40 effectively)
+		particleSizeTests(settings); // 60 tests (40 effectively)
+		particleSpreadTests(settings); // 60 tests (40 effectively)
 	}
 	if (fullCountTests) {
-		fullParticleCountTests(settings); // 320 tests
+		fullParticleCountTests(settings); // 400 tests
 	}
 	if (fullSizeTests) {
-		fullParticleSizeTests(settings); // 320 tests
+		fullParticleSizeTests(settings); // 205 tests
+	}
+	if (encodingTests) {
+		particleEncodingTests(settings); // 36 tests
+	}
+	if (resolveModeTests) {
+		resolveTests(settings); // 18 tests
+	}
+	if (lowResTests) {
+		particleResolutionTests(settings); // 24 tests
+	}
+	if (lightTests) {
+		lightCountTests(settings); // 20 tests
 	}
 }